@@ -0,0 +1,721 @@
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Differential accuracy check of optimized correlator paths
+ *
+ * Program compares two backends of correlator on synthetic rasters:
+ * reference one - the original scalar code (REFERENCE level of
+ * GDALCPUDispatch), detection on the whole image and exhaustive
+ * MatchFeaturePoints, and optimized one, configured by options: level
+ * of SIMD kernels, memory budget of detection (which leads to octave
+ * by octave or tiled processing) and matching method.
+ *
+ * For every case the second raster is produced from the first one by
+ * known affine transformation (shift, rotation, scale), so matches of
+ * both backends are verified by geometry. Reported values:
+ * - repeatability: share of reference points, which are also found by
+ * optimized backend at the same position, scale and sign;
+ * - descriptor delta: distance between descriptors of repeated points,
+ * relative to norm of reference descriptor (maximum and mean);
+ * - precision: share of matches, which agree with transformation;
+ * - recall: share of points of the first raster, which have counterpart
+ * on the second one, matched correctly;
+ * - agreement: share of reference matches, found by optimized backend;
+ * - runtime ratio: time of optimized backend to time of reference one.
+ *
+ * By default optimized backend uses the highest SIMD level of CPU, so
+ * integral image, Hessian filters, descriptors and distances of matching
+ * are computed by optimized kernels instead of the original code
+ * (SCALAR level selects the same kernels without SIMD). Other
+ * optimizations are enabled by options.
+ *
+ * Results are printed as JSON. Program fails (returns 1), if
+ * repeatability or descriptor delta exceed tolerances, or precision
+ * or recall of optimized backend drop below reference ones more than
+ * allowed, or optimized backend is too slow (if limit is specified).
+ *
+ * This program is free software and
+ * is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY
+ */
+
+#include "gdal.h"
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+
+#include "GDALCorrelator.h"
+#include "GDALCPUDispatch.h"
+#include "GDALSyntheticRaster.h"
+#include "GDALCorrelatorStats.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <string>
+
+using namespace std;
+
+/**
+ * Methods of matching, which may be used by optimized backend
+ */
+enum AccuracyMatcher
+{
+	MATCHER_EXHAUSTIVE,
+	MATCHER_BLOCKED,
+	MATCHER_INDEXED,
+	MATCHER_MUTUAL
+};
+
+static const char *apszMatcherNames[] =
+{
+	"exhaustive", "blocked", "indexed", "mutual"
+};
+
+/**
+ * Configuration of backend
+ */
+struct AccuracyBackend
+{
+	GDALCPUDispatch::Level eLevel;
+	GIntBig nMemoryBudget;
+	AccuracyMatcher eMatcher;
+	int nChecks;
+};
+
+/**
+ * Known transformation of the second raster: rotation by angle and
+ * scaling around center of raster, then shift
+ */
+struct AccuracyCase
+{
+	const char *pszName;
+	double dfAngle;
+	double dfScale;
+	double dfShiftX;
+	double dfShiftY;
+};
+
+static const AccuracyCase asCases[] =
+{
+	{ "shift", 0.0, 1.0, 7.0, 5.0 },
+	{ "rotation", 6.0, 1.0, -12.0, 9.0 },
+	{ "scale", 0.0, 1.08, 4.0, -6.0 },
+	{ "affine", -4.0, 0.94, 10.0, 3.0 }
+};
+
+static const int nCases = sizeof(asCases) / sizeof(asCases[0]);
+
+/**
+ * Measured values of one case
+ */
+struct AccuracyMetrics
+{
+	double dfRepeatability;
+	double dfMaxDescriptorDelta;
+	double dfMeanDescriptorDelta;
+	double adfPrecision[2];
+	double adfRecall[2];
+	int anMatches[2];
+	double dfAgreement;
+	double adfSeconds[2];
+};
+
+/**
+ * Compose transformation of case from pixel/line of the first raster
+ * to pixel/line of the second one, in the same form as geotransform.
+ *
+ * @param psCase Case
+ * @param nWidth Width of rasters
+ * @param nHeight Height of rasters
+ * @param padfTransform Resulting array of 6 values
+ */
+static void ComputeCaseTransform(const AccuracyCase *psCase,
+		int nWidth, int nHeight, double *padfTransform)
+{
+	double dfAngle = psCase->dfAngle * atan(1.0) / 45.0;
+	double dfCos = cos(dfAngle) * psCase->dfScale;
+	double dfSin = sin(dfAngle) * psCase->dfScale;
+	double dfCenterX = nWidth / 2.0;
+	double dfCenterY = nHeight / 2.0;
+
+	padfTransform[1] = dfCos;
+	padfTransform[2] = -dfSin;
+	padfTransform[4] = dfSin;
+	padfTransform[5] = dfCos;
+	padfTransform[0] = dfCenterX + psCase->dfShiftX
+			- dfCos * dfCenterX + dfSin * dfCenterY;
+	padfTransform[3] = dfCenterY + psCase->dfShiftY
+			- dfSin * dfCenterX - dfCos * dfCenterY;
+}
+
+/**
+ * Resample field by inverse of transformation with bilinear
+ * interpolation. Positions outside of field take the nearest value.
+ *
+ * @param pafField Source field
+ * @param pafWarped Resulting field of the same size
+ * @param nWidth Width of fields
+ * @param nHeight Height of fields
+ * @param padfTransform Transformation from source to result
+ */
+static void WarpTexture(const float *pafField, float *pafWarped,
+		int nWidth, int nHeight, const double *padfTransform)
+{
+	double dfDet = padfTransform[1] * padfTransform[5] -
+			padfTransform[2] * padfTransform[4];
+
+	for (int i = 0; i < nHeight; i++)
+		for (int j = 0; j < nWidth; j++)
+		{
+			// Centers of pixels are mapped
+			double dfX = j + 0.5 - padfTransform[0];
+			double dfY = i + 0.5 - padfTransform[3];
+			double dfSrcX = (padfTransform[5] * dfX - padfTransform[2] * dfY)
+					/ dfDet - 0.5;
+			double dfSrcY = (padfTransform[1] * dfY - padfTransform[4] * dfX)
+					/ dfDet - 0.5;
+
+			dfSrcX = MIN(MAX(dfSrcX, 0.0), nWidth - 1.0);
+			dfSrcY = MIN(MAX(dfSrcY, 0.0), nHeight - 1.0);
+
+			int nCol = MIN((int)dfSrcX, nWidth - 2);
+			int nRow = MIN((int)dfSrcY, nHeight - 2);
+			double dfFracX = dfSrcX - nCol;
+			double dfFracY = dfSrcY - nRow;
+
+			const float *pafTop = pafField + (size_t)nRow * nWidth + nCol;
+			const float *pafBottom = pafTop + nWidth;
+
+			pafWarped[(size_t)i * nWidth + j] = (float)(
+					(pafTop[0] * (1 - dfFracX) + pafTop[1] * dfFracX) * (1 - dfFracY) +
+					(pafBottom[0] * (1 - dfFracX) + pafBottom[1] * dfFracX) * dfFracY);
+		}
+}
+
+/**
+ * Detect and match feature points on pair of rasters by backend.
+ *
+ * @param psBackend Configuration of backend
+ * @param apoDatasets Two rasters
+ * @param paoCollections Two resulting collections
+ * @param poMatched Resulting matches
+ * @param pdfSeconds Wall time of detection and matching
+ *
+ * @return CE_None or CE_Failure if error occurs or SIMD level
+ * of backend isn't supported by CPU.
+ */
+static CPLErr RunBackend(const AccuracyBackend *psBackend,
+		GDALDataset **apoDatasets, int nOctaveStart, int nOctaveEnd,
+		double dfThreshold, double dfMatchingThreshold,
+		GDALFeaturePointsCollection *paoCollections,
+		GDALMatchedPointsCollection *poMatched, double *pdfSeconds)
+{
+	int anBands[3] = { 1, 2, 3 };
+
+	// Kernels of lower level would run under name of requested one
+	GDALCPUDispatch::Level eLevel = GDALCPUDispatch::SetLevel(psBackend->eLevel);
+	if (eLevel != psBackend->eLevel)
+	{
+		CPLError(CE_Failure, CPLE_NotSupported,
+				"SIMD level %s isn't supported, the highest one is %s",
+				GDALCPUDispatch::GetLevelName(psBackend->eLevel),
+				GDALCPUDispatch::GetLevelName(eLevel));
+		return CE_Failure;
+	}
+
+	double dfStart = GDALCorrelatorStats::GetWallClock();
+	CPLErr eErr = CE_None;
+
+	for (int k = 0; k < 2 && eErr == CE_None; k++)
+	{
+		paoCollections[k].Clear();
+		eErr = GatherFeaturePoints(apoDatasets[k], anBands,
+				&paoCollections[k], nOctaveStart, nOctaveEnd, dfThreshold,
+				NULL, psBackend->nMemoryBudget);
+	}
+
+	if (eErr != CE_None)
+		return eErr;
+
+	poMatched->Clear();
+	switch (psBackend->eMatcher)
+	{
+		case MATCHER_BLOCKED:
+			eErr = GDALSimpleSURF::MatchFeaturePointsBlocked(poMatched,
+					&paoCollections[0], &paoCollections[1],
+					dfMatchingThreshold);
+			break;
+		case MATCHER_INDEXED:
+			eErr = GDALSimpleSURF::MatchFeaturePointsIndexed(poMatched,
+					&paoCollections[0], &paoCollections[1],
+					dfMatchingThreshold, psBackend->nChecks);
+			break;
+		case MATCHER_MUTUAL:
+			eErr = GDALSimpleSURF::MatchFeaturePointsMutual(poMatched,
+					&paoCollections[0], &paoCollections[1],
+					dfMatchingThreshold);
+			break;
+		default:
+			eErr = GDALSimpleSURF::MatchFeaturePoints(poMatched,
+					&paoCollections[0], &paoCollections[1],
+					dfMatchingThreshold);
+			break;
+	}
+
+	*pdfSeconds = GDALCorrelatorStats::GetWallClock() - dfStart;
+
+	return eErr;
+}
+
+/**
+ * Compare points of the same raster found by two backends.
+ * Point is repeated, if point of the same scale and sign is found
+ * within tolerance.
+ *
+ * @param poReference Points of reference backend
+ * @param poOptimized Points of optimized backend
+ * @param dfTolerance Maximal distance between positions in pixels
+ * @param pnRepeated Number of repeated reference points
+ * @param pdfMaxDelta Maximal relative distance between descriptors
+ * @param pdfSumDelta Sum of relative distances between descriptors
+ */
+static void CompareDetection(GDALFeaturePointsCollection *poReference,
+		GDALFeaturePointsCollection *poOptimized, double dfTolerance,
+		int *pnRepeated, double *pdfMaxDelta, double *pdfSumDelta)
+{
+	for (int i = 0; i < poReference->GetSize(); i++)
+	{
+		const GDALFeaturePoint *poRef = poReference->GetPoint(i);
+		const double *padfRef = poRef->GetDescriptor();
+		double dfBest = -1;
+
+		for (int j = 0; j < poOptimized->GetSize(); j++)
+		{
+			const GDALFeaturePoint *poOpt = poOptimized->GetPoint(j);
+
+			if (poOpt->GetScale() != poRef->GetScale() ||
+					poOpt->GetSign() != poRef->GetSign() ||
+					fabs((double)poOpt->GetX() - poRef->GetX()) > dfTolerance ||
+					fabs((double)poOpt->GetY() - poRef->GetY()) > dfTolerance)
+				continue;
+
+			const double *padfOpt = poOpt->GetDescriptor();
+			double dfDiff = 0, dfNorm = 0;
+			for (int k = 0; k < GDALFeaturePoint::DESC_SIZE; k++)
+			{
+				dfDiff += (padfOpt[k] - padfRef[k]) * (padfOpt[k] - padfRef[k]);
+				dfNorm += padfRef[k] * padfRef[k];
+			}
+
+			double dfDelta = (dfNorm > 0) ? sqrt(dfDiff / dfNorm) : sqrt(dfDiff);
+			if (dfBest < 0 || dfDelta < dfBest)
+				dfBest = dfDelta;
+		}
+
+		if (dfBest >= 0)
+		{
+			(*pnRepeated)++;
+			*pdfMaxDelta = MAX(*pdfMaxDelta, dfBest);
+			*pdfSumDelta += dfBest;
+		}
+	}
+}
+
+/**
+ * Check whether point of the second raster corresponds to point
+ * of the first one under transformation.
+ */
+static bool IsCorrespondent(const GDALFeaturePoint *poFirst,
+		const GDALFeaturePoint *poSecond, const double *padfTransform,
+		double dfTolerance)
+{
+	double dfX = poFirst->GetX() + 0.5;
+	double dfY = poFirst->GetY() + 0.5;
+	double dfDX = padfTransform[0] + dfX * padfTransform[1] +
+			dfY * padfTransform[2] - (poSecond->GetX() + 0.5);
+	double dfDY = padfTransform[3] + dfX * padfTransform[4] +
+			dfY * padfTransform[5] - (poSecond->GetY() + 0.5);
+
+	return dfDX * dfDX + dfDY * dfDY <= dfTolerance * dfTolerance;
+}
+
+/**
+ * Evaluate matches by known transformation.
+ *
+ * @param paoCollections Points of both rasters
+ * @param poMatched Matches
+ * @param padfTransform Transformation from the first raster to the second
+ * @param dfTolerance Maximal error of correct match in pixels
+ * @param pdfPrecision Share of correct matches
+ * @param pdfRecall Share of points with counterpart, matched correctly
+ */
+static void EvaluateMatches(GDALFeaturePointsCollection *paoCollections,
+		GDALMatchedPointsCollection *poMatched, const double *padfTransform,
+		double dfTolerance, double *pdfPrecision, double *pdfRecall)
+{
+	int nCorrect = 0;
+	for (int i = 0; i < poMatched->GetSize(); i++)
+		if (IsCorrespondent(poMatched->GetFirstPoint(i),
+				poMatched->GetSecondPoint(i), padfTransform, dfTolerance))
+			nCorrect++;
+
+	// Points of the first raster, which are detected on the second one
+	int nCorrespondent = 0;
+	for (int i = 0; i < paoCollections[0].GetSize(); i++)
+	{
+		const GDALFeaturePoint *poFirst = paoCollections[0].GetPoint(i);
+
+		for (int j = 0; j < paoCollections[1].GetSize(); j++)
+		{
+			const GDALFeaturePoint *poSecond = paoCollections[1].GetPoint(j);
+
+			if (poSecond->GetSign() == poFirst->GetSign() &&
+					IsCorrespondent(poFirst, poSecond, padfTransform, dfTolerance))
+			{
+				nCorrespondent++;
+				break;
+			}
+		}
+	}
+
+	*pdfPrecision = (poMatched->GetSize() > 0) ?
+			(double)nCorrect / poMatched->GetSize() : 1.0;
+	*pdfRecall = (nCorrespondent > 0) ?
+			MIN((double)nCorrect / nCorrespondent, 1.0) : 1.0;
+}
+
+/**
+ * Main function of accuracy check
+ */
+int main(int argc, char* argv[])
+{
+	const char* USAGE = "Usage: [-size width height] [-type Byte|UInt16|Float32]"
+			" [-density blobs_per_megapixel] [-octaves start end]"
+			" [-threshold value] [-seed n]"
+			" [-simd SCALAR|SSE2|AVX2|AVX512] [-budget bytes]"
+			" [-matcher exhaustive|blocked|indexed|mutual] [-checks n]"
+			" [-min-repeatability value] [-max-descriptor-delta value]"
+			" [-max-precision-drop value] [-max-recall-drop value]"
+			" [-max-runtime-ratio value] [-o output.json]\n";
+
+	int nWidth = 768;
+	int nHeight = 768;
+	GDALDataType eType = GDT_Byte;
+	double dfDensity = 2000;
+	int nOctaveStart = 1;
+	int nOctaveEnd = 3;
+	double dfThreshold = 0.001;
+	double dfMatchingThreshold = 0.015;
+	GUInt32 nSeed = 1;
+	const char *pszOutput = NULL;
+
+	AccuracyBackend sReference;
+	sReference.eLevel = GDALCPUDispatch::LEVEL_REFERENCE;
+	sReference.nMemoryBudget = 0;
+	sReference.eMatcher = MATCHER_EXHAUSTIVE;
+	sReference.nChecks = 0;
+
+	AccuracyBackend sOptimized;
+	sOptimized.eLevel = GDALCPUDispatch::DetectLevel();
+	sOptimized.nMemoryBudget = 0;
+	sOptimized.eMatcher = MATCHER_EXHAUSTIVE;
+	sOptimized.nChecks = 128;
+
+	// Tolerances, position ones are in pixels
+	double dfPositionTolerance = 1.0;
+	double dfMatchTolerance = 3.0;
+	double dfMinRepeatability = 0.98;
+	double dfMaxDescriptorDelta = 1e-6;
+	double dfMaxPrecisionDrop = 0.02;
+	double dfMaxRecallDrop = 0.02;
+	double dfMaxRuntimeRatio = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (EQUAL(argv[i], "-size") && i + 2 < argc)
+		{
+			nWidth = atoi(argv[++i]);
+			nHeight = atoi(argv[++i]);
+		}
+		else if (EQUAL(argv[i], "-type") && i + 1 < argc)
+		{
+			i++;
+			if (EQUAL(argv[i], "Byte"))
+				eType = GDT_Byte;
+			else if (EQUAL(argv[i], "UInt16"))
+				eType = GDT_UInt16;
+			else if (EQUAL(argv[i], "Float32"))
+				eType = GDT_Float32;
+			else
+			{
+				printf(USAGE);
+				return -1;
+			}
+		}
+		else if (EQUAL(argv[i], "-density") && i + 1 < argc)
+			dfDensity = CPLAtof(argv[++i]);
+		else if (EQUAL(argv[i], "-octaves") && i + 2 < argc)
+		{
+			nOctaveStart = atoi(argv[++i]);
+			nOctaveEnd = atoi(argv[++i]);
+		}
+		else if (EQUAL(argv[i], "-threshold") && i + 1 < argc)
+			dfThreshold = CPLAtof(argv[++i]);
+		else if (EQUAL(argv[i], "-seed") && i + 1 < argc)
+			nSeed = (GUInt32)atoi(argv[++i]);
+		else if (EQUAL(argv[i], "-simd") && i + 1 < argc)
+		{
+			if (GDALCPUDispatch::ParseLevel(argv[++i],
+					&sOptimized.eLevel) != CE_None)
+			{
+				printf(USAGE);
+				return -1;
+			}
+		}
+		else if (EQUAL(argv[i], "-budget") && i + 1 < argc)
+			sOptimized.nMemoryBudget = CPLAtoGIntBig(argv[++i]);
+		else if (EQUAL(argv[i], "-matcher") && i + 1 < argc)
+		{
+			i++;
+			if (EQUAL(argv[i], "exhaustive"))
+				sOptimized.eMatcher = MATCHER_EXHAUSTIVE;
+			else if (EQUAL(argv[i], "blocked"))
+				sOptimized.eMatcher = MATCHER_BLOCKED;
+			else if (EQUAL(argv[i], "indexed"))
+				sOptimized.eMatcher = MATCHER_INDEXED;
+			else if (EQUAL(argv[i], "mutual"))
+				sOptimized.eMatcher = MATCHER_MUTUAL;
+			else
+			{
+				printf(USAGE);
+				return -1;
+			}
+		}
+		else if (EQUAL(argv[i], "-checks") && i + 1 < argc)
+			sOptimized.nChecks = atoi(argv[++i]);
+		else if (EQUAL(argv[i], "-min-repeatability") && i + 1 < argc)
+			dfMinRepeatability = CPLAtof(argv[++i]);
+		else if (EQUAL(argv[i], "-max-descriptor-delta") && i + 1 < argc)
+			dfMaxDescriptorDelta = CPLAtof(argv[++i]);
+		else if (EQUAL(argv[i], "-max-precision-drop") && i + 1 < argc)
+			dfMaxPrecisionDrop = CPLAtof(argv[++i]);
+		else if (EQUAL(argv[i], "-max-recall-drop") && i + 1 < argc)
+			dfMaxRecallDrop = CPLAtof(argv[++i]);
+		else if (EQUAL(argv[i], "-max-runtime-ratio") && i + 1 < argc)
+			dfMaxRuntimeRatio = CPLAtof(argv[++i]);
+		else if (EQUAL(argv[i], "-o") && i + 1 < argc)
+			pszOutput = argv[++i];
+		else
+		{
+			printf(USAGE);
+			return -1;
+		}
+	}
+
+	if (nWidth <= 1 || nHeight <= 1 || sOptimized.nChecks <= 0 ||
+			nOctaveStart < 1 || nOctaveEnd < nOctaveStart)
+	{
+		printf(USAGE);
+		return -1;
+	}
+
+	GDALAllRegister();
+
+	float *pafField = (float *)VSIMalloc3(nWidth, nHeight, sizeof(float));
+	float *pafWarped = (float *)VSIMalloc3(nWidth, nHeight, sizeof(float));
+	if (pafField == NULL || pafWarped == NULL)
+	{
+		CPLError(CE_Failure, CPLE_OutOfMemory, "Can't allocate texture");
+		CPLFree(pafField);
+		CPLFree(pafWarped);
+		return -1;
+	}
+	GDALSyntheticRaster::GenerateTexture(pafField, nWidth, nHeight,
+			dfDensity, nSeed);
+
+	GDALDataset *poFirst = GDALSyntheticRaster::Create(pafField, nWidth,
+			0, 0, nWidth, nHeight, eType);
+	if (poFirst == NULL)
+	{
+		CPLFree(pafField);
+		CPLFree(pafWarped);
+		return -1;
+	}
+
+	AccuracyMetrics asMetrics[nCases];
+	double adfTotalSeconds[2] = { 0, 0 };
+	CPLErr eErr = CE_None;
+
+	for (int c = 0; c < nCases && eErr == CE_None; c++)
+	{
+		double adfTransform[6];
+		ComputeCaseTransform(&asCases[c], nWidth, nHeight, adfTransform);
+		WarpTexture(pafField, pafWarped, nWidth, nHeight, adfTransform);
+
+		GDALDataset *apoDatasets[2];
+		apoDatasets[0] = poFirst;
+		apoDatasets[1] = GDALSyntheticRaster::Create(pafWarped, nWidth,
+				0, 0, nWidth, nHeight, eType);
+		if (apoDatasets[1] == NULL)
+		{
+			eErr = CE_Failure;
+			break;
+		}
+
+		// Index 0 is reference backend, 1 - optimized one
+		GDALFeaturePointsCollection aoCollections[2][2];
+		GDALMatchedPointsCollection aoMatched[2];
+		const AccuracyBackend *apsBackends[2] = { &sReference, &sOptimized };
+		AccuracyMetrics *psMetrics = &asMetrics[c];
+
+		for (int b = 0; b < 2 && eErr == CE_None; b++)
+		{
+			eErr = RunBackend(apsBackends[b], apoDatasets,
+					nOctaveStart, nOctaveEnd, dfThreshold, dfMatchingThreshold,
+					aoCollections[b], &aoMatched[b], &psMetrics->adfSeconds[b]);
+
+			if (eErr == CE_None)
+			{
+				EvaluateMatches(aoCollections[b], &aoMatched[b], adfTransform,
+						dfMatchTolerance, &psMetrics->adfPrecision[b],
+						&psMetrics->adfRecall[b]);
+				psMetrics->anMatches[b] = aoMatched[b].GetSize();
+				adfTotalSeconds[b] += psMetrics->adfSeconds[b];
+			}
+		}
+
+		if (eErr == CE_None)
+		{
+			int nPoints = 0;
+			int nRepeated = 0;
+			double dfSumDelta = 0;
+			psMetrics->dfMaxDescriptorDelta = 0;
+
+			for (int k = 0; k < 2; k++)
+			{
+				nPoints += aoCollections[0][k].GetSize();
+				CompareDetection(&aoCollections[0][k], &aoCollections[1][k],
+						dfPositionTolerance, &nRepeated,
+						&psMetrics->dfMaxDescriptorDelta, &dfSumDelta);
+			}
+
+			psMetrics->dfRepeatability = (nPoints > 0) ?
+					(double)nRepeated / nPoints : 1.0;
+			psMetrics->dfMeanDescriptorDelta = (nRepeated > 0) ?
+					dfSumDelta / nRepeated : 0.0;
+			psMetrics->dfAgreement = GDALSimpleSURF::ComputeMatchingRecall(
+					&aoMatched[0], &aoMatched[1]);
+		}
+
+		GDALClose((GDALDatasetH)apoDatasets[1]);
+	}
+
+	GDALClose((GDALDatasetH)poFirst);
+	CPLFree(pafField);
+	CPLFree(pafWarped);
+
+	if (eErr != CE_None)
+		return -1;
+
+/* -------------------------------------------------------------------- */
+/*      Check tolerances and report.                                    */
+/* -------------------------------------------------------------------- */
+	string osFailures;
+	for (int c = 0; c < nCases; c++)
+	{
+		const AccuracyMetrics *psMetrics = &asMetrics[c];
+		const char *pszCase = asCases[c].pszName;
+
+		if (psMetrics->dfRepeatability < dfMinRepeatability)
+			osFailures += CPLSPrintf("%s\"%s: repeatability %.4f < %.4f\"",
+					osFailures.empty() ? "" : ", ", pszCase,
+					psMetrics->dfRepeatability, dfMinRepeatability);
+		if (psMetrics->dfMaxDescriptorDelta > dfMaxDescriptorDelta)
+			osFailures += CPLSPrintf("%s\"%s: descriptor delta %.3g > %.3g\"",
+					osFailures.empty() ? "" : ", ", pszCase,
+					psMetrics->dfMaxDescriptorDelta, dfMaxDescriptorDelta);
+		if (psMetrics->adfPrecision[0] - psMetrics->adfPrecision[1] >
+				dfMaxPrecisionDrop)
+			osFailures += CPLSPrintf("%s\"%s: precision %.4f, reference %.4f\"",
+					osFailures.empty() ? "" : ", ", pszCase,
+					psMetrics->adfPrecision[1], psMetrics->adfPrecision[0]);
+		if (psMetrics->adfRecall[0] - psMetrics->adfRecall[1] > dfMaxRecallDrop)
+			osFailures += CPLSPrintf("%s\"%s: recall %.4f, reference %.4f\"",
+					osFailures.empty() ? "" : ", ", pszCase,
+					psMetrics->adfRecall[1], psMetrics->adfRecall[0]);
+	}
+
+	double dfRuntimeRatio = (adfTotalSeconds[0] > 0) ?
+			adfTotalSeconds[1] / adfTotalSeconds[0] : 0.0;
+	if (dfMaxRuntimeRatio > 0 && dfRuntimeRatio > dfMaxRuntimeRatio)
+		osFailures += CPLSPrintf("%s\"runtime ratio %.3f > %.3f\"",
+				osFailures.empty() ? "" : ", ",
+				dfRuntimeRatio, dfMaxRuntimeRatio);
+
+	VSILFILE *fp = (pszOutput != NULL) ? VSIFOpenL(pszOutput, "w") : NULL;
+	if (pszOutput != NULL && fp == NULL)
+	{
+		CPLError(CE_Failure, CPLE_OpenFailed, "Can't create %s", pszOutput);
+		return -1;
+	}
+
+	string osJSON;
+	osJSON += "{\n";
+	osJSON += CPLSPrintf("  \"raster\": {\"width\": %d, \"height\": %d, "
+			"\"type\": \"%s\", \"density\": %.17g, \"seed\": %u},\n",
+			nWidth, nHeight, GDALGetDataTypeName(eType), dfDensity, nSeed);
+	osJSON += CPLSPrintf("  \"octave_start\": %d,\n  \"octave_end\": %d,\n"
+			"  \"threshold\": %.17g,\n", nOctaveStart, nOctaveEnd, dfThreshold);
+	osJSON += CPLSPrintf("  \"reference\": {\"simd\": \"%s\", "
+			"\"memory_budget\": 0, \"matcher\": \"%s\"},\n",
+			GDALCPUDispatch::GetLevelName(sReference.eLevel),
+			apszMatcherNames[sReference.eMatcher]);
+	osJSON += CPLSPrintf("  \"optimized\": {\"simd\": \"%s\", "
+			"\"memory_budget\": " CPL_FRMT_GIB ", \"matcher\": \"%s\"",
+			GDALCPUDispatch::GetLevelName(sOptimized.eLevel),
+			sOptimized.nMemoryBudget, apszMatcherNames[sOptimized.eMatcher]);
+	if (sOptimized.eMatcher == MATCHER_INDEXED)
+		osJSON += CPLSPrintf(", \"checks\": %d", sOptimized.nChecks);
+	osJSON += "},\n";
+	osJSON += "  \"cases\": [\n";
+
+	for (int c = 0; c < nCases; c++)
+	{
+		const AccuracyMetrics *psMetrics = &asMetrics[c];
+
+		osJSON += CPLSPrintf("    {\"name\": \"%s\", \"angle\": %.17g, "
+				"\"scale\": %.17g, \"shift\": [%.17g, %.17g],\n",
+				asCases[c].pszName, asCases[c].dfAngle, asCases[c].dfScale,
+				asCases[c].dfShiftX, asCases[c].dfShiftY);
+		osJSON += CPLSPrintf("     \"repeatability\": %.6f, "
+				"\"descriptor_delta\": {\"max\": %.6g, \"mean\": %.6g},\n",
+				psMetrics->dfRepeatability, psMetrics->dfMaxDescriptorDelta,
+				psMetrics->dfMeanDescriptorDelta);
+		osJSON += CPLSPrintf("     \"matches\": [%d, %d], "
+				"\"precision\": [%.6f, %.6f], \"recall\": [%.6f, %.6f], "
+				"\"agreement\": %.6f,\n",
+				psMetrics->anMatches[0], psMetrics->anMatches[1],
+				psMetrics->adfPrecision[0], psMetrics->adfPrecision[1],
+				psMetrics->adfRecall[0], psMetrics->adfRecall[1],
+				psMetrics->dfAgreement);
+		osJSON += CPLSPrintf("     \"seconds\": [%.6f, %.6f]}%s\n",
+				psMetrics->adfSeconds[0], psMetrics->adfSeconds[1],
+				(c + 1 < nCases) ? "," : "");
+	}
+
+	osJSON += "  ],\n";
+	osJSON += CPLSPrintf("  \"runtime_ratio\": %.6f,\n", dfRuntimeRatio);
+	osJSON += CPLSPrintf("  \"passed\": %s,\n  \"failures\": [%s]\n}\n",
+			osFailures.empty() ? "true" : "false", osFailures.c_str());
+
+	if (fp != NULL)
+	{
+		VSIFWriteL(osJSON.c_str(), 1, osJSON.size(), fp);
+		VSIFCloseL(fp);
+	}
+	else
+		printf("%s", osJSON.c_str());
+
+	return osFailures.empty() ? 0 : 1;
+}
@@ -0,0 +1,337 @@
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Benchmark of correlator stages on synthetic rasters
+ *
+ * Program creates two RGB rasters in MEM driver, the second one is
+ * shifted copy of the first one, and measures time of every stage
+ * of detection and matching of feature points separately:
+ * conversion to luminosity, integral image, Hessian map, search
+ * of extrema, descriptors and matching. Rasters are generated from
+ * fixed seed, so runs with the same parameters process the same data.
+ *
+ * Every stage is repeated several times and the best time is reported,
+ * results are printed as JSON:
+ *
+ * {
+ *   "raster": {"width": 2048, "height": 2048, "type": "Byte", ...},
+ *   ...
+ *   "stages": {
+ *     "luminosity": {"seconds": 0.05, "ns_per_pixel": 6.1},
+ *     ...
+ *     "matching": {"seconds": 1.2, "pairs_per_second": 2.1e+08}
+ *   }
+ * }
+ *
+ * Rate of extrema search and descriptors is in points per second,
+ * rate of matching - in pairs of compared points per second.
+ *
+ * This program is free software and
+ * is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY
+ */
+
+#include "gdal.h"
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+
+#include "GDALSimpleSURF.h"
+#include "GDALIntegralImage.h"
+#include "GDALFeaturePointsCollection.h"
+#include "GDALMatchedPointsCollection.h"
+#include "GDALCPUDispatch.h"
+#include "GDALSyntheticRaster.h"
+#include "GDALCorrelatorStats.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <string>
+
+using namespace std;
+
+/**
+ * Stages of correlator, in order of execution
+ */
+enum BenchmarkStage
+{
+	STAGE_LUMINOSITY,
+	STAGE_INTEGRAL,
+	STAGE_HESSIAN,
+	STAGE_EXTREMA,
+	STAGE_DESCRIPTORS,
+	STAGE_MATCHING,
+	STAGE_COUNT
+};
+
+static const char *apszStageNames[STAGE_COUNT] =
+{
+	"luminosity", "integral", "hessian", "extrema", "descriptors", "matching"
+};
+
+/**
+ * Run detection stages on raster, adding their time to padfSeconds.
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+static CPLErr RunDetection(GDALDataset *poDataset,
+		GDALFeaturePointsCollection *poCollection, double **padfImg,
+		int nOctaveStart, int nOctaveEnd, double dfThreshold,
+		double *padfSeconds)
+{
+	int nWidth = poDataset->GetRasterXSize();
+	int nHeight = poDataset->GetRasterYSize();
+
+	double dfStart = GDALCorrelatorStats::GetWallClock();
+	CPLErr eErr = GDALSimpleSURF::ConvertRGBToLuminosity(
+			poDataset->GetRasterBand(1), poDataset->GetRasterBand(2),
+			poDataset->GetRasterBand(3), nWidth, nHeight,
+			padfImg, nHeight, nWidth);
+	double dfEnd = GDALCorrelatorStats::GetWallClock();
+	padfSeconds[STAGE_LUMINOSITY] += dfEnd - dfStart;
+
+	if (eErr != CE_None)
+		return eErr;
+
+	GDALIntegralImage oImg;
+	dfStart = GDALCorrelatorStats::GetWallClock();
+	oImg.Initialize((const double**)padfImg, nHeight, nWidth);
+	dfEnd = GDALCorrelatorStats::GetWallClock();
+	padfSeconds[STAGE_INTEGRAL] += dfEnd - dfStart;
+
+	GDALSimpleSURF oSurf(nOctaveStart, nOctaveEnd);
+
+	dfStart = GDALCorrelatorStats::GetWallClock();
+	oSurf.ComputeHessianMap(&oImg);
+	dfEnd = GDALCorrelatorStats::GetWallClock();
+	padfSeconds[STAGE_HESSIAN] += dfEnd - dfStart;
+
+	dfStart = GDALCorrelatorStats::GetWallClock();
+	oSurf.DetectExtrema(poCollection, dfThreshold);
+	dfEnd = GDALCorrelatorStats::GetWallClock();
+	padfSeconds[STAGE_EXTREMA] += dfEnd - dfStart;
+
+	dfStart = GDALCorrelatorStats::GetWallClock();
+	oSurf.ComputeDescriptors(&oImg, poCollection);
+	dfEnd = GDALCorrelatorStats::GetWallClock();
+	padfSeconds[STAGE_DESCRIPTORS] += dfEnd - dfStart;
+
+	return CE_None;
+}
+
+/**
+ * Main function of benchmark
+ */
+int main(int argc, char* argv[])
+{
+	const char* USAGE = "Usage: [-size width height] [-type Byte|UInt16|Float32]"
+			" [-density blobs_per_megapixel] [-octaves start end]"
+			" [-threshold value] [-repeat n] [-seed n] [-o output.json]\n";
+
+	int nWidth = 1024;
+	int nHeight = 1024;
+	GDALDataType eType = GDT_Byte;
+	double dfDensity = 2000;
+	int nOctaveStart = 1;
+	int nOctaveEnd = 3;
+	double dfThreshold = 0.001;
+	double dfMatchingThreshold = 0.015;
+	int nRepeat = 3;
+	GUInt32 nSeed = 1;
+	const char *pszOutput = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (EQUAL(argv[i], "-size") && i + 2 < argc)
+		{
+			nWidth = atoi(argv[++i]);
+			nHeight = atoi(argv[++i]);
+		}
+		else if (EQUAL(argv[i], "-type") && i + 1 < argc)
+		{
+			i++;
+			if (EQUAL(argv[i], "Byte"))
+				eType = GDT_Byte;
+			else if (EQUAL(argv[i], "UInt16"))
+				eType = GDT_UInt16;
+			else if (EQUAL(argv[i], "Float32"))
+				eType = GDT_Float32;
+			else
+			{
+				printf(USAGE);
+				return -1;
+			}
+		}
+		else if (EQUAL(argv[i], "-density") && i + 1 < argc)
+			dfDensity = CPLAtof(argv[++i]);
+		else if (EQUAL(argv[i], "-octaves") && i + 2 < argc)
+		{
+			nOctaveStart = atoi(argv[++i]);
+			nOctaveEnd = atoi(argv[++i]);
+		}
+		else if (EQUAL(argv[i], "-threshold") && i + 1 < argc)
+			dfThreshold = CPLAtof(argv[++i]);
+		else if (EQUAL(argv[i], "-repeat") && i + 1 < argc)
+			nRepeat = atoi(argv[++i]);
+		else if (EQUAL(argv[i], "-seed") && i + 1 < argc)
+			nSeed = (GUInt32)atoi(argv[++i]);
+		else if (EQUAL(argv[i], "-o") && i + 1 < argc)
+			pszOutput = argv[++i];
+		else
+		{
+			printf(USAGE);
+			return -1;
+		}
+	}
+
+	if (nWidth <= 0 || nHeight <= 0 || nRepeat <= 0 ||
+			nOctaveStart < 1 || nOctaveEnd < nOctaveStart)
+	{
+		printf(USAGE);
+		return -1;
+	}
+
+	GDALAllRegister();
+
+	// The second raster is shifted copy of the first one
+	const int nShiftX = 7;
+	const int nShiftY = 5;
+	int nFieldWidth = nWidth + nShiftX;
+	int nFieldHeight = nHeight + nShiftY;
+
+	float *pafField = (float *)VSIMalloc3(nFieldWidth, nFieldHeight, sizeof(float));
+	if (pafField == NULL)
+	{
+		CPLError(CE_Failure, CPLE_OutOfMemory, "Can't allocate texture");
+		return -1;
+	}
+	GDALSyntheticRaster::GenerateTexture(pafField, nFieldWidth, nFieldHeight,
+			dfDensity, nSeed);
+
+	GDALDataset *apoDatasets[2];
+	apoDatasets[0] = GDALSyntheticRaster::Create(pafField, nFieldWidth,
+			0, 0, nWidth, nHeight, eType);
+	apoDatasets[1] = GDALSyntheticRaster::Create(pafField, nFieldWidth,
+			nShiftX, nShiftY, nWidth, nHeight, eType);
+	CPLFree(pafField);
+
+	if (apoDatasets[0] == NULL || apoDatasets[1] == NULL)
+	{
+		if (apoDatasets[0] != NULL)
+			GDALClose((GDALDatasetH)apoDatasets[0]);
+		if (apoDatasets[1] != NULL)
+			GDALClose((GDALDatasetH)apoDatasets[1]);
+		return -1;
+	}
+
+	double **padfImg = new double*[nHeight];
+	for (int i = 0; i < nHeight; i++)
+		padfImg[i] = new double[nWidth];
+
+	GDALFeaturePointsCollection aoCollections[2];
+	GDALMatchedPointsCollection oMatched;
+
+	double adfBest[STAGE_COUNT];
+	for (int s = 0; s < STAGE_COUNT; s++)
+		adfBest[s] = -1;
+
+	CPLErr eErr = CE_None;
+	for (int r = 0; r < nRepeat && eErr == CE_None; r++)
+	{
+		double adfSeconds[STAGE_COUNT];
+		for (int s = 0; s < STAGE_COUNT; s++)
+			adfSeconds[s] = 0;
+
+		for (int k = 0; k < 2 && eErr == CE_None; k++)
+		{
+			aoCollections[k].Clear();
+			eErr = RunDetection(apoDatasets[k], &aoCollections[k], padfImg,
+					nOctaveStart, nOctaveEnd, dfThreshold, adfSeconds);
+		}
+
+		if (eErr != CE_None)
+			break;
+
+		oMatched.Clear();
+		double dfStart = GDALCorrelatorStats::GetWallClock();
+		eErr = GDALSimpleSURF::MatchFeaturePoints(&oMatched,
+				&aoCollections[0], &aoCollections[1], dfMatchingThreshold);
+		adfSeconds[STAGE_MATCHING] =
+				GDALCorrelatorStats::GetWallClock() - dfStart;
+
+		for (int s = 0; s < STAGE_COUNT; s++)
+			if (adfBest[s] < 0 || adfSeconds[s] < adfBest[s])
+				adfBest[s] = adfSeconds[s];
+	}
+
+	for (int i = 0; i < nHeight; i++)
+		delete[] padfImg[i];
+	delete[] padfImg;
+
+	GDALClose((GDALDatasetH)apoDatasets[0]);
+	GDALClose((GDALDatasetH)apoDatasets[1]);
+
+	if (eErr != CE_None)
+		return -1;
+
+/* -------------------------------------------------------------------- */
+/*      Rates of stages. Detection stages process both rasters.         */
+/* -------------------------------------------------------------------- */
+	double dfPixels = 2.0 * nWidth * nHeight;
+	double dfPoints = aoCollections[0].GetSize() + aoCollections[1].GetSize();
+	double dfPairs = (double)aoCollections[0].GetSize() * aoCollections[1].GetSize();
+
+	VSILFILE *fp = (pszOutput != NULL) ? VSIFOpenL(pszOutput, "w") : NULL;
+	if (pszOutput != NULL && fp == NULL)
+	{
+		CPLError(CE_Failure, CPLE_OpenFailed, "Can't create %s", pszOutput);
+		return -1;
+	}
+
+	string osJSON;
+	osJSON += "{\n";
+	osJSON += CPLSPrintf("  \"raster\": {\"width\": %d, \"height\": %d, "
+			"\"type\": \"%s\", \"density\": %.17g, \"seed\": %u},\n",
+			nWidth, nHeight, GDALGetDataTypeName(eType), dfDensity, nSeed);
+	osJSON += CPLSPrintf("  \"octave_start\": %d,\n  \"octave_end\": %d,\n"
+			"  \"threshold\": %.17g,\n  \"repeat\": %d,\n",
+			nOctaveStart, nOctaveEnd, dfThreshold, nRepeat);
+	osJSON += CPLSPrintf("  \"simd\": \"%s\",\n", GDALCPUDispatch::GetLevelName(
+			GDALCPUDispatch::GetLevel()));
+	osJSON += CPLSPrintf("  \"points\": [%d, %d],\n  \"matches\": %d,\n",
+			aoCollections[0].GetSize(), aoCollections[1].GetSize(),
+			oMatched.GetSize());
+	osJSON += "  \"stages\": {\n";
+
+	for (int s = 0; s < STAGE_COUNT; s++)
+	{
+		double dfSeconds = adfBest[s];
+		osJSON += CPLSPrintf("    \"%s\": {\"seconds\": %.9f",
+				apszStageNames[s], dfSeconds);
+
+		if (s <= STAGE_EXTREMA)
+			osJSON += CPLSPrintf(", \"ns_per_pixel\": %.6g",
+					dfSeconds * 1e9 / dfPixels);
+		if (s == STAGE_EXTREMA || s == STAGE_DESCRIPTORS)
+			osJSON += CPLSPrintf(", \"points_per_second\": %.6g",
+					dfSeconds > 0 ? dfPoints / dfSeconds : 0.0);
+		if (s == STAGE_MATCHING)
+			osJSON += CPLSPrintf(", \"pairs_per_second\": %.6g",
+					dfSeconds > 0 ? dfPairs / dfSeconds : 0.0);
+
+		osJSON += (s + 1 < STAGE_COUNT) ? "},\n" : "}\n";
+	}
+
+	osJSON += "  }\n}\n";
+
+	if (fp != NULL)
+	{
+		VSIFWriteL(osJSON.c_str(), 1, osJSON.size(), fp);
+		VSIFCloseL(fp);
+	}
+	else
+		printf("%s", osJSON.c_str());
+
+	return 0;
+}
@@ -18,8 +18,8 @@
 #include "GDALFeaturePointsCollection.h"
 #include "GDALMatchedPointsCollection.h"
 #include "GDALCorrelator.h"
-
-#include <fstream>
+#include "GDALPointsWriter.h"
+#include "GDALMatchesExporter.h"
 
 using namespace std;
 
@@ -28,7 +28,11 @@ using namespace std;
  */
 int main(int argc, char* argv[])
 {
-	const char* USAGE = "Usage: filename, filename, lowest octave, highest octave\n";
+	const char* USAGE = "Usage: filename, filename, lowest octave, highest octave"
+			" [, output format: text (default), binary, gcp or ogr]\n"
+			"gcp writes copy of the first image with GCPs to matched_points.vrt,\n"
+			"ogr writes pairs to matched_points.gpkg while they are matched.\n"
+			"Both need georeferenced second image.\n";
 
     GDALAllRegister();
 
@@ -42,6 +46,20 @@ int main(int argc, char* argv[])
     	return -1;
     }
 
+	// Matched pairs can be exported by GDAL instead of points writer
+	bool bExportGCPs = argc > 5 && EQUAL(argv[5], "gcp");
+	bool bExportLayer = argc > 5 && EQUAL(argv[5], "ogr");
+
+	GDALPointsWriter::Format eFormat = GDALPointsWriter::FORMAT_TEXT;
+	if (argc > 5 && !bExportGCPs && !bExportLayer &&
+			GDALPointsWriter::ParseFormat(argv[5], &eFormat) != CE_None)
+	{
+		printf(USAGE);
+		return -1;
+	}
+	const char* pszExtension =
+			eFormat == GDALPointsWriter::FORMAT_BINARY ? "bin" : "txt";
+
     //poDataset_1 = (GDALDataset *) GDALOpen(
     //		"/home/andrew/workspace/GDAL-correlator/Debug/1.jpg", GA_ReadOnly );
     poDataset_1 = (GDALDataset *) GDALOpen(argv[1], GA_ReadOnly );
@@ -59,7 +77,40 @@ int main(int argc, char* argv[])
 	GDALFeaturePointsCollection *poFPCollection_2 =
 			new GDALFeaturePointsCollection(poDataset_2);
 
+	double adfGeoTransform[6];
+	if ((bExportGCPs || bExportLayer) &&
+			poDataset_2->GetGeoTransform(adfGeoTransform) != CE_None)
+	{
+		printf("The second image isn't georeferenced\n");
+		return -1;
+	}
+
+	// Layer receives pairs from matcher, so they aren't written to text first
+	GDALDataset *poLayerDS = NULL;
+	GDALMatchesExporter *poExporter = NULL;
+	if (bExportLayer)
+	{
+		GDALDriver *poDriver = GetGDALDriverManager()->GetDriverByName("GPKG");
+		if (poDriver != NULL)
+			poLayerDS = poDriver->Create("matched_points.gpkg", 0, 0, 0,
+					GDT_Unknown, NULL);
+
+		OGRSpatialReference oSRS(poDataset_2->GetProjectionRef());
+		OGRLayer *poLayer = poLayerDS != NULL ?
+				poLayerDS->CreateLayer("matched_points", &oSRS, wkbPoint, NULL) :
+				NULL;
+		if (poLayer == NULL)
+		{
+			printf("Can't create matched_points.gpkg\n");
+			return -1;
+		}
+
+		poExporter = new GDALMatchesExporter(poLayer, adfGeoTransform);
+	}
+
 	GDALMatchedPointsCollection *poMatched = new GDALMatchedPointsCollection();
+	// Matched pairs refer to points of collections without copying
+	poMatched->SetSources(poFPCollection_1, poFPCollection_2);
 
 	int nOctStart = atoi(argv[3]);
     int nOctEnd = atoi(argv[4]);
@@ -73,65 +124,71 @@ int main(int argc, char* argv[])
 	for (int i = 0; i < 3; i++)
 		panBands[i] = i + 1;
 
-	// Find feature points on both images
-    printf("Finding feature points on 1 image... ");
-	GatherFeaturePoints(poDataset_1, panBands,
+	// Find feature points on both images concurrently
+    printf("Finding feature points on both images... ");
+	GDALExtractionTask *poTask = GatherFeaturePointsAsync(poDataset_1, panBands,
 			poFPCollection_1, nOctStart, nOctEnd, dfSURFTreshold);
-	printf("Found: %d points \n", poFPCollection_1->GetSize());
-    printf("Finding feature points on 2 image... ");
 	GatherFeaturePoints(poDataset_2, panBands,
 			poFPCollection_2, nOctStart, nOctEnd, dfSURFTreshold);
-	printf("Found: %d points \n", poFPCollection_2->GetSize());
+	WaitFeaturePoints(poTask);
+	printf("Found: %d and %d points \n",
+			poFPCollection_1->GetSize(), poFPCollection_2->GetSize());
 	// Use gathered points to find correspondences
     printf("Matching... ");
-	MatchFeaturePoints(poMatched,
-			poFPCollection_1, poFPCollection_2, dfMatchingThreshold);
-	printf("Pairs found: %d \n", poMatched->GetSize());
+	CPLErr eMatchErr = MatchFeaturePoints(poMatched,
+			poFPCollection_1, poFPCollection_2, dfMatchingThreshold, 0, NULL,
+			poExporter != NULL ? GDALMatchesExporter::SinkFunc : NULL, poExporter);
+	if (eMatchErr == CE_None && poExporter != NULL)
+		eMatchErr = poExporter->Flush();
+	if (eMatchErr == CE_None)
+		printf("Pairs found: %d \n", poMatched->GetSize());
+	else
+		printf("Matching failed\n");
 
 /* -------------------------------------------------------------------- */
 /*      Printing parameters for demonstration                           */
 /* -------------------------------------------------------------------- */
-	ofstream out;
-    printf("Writing results...\n");   
-
-	out.open("points_1.txt");
-	for (int i = 0; i < poFPCollection_1->GetSize(); i++)
-		out << poFPCollection_1->GetPoint(i)->GetX() << " "
-			<< poFPCollection_1->GetPoint(i)->GetY() << endl;
-	out.close();
-
-	out.open("points_2.txt");
-	for (int i = 0; i < poFPCollection_2->GetSize(); i++)
-		out << poFPCollection_2->GetPoint(i)->GetX() << " "
-			<< poFPCollection_2->GetPoint(i)->GetY() << endl;
-
-	out.close();
+    printf("Writing results...\n");
 
-	GDALFeaturePoint *point_1 = new GDALFeaturePoint();
-	GDALFeaturePoint *point_2 = new GDALFeaturePoint();
-
-	out.open("matched_points.txt");
-	for (int i = 0; i < poMatched->GetSize(); i++)
+	GDALPointsWriter::WritePoints(poFPCollection_1,
+			CPLSPrintf("points_1.%s", pszExtension), eFormat);
+	GDALPointsWriter::WritePoints(poFPCollection_2,
+			CPLSPrintf("points_2.%s", pszExtension), eFormat);
+	if (eMatchErr == CE_None && bExportGCPs)
 	{
-		poMatched->GetPoints(i, point_1, point_2);
-
-		out << point_1->GetX() << " " << point_1->GetY();
-		out << " ";
-		out << point_2->GetX() << " " << point_2->GetY();
-		out << endl;
+		GDALDriver *poDriver = GetGDALDriverManager()->GetDriverByName("VRT");
+		GDALDataset *poCopy = poDriver != NULL ?
+				poDriver->CreateCopy("matched_points.vrt", poDataset_1,
+						FALSE, NULL, NULL, NULL) :
+				NULL;
+		if (poCopy == NULL ||
+				ExportMatchedPointsToGCPs(poMatched, poCopy, poDataset_2) != CE_None)
+		{
+			printf("Can't write GCPs to matched_points.vrt\n");
+			eMatchErr = CE_Failure;
+		}
+		if (poCopy != NULL)
+			GDALClose(poCopy);
 	}
-	out.close();
+	else if (eMatchErr == CE_None && !bExportLayer)
+		GDALPointsWriter::WriteMatchedPoints(poMatched,
+				CPLSPrintf("matched_points.%s", pszExtension), eFormat);
+
+	delete poExporter;
+	if (poLayerDS != NULL)
+		GDALClose(poLayerDS);
 
 	delete poDataset_1;
 	delete poDataset_2;
 	delete poFPCollection_1;
 	delete poFPCollection_2;
 	delete poMatched;
-	delete point_1;
-	delete point_2;
 
 	delete[] panBands;
 
+	if (eMatchErr != CE_None)
+		return 1;
+
 	printf("Everything looks good...\n");
 
 	return 0;
@@ -0,0 +1,449 @@
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Resident correlation service
+ *
+ * Service reads correlation jobs line by line from standard input
+ * or from connections to local UNIX socket, and writes results back.
+ * Datasets and feature points of recently used images are kept
+ * in memory, so repeated jobs cost only matching time.
+ *
+ * Protocol, one request per line (file names can't contain spaces):
+ *
+ * MATCH id first_file second_file
+ *         [octave_start octave_end matching_threshold [surf_threshold]]
+ *     Optional values override defaults of service. SURF threshold
+ *     affects detected points, so points detected with different
+ *     octaves or SURF threshold are cached separately.
+ *     Responds with "id OK n" followed by n lines "x1 y1 x2 y2",
+ *     or with "id ERROR message".
+ * STATS
+ *     Responds with "STATS hits misses memory_bytes".
+ * QUIT
+ *     Finishes current jobs and stops service.
+ *
+ * Responses of jobs may come in any order, they are identified by id.
+ *
+ * This program is free software and
+ * is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY
+ */
+
+#include "gdal.h"
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+#include "cpl_multiproc.h"
+#include "cpl_string.h"
+
+#include "GDALCorrelator.h"
+#include "GDALCorrelationCache.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/**
+ * Parameters of extraction and matching
+ */
+struct ServiceParameters
+{
+	int nOctaveStart;
+	int nOctaveEnd;
+	double dfSURFThreshold;
+	double dfMatchingThreshold;
+};
+
+/**
+ * State shared by reader and workers
+ */
+struct ServiceState
+{
+	GDALCorrelationCache *poCache;
+	ServiceParameters sDefaults;
+
+	// Jobs waiting for worker
+	deque<string> aoJobs;
+	int nActiveJobs;
+	bool bStopping;
+	void *hMutex;
+	void *hCond;
+
+	// Output of current connection
+	FILE *fpOutput;
+	void *hOutputMutex;
+};
+
+/**
+ * Write response as one piece, so responses of workers don't mix.
+ */
+static void WriteResponse(ServiceState *poState, const string &osResponse)
+{
+	CPLAcquireMutex(poState->hOutputMutex, 1000.0);
+	fwrite(osResponse.c_str(), 1, osResponse.size(), poState->fpOutput);
+	fflush(poState->fpOutput);
+	CPLReleaseMutex(poState->hOutputMutex);
+}
+
+/**
+ * Fetch feature points of image from cache, detecting them on miss.
+ */
+static const GDALReferenceCorrelator *GetFeaturePoints(ServiceState *poState,
+		const char *pszFilename, const ServiceParameters *psParams)
+{
+	string osKey = CPLSPrintf("%s|%d|%d|%.17g", pszFilename,
+			psParams->nOctaveStart, psParams->nOctaveEnd,
+			psParams->dfSURFThreshold);
+
+	const GDALReferenceCorrelator *poCorrelator =
+			poState->poCache->AcquireReference(osKey.c_str());
+	if (poCorrelator != NULL)
+		return poCorrelator;
+
+	GDALDatasetPool *poPool = poState->poCache->AcquireDataset(pszFilename);
+	if (poPool == NULL)
+		return NULL;
+
+	// Strips are decoded in parallel through handles of pool
+	GDALDataset *poDataset = poPool->GetDataset();
+	int anBands[3] = {1, 2, 3};
+	GDALFeaturePointsCollection *poCollection =
+			new GDALFeaturePointsCollection(poDataset);
+
+	CPLErr eErr = GatherFeaturePointsWindow(poDataset, anBands, poCollection,
+			0, 0, poDataset->GetRasterXSize(), poDataset->GetRasterYSize(),
+			psParams->nOctaveStart, psParams->nOctaveEnd,
+			psParams->dfSURFThreshold, 1, poPool);
+
+	// Points may outlive dataset in cache
+	poCollection->SetDataset(NULL);
+	poState->poCache->ReleaseDataset(poPool);
+
+	if (eErr != CE_None)
+	{
+		delete poCollection;
+		return NULL;
+	}
+
+	GDALReferenceCorrelator *poNew = new GDALReferenceCorrelator();
+	poNew->SetReference(poCollection);
+
+	return poState->poCache->InsertReference(osKey.c_str(), poNew);
+}
+
+/**
+ * Execute MATCH request.
+ */
+static void ProcessMatch(ServiceState *poState, char **papszTokens)
+{
+	int nTokens = CSLCount(papszTokens);
+	const char *pszId = (nTokens > 1) ? papszTokens[1] : "-";
+
+	if (nTokens != 4 && nTokens != 7 && nTokens != 8)
+	{
+		WriteResponse(poState, CPLSPrintf(
+				"%s ERROR Wrong number of parameters\n", pszId));
+		return;
+	}
+
+	ServiceParameters sParams = poState->sDefaults;
+	if (nTokens >= 7)
+	{
+		sParams.nOctaveStart = atoi(papszTokens[4]);
+		sParams.nOctaveEnd = atoi(papszTokens[5]);
+		sParams.dfMatchingThreshold = CPLAtof(papszTokens[6]);
+	}
+	if (nTokens == 8)
+		sParams.dfSURFThreshold = CPLAtof(papszTokens[7]);
+
+	const GDALReferenceCorrelator *poFirst =
+			GetFeaturePoints(poState, papszTokens[2], &sParams);
+	const GDALReferenceCorrelator *poSecond = (poFirst != NULL) ?
+			GetFeaturePoints(poState, papszTokens[3], &sParams) : NULL;
+
+	if (poFirst == NULL || poSecond == NULL)
+	{
+		poState->poCache->ReleaseReference(poFirst);
+		WriteResponse(poState, CPLSPrintf(
+				"%s ERROR Feature points can't be detected\n", pszId));
+		return;
+	}
+
+	GDALMatchedPointsCollection oMatched;
+	oMatched.SetSources(poFirst->GetReference(), poSecond->GetReference());
+
+	string osResponse;
+	if (poSecond->Match(poFirst->GetReference(), &oMatched,
+			sParams.dfMatchingThreshold) != CE_None)
+		osResponse = CPLSPrintf("%s ERROR Matching failed\n", pszId);
+	else
+	{
+		osResponse = CPLSPrintf("%s OK %d\n", pszId, oMatched.GetSize());
+		for (int i = 0; i < oMatched.GetSize(); i++)
+		{
+			const GDALFeaturePoint *poPoint_1 = oMatched.GetFirstPoint(i);
+			const GDALFeaturePoint *poPoint_2 = oMatched.GetSecondPoint(i);
+			osResponse += CPLSPrintf("%d %d %d %d\n",
+					poPoint_1->GetX(), poPoint_1->GetY(),
+					poPoint_2->GetX(), poPoint_2->GetY());
+		}
+	}
+
+	poState->poCache->ReleaseReference(poFirst);
+	poState->poCache->ReleaseReference(poSecond);
+
+	WriteResponse(poState, osResponse);
+}
+
+/**
+ * Worker thread: executes jobs until service stops.
+ */
+static void WorkerFunc(void *pData)
+{
+	ServiceState *poState = (ServiceState *)pData;
+
+	while (true)
+	{
+		CPLAcquireMutex(poState->hMutex, 1000.0);
+		while (poState->aoJobs.empty() && !poState->bStopping)
+			CPLCondWait(poState->hCond, poState->hMutex);
+
+		if (poState->aoJobs.empty())
+		{
+			CPLReleaseMutex(poState->hMutex);
+			break;
+		}
+
+		string osJob = poState->aoJobs.front();
+		poState->aoJobs.pop_front();
+		poState->nActiveJobs++;
+		CPLReleaseMutex(poState->hMutex);
+
+		char **papszTokens = CSLTokenizeString2(osJob.c_str(), " \t\r\n", 0);
+		ProcessMatch(poState, papszTokens);
+		CSLDestroy(papszTokens);
+
+		CPLAcquireMutex(poState->hMutex, 1000.0);
+		poState->nActiveJobs--;
+		CPLCondBroadcast(poState->hCond);
+		CPLReleaseMutex(poState->hMutex);
+	}
+}
+
+/**
+ * Wait until all queued jobs are finished.
+ */
+static void WaitJobs(ServiceState *poState)
+{
+	CPLAcquireMutex(poState->hMutex, 1000.0);
+	while (!poState->aoJobs.empty() || poState->nActiveJobs > 0)
+		CPLCondWait(poState->hCond, poState->hMutex);
+	CPLReleaseMutex(poState->hMutex);
+}
+
+/**
+ * Read requests from stream and queue jobs.
+ *
+ * @return FALSE if QUIT is received.
+ */
+static bool ReadRequests(ServiceState *poState, FILE *fpInput)
+{
+	char szLine[4096];
+
+	while (fgets(szLine, sizeof(szLine), fpInput) != NULL)
+	{
+		char **papszTokens = CSLTokenizeString2(szLine, " \t\r\n", 0);
+		const char *pszCommand = CSLCount(papszTokens) > 0 ? papszTokens[0] : "";
+
+		if (EQUAL(pszCommand, "MATCH"))
+		{
+			CPLAcquireMutex(poState->hMutex, 1000.0);
+			poState->aoJobs.push_back(szLine);
+			CPLCondSignal(poState->hCond);
+			CPLReleaseMutex(poState->hMutex);
+		}
+		else if (EQUAL(pszCommand, "STATS"))
+		{
+			GIntBig nHits, nMisses;
+			poState->poCache->GetStatistics(&nHits, &nMisses);
+			WriteResponse(poState, CPLSPrintf("STATS " CPL_FRMT_GIB
+					" " CPL_FRMT_GIB " " CPL_FRMT_GIB "\n", nHits, nMisses,
+					poState->poCache->GetMemoryUsage()));
+		}
+		else if (EQUAL(pszCommand, "QUIT"))
+		{
+			CSLDestroy(papszTokens);
+			return false;
+		}
+		else if (pszCommand[0] != '\0')
+			WriteResponse(poState, CPLSPrintf(
+					"ERROR Unknown request %s\n", pszCommand));
+
+		CSLDestroy(papszTokens);
+	}
+
+	return true;
+}
+
+#ifndef _WIN32
+/**
+ * Accept connections to UNIX socket one after another. Jobs of
+ * connection are executed in parallel, connection is closed when
+ * client closes its side and all its jobs are finished.
+ */
+static int ServeSocket(ServiceState *poState, const char *pszPath)
+{
+	int nSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (nSocket < 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Can't create socket");
+		return -1;
+	}
+
+	struct sockaddr_un sAddress;
+	memset(&sAddress, 0, sizeof(sAddress));
+	sAddress.sun_family = AF_UNIX;
+	strncpy(sAddress.sun_path, pszPath, sizeof(sAddress.sun_path) - 1);
+	unlink(pszPath);
+
+	if (bind(nSocket, (struct sockaddr *)&sAddress, sizeof(sAddress)) != 0 ||
+			listen(nSocket, 16) != 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Can't listen on %s", pszPath);
+		close(nSocket);
+		return -1;
+	}
+
+	bool bContinue = true;
+	while (bContinue)
+	{
+		int nConnection = accept(nSocket, NULL, NULL);
+		if (nConnection < 0)
+			continue;
+
+		FILE *fpInput = fdopen(nConnection, "r");
+		FILE *fpOutput = fdopen(dup(nConnection), "w");
+
+		poState->fpOutput = fpOutput;
+		bContinue = ReadRequests(poState, fpInput);
+		WaitJobs(poState);
+
+		fclose(fpOutput);
+		fclose(fpInput);
+	}
+
+	close(nSocket);
+	unlink(pszPath);
+	return 0;
+}
+#endif
+
+/**
+ * Main function of service
+ */
+int main(int argc, char* argv[])
+{
+	const char* USAGE = "Usage: [-socket path] [-threads n] [-cache_mb n]"
+			" [-datasets n] [-octaves start end]\n";
+
+	const char *pszSocket = NULL;
+	int nThreads = 0;
+	GIntBig nCacheMB = 1024;
+	int nMaxDatasets = 16;
+
+	ServiceState oState;
+	oState.sDefaults.nOctaveStart = 1;
+	oState.sDefaults.nOctaveEnd = 3;
+	oState.sDefaults.dfSURFThreshold = 0.001;
+	oState.sDefaults.dfMatchingThreshold = 0.015;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (EQUAL(argv[i], "-socket") && i + 1 < argc)
+			pszSocket = argv[++i];
+		else if (EQUAL(argv[i], "-threads") && i + 1 < argc)
+			nThreads = atoi(argv[++i]);
+		else if (EQUAL(argv[i], "-cache_mb") && i + 1 < argc)
+			nCacheMB = atoi(argv[++i]);
+		else if (EQUAL(argv[i], "-datasets") && i + 1 < argc)
+			nMaxDatasets = atoi(argv[++i]);
+		else if (EQUAL(argv[i], "-octaves") && i + 2 < argc)
+		{
+			oState.sDefaults.nOctaveStart = atoi(argv[++i]);
+			oState.sDefaults.nOctaveEnd = atoi(argv[++i]);
+		}
+		else
+		{
+			printf(USAGE);
+			return -1;
+		}
+	}
+
+	GDALAllRegister();
+
+	if (nThreads <= 0)
+		nThreads = GDALThreadPool::GetDefaultThreadCount();
+
+	GDALCorrelationCache oCache(nCacheMB * 1024 * 1024, nMaxDatasets);
+	oState.poCache = &oCache;
+	oState.nActiveJobs = 0;
+	oState.bStopping = false;
+	oState.fpOutput = stdout;
+	oState.hMutex = CPLCreateMutex();
+	CPLReleaseMutex(oState.hMutex);
+	oState.hOutputMutex = CPLCreateMutex();
+	CPLReleaseMutex(oState.hOutputMutex);
+	oState.hCond = CPLCreateCond();
+
+	vector<CPLJoinableThread *> apoWorkers;
+	for (int i = 0; i < nThreads; i++)
+	{
+		CPLJoinableThread *poThread = CPLCreateJoinableThread(WorkerFunc, &oState);
+		if (poThread != NULL)
+			apoWorkers.push_back(poThread);
+	}
+
+	int nResult = 0;
+	if (apoWorkers.empty())
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Can't start worker threads");
+		nResult = -1;
+	}
+	else if (pszSocket != NULL)
+	{
+#ifndef _WIN32
+		nResult = ServeSocket(&oState, pszSocket);
+#else
+		CPLError(CE_Failure, CPLE_NotSupported, "UNIX sockets aren't supported");
+		nResult = -1;
+#endif
+	}
+	else
+		ReadRequests(&oState, stdin);
+
+	// Finish queued jobs and stop workers
+	WaitJobs(&oState);
+	CPLAcquireMutex(oState.hMutex, 1000.0);
+	oState.bStopping = true;
+	CPLCondBroadcast(oState.hCond);
+	CPLReleaseMutex(oState.hMutex);
+
+	for (size_t i = 0; i < apoWorkers.size(); i++)
+		CPLJoinThread(apoWorkers[i]);
+
+	CPLDestroyCond(oState.hCond);
+	CPLDestroyMutex(oState.hOutputMutex);
+	CPLDestroyMutex(oState.hMutex);
+
+	return nResult;
+}
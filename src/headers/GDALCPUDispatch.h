@@ -0,0 +1,146 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Selection of SIMD kernels by instruction sets of CPU.
+ */
+
+#ifndef GDALCPUDISPATCH_H_
+#define GDALCPUDISPATCH_H_
+
+#include "gdal.h"
+
+/*
+ * Compilers, which support target attribute, build kernels for newer
+ * instruction sets in the same translation unit without special flags.
+ * Kernel marked with GDAL_CORRELATOR_TARGET may be called only if
+ * GDALCPUDispatch::GetLevel() reports corresponding level.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && \
+		(defined(__x86_64__) || defined(__i386__))
+#define GDAL_CORRELATOR_HAVE_DISPATCH
+#define GDAL_CORRELATOR_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/*
+ * AVX-512 includes fused multiply-add, which GCC would generate from
+ * separate multiplication and addition. Kernels, which should give
+ * the same result as kernels of lower levels, disable it.
+ */
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH) && !defined(__clang__)
+#define GDAL_CORRELATOR_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define GDAL_CORRELATOR_NO_CONTRACT
+#endif
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Selection of SIMD kernels by instruction sets of CPU.
+ * @details Level is detected once by CPUID. It can be lowered for testing
+ * or benchmarking with GDAL_CORRELATOR_SIMD configuration option
+ * (or environment variable): REFERENCE, SCALAR, SSE2, AVX2 or AVX512.
+ * Level higher than supported by CPU is never used.
+ *
+ * Kernels of all levels from SCALAR compute every output value with
+ * the same sequence of operations (no fused multiply-add), so results
+ * don't depend on the selected level.
+ *
+ * REFERENCE level is never detected, it selects the original scalar
+ * code, which optimized kernels replace: integral image by recurrence,
+ * range checked Hessian filters and descriptors, and descriptor distances
+ * summed in order without early abandoning. It's kept as reference
+ * for differential checks of optimized paths, and its results may differ
+ * from other levels by rounding.
+ */
+class GDALCPUDispatch
+{
+public:
+	/**
+	 * Levels of instruction sets, every level includes previous ones
+	 */
+	enum Level
+	{
+		LEVEL_REFERENCE = 0,
+		LEVEL_SCALAR = 1,
+		LEVEL_SSE2 = 2,
+		LEVEL_AVX2 = 3,
+		LEVEL_AVX512 = 4
+	};
+
+	/**
+	 * Fetch level of kernels to be used. Level is selected on the first
+	 * call from CPU capabilities and GDAL_CORRELATOR_SIMD option.
+	 *
+	 * @return Selected level.
+	 */
+	static Level GetLevel();
+
+	/**
+	 * Override selected level. Level is limited by capabilities of CPU.
+	 *
+	 * @param eLevel Requested level
+	 *
+	 * @return Level, which will be used.
+	 */
+	static Level SetLevel(Level eLevel);
+
+	/**
+	 * Detect the highest level supported by CPU and compiler.
+	 *
+	 * @return Supported level.
+	 */
+	static Level DetectLevel();
+
+	/**
+	 * Fetch name of level, as accepted by GDAL_CORRELATOR_SIMD.
+	 *
+	 * @param eLevel Level
+	 *
+	 * @return Name of level.
+	 */
+	static const char *GetLevelName(Level eLevel);
+
+	/**
+	 * Parse name of level.
+	 *
+	 * @param pszName Name of level, case insensitive
+	 * @param peLevel Parsed level
+	 *
+	 * @return CE_None or CE_Failure if name is unknown.
+	 */
+	static CPLErr ParseLevel(const char *pszName, Level *peLevel);
+
+private:
+	/**
+	 * Selected level or -1 if it isn't selected yet
+	 */
+	static volatile int nLevel;
+};
+
+#endif /* GDALCPUDISPATCH_H_ */
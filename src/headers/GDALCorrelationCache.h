@@ -0,0 +1,216 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief LRU cache of datasets and prepared feature points.
+ */
+
+#ifndef GDALCORRELATIONCACHE_H_
+#define GDALCORRELATIONCACHE_H_
+
+#include "gdal.h"
+#include "gdal_priv.h"
+#include "GDALDatasetPool.h"
+#include "GDALReferenceCorrelator.h"
+
+#include <list>
+#include <map>
+#include <string>
+
+using namespace std;
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief LRU cache of datasets and prepared feature points.
+ * @details Cache is intended for long-running processes, which correlate
+ * the same images many times. It keeps two kinds of entries:
+ *
+ * - opened datasets, every one with pool of handles for parallel reading
+ * (see GDALDatasetPool). Number of datasets is limited;
+ * - feature points of images together with their search structure
+ * (see GDALReferenceCorrelator), identified by arbitrary key, which
+ * should include extraction parameters. Total memory of these entries
+ * is limited.
+ *
+ * Acquired entry is pinned and can't be evicted until it's released.
+ * When limit is exceeded, least recently used unpinned entries are
+ * evicted. Pinned entries may temporarily exceed the limit.
+ * All methods can be called from several threads.
+ */
+class GDALCorrelationCache
+{
+public:
+	/**
+	 * Create empty cache.
+	 *
+	 * @param nMaxMemory Limit of memory of feature points in bytes
+	 * @param nMaxDatasets Limit of number of opened datasets
+	 * @param nHandlesPerDataset Limit of handles of every dataset,
+	 * zero for default (see GDALDatasetPool)
+	 */
+	GDALCorrelationCache(GIntBig nMaxMemory, int nMaxDatasets,
+			int nHandlesPerDataset = 0);
+
+	/**
+	 * Close datasets and destroy feature points. All entries
+	 * should be released.
+	 */
+	virtual ~GDALCorrelationCache();
+
+	/**
+	 * Fetch dataset, opening it if it isn't cached.
+	 *
+	 * @param pszFilename Name of dataset
+	 *
+	 * @return Pool of handles of pinned dataset, or NULL if dataset
+	 * can't be opened.
+	 */
+	GDALDatasetPool *AcquireDataset(const char *pszFilename);
+
+	/**
+	 * Unpin dataset.
+	 *
+	 * @param poPool Pool returned by AcquireDataset
+	 */
+	void ReleaseDataset(GDALDatasetPool *poPool);
+
+	/**
+	 * Fetch feature points by key.
+	 *
+	 * @param pszKey Key of entry
+	 *
+	 * @return Pinned correlator or NULL if entry isn't cached.
+	 */
+	const GDALReferenceCorrelator *AcquireReference(const char *pszKey);
+
+	/**
+	 * Add feature points. Cache takes ownership of correlator. If entry
+	 * with the same key was added meanwhile by another thread, provided
+	 * correlator is destroyed and existing one is returned.
+	 *
+	 * @param pszKey Key of entry
+	 * @param poCorrelator Correlator with reference points
+	 *
+	 * @return Pinned correlator.
+	 */
+	const GDALReferenceCorrelator *InsertReference(const char *pszKey,
+			GDALReferenceCorrelator *poCorrelator);
+
+	/**
+	 * Unpin feature points.
+	 *
+	 * @param poCorrelator Correlator returned by AcquireReference
+	 * or InsertReference
+	 */
+	void ReleaseReference(const GDALReferenceCorrelator *poCorrelator);
+
+	/**
+	 * Fetch memory occupied by cached feature points.
+	 *
+	 * @return Size in bytes.
+	 */
+	GIntBig GetMemoryUsage();
+
+	/**
+	 * Fetch numbers of cache hits and misses of both kinds.
+	 *
+	 * @param pnHits Number of hits
+	 * @param pnMisses Number of misses
+	 */
+	void GetStatistics(GIntBig *pnHits, GIntBig *pnMisses);
+
+private:
+	/**
+	 * Kinds of entries
+	 */
+	enum Kind
+	{
+		KIND_DATASET,
+		KIND_REFERENCE
+	};
+
+	/**
+	 * Cached object
+	 */
+	class Entry
+	{
+	public:
+		Kind eKind;
+		string osKey;
+		// Pool for dataset, correlator for feature points
+		void *pObject;
+		GDALDataset *poDataset;
+		GIntBig nSize;
+		int nRefs;
+	};
+
+	/**
+	 * Find entry, pin it and move it to the front of LRU list.
+	 * Mutex should be held.
+	 */
+	Entry *Lookup(Kind eKind, const string &osKey);
+
+	/**
+	 * Add pinned entry. Mutex should be held.
+	 */
+	void Insert(Entry *poEntry);
+
+	/**
+	 * Unpin entry of object and evict entries over limits.
+	 */
+	void Release(const void *pObject);
+
+	/**
+	 * Evict unpinned entries while limits are exceeded. Mutex should be held.
+	 */
+	void Evict();
+
+	/**
+	 * Destroy object of entry and entry itself.
+	 */
+	static void Destroy(Entry *poEntry);
+
+	GIntBig nMaxMemory;
+	int nMaxDatasets;
+	int nHandlesPerDataset;
+
+	GIntBig nMemory;
+	int nDatasets;
+	GIntBig nHits;
+	GIntBig nMisses;
+
+	// Entries from the most recently used
+	list<Entry *> oLRU;
+	map<pair<int, string>, list<Entry *>::iterator> oIndex;
+	map<const void *, list<Entry *>::iterator> oObjects;
+
+	void *hMutex;
+};
+
+#endif /* GDALCORRELATIONCACHE_H_ */
@@ -45,12 +45,67 @@
 #include "gdal_priv.h"
 #include "cpl_conv.h"
 #include "cpl_vsi.h"
+#include "cpl_multiproc.h"
 
 #include "GDALFeaturePoint.h"
 #include "GDALFeaturePointsCollection.h"
 #include "GDALMatchedPointsCollection.h"
 #include "GDALSimpleSURF.h"
 #include "GDALIntegralImage.h"
+#include "GDALRansacVerifier.h"
+#include "GDALReferenceCorrelator.h"
+#include "GDALOverlapGraph.h"
+#include "GDALThreadPool.h"
+#include "GDALMatchesExporter.h"
+#include "GDALDatasetPool.h"
+#include "GDALMemoryBudget.h"
+
+/**
+ * Fetch layout of bands, which determines size of reading buffers,
+ * see GDALMemoryBudget::EstimateReading.
+ *
+ * @param poDataset Image
+ * @param panBands Array of 3 raster bands numbers
+ * @param pnBlockYSize Resulting block height of red band, by which
+ * strips are read
+ * @param pnPixelSize Resulting sum of pixel sizes of bands in bytes
+ *
+ * @return CE_None or CE_Failure if some band doesn't exist.
+ */
+static CPLErr GetReadingLayout(GDALDataset* poDataset, const int* panBands,
+			int* pnBlockYSize, int* pnPixelSize)
+{
+	*pnBlockYSize = 1;
+	*pnPixelSize = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		GDALRasterBand *poBand = poDataset->GetRasterBand(panBands[i]);
+		if (poBand == NULL)
+		{
+			CPLError(CE_Failure, CPLE_AppDefined,
+					"Raster bands are not specified");
+			return CE_Failure;
+		}
+
+		if (i == 0)
+		{
+			int nBlockXSize;
+			poBand->GetBlockSize(&nBlockXSize, pnBlockYSize);
+		}
+
+		*pnPixelSize += GDALGetDataTypeSize(poBand->GetRasterDataType()) / 8;
+	}
+
+	return CE_None;
+}
+
+CPLErr GatherFeaturePointsWindow(GDALDataset* poDataset, int* panBands,
+			GDALFeaturePointsCollection* poCollection,
+			int nXOff, int nYOff, int nXSize, int nYSize,
+			int nOctaveStart, int nOctaveEnd, double dfThreshold,
+			int nDecimation = 1, GDALDatasetPool* poPool = NULL,
+			GDALCorrelatorStats* poStats = NULL, GIntBig nMemoryBudget = 0);
 
 /**
  * Detect feature points on provided image. Please carefully read documentation below.
@@ -89,11 +144,173 @@
  * NOTICE that every octave requires time to compute. Use a little range
  * or only one octave, if execution time is significant.
  *
+ * @param poStats Statistics receiving time of stages and counters
+ * of detection or NULL. Statistics are accumulated, see GDALCorrelatorStats
+ * @param nMemoryBudget Limit of working memory in bytes or zero
+ * for no limit. If detection on the whole image doesn't fit, octaves
+ * are processed one by one, and if it isn't enough, image is split
+ * into overlapping tiles, see GDALMemoryBudget. Points of tiled
+ * image are nearly the same as of the whole one, but their order differs.
+ * Memory of detected points isn't limited by budget, but is included
+ * in peak memory, which is reported in poStats and by CPLDebug.
+ *
  * @return CE_None or CE_Failure if error occurs.
  */
 CPLErr GatherFeaturePoints(GDALDataset* poDataset, int* panBands,
 			GDALFeaturePointsCollection* poCollection,
-			int nOctaveStart, int nOctaveEnd, double dfThreshold)
+			int nOctaveStart, int nOctaveEnd, double dfThreshold,
+			GDALCorrelatorStats* poStats = NULL, GIntBig nMemoryBudget = 0)
+{
+	if (poDataset == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "GDALDataset isn't specified");
+		return CE_Failure;
+	}
+
+	int nXSize = poDataset->GetRasterXSize();
+	int nYSize = poDataset->GetRasterYSize();
+
+	if (nMemoryBudget <= 0)
+		return GatherFeaturePointsWindow(poDataset, panBands, poCollection,
+				0, 0, nXSize, nYSize,
+				nOctaveStart, nOctaveEnd, dfThreshold, 1, NULL, poStats);
+
+	if (poCollection == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"GDALFeaturePointsCollection isn't specified");
+		return CE_Failure;
+	}
+
+	if (nOctaveStart <= 0 || nOctaveStart > nOctaveEnd)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+						"Octave numbers are invalid");
+		return CE_Failure;
+	}
+
+	if (panBands == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+						"Raster bands are not specified");
+		return CE_Failure;
+	}
+
+	int nBlockYSize, nPixelSize;
+	if (GetReadingLayout(poDataset, panBands, &nBlockYSize, &nPixelSize)
+			!= CE_None)
+		return CE_Failure;
+
+	// Tiles are read through one handle
+	GDALMemoryBudget::ExecutionPlan oPlan;
+	if (GDALMemoryBudget::Plan(nXSize, nYSize, nOctaveStart, nOctaveEnd,
+			nMemoryBudget, nBlockYSize, nPixelSize, 0, &oPlan) != CE_None)
+		return CE_Failure;
+
+	// Peak memory is tracked even if statistics aren't requested
+	GDALCorrelatorStats oRunStats;
+	CPLErr eErr = CE_None;
+
+	if (!oPlan.IsTiled())
+		eErr = GatherFeaturePointsWindow(poDataset, panBands, poCollection,
+				0, 0, nXSize, nYSize, nOctaveStart, nOctaveEnd, dfThreshold,
+				1, NULL, &oRunStats, nMemoryBudget);
+	else
+	{
+		// Points of every tile are kept only in its core,
+		// margins provide complete neighbourhood of core points
+		GDALFeaturePointsCollection oTileCollection(poDataset);
+
+		for (int nTileY = 0; eErr == CE_None && nTileY < nYSize;
+				nTileY += oPlan.nTileYSize)
+			for (int nTileX = 0; eErr == CE_None && nTileX < nXSize;
+					nTileX += oPlan.nTileXSize)
+			{
+				int nCoreXEnd = MIN(nTileX + oPlan.nTileXSize, nXSize);
+				int nCoreYEnd = MIN(nTileY + oPlan.nTileYSize, nYSize);
+				int nXOff = MAX(nTileX - oPlan.nMargin, 0);
+				int nYOff = MAX(nTileY - oPlan.nMargin, 0);
+				int nXEnd = MIN(nCoreXEnd + oPlan.nMargin, nXSize);
+				int nYEnd = MIN(nCoreYEnd + oPlan.nMargin, nYSize);
+
+				GDALCorrelatorStats oTileStats;
+				oTileCollection.Clear();
+				eErr = GatherFeaturePointsWindow(poDataset, panBands,
+						&oTileCollection, nXOff, nYOff,
+						nXEnd - nXOff, nYEnd - nYOff,
+						nOctaveStart, nOctaveEnd, dfThreshold,
+						1, NULL, &oTileStats, nMemoryBudget);
+
+				for (int i = 0; eErr == CE_None &&
+						i < oTileCollection.GetSize(); i++)
+				{
+					const GDALFeaturePoint *poPoint =
+							oTileCollection.GetPoint(i);
+
+					if (poPoint->GetX() >= nTileX && poPoint->GetX() < nCoreXEnd &&
+							poPoint->GetY() >= nTileY && poPoint->GetY() < nCoreYEnd)
+						poCollection->NewPoint(*poPoint);
+				}
+
+				// Points of previous tiles are kept during the whole run
+				oTileStats.UpdatePeakMemory(oTileStats.nPeakMemory +
+						poCollection->GetMemoryUsage());
+				oRunStats.Merge(oTileStats);
+			}
+
+		poCollection->SetExtractionParameters(nOctaveStart, nOctaveEnd,
+				dfThreshold);
+	}
+
+	CPLDebug("GDALCorrelator", "Peak memory " CPL_FRMT_GIB " bytes "
+			"of budget " CPL_FRMT_GIB " bytes, %s",
+			oRunStats.nPeakMemory, nMemoryBudget,
+			(oPlan.IsTiled()) ? "tiled" :
+			(oPlan.bRetainLayers) ? "whole image" : "octave by octave");
+
+	if (poStats != NULL)
+		poStats->Merge(oRunStats);
+
+	return eErr;
+}
+
+/**
+ * Detect feature points on window of provided image.
+ * Coordinates of points are relative to the whole image.
+ * Parameters are the same as in GatherFeaturePoints.
+ * Window may be read with reduced resolution (overviews are used
+ * if available), then coordinates, scales and radii of points are
+ * multiplied by decimation factor.
+ *
+ * @param poDataset Image on which feature points will be detected
+ * @param panBands Array of 3 raster bands numbers, for Red, Green, Blue bands (in that order)
+ * @param poCollection Feaure point collection where detected points will be stored
+ * @param nXOff Pixel offset of window
+ * @param nYOff Line offset of window
+ * @param nXSize Width of window
+ * @param nYSize Height of window
+ * @param nOctaveStart Number of bottom octave
+ * @param nOctaveEnd Number of top octave
+ * @param dfThreshold Threshold for feature point recognition
+ * @param nDecimation Reduction factor of resolution, 1 for full resolution
+ * @param poPool Pool of handles of poDataset or NULL. If specified,
+ * strips of window are decoded in parallel through handles of pool
+ * @param poStats Statistics receiving time of stages and counters
+ * of detection or NULL
+ * @param nMemoryBudget Limit of working memory in bytes or zero for
+ * no limit. If Hessian layers of all octaves don't fit, octaves are
+ * processed one by one. Window isn't split, see GatherFeaturePoints
+ *
+ * @see GatherFeaturePoints
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr GatherFeaturePointsWindow(GDALDataset* poDataset, int* panBands,
+			GDALFeaturePointsCollection* poCollection,
+			int nXOff, int nYOff, int nXSize, int nYSize,
+			int nOctaveStart, int nOctaveEnd, double dfThreshold,
+			int nDecimation, GDALDatasetPool* poPool,
+			GDALCorrelatorStats* poStats, GIntBig nMemoryBudget)
 {
 	if (poDataset == NULL)
 	{
@@ -130,12 +347,41 @@ CPLErr GatherFeaturePoints(GDALDataset* poDataset, int* panBands,
 		return CE_Failure;
 	}
 
+	if (nDecimation < 1)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Decimation factor should be positive");
+		return CE_Failure;
+	}
+
+	if (nXSize < nDecimation || nYSize < nDecimation)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Window is empty");
+		return CE_Failure;
+	}
+
 	GDALRasterBand *poRstRedBand = poDataset->GetRasterBand(panBands[0]);
 	GDALRasterBand *poRstGreenBand = poDataset->GetRasterBand(panBands[1]);
 	GDALRasterBand *poRstBlueBand = poDataset->GetRasterBand(panBands[2]);
 
-	int nWidth = poRstRedBand->GetXSize();
-	int nHeight = poRstRedBand->GetYSize();
+	int nBlockYSize, nPixelSize;
+	if (GetReadingLayout(poDataset, panBands, &nBlockYSize, &nPixelSize)
+			!= CE_None)
+		return CE_Failure;
+
+	int nWidth = nXSize / nDecimation;
+	int nHeight = nYSize / nDecimation;
+
+	// Band buffers of strips, read through one handle or by pool threads
+	int nReaders = (poPool != NULL) ? MIN(
+			GDALThreadPool::GetDefaultThreadCount(), poPool->GetMaxHandles()) : 0;
+	GIntBig nReadingMemory = GDALMemoryBudget::EstimateReading(nWidth, nHeight,
+			nYSize, nBlockYSize, nPixelSize, nReaders);
+
+	// Statistics of this call are reported if requested by configuration
+	GDALCorrelatorStats oCallStats;
+	bool bLogStats = GDALCorrelatorStats::IsLoggingEnabled();
+	GDALCorrelatorStats *poCallStats = (bLogStats) ? &oCallStats : poStats;
 
 	// Allocate memory for grayscale image
 	double **padfImg = NULL;
@@ -143,29 +389,244 @@ CPLErr GatherFeaturePoints(GDALDataset* poDataset, int* panBands,
 	for (int i = 0; i < nHeight; i++)
 		padfImg[i] = new double[nWidth];
 
+	// Size of grayscale and integral images, they have the same layout
+	GIntBig nImageMemory = (GIntBig)nWidth * nHeight * sizeof(double) +
+			nHeight * sizeof(double*);
+	GIntBig nPointsMemory = poCollection->GetMemoryUsage();
+
 	// Create grayscale image
-	GDALSimpleSURF::ConvertRGBToLuminosity(
-			poRstRedBand, poRstGreenBand, poRstBlueBand, nWidth, nHeight,
-			padfImg, nHeight, nWidth);
+	GDALCorrelatorStats::Timer oReadTimer(poCallStats,
+			GDALCorrelatorStats::STAGE_READING);
+	CPLErr eErr;
+	if (poPool != NULL)
+		eErr = GDALSimpleSURF::ConvertRGBToLuminosity(poPool, panBands,
+				nXOff, nYOff, nXSize, nYSize, padfImg, nHeight, nWidth);
+	else
+		eErr = GDALSimpleSURF::ConvertRGBToLuminosity(
+				poRstRedBand, poRstGreenBand, poRstBlueBand,
+				nXOff, nYOff, nXSize, nYSize, padfImg, nHeight, nWidth);
+	oReadTimer.Stop();
 
-	// Prepare integral image
-	GDALIntegralImage *poImg = new GDALIntegralImage();
-	poImg->Initialize((const double**)padfImg, nHeight, nWidth);
+	if (poCallStats != NULL)
+		poCallStats->UpdatePeakMemory(nImageMemory + nReadingMemory +
+				nPointsMemory);
 
-	// Get feature points
-	GDALSimpleSURF *poSurf = new GDALSimpleSURF(nOctaveStart, nOctaveEnd);
-	poSurf->ExtractFeaturePoints(poImg, poCollection, dfThreshold);
+	GDALIntegralImage *poImg = NULL;
+	if (eErr == CE_None)
+	{
+		if (poCallStats != NULL)
+		{
+			for (int i = 0; i < 3; i++)
+				poCallStats->nBytesRead += (GIntBig)nXSize * nYSize *
+						(GDALGetDataTypeSize(poDataset->GetRasterBand(
+						panBands[i])->GetRasterDataType()) / 8);
+			poCallStats->nPixels += (GIntBig)nWidth * nHeight;
+		}
 
-	// Clean up
-	delete poImg;
-	delete poSurf;
+		// Prepare integral image
+		GDALCorrelatorStats::Timer oIntegralTimer(poCallStats,
+				GDALCorrelatorStats::STAGE_INTEGRAL);
+		poImg = new GDALIntegralImage();
+		poImg->Initialize((const double**)padfImg, nHeight, nWidth);
+		oIntegralTimer.Stop();
 
+		if (poCallStats != NULL)
+			poCallStats->UpdatePeakMemory(2 * nImageMemory + nPointsMemory);
+	}
+
+	// Grayscale image isn't needed anymore
 	for (int i = 0; i < nHeight; i++)
 		delete[] padfImg[i];
 
 	delete[] padfImg;
 
-	return CE_None;
+	if (eErr == CE_None)
+	{
+		// Get feature points, the same as ExtractFeaturePoints
+		// with time of every stage
+		int nFirstNew = poCollection->GetSize();
+		GDALSimpleSURF *poSurf = new GDALSimpleSURF(nOctaveStart, nOctaveEnd);
+
+		// Octaves are processed one by one if all layers don't fit
+		bool bRetainLayers = nMemoryBudget <= 0 ||
+				GDALMemoryBudget::EstimateWindow(nWidth, nHeight,
+				nOctaveStart, nOctaveEnd, true, nReadingMemory) <= nMemoryBudget;
+
+		if (bRetainLayers)
+		{
+			GDALCorrelatorStats::Timer oHessianTimer(poCallStats,
+					GDALCorrelatorStats::STAGE_HESSIAN);
+			poSurf->ComputeHessianMap(poImg);
+			oHessianTimer.Stop();
+
+			if (poCallStats != NULL)
+				poCallStats->UpdatePeakMemory(nImageMemory + nPointsMemory +
+						poSurf->GetHessianMemoryUsage());
+
+			GDALCorrelatorStats::Timer oExtremaTimer(poCallStats,
+					GDALCorrelatorStats::STAGE_EXTREMA);
+			poSurf->DetectExtrema(poCollection, dfThreshold, poCallStats);
+			oExtremaTimer.Stop();
+
+			for (int oct = nOctaveStart; oct <= nOctaveEnd; oct++)
+				poSurf->ReleaseHessianOctave(oct);
+		}
+		else
+		{
+			for (int oct = nOctaveStart; oct <= nOctaveEnd; oct++)
+			{
+				GDALCorrelatorStats::Timer oHessianTimer(poCallStats,
+						GDALCorrelatorStats::STAGE_HESSIAN);
+				poSurf->ComputeHessianOctave(poImg, oct);
+				oHessianTimer.Stop();
+
+				if (poCallStats != NULL)
+					poCallStats->UpdatePeakMemory(nImageMemory +
+							poCollection->GetMemoryUsage() +
+							poSurf->GetHessianMemoryUsage());
+
+				GDALCorrelatorStats::Timer oExtremaTimer(poCallStats,
+						GDALCorrelatorStats::STAGE_EXTREMA);
+				poSurf->DetectOctaveExtrema(oct, poCollection, dfThreshold,
+						poCallStats);
+				oExtremaTimer.Stop();
+
+				poSurf->ReleaseHessianOctave(oct);
+			}
+		}
+
+		GDALCorrelatorStats::Timer oDescriptorsTimer(poCallStats,
+				GDALCorrelatorStats::STAGE_DESCRIPTORS);
+		poSurf->ComputeDescriptors(poImg, poCollection, nFirstNew);
+		oDescriptorsTimer.Stop();
+
+		if (poCallStats != NULL)
+			poCallStats->UpdatePeakMemory(nImageMemory +
+					poCollection->GetMemoryUsage());
+
+		poCollection->SetExtractionParameters(nOctaveStart, nOctaveEnd, dfThreshold);
+
+		// Coordinates relative to the whole image at full resolution
+		for (int i = nFirstNew; i < poCollection->GetSize(); i++)
+		{
+			GDALFeaturePoint *poPoint = poCollection->GetPoint(i);
+			poPoint->SetX(poPoint->GetX() * nDecimation + nXOff);
+			poPoint->SetY(poPoint->GetY() * nDecimation + nYOff);
+			poPoint->SetScale(poPoint->GetScale() * nDecimation);
+			poPoint->SetRadius(poPoint->GetRadius() * nDecimation);
+		}
+
+		// Clean up
+		delete poSurf;
+	}
+
+	delete poImg;
+
+	if (bLogStats)
+	{
+		oCallStats.Log(poDataset->GetDescription());
+		if (poStats != NULL)
+			poStats->Merge(oCallStats);
+	}
+
+	return eErr;
+}
+
+/**
+ * Extraction of feature points running in separate thread
+ */
+struct GDALExtractionTask
+{
+	GDALDataset *poDataset;
+	int anBands[3];
+	GDALFeaturePointsCollection *poCollection;
+	int nOctaveStart;
+	int nOctaveEnd;
+	double dfThreshold;
+
+	CPLErr eErr;
+	CPLJoinableThread *poThread;
+};
+
+static void GDALExtractionTaskFunc(void *pData)
+{
+	GDALExtractionTask *poTask = (GDALExtractionTask *)pData;
+
+	poTask->eErr = GatherFeaturePoints(poTask->poDataset, poTask->anBands,
+			poTask->poCollection, poTask->nOctaveStart, poTask->nOctaveEnd,
+			poTask->dfThreshold);
+}
+
+/**
+ * Start detection of feature points in separate thread. Parameters are
+ * the same as in GatherFeaturePoints. Dataset and collection shouldn't
+ * be used by other threads until task is finished by
+ * WaitFeaturePoints. So both images of pair can be processed
+ * concurrently: reading and decoding of one image overlap with
+ * computations on another one.
+ *
+ * @param poDataset Image on which feature points will be detected
+ * @param panBands Array of 3 raster bands numbers, for Red, Green, Blue bands (in that order)
+ * @param poCollection Feaure point collection where detected points will be stored
+ * @param nOctaveStart Number of bottom octave
+ * @param nOctaveEnd Number of top octave
+ * @param dfThreshold Threshold for feature point recognition
+ *
+ * @see GatherFeaturePoints, WaitFeaturePoints
+ *
+ * @return Task, which should be passed to WaitFeaturePoints, or NULL if
+ * parameters are invalid.
+ */
+GDALExtractionTask* GatherFeaturePointsAsync(GDALDataset* poDataset,
+			int* panBands, GDALFeaturePointsCollection* poCollection,
+			int nOctaveStart, int nOctaveEnd, double dfThreshold)
+{
+	if (panBands == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+						"Raster bands are not specified");
+		return NULL;
+	}
+
+	GDALExtractionTask *poTask = new GDALExtractionTask();
+	poTask->poDataset = poDataset;
+	for (int i = 0; i < 3; i++)
+		poTask->anBands[i] = panBands[i];
+	poTask->poCollection = poCollection;
+	poTask->nOctaveStart = nOctaveStart;
+	poTask->nOctaveEnd = nOctaveEnd;
+	poTask->dfThreshold = dfThreshold;
+	poTask->eErr = CE_None;
+
+	poTask->poThread = CPLCreateJoinableThread(GDALExtractionTaskFunc, poTask);
+
+	// Thread isn't available, task is completed at once
+	if (poTask->poThread == NULL)
+		GDALExtractionTaskFunc(poTask);
+
+	return poTask;
+}
+
+/**
+ * Wait for completion of detection started by GatherFeaturePointsAsync.
+ * Task is destroyed.
+ *
+ * @param poTask Task returned by GatherFeaturePointsAsync
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr WaitFeaturePoints(GDALExtractionTask* poTask)
+{
+	if (poTask == NULL)
+		return CE_Failure;
+
+	if (poTask->poThread != NULL)
+		CPLJoinThread(poTask->poThread);
+
+	CPLErr eErr = poTask->eErr;
+	delete poTask;
+
+	return eErr;
 }
 
 /**
@@ -186,18 +647,931 @@ CPLErr GatherFeaturePoints(GDALDataset* poDataset, int* panBands,
  * detections and produces bad results, reduce threshold.
  * Otherwise, if algorithm finds nothing, increase threshold.
  *
+ * @param dfMaxScaleRatio Maximal ratio of scales of matched points
+ * (2 allows neighbouring octaves). Zero disables the constraint
+ * @param poStats Statistics receiving time and counters of matching
+ * or NULL. Statistics are accumulated, see GDALCorrelatorStats
+ * @param pfnSink Callback receiving new pairs or NULL,
+ * e.g. GDALMatchesExporter::SinkFunc
+ * @param pSinkData User data passed to pfnSink
+ *
+ * @note Distances are normalized by the largest distance among pairs
+ * found by the call and the threshold is applied after that, so no
+ * pair is final before the whole collection is matched. Therefore
+ * pfnSink receives all new pairs of the call as one batch, when
+ * matching succeeds. Pairs refer to points of source collections
+ * (see GDALMatchedPointsCollection::SetSources), so the batch costs
+ * only indexes and distances.
+ *
  * @return CE_None or CE_Failure if error occurs.
  */
 CPLErr MatchFeaturePoints(
+			GDALMatchedPointsCollection* poMatched,
+			GDALFeaturePointsCollection* poFirstCollection,
+			GDALFeaturePointsCollection* poSecondCollection,
+			double dfThreshold, double dfMaxScaleRatio = 0,
+			GDALCorrelatorStats* poStats = NULL,
+			GDALMatchesSinkFunc pfnSink = NULL, void* pSinkData = NULL)
+{
+	CPLErr eErr;
+	int nMatchedBefore = poMatched != NULL ? poMatched->GetSize() : 0;
+
+	if (!GDALCorrelatorStats::IsLoggingEnabled())
+	{
+		eErr = GDALSimpleSURF::MatchFeaturePoints(poMatched, poFirstCollection,
+				poSecondCollection, dfThreshold, dfMaxScaleRatio, poStats);
+	}
+	else
+	{
+		// Statistics are reported even if matching fails
+		GDALCorrelatorStats oCallStats;
+		eErr = GDALSimpleSURF::MatchFeaturePoints(poMatched,
+				poFirstCollection, poSecondCollection, dfThreshold,
+				dfMaxScaleRatio, &oCallStats);
+
+		oCallStats.Log("matching");
+		if (poStats != NULL)
+			poStats->Merge(oCallStats);
+	}
+
+	if (eErr == CE_None && pfnSink != NULL)
+		eErr = pfnSink(poMatched, nMatchedBefore,
+				poMatched->GetSize() - nMatchedBefore, pSinkData);
+
+	return eErr;
+}
+
+/**
+ * Find corresponding points with absolute threshold of distance
+ * between descriptors. Since bound is known during search, it's
+ * considerably faster than MatchFeaturePoints.
+ *
+ * @param poMatched Resulting collection for matched points
+ * @param poFirstCollection Points on the first image
+ * @param poSecondCollection Points on the second image
+ * @param dfMaxDistance Maximal euclidean distance between descriptors
+ * of matched points
+ *
+ * @see GDALSimpleSURF::MatchFeaturePointsAbsolute
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr MatchFeaturePointsAbsolute(
+			GDALMatchedPointsCollection* poMatched,
+			GDALFeaturePointsCollection* poFirstCollection,
+			GDALFeaturePointsCollection* poSecondCollection,
+			double dfMaxDistance)
+{
+	return GDALSimpleSURF::MatchFeaturePointsAbsolute(poMatched,
+			poFirstCollection, poSecondCollection, dfMaxDistance);
+}
+
+/**
+ * Find corresponding points using approximate nearest neighbour search.
+ * Much faster than MatchFeaturePoints for large collections.
+ *
+ * @param poMatched Resulting collection for matched points
+ * @param poFirstCollection Points on the first image
+ * @param poSecondCollection Points on the second image
+ * @param dfThreshold Value from 0 to 1, same as in MatchFeaturePoints
+ * @param nChecks Maximum number of descriptor comparisons per point.
+ * Controls balance between accuracy and speed. Typical value is 128
+ *
+ * @see GDALSimpleSURF::MatchFeaturePointsIndexed,
+ * GDALSimpleSURF::ComputeMatchingRecall
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr MatchFeaturePointsIndexed(
+			GDALMatchedPointsCollection* poMatched,
+			GDALFeaturePointsCollection* poFirstCollection,
+			GDALFeaturePointsCollection* poSecondCollection,
+			double dfThreshold, int nChecks)
+{
+	return GDALSimpleSURF::MatchFeaturePointsIndexed(poMatched,
+			poFirstCollection, poSecondCollection, dfThreshold, nChecks);
+}
+
+/**
+ * Find corresponding points by exact exhaustive search with
+ * cache-blocked distance computation. Much faster than
+ * MatchFeaturePoints, while every point is still compared with all others.
+ *
+ * @param poMatched Resulting collection for matched points
+ * @param poFirstCollection Points on the first image
+ * @param poSecondCollection Points on the second image
+ * @param dfThreshold Value from 0 to 1, same as in MatchFeaturePoints
+ *
+ * @see GDALSimpleSURF::MatchFeaturePointsBlocked
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr MatchFeaturePointsBlocked(
 			GDALMatchedPointsCollection* poMatched,
 			GDALFeaturePointsCollection* poFirstCollection,
 			GDALFeaturePointsCollection* poSecondCollection,
 			double dfThreshold)
 {
-	GDALSimpleSURF::MatchFeaturePoints(poMatched,
+	return GDALSimpleSURF::MatchFeaturePointsBlocked(poMatched,
 			poFirstCollection, poSecondCollection, dfThreshold);
+}
 
-	return CE_None;
+/**
+ * Find corresponding points as mutual nearest neighbours, using several threads.
+ * Result doesn't depend on order of points in collections or on number of threads.
+ *
+ * @param poMatched Resulting collection for matched points
+ * @param poFirstCollection Points on the first image
+ * @param poSecondCollection Points on the second image
+ * @param dfThreshold Value from 0 to 1, same as in MatchFeaturePoints
+ * @param nThreads Number of threads, zero means
+ * GDAL_NUM_THREADS configuration option or number of CPUs
+ *
+ * @see GDALSimpleSURF::MatchFeaturePointsMutual
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr MatchFeaturePointsMutual(
+			GDALMatchedPointsCollection* poMatched,
+			GDALFeaturePointsCollection* poFirstCollection,
+			GDALFeaturePointsCollection* poSecondCollection,
+			double dfThreshold, int nThreads)
+{
+	return GDALSimpleSURF::MatchFeaturePointsMutual(poMatched,
+			poFirstCollection, poSecondCollection, dfThreshold, nThreads);
+}
+
+/**
+ * Find corresponding points, searching candidates only near expected
+ * position. Expected position is computed by affine transformation
+ * from pixel/line of the first image to pixel/line of the second one.
+ *
+ * @param poMatched Resulting collection for matched points
+ * @param poFirstCollection Points on the first image
+ * @param poSecondCollection Points on the second image
+ * @param dfThreshold Value from 0 to 1, same as in MatchFeaturePoints
+ * @param padfTransform Affine transformation (6 values, as geotransform)
+ * @param dfRadius Search radius in pixels of the second image
+ *
+ * @see GDALSimpleSURF::MatchFeaturePointsGuided
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr MatchFeaturePointsGuided(
+			GDALMatchedPointsCollection* poMatched,
+			GDALFeaturePointsCollection* poFirstCollection,
+			GDALFeaturePointsCollection* poSecondCollection,
+			double dfThreshold, const double *padfTransform, double dfRadius)
+{
+	return GDALSimpleSURF::MatchFeaturePointsGuided(poMatched,
+			poFirstCollection, poSecondCollection, dfThreshold,
+			padfTransform, dfRadius);
+}
+
+/**
+ * Find corresponding points, searching candidates only near expected
+ * position. Expected position is derived from geotransforms of datasets,
+ * so both datasets should be georeferenced in the same coordinate system.
+ *
+ * @param poMatched Resulting collection for matched points
+ * @param poFirstCollection Points on the first image
+ * @param poSecondCollection Points on the second image
+ * @param dfThreshold Value from 0 to 1, same as in MatchFeaturePoints
+ * @param poFirstDataset Dataset of the first image
+ * @param poSecondDataset Dataset of the second image
+ * @param dfRadius Search radius in pixels of the second image.
+ * It should cover error of georeferencing
+ *
+ * @see GDALSimpleSURF::MatchFeaturePointsGuided
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr MatchFeaturePointsGuided(
+			GDALMatchedPointsCollection* poMatched,
+			GDALFeaturePointsCollection* poFirstCollection,
+			GDALFeaturePointsCollection* poSecondCollection,
+			double dfThreshold, GDALDataset* poFirstDataset,
+			GDALDataset* poSecondDataset, double dfRadius)
+{
+	if (poFirstDataset == NULL || poSecondDataset == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Datasets are not specified");
+		return CE_Failure;
+	}
+
+	double adfFirstGeoTransform[6];
+	double adfSecondGeoTransform[6];
+	if (poFirstDataset->GetGeoTransform(adfFirstGeoTransform) != CE_None ||
+			poSecondDataset->GetGeoTransform(adfSecondGeoTransform) != CE_None)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Datasets don't have geotransforms");
+		return CE_Failure;
+	}
+
+	double adfTransform[6];
+	if (GDALSimpleSURF::ComputeAffinePrior(adfFirstGeoTransform,
+			adfSecondGeoTransform, adfTransform) != CE_None)
+		return CE_Failure;
+
+	return GDALSimpleSURF::MatchFeaturePointsGuided(poMatched,
+			poFirstCollection, poSecondCollection, dfThreshold,
+			adfTransform, dfRadius);
+}
+
+/**
+ * Find corresponding points between image and compressed index
+ * of reference points, which may come from many images.
+ *
+ * @param poMatched Resulting collection for matched points
+ * @param poCollection Points on the image
+ * @param poIndex Trained index of reference points
+ * @param dfThreshold Value from 0 to 1, same as in MatchFeaturePoints
+ * @param nProbe Number of visited lists of index
+ * @param nRerank Number of candidates re-ranked by exact distance
+ * @param panScenes Vector receiving scene of indexed point of every
+ * added pair or NULL
+ * @param panScenePoints Vector receiving index of indexed point of every
+ * added pair in its scene or NULL
+ *
+ * @see GDALSimpleSURF::MatchFeaturePointsPQ
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr MatchFeaturePointsPQ(
+			GDALMatchedPointsCollection* poMatched,
+			GDALFeaturePointsCollection* poCollection,
+			const GDALPQIndex* poIndex,
+			double dfThreshold, int nProbe, int nRerank,
+			vector<int>* panScenes = NULL, vector<int>* panScenePoints = NULL)
+{
+	return GDALSimpleSURF::MatchFeaturePointsPQ(poMatched,
+			poCollection, poIndex, dfThreshold, nProbe, nRerank,
+			panScenes, panScenePoints);
+}
+
+/**
+ * Verify matched points geometrically. Affine transformation or
+ * homography between images is estimated by RANSAC, pairs which
+ * don't agree with it are rejected.
+ *
+ * @param poMatched Matched points
+ * @param bHomography TRUE for homography, FALSE for affine transformation
+ * @param dfMaxError Maximal reprojection error of inlier in pixels
+ * @param padfModel Resulting 3x3 model in row-major order
+ * @param poInliers Collection for inlier pairs
+ * @param nThreads Number of threads, zero means
+ * GDAL_NUM_THREADS configuration option or number of CPUs
+ *
+ * @see GDALRansacVerifier::Verify
+ *
+ * @return Number of inliers or -1 if model can't be estimated.
+ */
+int VerifyMatchedPoints(
+			GDALMatchedPointsCollection* poMatched,
+			bool bHomography, double dfMaxError, double *padfModel,
+			GDALMatchedPointsCollection* poInliers, int nThreads)
+{
+	return GDALRansacVerifier::Verify(poMatched,
+			bHomography ? GDALRansacVerifier::MODEL_HOMOGRAPHY
+					: GDALRansacVerifier::MODEL_AFFINE,
+			dfMaxError, padfModel, poInliers, NULL, nThreads);
+}
+
+/**
+ * Prepare correlator for matching of many images against reference image.
+ * Feature points of reference image are detected once.
+ *
+ * @param poCorrelator Correlator to be prepared
+ * @param poReference Reference image
+ * @param panBands Array of 3 raster bands numbers, for Red, Green, Blue bands
+ * @param nOctaveStart Number of bottom octave
+ * @param nOctaveEnd Number of top octave
+ * @param dfThreshold Threshold for feature point recognition
+ *
+ * @see GatherFeaturePoints, GDALReferenceCorrelator
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr PrepareReferenceCorrelator(GDALReferenceCorrelator* poCorrelator,
+			GDALDataset* poReference, int* panBands,
+			int nOctaveStart, int nOctaveEnd, double dfThreshold)
+{
+	if (poCorrelator == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Correlator isn't specified");
+		return CE_Failure;
+	}
+
+	GDALFeaturePointsCollection *poCollection =
+			new GDALFeaturePointsCollection(poReference);
+
+	if (GatherFeaturePoints(poReference, panBands, poCollection,
+			nOctaveStart, nOctaveEnd, dfThreshold) != CE_None)
+	{
+		delete poCollection;
+		return CE_Failure;
+	}
+
+	return poCorrelator->SetReference(poCollection);
+}
+
+/**
+ * Find corresponding points of query image and reference image of
+ * correlator. Feature points of query are detected with the same
+ * parameters as points of reference. Function can be called from
+ * several threads simultaneously, if every thread uses its own dataset.
+ *
+ * @param poCorrelator Prepared correlator
+ * @param poQuery Query image
+ * @param panBands Array of 3 raster bands numbers, for Red, Green, Blue bands
+ * @param poQueryCollection Collection for feature points of query
+ * @param poMatched Resulting collection for matched points,
+ * the first point of pair is from query
+ * @param dfThreshold Value from 0 to 1, same as in MatchFeaturePoints
+ *
+ * @see PrepareReferenceCorrelator
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr CorrelateWithReference(const GDALReferenceCorrelator* poCorrelator,
+			GDALDataset* poQuery, int* panBands,
+			GDALFeaturePointsCollection* poQueryCollection,
+			GDALMatchedPointsCollection* poMatched, double dfThreshold)
+{
+	if (poCorrelator == NULL || poCorrelator->GetReference() == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Correlator isn't prepared");
+		return CE_Failure;
+	}
+
+	GDALFeaturePointsCollection *poReference = poCorrelator->GetReference();
+
+	if (GatherFeaturePoints(poQuery, panBands, poQueryCollection,
+			poReference->GetOctaveStart(), poReference->GetOctaveEnd(),
+			poReference->GetThreshold()) != CE_None)
+		return CE_Failure;
+
+	return poCorrelator->Match(poQueryCollection, poMatched, dfThreshold);
+}
+
+/**
+ * Assign matched points to dataset of the first image as GCPs.
+ * Georeferenced coordinates of GCPs are positions of the second points
+ * transformed by geotransform of reference dataset.
+ *
+ * @param poMatched Collection of matched pairs
+ * @param poTarget Dataset of the first image, opened for update
+ * @param poReference Georeferenced dataset of the second image
+ *
+ * @see GDALMatchesExporter::ExportToGCPs
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr ExportMatchedPointsToGCPs(const GDALMatchedPointsCollection* poMatched,
+			GDALDataset* poTarget, GDALDataset* poReference)
+{
+	return GDALMatchesExporter::ExportToGCPs(poMatched, poTarget, poReference);
+}
+
+/**
+ * Append matched points to OGR layer as point features located at
+ * georeferenced positions of the second points. Features are written
+ * in transactions of nBatchSize features. To export pairs as soon as
+ * they are produced, use GDALMatchesExporter directly.
+ *
+ * @param poMatched Collection of matched pairs
+ * @param poLayer Layer opened for update
+ * @param poReference Georeferenced dataset of the second image
+ * @param nBatchSize Number of features per transaction
+ *
+ * @see GDALMatchesExporter
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr ExportMatchedPointsToLayer(const GDALMatchedPointsCollection* poMatched,
+			OGRLayer* poLayer, GDALDataset* poReference, int nBatchSize)
+{
+	if (poReference == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Reference dataset isn't specified");
+		return CE_Failure;
+	}
+
+	double adfGeoTransform[6];
+	if (poReference->GetGeoTransform(adfGeoTransform) != CE_None)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Reference dataset doesn't have geotransform");
+		return CE_Failure;
+	}
+
+	GDALMatchesExporter oExporter(poLayer, adfGeoTransform, nBatchSize);
+	if (oExporter.Append(poMatched) != CE_None)
+		return CE_Failure;
+
+	return oExporter.Flush();
+}
+
+/**
+ * Compute window of the second image, which is covered by the first
+ * image mapped by affine model, expanded by margin and clipped by image.
+ * Returns FALSE if window is empty or model gives non-finite coordinates.
+ */
+bool ComputeOverlapWindow(const double *padfModel,
+			int nFirstXSize, int nFirstYSize,
+			int nSecondXSize, int nSecondYSize, double dfMargin,
+			int *pnXOff, int *pnYOff, int *pnXSize, int *pnYSize)
+{
+	double adfCornerX[4] = {0, (double)nFirstXSize, 0, (double)nFirstXSize};
+	double adfCornerY[4] = {0, 0, (double)nFirstYSize, (double)nFirstYSize};
+
+	double dfMinX = 0, dfMaxX = 0, dfMinY = 0, dfMaxY = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		double dfX = padfModel[0] * adfCornerX[i] +
+				padfModel[1] * adfCornerY[i] + padfModel[2];
+		double dfY = padfModel[3] * adfCornerX[i] +
+				padfModel[4] * adfCornerY[i] + padfModel[5];
+
+		if (i == 0 || dfX < dfMinX) dfMinX = dfX;
+		if (i == 0 || dfX > dfMaxX) dfMaxX = dfX;
+		if (i == 0 || dfY < dfMinY) dfMinY = dfY;
+		if (i == 0 || dfY > dfMaxY) dfMaxY = dfY;
+	}
+
+	// Degenerate models give huge or NaN coordinates, so values are clipped
+	// in double before conversion to int
+	if (!CPLIsFinite(dfMinX) || !CPLIsFinite(dfMaxX) ||
+			!CPLIsFinite(dfMinY) || !CPLIsFinite(dfMaxY))
+		return false;
+
+	dfMinX = MAX(0.0, MIN((double)nSecondXSize, floor(dfMinX - dfMargin)));
+	dfMinY = MAX(0.0, MIN((double)nSecondYSize, floor(dfMinY - dfMargin)));
+	dfMaxX = MAX(0.0, MIN((double)nSecondXSize, ceil(dfMaxX + dfMargin)));
+	dfMaxY = MAX(0.0, MIN((double)nSecondYSize, ceil(dfMaxY + dfMargin)));
+
+	int nXStart = (int)dfMinX;
+	int nYStart = (int)dfMinY;
+	int nXEnd = (int)dfMaxX;
+	int nYEnd = (int)dfMaxY;
+
+	if (nXEnd <= nXStart || nYEnd <= nYStart)
+		return false;
+
+	*pnXOff = nXStart;
+	*pnYOff = nYStart;
+	*pnXSize = nXEnd - nXStart;
+	*pnYSize = nYEnd - nYStart;
+
+	return true;
+}
+
+/**
+ * Find corresponding points from coarse to fine scale.
+ * At first, coarse octaves are extracted on whole images with reduced
+ * resolution (so overviews are used if they exist) and matched, and affine
+ * transformation between images is estimated by RANSAC.
+ * Then fine octaves are extracted only in overlapping regions
+ * of images, and fine points are matched only within neighbourhood
+ * predicted by the transformation (see MatchFeaturePointsGuided).
+ * Usually it's much faster than matching of full octave range.
+ *
+ * If coarse transformation can't be estimated, fine octaves are
+ * extracted and matched on whole images as by GatherFeaturePoints
+ * and MatchFeaturePoints.
+ *
+ * @param poFirstDataset The first image
+ * @param poSecondDataset The second image
+ * @param panBands Array of 3 raster bands numbers, for Red, Green, Blue bands
+ * @param nCoarseDecimation Reduction factor of resolution for coarse
+ * level, for example 4 or 8
+ * @param nCoarseOctaveStart Bottom octave of coarse level
+ * @param nCoarseOctaveEnd Top octave of coarse level
+ * @param nFineOctaveStart Bottom fine octave
+ * @param nFineOctaveEnd Top fine octave
+ * @param dfSURFThreshold Threshold for feature point recognition
+ * @param dfMatchingThreshold Value from 0 to 1, same as in MatchFeaturePoints
+ * @param dfRadius Search radius for fine points in pixels of the second
+ * image, also maximal error of coarse transformation. It should be
+ * at least nCoarseDecimation
+ * @param poFirstCollection Collection for fine points of the first image
+ * @param poSecondCollection Collection for fine points of the second image
+ * @param poMatched Resulting collection for matched fine points. It may
+ * have poFirstCollection and poSecondCollection as external sources
+ * @param padfModel Estimated affine model (9 values, see GDALRansacVerifier)
+ * or NULL. If coarse transformation isn't found, model isn't modified
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr CorrelateHierarchical(GDALDataset* poFirstDataset,
+			GDALDataset* poSecondDataset, int* panBands,
+			int nCoarseDecimation, int nCoarseOctaveStart, int nCoarseOctaveEnd,
+			int nFineOctaveStart, int nFineOctaveEnd,
+			double dfSURFThreshold, double dfMatchingThreshold, double dfRadius,
+			GDALFeaturePointsCollection* poFirstCollection,
+			GDALFeaturePointsCollection* poSecondCollection,
+			GDALMatchedPointsCollection* poMatched, double *padfModel)
+{
+	if (poFirstDataset == NULL || poSecondDataset == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Datasets are not specified");
+		return CE_Failure;
+	}
+
+	if (poFirstCollection == NULL || poSecondCollection == NULL ||
+			poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Collections are not specified");
+		return CE_Failure;
+	}
+
+	if (!(dfRadius > 0))
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Search radius should be positive");
+		return CE_Failure;
+	}
+
+/* -------------------------------------------------------------------- */
+/*      Coarse level: few large points on whole images, read with      */
+/*      reduced resolution.                                             */
+/* -------------------------------------------------------------------- */
+	GDALFeaturePointsCollection oCoarse_1(poFirstDataset);
+	GDALFeaturePointsCollection oCoarse_2(poSecondDataset);
+
+	if (GatherFeaturePointsWindow(poFirstDataset, panBands, &oCoarse_1,
+			0, 0, poFirstDataset->GetRasterXSize(), poFirstDataset->GetRasterYSize(),
+			nCoarseOctaveStart, nCoarseOctaveEnd, dfSURFThreshold,
+			nCoarseDecimation) != CE_None ||
+			GatherFeaturePointsWindow(poSecondDataset, panBands, &oCoarse_2,
+			0, 0, poSecondDataset->GetRasterXSize(), poSecondDataset->GetRasterYSize(),
+			nCoarseOctaveStart, nCoarseOctaveEnd, dfSURFThreshold,
+			nCoarseDecimation) != CE_None)
+		return CE_Failure;
+
+	// All pairs, which pass ratio test, are kept for verification
+	GDALMatchedPointsCollection oCoarseMatched;
+	oCoarseMatched.SetSources(&oCoarse_1, &oCoarse_2);
+	if (GDALSimpleSURF::MatchFeaturePointsMutual(&oCoarseMatched,
+			&oCoarse_1, &oCoarse_2, 1.0) != CE_None)
+		return CE_Failure;
+
+	double adfModel[9];
+	int nInliers = -1;
+	if (oCoarseMatched.GetSize() >= 3)
+	{
+		CPLPushErrorHandler(CPLQuietErrorHandler);
+		nInliers = GDALRansacVerifier::Verify(&oCoarseMatched,
+				GDALRansacVerifier::MODEL_AFFINE, dfRadius, adfModel, NULL, NULL);
+		CPLPopErrorHandler();
+	}
+
+	CPLDebug("GDALCorrelator", "Coarse points: %d and %d, matched %d, inliers %d",
+			oCoarse_1.GetSize(), oCoarse_2.GetSize(),
+			oCoarseMatched.GetSize(), nInliers);
+
+	if (nInliers < 3)
+	{
+		CPLDebug("GDALCorrelator",
+				"Coarse transformation isn't found, fine octaves are matched on whole images");
+
+		if (GatherFeaturePoints(poFirstDataset, panBands, poFirstCollection,
+				nFineOctaveStart, nFineOctaveEnd, dfSURFThreshold) != CE_None ||
+				GatherFeaturePoints(poSecondDataset, panBands, poSecondCollection,
+				nFineOctaveStart, nFineOctaveEnd, dfSURFThreshold) != CE_None)
+			return CE_Failure;
+
+		return GDALSimpleSURF::MatchFeaturePoints(poMatched,
+				poFirstCollection, poSecondCollection, dfMatchingThreshold);
+	}
+
+	if (padfModel != NULL)
+		memcpy(padfModel, adfModel, sizeof(adfModel));
+
+/* -------------------------------------------------------------------- */
+/*      Overlapping regions: the second image covered by the first      */
+/*      one and vice versa (through inverse transformation).            */
+/* -------------------------------------------------------------------- */
+	double dfDet = adfModel[0] * adfModel[4] - adfModel[1] * adfModel[3];
+	if (dfDet == 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Coarse transformation is degenerate");
+		return CE_Failure;
+	}
+
+	double adfInverse[9];
+	adfInverse[0] = adfModel[4] / dfDet;
+	adfInverse[1] = -adfModel[1] / dfDet;
+	adfInverse[3] = -adfModel[3] / dfDet;
+	adfInverse[4] = adfModel[0] / dfDet;
+	adfInverse[2] = -(adfInverse[0] * adfModel[2] + adfInverse[1] * adfModel[5]);
+	adfInverse[5] = -(adfInverse[3] * adfModel[2] + adfInverse[4] * adfModel[5]);
+	adfInverse[6] = 0;
+	adfInverse[7] = 0;
+	adfInverse[8] = 1;
+
+	int nXSize_1 = poFirstDataset->GetRasterXSize();
+	int nYSize_1 = poFirstDataset->GetRasterYSize();
+	int nXSize_2 = poSecondDataset->GetRasterXSize();
+	int nYSize_2 = poSecondDataset->GetRasterYSize();
+
+	int anWindow_1[4];
+	int anWindow_2[4];
+	if (!ComputeOverlapWindow(adfModel, nXSize_1, nYSize_1, nXSize_2, nYSize_2,
+			dfRadius, &anWindow_2[0], &anWindow_2[1], &anWindow_2[2], &anWindow_2[3]) ||
+			!ComputeOverlapWindow(adfInverse, nXSize_2, nYSize_2, nXSize_1, nYSize_1,
+			dfRadius, &anWindow_1[0], &anWindow_1[1], &anWindow_1[2], &anWindow_1[3]))
+	{
+		CPLDebug("GDALCorrelator", "Images don't overlap");
+		return CE_None;
+	}
+
+	CPLDebug("GDALCorrelator", "Overlap: %dx%d of the 1st image, %dx%d of the 2nd",
+			anWindow_1[2], anWindow_1[3], anWindow_2[2], anWindow_2[3]);
+
+/* -------------------------------------------------------------------- */
+/*      Fine level: only overlapping regions, guided matching.          */
+/* -------------------------------------------------------------------- */
+	if (GatherFeaturePointsWindow(poFirstDataset, panBands, poFirstCollection,
+			anWindow_1[0], anWindow_1[1], anWindow_1[2], anWindow_1[3],
+			nFineOctaveStart, nFineOctaveEnd, dfSURFThreshold) != CE_None ||
+			GatherFeaturePointsWindow(poSecondDataset, panBands, poSecondCollection,
+			anWindow_2[0], anWindow_2[1], anWindow_2[2], anWindow_2[3],
+			nFineOctaveStart, nFineOctaveEnd, dfSURFThreshold) != CE_None)
+		return CE_Failure;
+
+	// Model in the form of geotransform
+	double adfTransform[6] = {adfModel[2], adfModel[0], adfModel[1],
+			adfModel[5], adfModel[3], adfModel[4]};
+
+	return GDALSimpleSURF::MatchFeaturePointsGuided(poMatched,
+			poFirstCollection, poSecondCollection, dfMatchingThreshold,
+			adfTransform, dfRadius);
+}
+
+/**
+ * State of batch correlation shared by jobs
+ */
+struct GDALBatchCorrelation
+{
+	GDALDataset **papoDatasets;
+	int *panBands;
+	int nOctaveStart;
+	int nOctaveEnd;
+	double dfSURFThreshold;
+	double dfMatchingThreshold;
+	double dfRadius;
+	const GDALOverlapGraph *poGraph;
+	GDALFeaturePointsCollection **papoCollections;
+	GDALMatchedPointsCollection **papoMatched;
+	CPLErr *paeErrors;
+	GDALMatchesSinkFunc pfnSink;
+	void *pSinkData;
+	// Serializes calls of pfnSink
+	void *hSinkMutex;
+	// Pairs are needed after matching for output file
+	bool bKeepMatched;
+};
+
+static void GDALBatchExtractionJob(void *pData, int iJob)
+{
+	GDALBatchCorrelation *poBatch = (GDALBatchCorrelation *)pData;
+
+	// Dataset doesn't overlap with others
+	if (poBatch->papoCollections[iJob] == NULL)
+	{
+		poBatch->paeErrors[iJob] = CE_None;
+		return;
+	}
+
+	poBatch->paeErrors[iJob] = GatherFeaturePoints(
+			poBatch->papoDatasets[iJob], poBatch->panBands,
+			poBatch->papoCollections[iJob], poBatch->nOctaveStart,
+			poBatch->nOctaveEnd, poBatch->dfSURFThreshold);
+}
+
+static void GDALBatchMatchingJob(void *pData, int iJob)
+{
+	GDALBatchCorrelation *poBatch = (GDALBatchCorrelation *)pData;
+
+	int nFirst, nSecond;
+	poBatch->poGraph->GetEdge(iJob, &nFirst, &nSecond);
+
+	GDALFeaturePointsCollection *poFirst = poBatch->papoCollections[nFirst];
+	GDALFeaturePointsCollection *poSecond = poBatch->papoCollections[nSecond];
+	GDALMatchedPointsCollection *poMatched = poBatch->papoMatched[iJob];
+
+	poMatched->SetSources(poFirst, poSecond);
+
+	if (poBatch->dfRadius > 0)
+		poBatch->paeErrors[iJob] = MatchFeaturePointsGuided(poMatched,
+				poFirst, poSecond, poBatch->dfMatchingThreshold,
+				poBatch->papoDatasets[nFirst], poBatch->papoDatasets[nSecond],
+				poBatch->dfRadius);
+	else
+		poBatch->paeErrors[iJob] = GDALSimpleSURF::MatchFeaturePointsBlocked(
+				poMatched, poFirst, poSecond, poBatch->dfMatchingThreshold);
+
+	if (poBatch->paeErrors[iJob] != CE_None || poBatch->pfnSink == NULL)
+		return;
+
+	// Pairs of images are handed over as soon as they are matched
+	CPLAcquireMutex(poBatch->hSinkMutex, 1000.0);
+	poBatch->paeErrors[iJob] = poBatch->pfnSink(poMatched, 0,
+			poMatched->GetSize(), poBatch->pSinkData);
+	CPLReleaseMutex(poBatch->hSinkMutex);
+
+	if (!poBatch->bKeepMatched)
+		poMatched->Clear();
+}
+
+/**
+ * Find tie points between all overlapping pairs of many images.
+ * Feature points are detected once per image, images are processed
+ * in parallel. Then only pairs of images with overlapping footprints
+ * (see GDALOverlapGraph) are matched, also in parallel.
+ * All tie points are written to one text file, a line per point:
+ * "first second x1 y1 x2 y2", where first and second are indices
+ * of datasets, x1 y1 and x2 y2 are pixel coordinates on them.
+ * Lines of the same pair are consecutive, pairs are in order of
+ * GDALOverlapGraph edges, so output doesn't depend on number of threads.
+ *
+ * Pairs can also be streamed to pfnSink (e.g. GDALMatchesExporter::SinkFunc):
+ * pairs of every couple of images are passed as one batch as soon as they
+ * are matched. Sources of collection are feature points of these images,
+ * which datasets are available by GetDataset. Calls are serialized, but
+ * batches come in order of completion. Without output file batches
+ * are released after the call, so tie points of all pairs aren't kept.
+ *
+ * @param papoDatasets Array of georeferenced datasets in the same
+ * coordinate system
+ * @param nDatasets Number of datasets
+ * @param panBands Array of 3 raster bands numbers, for Red, Green, Blue bands (in that order)
+ * @param nOctaveStart Number of bottom octave
+ * @param nOctaveEnd Number of top octave
+ * @param dfSURFThreshold Threshold for feature point recognition
+ * @param dfMatchingThreshold Value from 0 to 1, same as in MatchFeaturePoints
+ * @param dfRadius Search radius in pixels for guided matching, which uses
+ * geotransforms to predict positions. If zero, points are matched without
+ * guidance
+ * @param dfMinOverlap Minimal overlap of footprints, relative to the smaller one
+ * @param nThreads Number of threads, zero for default
+ * @param pszOutput Name of output file or NULL if pfnSink is set
+ * @param pfnSink Callback receiving pairs of every couple of images or NULL
+ * @param pSinkData User data passed to pfnSink
+ *
+ * @return CE_None or CE_Failure if error occurs.
+ */
+CPLErr CorrelateBatch(GDALDataset** papoDatasets, int nDatasets,
+			int* panBands, int nOctaveStart, int nOctaveEnd,
+			double dfSURFThreshold, double dfMatchingThreshold,
+			double dfRadius, double dfMinOverlap, int nThreads,
+			const char* pszOutput, GDALMatchesSinkFunc pfnSink = NULL,
+			void* pSinkData = NULL)
+{
+	if (pszOutput == NULL && pfnSink == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Output file isn't specified");
+		return CE_Failure;
+	}
+
+	GDALOverlapGraph oGraph;
+	if (oGraph.Build(papoDatasets, nDatasets, dfMinOverlap) != CE_None)
+		return CE_Failure;
+
+	int nEdges = oGraph.GetEdgeCount();
+
+	// Only datasets, which overlap with others, are processed
+	vector<int> anUsed(nDatasets, 0);
+	for (int i = 0; i < nEdges; i++)
+	{
+		int nFirst, nSecond;
+		oGraph.GetEdge(i, &nFirst, &nSecond);
+		anUsed[nFirst] = 1;
+		anUsed[nSecond] = 1;
+	}
+
+	CPLDebug("GDALCorrelator", "Batch: %d datasets, %d overlapping pairs",
+			nDatasets, nEdges);
+
+	vector<GDALFeaturePointsCollection *> apoCollections(nDatasets + 1,
+			(GDALFeaturePointsCollection *)NULL);
+	for (int i = 0; i < nDatasets; i++)
+		if (anUsed[i])
+			apoCollections[i] = new GDALFeaturePointsCollection(papoDatasets[i]);
+
+	vector<GDALMatchedPointsCollection *> apoMatched(nEdges);
+	for (int i = 0; i < nEdges; i++)
+		apoMatched[i] = new GDALMatchedPointsCollection();
+
+	vector<CPLErr> aeErrors(MAX(nDatasets, nEdges) + 1, CE_None);
+
+	GDALBatchCorrelation oBatch;
+	oBatch.panBands = panBands;
+	oBatch.nOctaveStart = nOctaveStart;
+	oBatch.nOctaveEnd = nOctaveEnd;
+	oBatch.dfSURFThreshold = dfSURFThreshold;
+	oBatch.dfMatchingThreshold = dfMatchingThreshold;
+	oBatch.dfRadius = dfRadius;
+	oBatch.papoDatasets = papoDatasets;
+	oBatch.poGraph = &oGraph;
+	oBatch.papoCollections = &apoCollections[0];
+	oBatch.papoMatched = NULL;
+	oBatch.paeErrors = &aeErrors[0];
+	oBatch.pfnSink = pfnSink;
+	oBatch.pSinkData = pSinkData;
+	oBatch.hSinkMutex = NULL;
+	oBatch.bKeepMatched = pszOutput != NULL;
+
+	if (pfnSink != NULL)
+	{
+		oBatch.hSinkMutex = CPLCreateMutex();
+		CPLReleaseMutex(oBatch.hSinkMutex);
+	}
+
+	CPLErr eErr = CE_None;
+
+/* -------------------------------------------------------------------- */
+/*      Detect feature points once per image.                           */
+/* -------------------------------------------------------------------- */
+	GDALThreadPool::RunJobs(nDatasets, GDALBatchExtractionJob, &oBatch, nThreads);
+
+	for (int i = 0; i < nDatasets; i++)
+		if (aeErrors[i] != CE_None)
+			eErr = CE_Failure;
+
+/* -------------------------------------------------------------------- */
+/*      Match overlapping pairs.                                        */
+/* -------------------------------------------------------------------- */
+	if (eErr == CE_None && nEdges > 0)
+	{
+		oBatch.papoMatched = &apoMatched[0];
+		GDALThreadPool::RunJobs(nEdges, GDALBatchMatchingJob, &oBatch, nThreads);
+
+		for (int i = 0; i < nEdges; i++)
+			if (aeErrors[i] != CE_None)
+				eErr = CE_Failure;
+	}
+
+/* -------------------------------------------------------------------- */
+/*      Write tie points of all pairs.                                  */
+/* -------------------------------------------------------------------- */
+	if (eErr == CE_None && pszOutput != NULL)
+	{
+		VSILFILE *fpOutput = VSIFOpenL(pszOutput, "w");
+		if (fpOutput == NULL)
+		{
+			CPLError(CE_Failure, CPLE_OpenFailed,
+					"Can't create file %s", pszOutput);
+			eErr = CE_Failure;
+		}
+		else
+		{
+			int nTotal = 0;
+			for (int i = 0; i < nEdges && eErr == CE_None; i++)
+			{
+				int nFirst, nSecond;
+				oGraph.GetEdge(i, &nFirst, &nSecond);
+
+				const GDALMatchedPointsCollection *poMatched = apoMatched[i];
+				for (int j = 0; j < poMatched->GetSize(); j++)
+				{
+					const GDALFeaturePoint *poPoint_1 = poMatched->GetFirstPoint(j);
+					const GDALFeaturePoint *poPoint_2 = poMatched->GetSecondPoint(j);
+
+					if (VSIFPrintfL(fpOutput, "%d %d %d %d %d %d\n",
+							nFirst, nSecond, poPoint_1->GetX(), poPoint_1->GetY(),
+							poPoint_2->GetX(), poPoint_2->GetY()) <= 0)
+					{
+						CPLError(CE_Failure, CPLE_FileIO,
+								"Can't write to file %s", pszOutput);
+						eErr = CE_Failure;
+						break;
+					}
+				}
+				nTotal += poMatched->GetSize();
+			}
+
+			if (VSIFCloseL(fpOutput) != 0 && eErr == CE_None)
+			{
+				CPLError(CE_Failure, CPLE_FileIO,
+						"Can't write to file %s", pszOutput);
+				eErr = CE_Failure;
+			}
+
+			CPLDebug("GDALCorrelator", "Batch: %d tie points", nTotal);
+		}
+	}
+
+	if (oBatch.hSinkMutex != NULL)
+		CPLDestroyMutex(oBatch.hSinkMutex);
+
+	for (int i = 0; i < nEdges; i++)
+		delete apoMatched[i];
+	for (int i = 0; i < nDatasets; i++)
+		delete apoCollections[i];
+
+	return eErr;
 }
 
 #endif /* GDALCORRELATOR_H_ */
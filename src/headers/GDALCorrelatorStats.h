@@ -0,0 +1,242 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Timers and counters of correlator stages.
+ */
+
+#ifndef GDALCORRELATORSTATS_H_
+#define GDALCORRELATORSTATS_H_
+
+#include "gdal.h"
+
+#include <vector>
+
+using namespace std;
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Timers and counters of correlator stages.
+ * @details Statistics are filled by GatherFeaturePoints,
+ * GatherFeaturePointsWindow and MatchFeaturePoints if instance is passed
+ * to them, and are accumulated over calls until Reset. Without instance
+ * clocks aren't queried, and counters are kept in local variables,
+ * so overhead is negligible.
+ *
+ * If GDAL_CORRELATOR_STATS configuration option is set to YES,
+ * statistics of every call are also reported by CPLDebug.
+ *
+ * Wall time and CPU time are measured by calling thread. CPU time is time
+ * of calling thread only, so images processed concurrently by different
+ * threads don't count each other's work, but helper threads of stage
+ * (pooled strip reading) aren't included either.
+ */
+class GDALCorrelatorStats
+{
+public:
+	/**
+	 * Stages of correlation, in order of execution
+	 */
+	enum Stage
+	{
+		// Reading of bands and conversion to luminosity
+		STAGE_READING,
+		STAGE_INTEGRAL,
+		STAGE_HESSIAN,
+		STAGE_EXTREMA,
+		STAGE_DESCRIPTORS,
+		STAGE_MATCHING,
+		STAGE_COUNT
+	};
+
+	/**
+	 * Measures time of stage from construction to Stop or destruction.
+	 * Does nothing if statistics aren't specified.
+	 */
+	class Timer
+	{
+	public:
+		/**
+		 * Start measurement.
+		 *
+		 * @param poStats Statistics receiving time or NULL
+		 * @param eStage Measured stage
+		 */
+		Timer(GDALCorrelatorStats *poStats, Stage eStage);
+		~Timer();
+
+		/**
+		 * Finish measurement and add time to statistics.
+		 * Repeated calls do nothing.
+		 */
+		void Stop();
+
+	private:
+		GDALCorrelatorStats *poStats;
+		Stage eStage;
+		double dfWallStart;
+		double dfCPUStart;
+	};
+
+	GDALCorrelatorStats();
+
+	/**
+	 * Zero all timers and counters.
+	 */
+	void Reset();
+
+	/**
+	 * Add timers and counters of another instance.
+	 *
+	 * @param oOther Added statistics
+	 */
+	void Merge(const GDALCorrelatorStats &oOther);
+
+	/**
+	 * Add time of stage.
+	 *
+	 * @param eStage Stage
+	 * @param dfWallTime Wall time in seconds
+	 * @param dfCPUTime CPU time in seconds
+	 */
+	void AddTime(Stage eStage, double dfWallTime, double dfCPUTime);
+
+	/**
+	 * Fetch accumulated wall time of stage.
+	 *
+	 * @return Time in seconds.
+	 */
+	double GetWallTime(Stage eStage) const;
+
+	/**
+	 * Fetch accumulated CPU time of stage.
+	 *
+	 * @return Time in seconds.
+	 */
+	double GetCPUTime(Stage eStage) const;
+
+	/**
+	 * Add counters of detection on octave.
+	 *
+	 * @param nOctave Number of octave, starting from one
+	 * @param nLayerPixels Number of pixels in every layer of octave
+	 * @param nCandidates Number of pixels with Hessian above threshold
+	 * @param nExtrema Number of found feature points
+	 */
+	void AddOctave(int nOctave, GIntBig nLayerPixels,
+			GIntBig nCandidates, GIntBig nExtrema);
+
+	/**
+	 * Fetch number of the top octave with counters.
+	 *
+	 * @return Number of octave or zero if there are no octaves.
+	 */
+	int GetOctaveCount() const;
+
+	/**
+	 * Fetch counters of octave. Values are zero for octaves,
+	 * which weren't processed.
+	 *
+	 * @param nOctave Number of octave, starting from one
+	 */
+	GIntBig GetLayerPixels(int nOctave) const;
+	GIntBig GetCandidates(int nOctave) const;
+	GIntBig GetExtrema(int nOctave) const;
+
+	/**
+	 * Raise peak memory if provided size is larger.
+	 *
+	 * @param nSize Size of memory in bytes, which is in use at the moment
+	 */
+	void UpdatePeakMemory(GIntBig nSize);
+
+	/**
+	 * Report statistics by CPLDebug.
+	 *
+	 * @param pszTitle Title of report, for example name of image
+	 */
+	void Log(const char *pszTitle) const;
+
+	/**
+	 * Check GDAL_CORRELATOR_STATS configuration option.
+	 *
+	 * @return TRUE if statistics should be reported by CPLDebug.
+	 */
+	static bool IsLoggingEnabled();
+
+	/**
+	 * Fetch name of stage.
+	 *
+	 * @return Name of stage.
+	 */
+	static const char *GetStageName(Stage eStage);
+
+	/**
+	 * Fetch current wall clock time.
+	 *
+	 * @return Time in seconds from arbitrary moment.
+	 */
+	static double GetWallClock();
+
+	/**
+	 * Fetch CPU time consumed by calling thread. Falls back to CPU time
+	 * of the whole process where thread time isn't available.
+	 *
+	 * @return Time in seconds.
+	 */
+	static double GetCPUClock();
+
+	// Bytes requested from raster bands
+	GIntBig nBytesRead;
+	// Pixels of luminosity image
+	GIntBig nPixels;
+	// Distances between descriptors computed by matching,
+	// including abandoned ones
+	GIntBig nDistanceEvaluations;
+	// Query points, which nearest neighbour failed ratio test
+	GIntBig nRatioRejections;
+	// Pairs added to matched collection
+	GIntBig nMatches;
+	// Peak size of working buffers and feature points in bytes.
+	// Merge keeps the largest peak, since calls run one after another
+	GIntBig nPeakMemory;
+
+private:
+	double adfWallTime[STAGE_COUNT];
+	double adfCPUTime[STAGE_COUNT];
+
+	// Counters by octave number, index zero isn't used
+	vector<GIntBig> anLayerPixels;
+	vector<GIntBig> anCandidates;
+	vector<GIntBig> anExtrema;
+
+	void ResizeOctaves(int nOctaves);
+};
+
+#endif /* GDALCORRELATORSTATS_H_ */
@@ -0,0 +1,144 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Pool of dataset handles for parallel reading.
+ */
+
+#ifndef GDALDATASETPOOL_H_
+#define GDALDATASETPOOL_H_
+
+#include "gdal.h"
+#include "gdal_priv.h"
+
+#include <vector>
+
+using namespace std;
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Pool of dataset handles for parallel reading.
+ * @details GDALDataset isn't thread-safe, so threads, which decode
+ * different parts of image, need their own handles. Pool opens
+ * additional handles from description of the original dataset on demand.
+ * Thread acquires handle, reads, and releases it. If all handles are busy
+ * and limit is reached, thread waits until some handle is released.
+ *
+ * All handles share global GDAL block cache, so number of handles is also
+ * limited by cache size (GDAL_CACHEMAX): every handle should be able to
+ * keep one row of blocks of all bands, otherwise handles would evict
+ * blocks of each other and decode them again.
+ *
+ * The original dataset is used as one of handles and isn't closed by pool.
+ * It shouldn't be used directly while pool is in use.
+ */
+class GDALDatasetPool
+{
+public:
+	/**
+	 * Create pool for dataset.
+	 *
+	 * @param poDataset Original dataset. It should be opened from file,
+	 * which can be opened again by its description, driver and open options.
+	 * Otherwise the original handle is shared by threads
+	 * @param nMaxHandles Maximal number of handles including the original one.
+	 * If zero or negative, GDALThreadPool::GetDefaultThreadCount() is used
+	 */
+	GDALDatasetPool(GDALDataset *poDataset, int nMaxHandles = 0);
+
+	/**
+	 * Close handles opened by pool. All handles should be released.
+	 */
+	virtual ~GDALDatasetPool();
+
+	/**
+	 * Take free handle, opening new one if necessary. Waits if all
+	 * handles are busy and limit is reached.
+	 *
+	 * @return Handle. If dataset can't be opened again, only
+	 * the original handle is shared by threads.
+	 */
+	GDALDataset *Acquire();
+
+	/**
+	 * Return handle to pool.
+	 *
+	 * @param poHandle Handle obtained from Acquire
+	 */
+	void Release(GDALDataset *poHandle);
+
+	/**
+	 * Fetch the original dataset.
+	 *
+	 * @return Original dataset.
+	 */
+	GDALDataset *GetDataset() const;
+
+	/**
+	 * Fetch maximal number of handles, which is limited
+	 * by cache size.
+	 *
+	 * @return Maximal number of handles.
+	 */
+	int GetMaxHandles() const;
+
+	/**
+	 * Estimate size of block cache needed by one handle reading
+	 * image by strips: one row of blocks of every band.
+	 *
+	 * @param poDataset Dataset
+	 *
+	 * @return Size in bytes.
+	 */
+	static GIntBig GetStripCacheSize(GDALDataset *poDataset);
+
+private:
+	GDALDataset *poDataset;
+	int nMaxHandles;
+	// Handles opened by pool, the original one isn't included
+	vector<GDALDataset *> apoOpened;
+	// Handles, which aren't acquired
+	vector<GDALDataset *> apoFree;
+	int nHandles;
+	// Dataset can't be opened again, only the original handle is used
+	bool bOpenFailed;
+
+	void *hMutex;
+	void *hCond;
+
+	/**
+	 * Open one more handle of the original dataset by its description,
+	 * driver and open options. Failure is quiet and leaves no error state.
+	 *
+	 * @return New handle or NULL if dataset can't be opened again.
+	 */
+	GDALDataset *OpenHandle();
+};
+
+#endif /* GDALDATASETPOOL_H_ */
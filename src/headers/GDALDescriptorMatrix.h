@@ -0,0 +1,224 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Packed descriptors of feature points for exhaustive matching.
+ */
+
+#ifndef GDALDESCRIPTORMATRIX_H_
+#define GDALDESCRIPTORMATRIX_H_
+
+#include "GDALFeaturePoint.h"
+#include "GDALFeaturePointsCollection.h"
+
+#include "gdal.h"
+
+#include <vector>
+
+using namespace std;
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Packed descriptors of feature points for exhaustive matching.
+ * @details Matrix stores descriptors of selected points row by row
+ * in one contiguous array together with their squared norms.
+ * Squared distance between descriptors is computed as
+ * ||a||^2 + ||b||^2 - 2 * a * b, so search of the nearest points
+ * becomes a matrix product. Base matrix is processed by tiles,
+ * which fit in cache, and every tile is multiplied by blocks of
+ * MR query rows with register-blocked kernel. Kernel is selected for
+ * instruction sets of CPU (see GDALCPUDispatch).
+ * The nearest candidates are tracked while tiles are processed,
+ * so distance matrix is never stored.
+ */
+class GDALDescriptorMatrix
+{
+public:
+	GDALDescriptorMatrix();
+	virtual ~GDALDescriptorMatrix();
+
+	/**
+	 * Copy descriptors of selected points into matrix.
+	 *
+	 * @param poCollection Source collection
+	 * @param panIndices Indexes of points in collection
+	 * @param nIndices Number of indexes
+	 */
+	void Initialize(GDALFeaturePointsCollection *poCollection,
+			const int *panIndices, int nIndices);
+
+	/**
+	 * Fetch number of rows (points).
+	 *
+	 * @return Number of rows.
+	 */
+	int GetRows() const;
+
+	/**
+	 * Fetch descriptor of specified row.
+	 *
+	 * @param nRow Row number
+	 *
+	 * @return Pointer to DESC_SIZE values.
+	 */
+	const double *GetRow(int nRow) const;
+
+	/**
+	 * Fetch index of row's point in source collection.
+	 *
+	 * @param nRow Row number
+	 *
+	 * @return Index of point in source collection.
+	 */
+	int GetIndex(int nRow) const;
+
+	/**
+	 * Fetch squared norm of row's descriptor.
+	 *
+	 * @param nRow Row number
+	 *
+	 * @return Squared norm.
+	 */
+	double GetSquaredNorm(int nRow) const;
+
+	/**
+	 * Compute exact squared distance between descriptors. Squares
+	 * of differences are accumulated in 8 partial sums, which are added
+	 * pairwise, so result is the same for all SIMD levels.
+	 */
+	static double GetSquaredDistance(const double *padfFirst,
+			const double *padfSecond);
+
+	/**
+	 * Compute squared distance between descriptors, checking partial sum
+	 * against the bound after every ABANDON_STEP components.
+	 * Components are summed in the same order as in GetSquaredDistance,
+	 * so result is the same if computation isn't abandoned.
+	 *
+	 * @param padfFirst First descriptor
+	 * @param padfSecond Second descriptor
+	 * @param dfBound Bound of squared distance
+	 *
+	 * @return Squared distance, or partial sum greater than dfBound
+	 * if computation was abandoned. Reference level of GDALCPUDispatch
+	 * never abandons and returns the full distance.
+	 */
+	static double GetSquaredDistanceBounded(const double *padfFirst,
+			const double *padfSecond, double dfBound);
+
+	/**
+	 * Number of components summed between checks of the bound
+	 */
+	static const int ABANDON_STEP = 8;
+
+	/**
+	 * Function, which computes squared distance between descriptors
+	 * as GetSquaredDistanceBounded does. Infinite bound gives
+	 * exact distance as GetSquaredDistance.
+	 */
+	typedef double (*DistanceKernelFunc)(const double *padfFirst,
+			const double *padfSecond, double dfBound);
+
+	/**
+	 * Select distance kernel for current CPU. Loops over many pairs
+	 * fetch it once instead of selection per distance.
+	 *
+	 * @return Kernel for current SIMD level.
+	 */
+	static DistanceKernelFunc GetDistanceKernel();
+
+	/**
+	 * For every row of queries find the nearest and the 2nd nearest rows
+	 * of base matrix. Distances are computed for all pairs of rows.
+	 *
+	 * @param oQueries Query descriptors
+	 * @param oBase Descriptors to be searched
+	 * @param panBest Row of the nearest point in base or -1, per query
+	 * @param padfBest Squared distance to the nearest point, per query
+	 * @param panBest_2 Row of the 2nd nearest point in base or -1, per query
+	 * @param padfBest_2 Squared distance to the 2nd nearest point, per query
+	 */
+	static void FindTwoNearest(const GDALDescriptorMatrix &oQueries,
+			const GDALDescriptorMatrix &oBase,
+			int *panBest, double *padfBest, int *panBest_2, double *padfBest_2);
+
+	/**
+	 * Same as above, but only for range of query rows. Result arrays
+	 * contain nQueryCount elements. Result of every row doesn't depend
+	 * on the range, so ranges can be processed by different threads.
+	 *
+	 * @param oQueries Query descriptors
+	 * @param nFirstQuery First query row to be processed
+	 * @param nQueryCount Number of query rows to be processed
+	 * @param oBase Descriptors to be searched
+	 * @param panBest Row of the nearest point in base or -1, per query
+	 * @param padfBest Squared distance to the nearest point, per query
+	 * @param panBest_2 Row of the 2nd nearest point in base or -1, per query
+	 * @param padfBest_2 Squared distance to the 2nd nearest point, per query
+	 */
+	static void FindTwoNearest(const GDALDescriptorMatrix &oQueries,
+			int nFirstQuery, int nQueryCount,
+			const GDALDescriptorMatrix &oBase,
+			int *panBest, double *padfBest, int *panBest_2, double *padfBest_2);
+
+	/**
+	 * Number of query rows in register block
+	 */
+	static const int MR = 4;
+
+	/**
+	 * Number of base rows in register block
+	 */
+	static const int NR = 4;
+
+	/**
+	 * Number of base rows in tile, which is kept in cache
+	 */
+	static const int NB = 256;
+
+private:
+	/**
+	 * Function, which computes MR x NR dot products. Query rows are stored
+	 * one after another, base rows are packed by NR values of every component.
+	 */
+	typedef void (*DotKernelFunc)(const double *padfQueries,
+			const double *padfPanel, double *padfDots);
+
+	/**
+	 * Select dot product kernel for current CPU.
+	 */
+	static DotKernelFunc GetDotKernel();
+
+	int nRows;
+	vector<double> adfData;
+	vector<double> adfNorms;
+	vector<int> anIndices;
+};
+
+#endif /* GDALDESCRIPTORMATRIX_H_ */
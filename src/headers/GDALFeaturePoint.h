@@ -87,6 +87,14 @@ public:
 	 */
 	double& operator[](int nIndex);
 
+	/**
+	 * Provide direct access to point's descriptor.
+	 *
+	 * @return Pointer to array of DESC_SIZE values.
+	 */
+	double *GetDescriptor();
+	const double *GetDescriptor() const;
+
 	// Descriptor length
 	static const int DESC_SIZE = 64;
 
@@ -95,7 +103,7 @@ public:
 	 *
 	 * @return X-coordinate in pixels
 	 */
-	int GetX();
+	int GetX() const;
 
 	/**
 	 * Set X coordinate of point
@@ -109,7 +117,7 @@ public:
 	 *
 	 * @return Y-coordinate in pixels.
 	 */
-	int  GetY();
+	int  GetY() const;
 
 	/**
 	 * Set Y coordinate of point.
@@ -123,7 +131,7 @@ public:
 	 *
 	 * @return Scale for this point.
 	 */
-	int  GetScale();
+	int  GetScale() const;
 
 	/**
 	 * Set scale of point.
@@ -137,7 +145,7 @@ public:
 	 *
 	 * @return Radius for this point.
 	 */
-	int  GetRadius();
+	int  GetRadius() const;
 
 	/**
 	 * Set radius of point.
@@ -151,7 +159,7 @@ public:
 	 *
 	 * @return Sign for this point.
 	 */
-	int  GetSign();
+	int  GetSign() const;
 
 	/**
 	 * Set sign of point.
@@ -160,7 +168,21 @@ public:
 	 */
 	void SetSign(int nSign);
 
+	/**
+	 * Check whether point is placed in GDALFeaturePointsArena.
+	 * Such points are freed by arena and shouldn't be deleted.
+	 *
+	 * @return TRUE if point belongs to arena.
+	 */
+	bool IsInArena() const;
+
 private:
+	friend class GDALFeaturePointsArena;
+
+	// Create point with descriptor in memory of arena
+	GDALFeaturePoint(int nX, int nY, int nScale, int nRadius, int nSign,
+			double *padfDescriptor);
+
 	// Coordinates of point in image
 	int nX;
 	int nY;
@@ -170,6 +192,8 @@ private:
 	int nSign;
 	// Descriptor array
 	double *padfDescriptor;
+	// Descriptor is allocated by arena
+	bool bInArena;
 };
 
 #endif /* GDALFEATUREPOINT_H_ */
@@ -0,0 +1,137 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Block storage for feature points.
+ */
+
+#ifndef GDALFEATUREPOINTSARENA_H_
+#define GDALFEATUREPOINTSARENA_H_
+
+#include "GDALFeaturePoint.h"
+
+#include "gdal.h"
+
+#include <vector>
+
+using namespace std;
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Block storage for feature points and their descriptors.
+ * @details Points are placed one after another in large blocks, so
+ * detection of thousands of points costs a few allocations.
+ * Points aren't freed one by one: Reset makes all blocks free at once
+ * and keeps them for the next points, so memory of long-lived
+ * collection is reused between runs instead of being fragmented.
+ *
+ * Points created by arena are valid until Reset or destruction of arena
+ * and shouldn't be deleted. Arena isn't thread-safe.
+ */
+class GDALFeaturePointsArena
+{
+public:
+	/**
+	 * Create empty arena. Memory is allocated on first point.
+	 *
+	 * @param nBlockSize Number of points in one block
+	 */
+	GDALFeaturePointsArena(int nBlockSize = 4096);
+
+	/**
+	 * Free all blocks. Points of arena become invalid.
+	 */
+	virtual ~GDALFeaturePointsArena();
+
+	/**
+	 * Create point in arena. Parameters are the same as in
+	 * GDALFeaturePoint constructor.
+	 *
+	 * @return Point or NULL if memory can't be allocated.
+	 */
+	GDALFeaturePoint *NewPoint(int nX, int nY, int nScale,
+			int nRadius, int nSign);
+
+	/**
+	 * Create copy of point in arena.
+	 *
+	 * @param oPoint Copied point
+	 *
+	 * @return Point or NULL if memory can't be allocated.
+	 */
+	GDALFeaturePoint *NewPoint(const GDALFeaturePoint &oPoint);
+
+	/**
+	 * Make all points free. Allocated blocks are kept for reuse.
+	 */
+	void Reset();
+
+	/**
+	 * Free blocks which aren't used by points.
+	 */
+	void Shrink();
+
+	/**
+	 * Fetch number of points in arena.
+	 *
+	 * @return Number of points.
+	 */
+	int GetPointCount() const;
+
+	/**
+	 * Fetch size of allocated blocks.
+	 *
+	 * @return Size in bytes.
+	 */
+	GIntBig GetMemoryUsage() const;
+
+private:
+	/**
+	 * Block of points with descriptors placed after them.
+	 */
+	struct Block
+	{
+		GByte *pabyPoints;
+		double *padfDescriptors;
+	};
+
+	int nBlockSize;
+	vector<Block> aoBlocks;
+	// Block where next point is placed
+	int nCurrentBlock;
+	// Number of points in current block
+	int nUsed;
+	int nPoints;
+
+	// Take place for next point, returns its descriptor
+	GByte *Allocate(double **ppadfDescriptor);
+	void FreeBlocks(int nFirst);
+};
+
+#endif /* GDALFEATUREPOINTSARENA_H_ */
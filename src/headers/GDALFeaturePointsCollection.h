@@ -35,6 +35,7 @@
 #define GDALFEATUREPOINTSCOLLECTION_H_
 
 #include "GDALFeaturePoint.h"
+#include "GDALFeaturePointsArena.h"
 
 #include "gdal.h"
 #include "gdal_priv.h"
@@ -50,6 +51,30 @@ using namespace std;
 class GDALFeaturePointsCollection
 {
 public:
+	/**
+	 * Class identifies dataset, which is source of feature points.
+	 * Used to check that stored points belong to the particular image.
+	 */
+	class DatasetFingerprint
+	{
+	public:
+		DatasetFingerprint();
+
+		/**
+		 * Compare two fingerprints.
+		 *
+		 * @return TRUE if fingerprints are equal or FALSE otherwise.
+		 */
+		bool IsEqual(const DatasetFingerprint &oOther) const;
+
+		int nRasterXSize;
+		int nRasterYSize;
+		int nBands;
+		double adfGeoTransform[6];
+		// FNV-1a hash of dataset file name (without path)
+		GUIntBig nNameHash;
+	};
+
 	GDALFeaturePointsCollection();
 
 	/**
@@ -85,6 +110,26 @@ public:
 	 */
 	void AddPoint(GDALFeaturePoint *fp);
 
+	/**
+	 * Create point in memory of collection and add it. Points are
+	 * allocated by blocks and are freed all at once by Clear, so this
+	 * is cheaper than adding points created by new.
+	 * Parameters are the same as in GDALFeaturePoint constructor.
+	 *
+	 * @return Added point or NULL if memory can't be allocated.
+	 */
+	GDALFeaturePoint* NewPoint(int nX, int nY, int nScale,
+			int nRadius, int nSign);
+
+	/**
+	 * Add copy of point, created in memory of collection.
+	 *
+	 * @param oPoint Copied point
+	 *
+	 * @return Added point or NULL if memory can't be allocated.
+	 */
+	GDALFeaturePoint* NewPoint(const GDALFeaturePoint &oPoint);
+
 	/**
 	 * Fetch stored point.
 	 *
@@ -92,6 +137,7 @@ public:
 	 * @return Pointer to object or NULL if index is out of range.
 	 */
 	GDALFeaturePoint* GetPoint(int nIndex);
+	const GDALFeaturePoint* GetPoint(int nIndex) const;
 
 	/**
 	 * Get number of stored objects.
@@ -101,13 +147,99 @@ public:
 	int GetSize() const;
 
 	/**
-	 * Empty collection and delete all stored objects
+	 * Empty collection and delete all stored objects. Memory of points
+	 * created by NewPoint is kept for next points.
 	 */
 	void Clear();
 
+	/**
+	 * Free memory which was kept by Clear for reuse.
+	 */
+	void Shrink();
+
+	/**
+	 * Fetch size of memory allocated by collection for points,
+	 * including memory kept for reuse.
+	 *
+	 * @return Size in bytes.
+	 */
+	GIntBig GetMemoryUsage() const;
+
+	/**
+	 * Memorize parameters which were used for detection of stored points.
+	 *
+	 * @param nOctaveStart Number of bottom octave
+	 * @param nOctaveEnd Number of top octave
+	 * @param dfThreshold Threshold for feature point recognition
+	 */
+	void SetExtractionParameters(int nOctaveStart, int nOctaveEnd,
+			double dfThreshold);
+
+	/**
+	 * Fetch parameters which were used for detection of stored points.
+	 * Values are negative if parameters are unknown.
+	 */
+	int GetOctaveStart() const;
+	int GetOctaveEnd() const;
+	double GetThreshold() const;
+
+	/**
+	 * Compute fingerprint of specified dataset.
+	 *
+	 * @param poDataset Dataset instance or NULL
+	 * @param poFingerprint Resulting fingerprint
+	 */
+	static void ComputeFingerprint(GDALDataset *poDataset,
+			DatasetFingerprint *poFingerprint);
+
+	/**
+	 * Fetch fingerprint of owning dataset. If dataset isn't specified,
+	 * returns fingerprint which was loaded from file.
+	 *
+	 * @return Fingerprint of dataset.
+	 */
+	DatasetFingerprint GetFingerprint() const;
+
+	/**
+	 * Set fingerprint, which is used when collection has no dataset.
+	 *
+	 * @param oFingerprint Fingerprint of dataset
+	 */
+	void SetFingerprint(const DatasetFingerprint &oFingerprint);
+
+	/**
+	 * Store collection in compact binary file.
+	 *
+	 * @param pszFilename Name of the file to be created
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 * @see GDALFeaturePointsFile for format description.
+	 */
+	CPLErr Save(const char *pszFilename);
+
+	/**
+	 * Append points stored in binary file. If collection has dataset,
+	 * its fingerprint should be equal to stored one.
+	 *
+	 * @param pszFilename Name of the file
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 * @see GDALFeaturePointsFile for format description.
+	 */
+	CPLErr Load(const char *pszFilename);
+
 private:
 	GDALDataset* poDataset;
 	vector<GDALFeaturePoint*> *pPoints;
+	// Storage of points created by NewPoint
+	GDALFeaturePointsArena oArena;
+	// Number of points passed to AddPoint, they are deleted one by one
+	int nHeapPoints;
+
+	int nOctaveStart;
+	int nOctaveEnd;
+	double dfThreshold;
+	DatasetFingerprint oFingerprint;
 };
 
 #endif /* GDALFEATUREPOINTSCOLLECTION_H_ */
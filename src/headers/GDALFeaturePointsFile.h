@@ -0,0 +1,166 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Binary storage of feature point collections.
+ */
+
+#ifndef GDALFEATUREPOINTSFILE_H_
+#define GDALFEATUREPOINTSFILE_H_
+
+#include "GDALFeaturePoint.h"
+#include "GDALFeaturePointsCollection.h"
+
+#include "gdal.h"
+#include "gdal_priv.h"
+#include "cpl_vsi.h"
+#include "cpl_virtualmem.h"
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Binary storage of feature point collections.
+ * @details File consists of fixed size header and flat arrays.
+ * Header contains format version, extraction parameters
+ * and fingerprint of the source dataset. Arrays follow in order:
+ * X, Y, scale, radius, sign (32-bit integers) and descriptors
+ * (DESC_SIZE doubles per point). All values are little-endian,
+ * every array starts on 8-byte boundary.
+ *
+ * Opened file is mapped into memory (if platform supports it)
+ * or read with one call, so arrays are accessible directly
+ * without any per-point parsing.
+ */
+class GDALFeaturePointsFile
+{
+public:
+	GDALFeaturePointsFile();
+	virtual ~GDALFeaturePointsFile();
+
+	/**
+	 * Write collection to file.
+	 *
+	 * @param pszFilename Name of the file to be created
+	 * @param poCollection Collection to be stored
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	static CPLErr Write(const char *pszFilename,
+			const GDALFeaturePointsCollection *poCollection);
+
+	/**
+	 * Open file and make its arrays accessible.
+	 *
+	 * @param pszFilename Name of the file
+	 *
+	 * @return CE_None or CE_Failure if file can't be read or has wrong format.
+	 */
+	CPLErr Open(const char *pszFilename);
+
+	/**
+	 * Release file data. Pointers returned by accessors become invalid.
+	 */
+	void Close();
+
+	/**
+	 * Fetch number of stored points.
+	 *
+	 * @return Number of points or zero if file isn't opened.
+	 */
+	int GetSize() const;
+
+	/**
+	 * Fetch extraction parameters of stored collection.
+	 */
+	int GetOctaveStart() const;
+	int GetOctaveEnd() const;
+	double GetThreshold() const;
+
+	/**
+	 * Fetch fingerprint of dataset, which was source of stored points.
+	 *
+	 * @return Fingerprint of dataset.
+	 */
+	const GDALFeaturePointsCollection::DatasetFingerprint &GetFingerprint() const;
+
+	/**
+	 * Flat arrays of stored values. Arrays contain GetSize() elements,
+	 * descriptors array contains GetSize() * DESC_SIZE elements.
+	 */
+	const GInt32 *GetX() const;
+	const GInt32 *GetY() const;
+	const GInt32 *GetScale() const;
+	const GInt32 *GetRadius() const;
+	const GInt32 *GetSign() const;
+	const double *GetDescriptors() const;
+
+	/**
+	 * Add copies of stored points into collection.
+	 * Collection receives stored extraction parameters and fingerprint.
+	 *
+	 * @param poCollection Collection for points
+	 *
+	 * @return CE_None or CE_Failure if file isn't opened.
+	 */
+	CPLErr ExportToCollection(GDALFeaturePointsCollection *poCollection) const;
+
+	/**
+	 * Current version of file format
+	 */
+	static const int FORMAT_VERSION = 1;
+
+	/**
+	 * Size of the file header in bytes
+	 */
+	static const int HEADER_SIZE = 128;
+
+private:
+	/**
+	 * Compute offset of every array for specified number of points.
+	 */
+	static void ComputeLayout(GUIntBig nCount, vsi_l_offset *panOffsets,
+			vsi_l_offset *pnTotalSize);
+
+	// Number of stored arrays
+	static const int ARRAYS = 6;
+
+	int nCount;
+	int nOctaveStart;
+	int nOctaveEnd;
+	double dfThreshold;
+	GDALFeaturePointsCollection::DatasetFingerprint oFingerprint;
+
+	// Either memory mapping or buffer with file content
+	CPLVirtualMem *psVirtualMem;
+	VSILFILE *fpMapped;
+	GByte *pabyBuffer;
+	const GByte *pabyData;
+	vsi_l_offset anOffsets[ARRAYS];
+};
+
+#endif /* GDALFEATUREPOINTSFILE_H_ */
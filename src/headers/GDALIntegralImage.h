@@ -117,6 +117,15 @@ public:
 	 */
 	int GetWidth();
 
+	/**
+	 * Fetch pointer to the first value of integral image.
+	 * Values are stored row by row in one contiguous block, so value
+	 * in position (nRow, nCol) is located at nRow * GetWidth() + nCol.
+	 *
+	 * @return Pointer to integral image values or NULL if image isn't initialized.
+	 */
+	const double *GetData();
+
 private:
 	double **pMatrix;
 	int nWidth;
@@ -0,0 +1,193 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Randomized kd-forest for approximate nearest neighbour search.
+ */
+
+#ifndef GDALKDFOREST_H_
+#define GDALKDFOREST_H_
+
+#include "gdal.h"
+
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Randomized kd-forest for approximate nearest neighbour search.
+ * @details Forest consists of several kd-trees, built over the same points.
+ * Every tree splits space by dimension, which is randomly selected among
+ * dimensions with the highest variance, so trees partition space differently.
+ * Search descends all trees and then examines the closest unexplored
+ * branches of all trees in priority order, until specified number of
+ * points has been checked. Number of checks is a trade-off between
+ * accuracy and speed: the more points are checked, the closer result
+ * is to exhaustive search.
+ *
+ * Forest doesn't copy points and stores only pointer to provided array.
+ * Search doesn't modify forest, so it can be performed from several
+ * threads simultaneously, if every thread uses its own SearchContext.
+ */
+class GDALKDForest
+{
+public:
+	/**
+	 * Per-query working memory. One instance should be used by one thread.
+	 */
+	class SearchContext
+	{
+	public:
+		SearchContext();
+
+		// Stamps of points which were checked during current query
+		vector<int> anVisited;
+		int nStamp;
+		// Heap of unexplored branches: lower bound of distance and node
+		vector< pair<double, int> > aoBranches;
+	};
+
+	/**
+	 * Create empty forest.
+	 *
+	 * @param nTrees Number of randomized trees
+	 */
+	GDALKDForest(int nTrees);
+	virtual ~GDALKDForest();
+
+	/**
+	 * Build forest over subset of points.
+	 *
+	 * @param padfData Points stored one after another, nDim values per point.
+	 * Array should exist while forest is used
+	 * @param nPoints Number of points in array
+	 * @param nDim Number of values per point
+	 * @param panIndices Indexes of points to be indexed
+	 * @param nIndices Number of indexes
+	 */
+	void Build(const double *padfData, int nPoints, int nDim,
+			const int *panIndices, int nIndices);
+
+	/**
+	 * Find the nearest and the 2nd nearest points to the query.
+	 *
+	 * @param padfQuery Query point, nDim values
+	 * @param nChecks Maximum number of points to be compared with query
+	 * @param pabExcluded Flags of points, which should be skipped, or NULL
+	 * @param poContext Working memory of calling thread
+	 * @param pnBest Index of the nearest point or -1 if nothing is found
+	 * @param pdfBestDist Squared distance to the nearest point
+	 * @param pdfBestDist_2 Squared distance to the 2nd nearest point
+	 * or -1 if only one point is found
+	 *
+	 * @return Number of points compared with query.
+	 */
+	int FindTwoNearest(const double *padfQuery, int nChecks,
+			const bool *pabExcluded, SearchContext *poContext,
+			int *pnBest, double *pdfBestDist, double *pdfBestDist_2) const;
+
+	/**
+	 * Fetch number of indexed points.
+	 *
+	 * @return Number of indexed points.
+	 */
+	int GetSize() const;
+
+	/**
+	 * Maximum number of points in leaf node
+	 */
+	static const int LEAF_SIZE = 8;
+
+	/**
+	 * Number of dimensions with the highest variance,
+	 * among which split dimension is randomly selected
+	 */
+	static const int RAND_DIMS = 5;
+
+	/**
+	 * Maximum number of points used for variance estimation
+	 */
+	static const int VARIANCE_SAMPLES = 128;
+
+private:
+	/**
+	 * Node of kd-tree. Inner node has split dimension and value,
+	 * leaf node refers to range of indexes in tree's index array.
+	 */
+	class Node
+	{
+	public:
+		// Split dimension or -1 for leaf
+		int nSplitDim;
+		double dfSplitVal;
+		// Children for inner node, range of indexes for leaf
+		int nLeft;
+		int nRight;
+	};
+
+	/**
+	 * Build subtree over range of tree's index array.
+	 * Returns index of subtree's root node.
+	 */
+	int BuildTree(int nStart, int nCount);
+
+	/**
+	 * Check points in leaf node and update the nearest candidates.
+	 */
+	void CheckLeaf(const Node &oLeaf, const double *padfQuery,
+			const bool *pabExcluded, SearchContext *poContext,
+			int *pnChecked, int *pnBest, double *pdfBest, double *pdfBest_2) const;
+
+	/**
+	 * Descend from node to leaf, memorizing skipped branches.
+	 */
+	int Descend(int nNode, double dfBound, const double *padfQuery,
+			SearchContext *poContext) const;
+
+	/**
+	 * Pseudo-random generator. Forest is reproducible for the same input.
+	 */
+	int NextRandom(int nRange);
+
+	int nTrees;
+	int nDim;
+	int nPoints;
+	const double *padfData;
+
+	vector<Node> aoNodes;
+	vector<int> anRoots;
+	// Index arrays of all trees, one after another
+	vector<int> anTreeIndices;
+
+	unsigned int nSeed;
+};
+
+#endif /* GDALKDFOREST_H_ */
@@ -38,12 +38,22 @@
 #include "GDALFeaturePoint.h"
 #include "GDALFeaturePointsCollection.h"
 
+#include <vector>
+
+using namespace std;
+
 /**
  * @author Andrew Migal migal.drew@gmail.com
  * @brief Collection of matched feature points.
  * @details Class stores matched (corresponding) points,
  * which was detected on couple of images.
- * Doesn't copy objects and only contains pointers to actual instances.
+ * Every pair is stored as indexes of points in source collections
+ * and distance between their descriptors.
+ *
+ * By default sources are internal collections, which take ownership of
+ * points passed to AddPoints. If external sources are set by SetSources,
+ * pairs are added by AddPair and refer to points of these collections
+ * without any copying, so sources should exist while pairs are used.
  */
 class GDALMatchedPointsCollection
 {
@@ -53,11 +63,76 @@ public:
 
 	/**
 	 * Add pair of feature points to collection. Doesn't copy objects.
+	 * Collection takes ownership of points. Can't be used if
+	 * external sources are set.
 	 *
 	 * @param poFirstPoint Pointer to first feature point
 	 * @param poSecondPoint Pointer to second feature point
+	 * @param dfDistance Distance between descriptors of points or -1
+	 */
+	void AddPoints(GDALFeaturePoint *poFirstPoint, GDALFeaturePoint *poSecondPoint,
+			double dfDistance = -1);
+
+	/**
+	 * Add copies of pair of feature points. Copies are allocated by blocks
+	 * in memory of collection. Can't be used if external sources are set.
+	 *
+	 * @param oFirstPoint First feature point
+	 * @param oSecondPoint Second feature point
+	 * @param dfDistance Distance between descriptors of points or -1
+	 */
+	void AddPointCopies(const GDALFeaturePoint &oFirstPoint,
+			const GDALFeaturePoint &oSecondPoint, double dfDistance = -1);
+
+	/**
+	 * Refer pairs to points of external collections instead of stored copies.
+	 * Collection should be empty.
+	 *
+	 * @param poFirstSource Collection of the first points of pairs
+	 * @param poSecondSource Collection of the second points of pairs
+	 *
+	 * @return CE_None or CE_Failure if collection isn't empty.
+	 */
+	CPLErr SetSources(GDALFeaturePointsCollection *poFirstSource,
+			GDALFeaturePointsCollection *poSecondSource);
+
+	/**
+	 * Check whether pairs refer to points of external collections.
+	 *
+	 * @return TRUE if external sources are set.
+	 */
+	bool HasExternalSources() const;
+
+	/**
+	 * Fetch collection of the first points of pairs.
+	 *
+	 * @return External source or internal collection.
+	 */
+	GDALFeaturePointsCollection *GetFirstSource() const;
+
+	/**
+	 * Fetch collection of the second points of pairs.
+	 *
+	 * @return External source or internal collection.
+	 */
+	GDALFeaturePointsCollection *GetSecondSource() const;
+
+	/**
+	 * Add pair of points of source collections. Doesn't allocate
+	 * anything except growth of index arrays (see Reserve).
+	 *
+	 * @param nFirstIndex Index of point in the first source
+	 * @param nSecondIndex Index of point in the second source
+	 * @param dfDistance Distance between descriptors of points
+	 */
+	void AddPair(int nFirstIndex, int nSecondIndex, double dfDistance);
+
+	/**
+	 * Preallocate memory for pairs.
+	 *
+	 * @param nPairs Expected number of pairs
 	 */
-	void AddPoints(GDALFeaturePoint *poFirstPoint, GDALFeaturePoint *poSecondPoint);
+	void Reserve(int nPairs);
 
 	/**
 	 * Get pair of corresponding feature points. Method copies data into provided objects.
@@ -70,6 +145,66 @@ public:
 	void GetPoints(int nIndex,
 			GDALFeaturePoint *poFirstPoint, GDALFeaturePoint *poSecondPoint);
 
+	/**
+	 * Fetch the first point of pair without copying.
+	 *
+	 * @param nIndex Index of pair. Should start from zero.
+	 *
+	 * @return Point or NULL if index isn't valid.
+	 */
+	const GDALFeaturePoint *GetFirstPoint(int nIndex) const;
+
+	/**
+	 * Fetch the second point of pair without copying.
+	 *
+	 * @param nIndex Index of pair. Should start from zero.
+	 *
+	 * @return Point or NULL if index isn't valid.
+	 */
+	const GDALFeaturePoint *GetSecondPoint(int nIndex) const;
+
+	/**
+	 * Fetch indexes of the first points of pairs in the first source.
+	 *
+	 * @return Array of GetSize() indexes or NULL if collection is empty.
+	 */
+	const int *GetFirstIndices() const;
+
+	/**
+	 * Fetch indexes of the second points of pairs in the second source.
+	 *
+	 * @return Array of GetSize() indexes or NULL if collection is empty.
+	 */
+	const int *GetSecondIndices() const;
+
+	/**
+	 * Fetch distances between descriptors of points of pairs.
+	 * Scale of distances depends on the method, which added pairs:
+	 * - MatchFeaturePoints, MatchFeaturePointsIndexed, Blocked, Prepacked,
+	 * Mutual, Guided and PQ store distances normalized by the largest
+	 * distance among pairs found by the call, values are from 0 to 1;
+	 * - MatchFeaturePointsAbsolute stores raw euclidean distances;
+	 * - AddPoints and AddPointCopies without distance store -1 (unknown).
+	 *
+	 * Geometric verification keeps distances of source pairs.
+	 * Values of different scales shouldn't be mixed in one collection.
+	 *
+	 * @return Array of GetSize() distances or NULL if collection is empty.
+	 */
+	const double *GetDistances() const;
+
+	/**
+	 * Copy coordinates of all pairs into flat arrays.
+	 * Every array should have GetSize() elements, NULL arrays are skipped.
+	 *
+	 * @param padfFirstX X-coordinates (pixel) of the first points
+	 * @param padfFirstY Y-coordinates (line) of the first points
+	 * @param padfSecondX X-coordinates (pixel) of the second points
+	 * @param padfSecondY Y-coordinates (line) of the second points
+	 */
+	void ExportCoordinates(double *padfFirstX, double *padfFirstY,
+			double *padfSecondX, double *padfSecondY) const;
+
 	/**
 	 * Fetch number of corresponding pairs.
 	 *
@@ -79,12 +214,22 @@ public:
 
 	/**
 	 * Empty collection and delete all stored objects.
+	 * External sources are detached, but not modified.
 	 */
 	void Clear();
 
 private:
+	// Internal collections, own points passed to AddPoints and AddPointCopies
 	GDALFeaturePointsCollection *poCollect_1;
 	GDALFeaturePointsCollection *poCollect_2;
+
+	// Collections referred by pairs
+	GDALFeaturePointsCollection *poSource_1;
+	GDALFeaturePointsCollection *poSource_2;
+
+	vector<int> anIndex_1;
+	vector<int> anIndex_2;
+	vector<double> adfDistance;
 };
 
 #endif /* GDALMATCHEDPOINTSCOLLECTION_H_ */
@@ -0,0 +1,204 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Export of matched points as GCPs or vector features.
+ */
+
+#ifndef GDALMATCHESEXPORTER_H_
+#define GDALMATCHESEXPORTER_H_
+
+#include "gdal.h"
+#include "gdal_priv.h"
+#include "ogrsf_frmts.h"
+#include "GDALMatchedPointsCollection.h"
+
+/**
+ * Callback receiving matched pairs as soon as matcher produces them
+ * (see MatchFeaturePoints and CorrelateBatch in GDALCorrelator.h).
+ * Pairs from nFirstPair to nFirstPair + nPairs - 1 of collection
+ * are new, collection may be cleared after callback returns.
+ *
+ * @param poMatched Collection holding pairs
+ * @param nFirstPair Index of the first new pair
+ * @param nPairs Number of new pairs
+ * @param pSinkData User data passed to matcher
+ *
+ * @return CE_None or CE_Failure to report error to matcher.
+ */
+typedef CPLErr (*GDALMatchesSinkFunc)(const GDALMatchedPointsCollection *poMatched,
+		int nFirstPair, int nPairs, void *pSinkData);
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Export of matched points as GCPs or vector features.
+ * @details Points of the first image are treated as pixel/line positions,
+ * points of the second (georeferenced) image are transformed to
+ * georeferenced coordinates by its geotransform.
+ *
+ * GCPs are assigned to dataset at once with ExportToGCPs.
+ *
+ * Features are streamed into OGR layer: object is attached to layer,
+ * then pairs are appended as soon as they are matched, either directly
+ * or by passing SinkFunc with exporter to matcher. Features are
+ * created inside layer transactions, which are committed every
+ * nBatchSize features and when exporter is flushed or destroyed,
+ * so drivers like GPKG don't commit every feature separately.
+ * If feature can't be created, uncommitted features of current
+ * transaction are rolled back.
+ * Point geometry is georeferenced position, attributes are
+ * PIXEL, LINE (the first image), PIXEL_2, LINE_2 (the second image)
+ * and DISTANCE of descriptors. Missing fields are created.
+ */
+class GDALMatchesExporter
+{
+public:
+	/**
+	 * Create exporter attached to layer.
+	 *
+	 * @param poLayer Layer opened for update. Exporter doesn't own it
+	 * @param padfGeoTransform Geotransform of the second image
+	 * @param nBatchSize Number of features per transaction
+	 */
+	GDALMatchesExporter(OGRLayer *poLayer, const double *padfGeoTransform,
+			int nBatchSize = 1000);
+
+	/**
+	 * Commit pending transaction.
+	 */
+	virtual ~GDALMatchesExporter();
+
+	/**
+	 * Append all pairs of collection to layer.
+	 *
+	 * @param poMatched Collection of matched pairs
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	CPLErr Append(const GDALMatchedPointsCollection *poMatched);
+
+	/**
+	 * Append range of pairs of collection to layer. Second points are
+	 * georeferenced by geotransform of dataset of the second source
+	 * of collection, if it has one, otherwise by geotransform passed
+	 * to constructor. So pairs of different images in the same
+	 * coordinate system can be appended to one layer.
+	 *
+	 * @param poMatched Collection of matched pairs
+	 * @param nFirstPair Index of the first pair
+	 * @param nPairs Number of pairs
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	CPLErr Append(const GDALMatchedPointsCollection *poMatched,
+			int nFirstPair, int nPairs);
+
+	/**
+	 * Sink for matchers, which appends new pairs by Append. Transactions
+	 * span batches of matcher, Flush should be called after matching.
+	 *
+	 * @param poMatched Collection holding pairs
+	 * @param nFirstPair Index of the first new pair
+	 * @param nPairs Number of new pairs
+	 * @param pExporter GDALMatchesExporter instance
+	 *
+	 * @see GDALMatchesSinkFunc
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	static CPLErr SinkFunc(const GDALMatchedPointsCollection *poMatched,
+			int nFirstPair, int nPairs, void *pExporter);
+
+	/**
+	 * Append one pair to layer. On failure uncommitted features
+	 * of current batch are rolled back.
+	 *
+	 * @param poFirstPoint Point on the first image
+	 * @param poSecondPoint Point on the second image
+	 * @param dfDistance Distance of descriptors, negative if unknown
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	CPLErr AppendPair(const GDALFeaturePoint *poFirstPoint,
+			const GDALFeaturePoint *poSecondPoint, double dfDistance);
+
+	/**
+	 * Commit pending transaction.
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	CPLErr Flush();
+
+	/**
+	 * Fetch number of features created by exporter, except rolled back.
+	 *
+	 * @return Number of features.
+	 */
+	int GetFeatureCount() const;
+
+	/**
+	 * Assign matched pairs to dataset as GCPs. Existing GCPs are replaced.
+	 *
+	 * @param poMatched Collection of matched pairs
+	 * @param poTarget Dataset of the first image, opened for update
+	 * @param poReference Georeferenced dataset of the second image.
+	 * Its geotransform is used for coordinates and its projection for GCPs
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	static CPLErr ExportToGCPs(const GDALMatchedPointsCollection *poMatched,
+			GDALDataset *poTarget, GDALDataset *poReference);
+
+private:
+	/**
+	 * Create missing fields and remember their indexes.
+	 */
+	CPLErr PrepareFields();
+
+	/**
+	 * Create feature of pair, second point is georeferenced
+	 * by given geotransform.
+	 */
+	CPLErr WritePair(const GDALFeaturePoint *poFirstPoint,
+			const GDALFeaturePoint *poSecondPoint, double dfDistance,
+			const double *padfGeoTransform);
+
+	OGRLayer *poLayer;
+	double adfGeoTransform[6];
+	int nBatchSize;
+
+	bool bPrepared;
+	bool bInTransaction;
+	int nPending;
+	int nFeatures;
+
+	int anFields[5];
+};
+
+#endif /* GDALMATCHESEXPORTER_H_ */
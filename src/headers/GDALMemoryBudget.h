@@ -0,0 +1,182 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Planning of detection within memory budget.
+ */
+
+#ifndef GDALMEMORYBUDGET_H_
+#define GDALMEMORYBUDGET_H_
+
+#include "gdal.h"
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Estimation of memory required by detection of feature points
+ * and choice of execution mode, which fits into budget.
+ * @details Detection keeps luminosity image, integral image and Hessian
+ * layers, every of them has size of the whole window. Budget is met by
+ * cheaper modes in the following order:
+ * - all layers of octave map are kept until search of extrema;
+ * - octaves are processed one by one, so only four layers are kept;
+ * - image is split into tiles, which are processed one by one. Tiles
+ * overlap by margin, which covers filters of the top octave and
+ * descriptors, so points of tile core are found as on the whole image.
+ *
+ * Estimation covers working buffers of detection, including band buffers
+ * of reading. Memory of detected points depends on image content
+ * and isn't included.
+ */
+class GDALMemoryBudget
+{
+public:
+	/**
+	 * Mode of detection chosen by Plan.
+	 */
+	class ExecutionPlan
+	{
+	public:
+		ExecutionPlan();
+
+		/**
+		 * Check whether image is split into tiles.
+		 *
+		 * @return TRUE if there are several tiles.
+		 */
+		bool IsTiled() const;
+
+		// Size of tile core, equal to image size if image isn't tiled
+		int nTileXSize;
+		int nTileYSize;
+		// Width of overlap added to every side of tile core
+		int nMargin;
+		// TRUE if all layers of octave map are kept at once
+		bool bRetainLayers;
+		// Estimated peak memory of one tile in bytes
+		GIntBig nEstimate;
+		// Size of image
+		int nXSize;
+		int nYSize;
+	};
+
+	/**
+	 * Choose strips, in which window is read into luminosity image.
+	 * Strip consists of whole rows of blocks and of at least
+	 * PREFETCH_LINES source lines. Strips give the same result as one
+	 * read only if every resulting line covers the same number of source
+	 * lines, otherwise window is a single strip.
+	 *
+	 * @param nYSize Height of window in source lines
+	 * @param nHeight Height of resulting image
+	 * @param nBlockYSize Height of block of bands
+	 * @param pnRatio Resulting number of source lines per resulting line,
+	 * zero if window is a single strip
+	 * @param pnStripRows Resulting number of image rows in strip
+	 */
+	static void GetReadStrips(int nYSize, int nHeight, int nBlockYSize,
+			int *pnRatio, int *pnStripRows);
+
+	/**
+	 * Estimate size of buffers used by reading of window into luminosity
+	 * image: band buffers of strips and rows of conversion.
+	 *
+	 * @param nWidth Width of resulting image
+	 * @param nHeight Height of resulting image
+	 * @param nYSize Height of window in source lines
+	 * @param nBlockYSize Height of block of bands
+	 * @param nPixelSize Sum of pixel sizes of three bands in bytes
+	 * @param nReaders Number of threads reading strips through pool
+	 * of handles, or zero if window is read through one handle (then two
+	 * strips are kept: one is read while another one is converted)
+	 *
+	 * @return Size in bytes.
+	 */
+	static GIntBig EstimateReading(int nWidth, int nHeight, int nYSize,
+			int nBlockYSize, int nPixelSize, int nReaders);
+
+	/**
+	 * Estimate peak memory of detection on window.
+	 *
+	 * @param nXSize Width of window
+	 * @param nYSize Height of window
+	 * @param nOctaveStart Number of bottom octave
+	 * @param nOctaveEnd Number of top octave
+	 * @param bRetainLayers TRUE if all layers of octave map are kept
+	 * at once, FALSE if octaves are processed one by one
+	 * @param nReadingMemory Size of reading buffers, see EstimateReading
+	 *
+	 * @return Size in bytes.
+	 */
+	static GIntBig EstimateWindow(int nXSize, int nYSize,
+			int nOctaveStart, int nOctaveEnd, bool bRetainLayers,
+			GIntBig nReadingMemory);
+
+	/**
+	 * Fetch width of overlap between tiles, which is required to detect
+	 * points of tile core as on the whole image.
+	 *
+	 * @param nOctaveEnd Number of top octave
+	 *
+	 * @return Width in pixels.
+	 */
+	static int GetTileMargin(int nOctaveEnd);
+
+	/**
+	 * Choose the cheapest mode of detection, which fits into budget.
+	 *
+	 * @param nXSize Width of image
+	 * @param nYSize Height of image
+	 * @param nOctaveStart Number of bottom octave
+	 * @param nOctaveEnd Number of top octave
+	 * @param nBudget Limit of memory in bytes
+	 * @param nBlockYSize Height of block of bands
+	 * @param nPixelSize Sum of pixel sizes of three bands in bytes
+	 * @param nReaders Number of threads reading strips, see EstimateReading
+	 * @param poPlan Resulting plan
+	 *
+	 * @return CE_None or CE_Failure if budget is too small even for
+	 * the smallest tile.
+	 */
+	static CPLErr Plan(int nXSize, int nYSize, int nOctaveStart,
+			int nOctaveEnd, GIntBig nBudget, int nBlockYSize, int nPixelSize,
+			int nReaders, ExecutionPlan *poPlan);
+
+	/**
+	 * Minimal size of tile core in pixels
+	 */
+	static const int MIN_TILE_SIZE = 64;
+
+	/**
+	 * Minimal number of source lines in strip, which is read
+	 * while previous strip is converted
+	 */
+	static const int PREFETCH_LINES = 256;
+};
+
+#endif /* GDALMEMORYBUDGET_H_ */
@@ -74,6 +74,19 @@ public:
 	 */
 	void ComputeLayer(GDALIntegralImage *poImg);
 
+	/**
+	 * Free Hessian values and signs. Layers, which share these
+	 * arrays, should be cleared by caller.
+	 */
+	void Release();
+
+	/**
+	 * Fetch size of Hessian values and signs.
+	 *
+	 * @return Size in bytes or zero if layer isn't computed.
+	 */
+	GIntBig GetMemoryUsage() const;
+
     /**
      * Octave which contains this layer (1,2,3...)
      */
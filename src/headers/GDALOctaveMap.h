@@ -63,6 +63,32 @@ public:
 	 */
 	void ComputeMap(GDALIntegralImage *poImg);
 
+	/**
+	 * Calculate Hessian values for layers of one octave. Octaves should
+	 * be computed in ascending order, because the first two layers
+	 * of octave are shared with the previous one.
+	 *
+	 * @param poImg Integral image instance which provides necessary data
+	 * @param nOctave Number of octave
+	 */
+	void ComputeOctave(GDALIntegralImage *poImg, int nOctave);
+
+	/**
+	 * Free layers of octave, which aren't shared with the next octave.
+	 * Layers of the top octave are freed completely. Used to keep only
+	 * few layers in memory, when octaves are processed one by one.
+	 *
+	 * @param nOctave Number of octave
+	 */
+	void ReleaseOctave(int nOctave);
+
+	/**
+	 * Fetch size of computed layers. Shared layers are counted once.
+	 *
+	 * @return Size in bytes.
+	 */
+	GIntBig GetMemoryUsage() const;
+
 	/**
 	 * Method makes decision that specified point
 	 * in middle octave layer is maximum among all points
@@ -109,6 +135,9 @@ public:
 	 */
 private:
 	void CopyCommonData(GDALOctaveLayer *source, GDALOctaveLayer *destination);
+
+	// Free data of layer and clear all layers sharing it
+	void ReleaseLayer(GDALOctaveLayer *poLayer);
 };
 
 #endif /* GDALOCTAVEMAP_H_ */
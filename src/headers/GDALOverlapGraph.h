@@ -0,0 +1,107 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Graph of overlapping georeferenced images.
+ */
+
+#ifndef GDALOVERLAPGRAPH_H_
+#define GDALOVERLAPGRAPH_H_
+
+#include "gdal.h"
+#include "gdal_priv.h"
+
+#include <vector>
+
+using namespace std;
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Graph of overlapping georeferenced images.
+ * @details Vertices are datasets, edge connects two datasets if their
+ * footprints overlap. Footprint is bounding box of raster corners
+ * transformed by geotransform, so all datasets should be in the same
+ * coordinate system. Overlapping pairs are found by sweep over footprints
+ * sorted by minimal X, which is much faster than checking of all pairs
+ * for large sets of scenes.
+ */
+class GDALOverlapGraph
+{
+public:
+	GDALOverlapGraph();
+	virtual ~GDALOverlapGraph();
+
+	/**
+	 * Build graph for datasets.
+	 *
+	 * @param papoDatasets Array of datasets
+	 * @param nDatasets Number of datasets
+	 * @param dfMinOverlap Minimal area of intersection of footprints,
+	 * relative to area of the smaller footprint, from 0 to 1
+	 *
+	 * @return CE_None or CE_Failure if some dataset has no geotransform.
+	 */
+	CPLErr Build(GDALDataset **papoDatasets, int nDatasets,
+			double dfMinOverlap = 0);
+
+	/**
+	 * Fetch number of overlapping pairs.
+	 *
+	 * @return Number of edges.
+	 */
+	int GetEdgeCount() const;
+
+	/**
+	 * Fetch overlapping pair. Edges are sorted by the first
+	 * and then by the second dataset, the first is always less.
+	 *
+	 * @param nEdge Index of edge
+	 * @param pnFirst Index of the first dataset
+	 * @param pnSecond Index of the second dataset
+	 */
+	void GetEdge(int nEdge, int *pnFirst, int *pnSecond) const;
+
+	/**
+	 * Compute footprint of dataset.
+	 *
+	 * @param poDataset Georeferenced dataset
+	 * @param padfFootprint Bounding box: minimal X, minimal Y,
+	 * maximal X, maximal Y
+	 *
+	 * @return CE_None or CE_Failure if dataset has no geotransform.
+	 */
+	static CPLErr ComputeFootprint(GDALDataset *poDataset,
+			double *padfFootprint);
+
+private:
+	vector<int> anFirst;
+	vector<int> anSecond;
+};
+
+#endif /* GDALOVERLAPGRAPH_H_ */
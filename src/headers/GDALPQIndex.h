@@ -0,0 +1,281 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Compressed index of descriptors for large sets of feature points.
+ */
+
+#ifndef GDALPQINDEX_H_
+#define GDALPQINDEX_H_
+
+#include "gdal.h"
+#include "GDALFeaturePoint.h"
+#include "GDALFeaturePointsCollection.h"
+#include "GDALFeaturePointsFile.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Inverted file index with product quantization of descriptors.
+ * @details Descriptor space is partitioned by coarse quantizer into lists,
+ * every point is stored in the list of its nearest coarse centroid.
+ * Residual between descriptor and centroid is split into subspaces and
+ * every part is replaced by index of the nearest centroid of subspace's
+ * codebook, so descriptor takes one byte per subspace instead of
+ * DESC_SIZE doubles.
+ *
+ * Search visits several nearest lists. For every list distances from
+ * query's residual to all codebook centroids are tabulated, so approximate
+ * distance to stored point is a sum of one value per subspace (asymmetric
+ * distance). The best candidates are re-ranked by exact distance to
+ * descriptors of GDALFeaturePointsFile, which is mapped into memory,
+ * so descriptors are paged in by system only for candidates:
+ * - points added from opened file use it directly, file should stay
+ * opened while index is used;
+ * - points added from collection are spilled to temporary file, which
+ * is owned by index and removed with it, so collection may be destroyed
+ * after Add.
+ * Position, scale and radius of points are also read from files, so
+ * memory holds only code, sign, list entry and source of every point,
+ * about nSubspaces + 13 bytes. On platforms without memory mapping files
+ * are read into memory entirely (see GDALFeaturePointsFile::Open).
+ *
+ * Every entry remembers scene (image) of its point, so matches with
+ * archive of many scenes can be attributed. Search doesn't modify index,
+ * so it can be performed from several threads simultaneously.
+ */
+class GDALPQIndex
+{
+public:
+	/**
+	 * Create empty untrained index.
+	 */
+	GDALPQIndex();
+	virtual ~GDALPQIndex();
+
+	/**
+	 * Train coarse quantizer and codebooks on points of collection.
+	 * Points aren't added to index. Previous content of index is removed.
+	 *
+	 * @param poCollection Training points, a sample of data to be indexed
+	 * @param nLists Number of lists (coarse centroids)
+	 * @param nSubspaces Number of subspaces, which is also size of code
+	 * in bytes. Should divide GDALFeaturePoint::DESC_SIZE, typically 8 or 16
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	CPLErr Train(GDALFeaturePointsCollection *poCollection,
+			int nLists, int nSubspaces);
+
+	/**
+	 * Encode and add all points of collection to the trained index.
+	 * Points are written to temporary file (see CPLGenerateTempFilename),
+	 * which is used like files passed to Add, so collection isn't needed
+	 * after this call.
+	 *
+	 * @param poCollection Points to be added
+	 * @param nScene Identifier of scene of points. Negative value means
+	 * number of this source in order of Add calls
+	 *
+	 * @return CE_None or CE_Failure if index isn't trained or
+	 * temporary file can't be written.
+	 */
+	CPLErr Add(GDALFeaturePointsCollection *poCollection, int nScene = -1);
+
+	/**
+	 * Encode and add all points of opened file to the trained index.
+	 * Descriptors of the file are used for re-ranking, so file should
+	 * stay opened while index is used.
+	 *
+	 * @param poFile Opened file of points
+	 * @param nScene Identifier of scene of points. Negative value means
+	 * number of this source in order of Add calls
+	 *
+	 * @return CE_None or CE_Failure if index isn't trained or file
+	 * isn't opened.
+	 */
+	CPLErr Add(const GDALFeaturePointsFile *poFile, int nScene = -1);
+
+	/**
+	 * Find the nearest and the 2nd nearest indexed points to the query.
+	 * Only points with the same sign of Hessian are considered.
+	 *
+	 * @param padfQuery Query descriptor, DESC_SIZE values
+	 * @param nSign Sign of Hessian of query point
+	 * @param nProbe Number of visited lists
+	 * @param nRerank Number of candidates re-ranked by exact distance
+	 * @param pabExcluded Flags of entries, which should be skipped, or NULL
+	 * @param pnBest Entry of the nearest point or -1 if nothing is found
+	 * @param pdfBestDist Squared distance to the nearest point
+	 * @param pdfBestDist_2 Squared distance to the 2nd nearest point
+	 * or -1 if only one point is found
+	 */
+	void FindTwoNearest(const double *padfQuery, int nSign,
+			int nProbe, int nRerank, const bool *pabExcluded,
+			int *pnBest, double *pdfBestDist, double *pdfBestDist_2) const;
+
+	/**
+	 * Fetch number of indexed points (entries).
+	 *
+	 * @return Number of entries.
+	 */
+	int GetSize() const;
+
+	/**
+	 * Fetch scene of point of entry.
+	 *
+	 * @param nEntry Entry of index
+	 *
+	 * @return Identifier of scene passed to Add.
+	 */
+	int GetScene(int nEntry) const;
+
+	/**
+	 * Fetch index of point of entry in its collection or file.
+	 *
+	 * @param nEntry Entry of index
+	 *
+	 * @return Index of point.
+	 */
+	int GetPointIndex(int nEntry) const;
+
+	/**
+	 * Restore point of entry.
+	 *
+	 * @param nEntry Entry of index
+	 * @param poPoint Point receiving position, scale, radius, sign
+	 * and descriptor
+	 */
+	void GetPoint(int nEntry, GDALFeaturePoint *poPoint) const;
+
+	/**
+	 * Fetch size of memory allocated by index, excluding files.
+	 *
+	 * @return Size in bytes.
+	 */
+	GIntBig GetMemoryUsage() const;
+
+	/**
+	 * Fetch size of code in bytes.
+	 *
+	 * @return Number of subspaces or 0 if index isn't trained.
+	 */
+	int GetCodeSize() const;
+
+	/**
+	 * Number of centroids in codebook of every subspace
+	 */
+	static const int CODEBOOK_SIZE = 256;
+
+	/**
+	 * Maximum number of points used for training
+	 */
+	static const int MAX_TRAIN_POINTS = 16384;
+
+	/**
+	 * Number of k-means iterations
+	 */
+	static const int TRAIN_ITERATIONS = 10;
+
+private:
+	// Index owns temporary files, so it isn't copied
+	GDALPQIndex(const GDALPQIndex &);
+	GDALPQIndex &operator=(const GDALPQIndex &);
+
+	/**
+	 * Close and remove temporary files.
+	 */
+	void RemoveSpilledFiles();
+
+	/**
+	 * Cluster points by k-means. Initial centroids are distinct
+	 * pseudo-randomly selected points.
+	 */
+	void KMeans(const double *padfData, int nPoints, int nDim,
+			int nClusters, double *padfCentroids);
+
+	/**
+	 * Find index of the nearest centroid.
+	 */
+	static int FindNearestCentroid(const double *padfPoint,
+			const double *padfCentroids, int nClusters, int nDim);
+
+	/**
+	 * Pseudo-random generator. Index is reproducible for the same input.
+	 */
+	int NextRandom(int nRange);
+
+	/**
+	 * Encode descriptor and append entry to its list.
+	 */
+	void AddEntry(const double *padfDesc, int nPoint, int nSign);
+
+	/**
+	 * Fetch descriptor of entry as doubles.
+	 *
+	 * @param nEntry Entry of index
+	 * @param padfDesc Resulting DESC_SIZE values
+	 */
+	void GetDescriptor(int nEntry, double *padfDesc) const;
+
+	int nLists;
+	int nSubspaces;
+	int nSubDim;
+
+	// Coarse centroids, DESC_SIZE values each
+	vector<double> adfCoarse;
+	// Codebooks of subspaces one after another,
+	// CODEBOOK_SIZE centroids of nSubDim values each
+	vector<double> adfCodebooks;
+
+	// Entries of every list and their codes (nSubspaces bytes per entry)
+	vector< vector<int> > aanListEntries;
+	vector< vector<GByte> > aabyListCodes;
+
+	// Source, point in source and sign of every entry
+	vector<int> anEntrySource;
+	vector<int> anEntryPoint;
+	vector<signed char> anEntrySign;
+
+	// Scene and file of every source
+	vector<int> anSourceScene;
+	vector<const GDALFeaturePointsFile *> apoSourceFiles;
+
+	// Temporary files of collections and their names
+	vector<GDALFeaturePointsFile *> apoSpilledFiles;
+	vector<string> aosSpilledFilenames;
+
+	unsigned int nSeed;
+};
+
+#endif /* GDALPQINDEX_H_ */
@@ -0,0 +1,139 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Writing of feature points and matched pairs to files.
+ */
+
+#ifndef GDALPOINTSWRITER_H_
+#define GDALPOINTSWRITER_H_
+
+#include "gdal.h"
+#include "cpl_vsi.h"
+#include "GDALFeaturePointsCollection.h"
+#include "GDALMatchedPointsCollection.h"
+#include "GDALFeaturePointsFile.h"
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Writing of feature points and matched pairs to files.
+ * @details Two formats are supported.
+ *
+ * Text format has a line per point "x y" or per pair "x1 y1 x2 y2".
+ * Lines are formatted into large buffer, which is written at once,
+ * so file isn't flushed after every line.
+ *
+ * Binary points are stored as GDALFeaturePointsFile, so they can be
+ * opened and mapped back with descriptors.
+ *
+ * Binary pairs are intended for memory mapping too. File starts with
+ * 16 bytes header: 4 bytes signature "GCMP", then format version,
+ * number of pairs and number of arrays as little-endian 32-bit integers.
+ * Header is followed by flat arrays, every array has a value per pair,
+ * all values are little-endian: 32-bit integer arrays of indexes
+ * of the first and the second
+ * points in their collections, X and Y of the first points, X and Y
+ * of the second points, followed by array of 64-bit floating point
+ * distances (negative if unknown). Distances start at offset
+ * multiple of 8, so they are aligned when file is mapped.
+ */
+class GDALPointsWriter
+{
+public:
+	/**
+	 * Output formats
+	 */
+	enum Format
+	{
+		FORMAT_TEXT,
+		FORMAT_BINARY
+	};
+
+	/**
+	 * Version of binary format of pairs
+	 */
+	static const int BINARY_VERSION = 1;
+
+	/**
+	 * Parse name of format: "text" or "binary".
+	 *
+	 * @param pszName Name of format, case insensitive
+	 * @param peFormat Parsed format
+	 *
+	 * @return CE_None or CE_Failure if name is unknown.
+	 */
+	static CPLErr ParseFormat(const char *pszName, Format *peFormat);
+
+	/**
+	 * Write feature points to file.
+	 *
+	 * @param poCollection Collection of points
+	 * @param pszFilename Name of file, which will be overwritten
+	 * @param eFormat Format of file
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	static CPLErr WritePoints(const GDALFeaturePointsCollection *poCollection,
+			const char *pszFilename, Format eFormat);
+
+	/**
+	 * Write matched pairs to file.
+	 *
+	 * @param poMatched Collection of matched pairs
+	 * @param pszFilename Name of file, which will be overwritten
+	 * @param eFormat Format of file
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	static CPLErr WriteMatchedPoints(const GDALMatchedPointsCollection *poMatched,
+			const char *pszFilename, Format eFormat);
+
+private:
+	/**
+	 * Number of values or bytes, which are collected before writing
+	 */
+	static const int BUFFER_SIZE = 65536;
+
+	/**
+	 * Write binary header.
+	 */
+	static CPLErr WriteHeader(VSILFILE *fp, const char *pszSignature,
+			int nRecords, int nArrays);
+
+	/**
+	 * Write array of 32-bit integers taken from pairs by field number.
+	 */
+	static CPLErr WriteIntArray(VSILFILE *fp,
+			const GDALMatchedPointsCollection *poMatched, int nField);
+
+	static int GetPairField(const GDALMatchedPointsCollection *poMatched,
+			int nIndex, int nField);
+};
+
+#endif /* GDALPOINTSWRITER_H_ */
@@ -0,0 +1,172 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Geometric verification of matched points by RANSAC.
+ */
+
+#ifndef GDALRANSACVERIFIER_H_
+#define GDALRANSACVERIFIER_H_
+
+#include "gdal.h"
+#include "GDALMatchedPointsCollection.h"
+
+#include <vector>
+
+using namespace std;
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Geometric verification of matched points by RANSAC.
+ * @details Transformation from the first image to the second one is
+ * estimated from random minimal samples of pairs, the hypothesis with
+ * the largest number of inliers is refined by least squares over its
+ * inliers. Hypotheses are generated and scored in batches, every batch
+ * is split between threads. Scoring of hypothesis is abandoned as soon
+ * as it can't beat the best hypothesis of previous batches.
+ * Sampling stops when number of hypotheses is enough to find
+ * all-inlier sample with the requested confidence.
+ *
+ * Sample of every hypothesis depends only on its number,
+ * so result doesn't depend on number of threads.
+ *
+ * Model is 3x3 matrix in row-major order, point (x, y) of the first image
+ * is mapped to ((m0 x + m1 y + m2) / w, (m3 x + m4 y + m5) / w) of the
+ * second image, where w = m6 x + m7 y + m8. For affine model the last row
+ * is (0, 0, 1).
+ */
+class GDALRansacVerifier
+{
+public:
+	/**
+	 * Type of transformation.
+	 */
+	enum ModelType
+	{
+		MODEL_AFFINE,
+		MODEL_HOMOGRAPHY
+	};
+
+	/**
+	 * Fit model to matched points and select inliers.
+	 *
+	 * @param poMatched Matched points
+	 * @param eModel Type of transformation
+	 * @param dfMaxError Maximal distance in pixels between mapped point
+	 * of the first image and its pair on the second image for inlier
+	 * @param padfModel Resulting model, array of 9 values
+	 * @param poInliers Collection for inlier pairs or NULL. If matched
+	 * collection has external sources, inliers refer to the same sources
+	 * (collection should be empty), otherwise copies of points are added
+	 * @param pabInlier Flags of inlier pairs, array of poMatched->GetSize()
+	 * values, or NULL
+	 * @param nThreads Number of threads, zero means
+	 * GDAL_NUM_THREADS configuration option or number of CPUs
+	 * @param dfConfidence Probability to draw at least one sample
+	 * without outliers, from 0 to 1
+	 * @param nMaxHypotheses Maximal number of hypotheses
+	 *
+	 * @return Number of inliers or -1 if model can't be estimated.
+	 */
+	static int Verify(GDALMatchedPointsCollection *poMatched,
+			ModelType eModel, double dfMaxError, double *padfModel,
+			GDALMatchedPointsCollection *poInliers, bool *pabInlier,
+			int nThreads = 0, double dfConfidence = 0.99,
+			int nMaxHypotheses = 4096);
+
+	/**
+	 * Number of hypotheses generated and scored between checks of stop criterion
+	 */
+	static const int BATCH_SIZE = 32;
+
+	/**
+	 * Number of points scored between checks of abandoning criterion
+	 */
+	static const int SCORE_BLOCK = 256;
+
+private:
+	/**
+	 * Coordinates of matched points in flat arrays
+	 * and parameters of estimation
+	 */
+	class Problem
+	{
+	public:
+		int nPoints;
+		int nSampleSize;
+		ModelType eModel;
+		double dfMaxErrorSquared;
+
+		vector<double> adfX_1;
+		vector<double> adfY_1;
+		vector<double> adfX_2;
+		vector<double> adfY_2;
+
+		// Hypotheses of current batch and their scores
+		int nFirstHypothesis;
+		int nBestScore;
+		vector<double> adfModels;
+		vector<int> anScores;
+	};
+
+	/**
+	 * Generate and score one hypothesis of current batch.
+	 */
+	static void ScoreHypothesis(void *pData, int iJob);
+
+	/**
+	 * Draw distinct pairs for hypothesis. Sample depends only on number
+	 * of hypothesis.
+	 */
+	static void DrawSample(const Problem *poProblem, int nHypothesis,
+			int *panSample);
+
+	/**
+	 * Estimate model by least squares over selected pairs.
+	 * Returns FALSE if configuration is degenerate.
+	 */
+	static bool FitModel(const Problem *poProblem, const int *panIndices,
+			int nCount, double *padfModel);
+
+	/**
+	 * Count inliers of model. Counting is abandoned and -1 returned
+	 * if number of inliers can't reach nMinScore.
+	 */
+	static int CountInliers(const Problem *poProblem, const double *padfModel,
+			int nMinScore, bool *pabInlier);
+
+	/**
+	 * Solve linear system by Gaussian elimination with partial pivoting.
+	 * Matrix is stored in row-major order and destroyed.
+	 * Returns FALSE if matrix is singular.
+	 */
+	static bool SolveLinear(double *padfA, double *padfB, int nSize);
+};
+
+#endif /* GDALRANSACVERIFIER_H_ */
@@ -0,0 +1,112 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Reusable correlator of many images against one reference image.
+ */
+
+#ifndef GDALREFERENCECORRELATOR_H_
+#define GDALREFERENCECORRELATOR_H_
+
+#include "gdal.h"
+#include "GDALFeaturePointsCollection.h"
+#include "GDALMatchedPointsCollection.h"
+#include "GDALDescriptorMatrix.h"
+
+#include <vector>
+
+using namespace std;
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Reusable correlator of many images against one reference image.
+ * @details Correlator owns feature points of reference image and keeps
+ * their descriptors packed for exhaustive blocked search
+ * (see GDALSimpleSURF::MatchFeaturePointsBlocked). Reference is processed
+ * once, then any number of query collections are matched against it.
+ *
+ * Matching doesn't modify correlator, so it can be performed from several
+ * threads simultaneously. Every thread should use its own query collection
+ * and resulting collection.
+ */
+class GDALReferenceCorrelator
+{
+public:
+	GDALReferenceCorrelator();
+	virtual ~GDALReferenceCorrelator();
+
+	/**
+	 * Set feature points of reference image and prepare search structure.
+	 * Correlator takes ownership of collection, previous reference is deleted.
+	 *
+	 * @param poReference Points of reference image
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	CPLErr SetReference(GDALFeaturePointsCollection *poReference);
+
+	/**
+	 * Fetch points of reference image.
+	 *
+	 * @return Reference collection or NULL if it isn't set.
+	 */
+	GDALFeaturePointsCollection *GetReference() const;
+
+	/**
+	 * Find corresponding points of query collection and reference.
+	 * The first point of every pair is from query, the second one is
+	 * from reference. If resulting collection has external sources,
+	 * they should be query collection and reference (see GetReference).
+	 *
+	 * @param poQuery Points of query image
+	 * @param poMatched Resulting collection for matched points
+	 * @param dfThreshold Value from 0 to 1, same as in MatchFeaturePoints
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	CPLErr Match(GDALFeaturePointsCollection *poQuery,
+			GDALMatchedPointsCollection *poMatched, double dfThreshold) const;
+
+	/**
+	 * Estimate memory occupied by reference points and search structure.
+	 *
+	 * @return Size in bytes.
+	 */
+	GIntBig GetMemoryUsage() const;
+
+private:
+	GDALFeaturePointsCollection *poReference;
+
+	// Descriptors of reference for positive and negative signs
+	GDALDescriptorMatrix aoMatrices[2];
+	// Row of every reference point in matrix of its sign
+	vector<int> anRows;
+};
+
+#endif /* GDALREFERENCECORRELATOR_H_ */
@@ -38,13 +38,17 @@
 #include "GDALIntegralImage.h"
 #include "GDALFeaturePoint.h"
 #include "GDALFeaturePointsCollection.h"
+#include "GDALPQIndex.h"
 #include "GDALMatchedPointsCollection.h"
+#include "GDALDescriptorMatrix.h"
+#include "GDALDatasetPool.h"
+#include "GDALCorrelatorStats.h"
 
 #include "gdal.h"
 #include "gdal_priv.h"
 #include "cpl_vsi.h"
 
-#include <list>
+#include <vector>
 #include <math.h>
 
 #define CPLFree VSIFree
@@ -81,6 +85,69 @@ private:
 		double euclideanDist;
 	};
 
+	/**
+	 * Class stores contiguous descriptors of points
+	 * with the same sign of Hessian and scale.
+	 */
+	class DescriptorBucket
+	{
+	public:
+		int nSign;
+		// Scale of points or zero if bucket contains all scales
+		int nScale;
+		GDALDescriptorMatrix oMatrix;
+	};
+
+	/**
+	 * Class stores sampling geometry of descriptor area for one scale.
+	 * Every Haar wavelet evaluation is described by 3x3 grid of
+	 * integral image corners, the central corner isn't used. Corners are stored as offsets relative
+	 * to the feature point position, so descriptor of the point,
+	 * which area is fully inside the image, is computed without
+	 * any range checks.
+	 */
+	class HaarSamplingTable
+	{
+	public:
+		/**
+		 * Build table for specified scale.
+		 *
+		 * @param nScale Scale of feature points (2, 4, 8, 16 and so on)
+		 * @param nImgWidth Width of integral image
+		 */
+		HaarSamplingTable(int nScale, int nImgWidth);
+
+		/**
+		 * Check that descriptor area of specified point
+		 * (including wavelet borders) is inside the image.
+		 *
+		 * @param nRow Row of feature point
+		 * @param nCol Column of feature point
+		 * @param nImgHeight Height of integral image
+		 *
+		 * @return TRUE if unchecked path can be used or FALSE otherwise.
+		 */
+		bool IsInside(int nRow, int nCol, int nImgHeight) const;
+
+		// Number of quadrants in 4x4 grid
+		static const int QUADS = 16;
+		// Number of samples in 5x5 grid of quadrant
+		static const int QUAD_SAMPLES = 25;
+		// Number of used corners per sample
+		static const int CORNERS = 8;
+
+		int scale;
+		int width;
+		// Bounds of used corners relative to the point
+		int minRow;
+		int maxRow;
+		int minCol;
+		int maxCol;
+		// Corner offsets, sample-major: (s * CORNERS + k) * QUADS + q,
+		// so one load per corner reads the same sample of adjacent quads
+		int anOffsets[QUADS * QUAD_SAMPLES * CORNERS];
+	};
+
 public:
 	/**
 	 * Prepare class according to specified parameters. Octave numbers affects
@@ -129,6 +196,55 @@ public:
 				int nXSize, int nYSize,
 				double **padfImg, int nHeight, int nWidth);
 
+	/**
+	 * Convert window of image with RGB channels to grayscale
+	 * using "luminosity" method.
+	 *
+	 * @param red Image's red channel
+	 * @param green Image's green channel
+	 * @param blue Image's blue channel
+	 * @param nXOff Pixel offset of window
+	 * @param nYOff Line offset of window
+	 * @param nXSize Width of window
+	 * @param nYSize Height of window
+	 * @param padfImg Array for resulting grayscale image
+	 * @param nHeight Height of resulting image
+	 * @param nWidth Width of resulting image
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	static CPLErr ConvertRGBToLuminosity(
+				GDALRasterBand *red,
+				GDALRasterBand *green,
+				GDALRasterBand *blue,
+				int nXOff, int nYOff, int nXSize, int nYSize,
+				double **padfImg, int nHeight, int nWidth);
+
+	/**
+	 * Convert window of image with RGB channels to grayscale, decoding
+	 * strips of window in parallel. Every thread reads through its own
+	 * dataset handle taken from pool. Result is the same as of
+	 * sequential conversion.
+	 *
+	 * @param poPool Pool of handles of image
+	 * @param panBands Array of 3 raster bands numbers, for Red, Green, Blue bands
+	 * @param nXOff Pixel offset of window
+	 * @param nYOff Line offset of window
+	 * @param nXSize Width of window
+	 * @param nYSize Height of window
+	 * @param padfImg Array for resulting grayscale image
+	 * @param nHeight Height of resulting image
+	 * @param nWidth Width of resulting image
+	 * @param nThreads Number of threads, zero for default. Number of
+	 * threads, which read simultaneously, is limited by pool
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	static CPLErr ConvertRGBToLuminosity(
+				GDALDatasetPool *poPool, const int *panBands,
+				int nXOff, int nYOff, int nXSize, int nYSize,
+				double **padfImg, int nHeight, int nWidth, int nThreads = 0);
+
 	/**
 	 * Find feature points using specified integral image.
 	 *
@@ -147,6 +263,76 @@ public:
 	void ExtractFeaturePoints(GDALIntegralImage *poImg,
 			GDALFeaturePointsCollection *poCollection, double dfThreshold);
 
+	// Stages of ExtractFeaturePoints, which can be invoked separately,
+	// for example to measure their time. They should be invoked
+	// in this order for the same integral image.
+
+	/**
+	 * Compute Hessian determinants for all layers of octaves.
+	 *
+	 * @param poImg Integral image to be used
+	 */
+	void ComputeHessianMap(GDALIntegralImage *poImg);
+
+	/**
+	 * Find local extrema of Hessian map computed by ComputeHessianMap
+	 * and add them to collection. Descriptors of points aren't set.
+	 *
+	 * @param poCollection Collection for storage detected feature points
+	 * @param dfThreshold Threshold for feature point recognition,
+	 * same as in ExtractFeaturePoints
+	 * @param poStats Statistics receiving counters of octaves or NULL
+	 */
+	void DetectExtrema(GDALFeaturePointsCollection *poCollection,
+			double dfThreshold, GDALCorrelatorStats *poStats = NULL);
+
+	// Octaves can also be processed one by one, releasing layers of
+	// every octave after search of extrema, so only few layers are kept
+	// in memory. Points are the same as of DetectExtrema.
+
+	/**
+	 * Compute Hessian determinants for layers of one octave.
+	 * Octaves should be computed in ascending order.
+	 *
+	 * @param poImg Integral image to be used
+	 * @param nOctave Number of octave
+	 */
+	void ComputeHessianOctave(GDALIntegralImage *poImg, int nOctave);
+
+	/**
+	 * Find local extrema of one octave computed by ComputeHessianMap or
+	 * ComputeHessianOctave. Parameters are the same as in DetectExtrema.
+	 *
+	 * @param nOctave Number of octave
+	 */
+	void DetectOctaveExtrema(int nOctave,
+			GDALFeaturePointsCollection *poCollection, double dfThreshold,
+			GDALCorrelatorStats *poStats = NULL);
+
+	/**
+	 * Free layers of octave, which aren't needed by the next octave.
+	 *
+	 * @param nOctave Number of octave
+	 */
+	void ReleaseHessianOctave(int nOctave);
+
+	/**
+	 * Fetch size of computed Hessian layers.
+	 *
+	 * @return Size in bytes.
+	 */
+	GIntBig GetHessianMemoryUsage() const;
+
+	/**
+	 * Compute descriptors of points added by DetectExtrema.
+	 *
+	 * @param poImg Integral image where feature points were found
+	 * @param poCollection Collection of points
+	 * @param nFirst Index of the first point, which needs descriptor
+	 */
+	void ComputeDescriptors(GDALIntegralImage *poImg,
+			GDALFeaturePointsCollection *poCollection, int nFirst = 0);
+
 	/**
 	 * Find corresponding points (equal points in two collections).
 	 *
@@ -156,16 +342,316 @@ public:
 	 * @param dfThreshold Value from 0 to 1. Threshold affects to number of
 	 * matched points. If threshold is lower, amount of corresponding
 	 * points is larger, and vice versa
+	 * @param dfMaxScaleRatio Maximal ratio of scales of matched points.
+	 * For example, with value 2 point of scale 4 is compared only with points
+	 * of scales 2, 4 and 8. Zero or negative value disables the constraint
+	 * @param poStats Statistics receiving time and counters of matching or NULL
 	 *
 	 * @return CE_None or CE_Failure if error occurs.
+	 *
+	 * @note Points are compared only with points from compatible buckets
+	 * (with the same sign of Hessian and allowed scale).
 	 */
 	static CPLErr MatchFeaturePoints(
+				GDALMatchedPointsCollection *poMatched,
+				GDALFeaturePointsCollection *poFirstCollect,
+				GDALFeaturePointsCollection *poSecondCollect,
+				double dfThreshold, double dfMaxScaleRatio = 0,
+				GDALCorrelatorStats *poStats = NULL);
+
+	/**
+	 * Find corresponding points with absolute distance threshold.
+	 * Works like MatchFeaturePoints, but threshold is applied to
+	 * euclidean distance between descriptors as is, without normalization.
+	 * Since the bound is known during search, distance computation
+	 * is abandoned as soon as candidate can't be accepted, which
+	 * saves most of arithmetic when points are far from each other.
+	 *
+	 * @param poMatched Resulting collection for matched points
+	 * @param poFirstCollect Points on the first image
+	 * @param poSecondCollect Points on the second image
+	 * @param dfMaxDistance Maximal euclidean distance between descriptors
+	 * of matched points
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 *
+	 * @note Unlike MatchFeaturePoints, the 2nd nearest point
+	 * is the true 2nd nearest among unmatched points.
+	 */
+	static CPLErr MatchFeaturePointsAbsolute(
+				GDALMatchedPointsCollection *poMatched,
+				GDALFeaturePointsCollection *poFirstCollect,
+				GDALFeaturePointsCollection *poSecondCollect,
+				double dfMaxDistance);
+
+	/**
+	 * Find corresponding points using approximate nearest neighbour search.
+	 * Randomized kd-forest is built over descriptors of the larger collection
+	 * (separately for each sign of Hessian), and every point of the smaller
+	 * collection is searched with bounded number of checks. Sign filter,
+	 * ratio test and threshold are the same as in MatchFeaturePoints.
+	 *
+	 * @param poMatched Resulting collection for matched points
+	 * @param poFirstCollect Points on the first image
+	 * @param poSecondCollect Points on the second image
+	 * @param dfThreshold Value from 0 to 1. Threshold affects to number of
+	 * matched points. If threshold is lower, amount of corresponding
+	 * points is larger, and vice versa
+	 * @param nChecks Maximum number of descriptor comparisons per point.
+	 * Larger value gives result closer to exhaustive search but takes more time.
+	 * Typical values are from 32 to 512
+	 * @param nTrees Number of randomized trees in forest
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 *
+	 * @note Unlike MatchFeaturePoints, which is exhaustive, result may miss
+	 * some pairs. Use ComputeMatchingRecall to measure it on particular data.
+	 */
+	static CPLErr MatchFeaturePointsIndexed(
+				GDALMatchedPointsCollection *poMatched,
+				GDALFeaturePointsCollection *poFirstCollect,
+				GDALFeaturePointsCollection *poSecondCollect,
+				double dfThreshold, int nChecks, int nTrees = 4);
+
+	/**
+	 * Find corresponding points by exhaustive search, organized as
+	 * distance matrix product.
+	 * Descriptors are packed into contiguous matrices (separately for each
+	 * sign of Hessian) and all distances are computed by cache-blocked
+	 * kernel, which tracks the nearest and the 2nd nearest points.
+	 * Then pairs are selected greedily in order of the smaller collection,
+	 * every point of the larger collection is matched at most once.
+	 * Ratio test and threshold are the same as in MatchFeaturePoints.
+	 *
+	 * @param poMatched Resulting collection for matched points
+	 * @param poFirstCollect Points on the first image
+	 * @param poSecondCollect Points on the second image
+	 * @param dfThreshold Value from 0 to 1. Threshold affects to number of
+	 * matched points. If threshold is lower, amount of corresponding
+	 * points is larger, and vice versa
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 *
+	 * @note Result is exact: the 2nd nearest point is the true
+	 * 2nd nearest among unmatched points of the same sign.
+	 */
+	static CPLErr MatchFeaturePointsBlocked(
 				GDALMatchedPointsCollection *poMatched,
 				GDALFeaturePointsCollection *poFirstCollect,
 				GDALFeaturePointsCollection *poSecondCollect,
 				double dfThreshold);
 
+	/**
+	 * Same as MatchFeaturePointsBlocked, but descriptors of the second
+	 * collection are already packed by PackBySign, so they can be reused
+	 * by many calls. Points of the first collection are processed in
+	 * order, regardless of sizes of collections. Packed matrices aren't
+	 * modified, so calls can be performed from several threads.
+	 *
+	 * @param poMatched Resulting collection for matched points
+	 * @param poFirstCollect Points on the first image
+	 * @param poSecondCollect Points on the second image
+	 * @param paoSecondMatrices Matrices of the second collection,
+	 * array of two matrices
+	 * @param anSecondRows Rows of points of the second collection
+	 * @param dfThreshold Value from 0 to 1, same as in MatchFeaturePoints
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	static CPLErr MatchFeaturePointsPrepacked(
+				GDALMatchedPointsCollection *poMatched,
+				GDALFeaturePointsCollection *poFirstCollect,
+				GDALFeaturePointsCollection *poSecondCollect,
+				const GDALDescriptorMatrix *paoSecondMatrices,
+				const vector<int> &anSecondRows, double dfThreshold);
+
+	/**
+	 * Pack descriptors of collection into two matrices:
+	 * for positive (index 0) and negative (index 1) sign of Hessian.
+	 * Points with other signs are skipped.
+	 *
+	 * @param poCollection Source collection
+	 * @param paoMatrices Array of two matrices
+	 * @param panRows Row of every point in matrix of its sign or -1
+	 */
+	static void PackBySign(GDALFeaturePointsCollection *poCollection,
+			GDALDescriptorMatrix *paoMatrices, vector<int> *panRows);
+
+	/**
+	 * Find corresponding points as mutual nearest neighbours.
+	 * For every point of each collection the nearest and the 2nd nearest
+	 * points of the same sign are found in another collection
+	 * (by the same exhaustive search as MatchFeaturePointsBlocked).
+	 * Both directions are processed independently by several threads.
+	 * Pair is kept, if its points are the nearest to each other
+	 * and ratio test is passed in both directions.
+	 * Threshold is applied as in MatchFeaturePoints.
+	 *
+	 * @param poMatched Resulting collection for matched points
+	 * @param poFirstCollect Points on the first image
+	 * @param poSecondCollect Points on the second image
+	 * @param dfThreshold Value from 0 to 1. Threshold affects to number of
+	 * matched points. If threshold is lower, amount of corresponding
+	 * points is larger, and vice versa
+	 * @param nThreads Number of threads, zero means
+	 * GDAL_NUM_THREADS configuration option or number of CPUs
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 *
+	 * @note Unlike greedy MatchFeaturePoints, result doesn't depend on
+	 * order of points in collections nor on number of threads.
+	 */
+	static CPLErr MatchFeaturePointsMutual(
+				GDALMatchedPointsCollection *poMatched,
+				GDALFeaturePointsCollection *poFirstCollect,
+				GDALFeaturePointsCollection *poSecondCollect,
+				double dfThreshold, int nThreads = 0);
+
+	/**
+	 * Find corresponding points using approximate geometric relation
+	 * between images. Every point of the first image is mapped into the
+	 * second image by affine transformation, and only points of the
+	 * second image within search radius around the mapped position are
+	 * considered as candidates. Candidates are fetched from uniform grid
+	 * index, so cost of matching is nearly linear in number of points.
+	 * Sign filter, ratio test and threshold are the same as in
+	 * MatchFeaturePoints, ratio test is applied among candidates.
+	 * The only candidate within search radius passes ratio test.
+	 *
+	 * @param poMatched Resulting collection for matched points
+	 * @param poFirstCollect Points on the first image
+	 * @param poSecondCollect Points on the second image
+	 * @param dfThreshold Value from 0 to 1. Threshold affects to number of
+	 * matched points. If threshold is lower, amount of corresponding
+	 * points is larger, and vice versa
+	 * @param padfTransform Affine transformation from pixel/line of the
+	 * first image to pixel/line of the second image, in the same form
+	 * as geotransform: x' = t[0] + x * t[1] + y * t[2],
+	 * y' = t[3] + x * t[4] + y * t[5]. See ComputeAffinePrior
+	 * @param dfRadius Search radius in pixels of the second image.
+	 * It should cover error of transformation
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 *
+	 * @note Points are processed in order of the first collection, every
+	 * point of the second collection is matched at most once.
+	 */
+	static CPLErr MatchFeaturePointsGuided(
+				GDALMatchedPointsCollection *poMatched,
+				GDALFeaturePointsCollection *poFirstCollect,
+				GDALFeaturePointsCollection *poSecondCollect,
+				double dfThreshold, const double *padfTransform,
+				double dfRadius);
+
+	/**
+	 * Compose affine transformation from pixel/line of the first image
+	 * to pixel/line of the second image using their geotransforms.
+	 * Both geotransforms should be in the same coordinate system.
+	 *
+	 * @param padfFirstGeoTransform Geotransform of the first image
+	 * @param padfSecondGeoTransform Geotransform of the second image
+	 * @param padfTransform Resulting transformation, array of 6 values
+	 *
+	 * @return CE_None or CE_Failure if geotransform of
+	 * the second image isn't invertible.
+	 */
+	static CPLErr ComputeAffinePrior(const double *padfFirstGeoTransform,
+				const double *padfSecondGeoTransform, double *padfTransform);
+
+	/**
+	 * Find corresponding points in compressed index, which may contain
+	 * points of many images. For every point the nearest and the 2nd
+	 * nearest indexed points of the same sign are found approximately
+	 * (see GDALPQIndex::FindTwoNearest), then ratio test and threshold
+	 * are applied as in MatchFeaturePoints. Points are processed in order
+	 * of collection, every indexed point is matched at most once.
+	 *
+	 * @param poMatched Resulting collection for matched points. The first
+	 * point of pair is from collection, the second is from index
+	 * @param poCollect Points of query image
+	 * @param poIndex Trained index of reference points
+	 * @param dfThreshold Value from 0 to 1. Threshold affects to number of
+	 * matched points. If threshold is lower, amount of corresponding
+	 * points is larger, and vice versa
+	 * @param nProbe Number of visited lists of index
+	 * @param nRerank Number of candidates re-ranked by exact distance
+	 * @param panScenes Vector receiving scene of the second point of every
+	 * added pair (see GDALPQIndex::Add), or NULL
+	 * @param panScenePoints Vector receiving index of the second point of
+	 * every added pair in its collection or file, or NULL
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 *
+	 * @note Result may miss some pairs, use ComputeMatchingRecall
+	 * to tune nProbe and nRerank on particular data.
+	 */
+	static CPLErr MatchFeaturePointsPQ(
+				GDALMatchedPointsCollection *poMatched,
+				GDALFeaturePointsCollection *poCollect,
+				const GDALPQIndex *poIndex,
+				double dfThreshold, int nProbe = 8, int nRerank = 32,
+				vector<int> *panScenes = NULL,
+				vector<int> *panScenePoints = NULL);
+
+	/**
+	 * Compute share of reference pairs, which are also present in
+	 * another matching result. Normally reference is produced by
+	 * exhaustive MatchFeaturePoints and compared one - by approximate method.
+	 *
+	 * @param poReference Reference matching result
+	 * @param poMatched Matching result to be evaluated
+	 *
+	 * @return Value from 0 to 1 or -1 if error occurs.
+	 */
+	static double ComputeMatchingRecall(
+				GDALMatchedPointsCollection *poReference,
+				GDALMatchedPointsCollection *poMatched);
+
 private:
+	/**
+	 * Normalize distances of found pairs, prune them by threshold
+	 * and add them into resulting collection. If resulting collection
+	 * has external sources, pairs refer to points of p_1 and p_2,
+	 * otherwise copies of points are added.
+	 *
+	 * @param poMatched Resulting collection for matched points
+	 * @param poPairInfoList Found pairs
+	 * @param p_1 Collection, which indexes are stored as ind_1
+	 * @param p_2 Collection, which indexes are stored as ind_2
+	 * @param isSwap TRUE if p_1 is the second collection of user
+	 * @param dfThreshold Threshold for distance
+	 * @param bNormalize TRUE if distances are normalized before pruning
+	 *
+	 * @return CE_None or CE_Failure if matched collection has
+	 * external sources, which differ from p_1 and p_2.
+	 */
+	static CPLErr AddMatchedPairs(GDALMatchedPointsCollection *poMatched,
+			vector<MatchedPointPairInfo> *poPairInfoList,
+			GDALFeaturePointsCollection *p_1, GDALFeaturePointsCollection *p_2,
+			bool isSwap, double dfThreshold, bool bNormalize);
+
+	/**
+	 * Greedy assignment of matrices packed by sign, which is shared
+	 * by MatchFeaturePointsBlocked and MatchFeaturePointsPrepacked.
+	 */
+	static CPLErr MatchPackedBySign(GDALMatchedPointsCollection *poMatched,
+			GDALFeaturePointsCollection *p_1, GDALFeaturePointsCollection *p_2,
+			bool isSwap, double dfThreshold,
+			const GDALDescriptorMatrix *paoQueries, const vector<int> &anQueryRow,
+			const GDALDescriptorMatrix *paoBase, const vector<int> &anBaseRow);
+
+	/**
+	 * Split collection into buckets by sign and, optionally, by scale.
+	 * Buckets are ordered by sign and scale, points inside bucket
+	 * keep order of collection.
+	 *
+	 * @param poCollection Source collection
+	 * @param bByScale TRUE if points with different scales are split
+	 * @param paoBuckets Resulting buckets
+	 */
+	static void BuildBuckets(GDALFeaturePointsCollection *poCollection,
+			bool bByScale, vector<DescriptorBucket> *paoBuckets);
+
 	/**
 	 * Compute euclidean distance between descriptors of two feature points.
 	 * It's used in comparison and matching of points.
@@ -183,7 +669,7 @@ private:
 	 *
 	 * @param poList List of distances to be normalized
 	 */
-	static void NormalizeDistances(list<MatchedPointPairInfo> *poList);
+	static void NormalizeDistances(vector<MatchedPointPairInfo> *poList);
 
 	/**
 	 * Compute descriptor for specified feature point.
@@ -193,6 +679,18 @@ private:
 	 */
 	void SetDescriptor(GDALFeaturePoint *poPoint, GDALIntegralImage *poImg);
 
+	/**
+	 * Compute descriptor for specified feature point using precomputed
+	 * sampling table. Falls back to the range checked version
+	 * if descriptor area crosses image border.
+	 *
+	 * @param poPoint Feature point instance
+	 * @param poImg Integral image where feature point was found
+	 * @param poTable Sampling table built for point's scale and image width
+	 */
+	void SetDescriptor(GDALFeaturePoint *poPoint, GDALIntegralImage *poImg,
+			const HaarSamplingTable *poTable);
+
 
 private:
 	int octaveStart;
@@ -0,0 +1,112 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Uniform grid index over positions of feature points.
+ */
+
+#ifndef GDALSPATIALGRID_H_
+#define GDALSPATIALGRID_H_
+
+#include "gdal.h"
+#include "GDALFeaturePointsCollection.h"
+
+#include <vector>
+
+using namespace std;
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Uniform grid index over positions of feature points.
+ * @details Image plane is divided into square cells, and indexes of points
+ * are stored contiguously cell by cell. Query visits only cells, which
+ * intersect bounding box of search circle, so its cost depends on density
+ * of points and radius rather than on size of collection.
+ *
+ * Grid copies coordinates of points and doesn't keep pointer to collection.
+ * Query doesn't modify grid, so it can be performed from several threads.
+ */
+class GDALSpatialGrid
+{
+public:
+	/**
+	 * Create empty grid.
+	 */
+	GDALSpatialGrid();
+
+	/**
+	 * Build grid over points of collection.
+	 *
+	 * @param poCollection Collection of points
+	 * @param dfCellSize Size of cell in pixels, should be positive.
+	 * Radius of typical query is a reasonable choice.
+	 *
+	 * @return CE_None or CE_Failure if error occurs.
+	 */
+	CPLErr Build(GDALFeaturePointsCollection *poCollection, double dfCellSize);
+
+	/**
+	 * Find points within circle.
+	 *
+	 * @param dfX X-coordinate (pixel) of center
+	 * @param dfY Y-coordinate (line) of center
+	 * @param dfRadius Radius of circle in pixels
+	 * @param panIndices Indexes of points, which distance from center
+	 * doesn't exceed radius. Previous content is removed. Indexes are
+	 * sorted in ascending order. Nothing is found if center
+	 * or radius isn't finite.
+	 */
+	void Query(double dfX, double dfY, double dfRadius,
+			vector<int> *panIndices) const;
+
+	/**
+	 * Fetch number of indexed points.
+	 *
+	 * @return Number of points.
+	 */
+	int GetSize() const;
+
+private:
+	double dfCellSize;
+	// Position of the top left corner of grid
+	double dfMinX;
+	double dfMinY;
+	int nCols;
+	int nRows;
+
+	// Points of cell c are anPoints[anCellStart[c]..anCellStart[c + 1])
+	vector<int> anCellStart;
+	vector<int> anPoints;
+
+	// Coordinates of points in order of collection
+	vector<double> adfX;
+	vector<double> adfY;
+};
+
+#endif /* GDALSPATIALGRID_H_ */
@@ -0,0 +1,94 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Synthetic rasters for benchmarks and accuracy checks.
+ */
+
+#ifndef GDALSYNTHETICRASTER_H_
+#define GDALSYNTHETICRASTER_H_
+
+#include "gdal.h"
+#include "gdal_priv.h"
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Synthetic rasters for benchmarks and accuracy checks.
+ * @details Texture is smooth gradient with gaussian blobs, generated
+ * from fixed seed by generator, which gives the same numbers on every
+ * platform, so runs with the same parameters process the same data.
+ * RGB rasters are created in MEM driver from windows of texture.
+ */
+class GDALSyntheticRaster
+{
+public:
+	/**
+	 * Generate texture of smooth gradient and gaussian blobs.
+	 *
+	 * @param pafField Resulting field of nWidth x nHeight values from 0 to 255
+	 * @param nWidth Width of field
+	 * @param nHeight Height of field
+	 * @param dfDensity Number of blobs per megapixel
+	 * @param nSeed Seed of generator
+	 */
+	static void GenerateTexture(float *pafField, int nWidth, int nHeight,
+			double dfDensity, GUInt32 nSeed);
+
+	/**
+	 * Create RGB raster in MEM driver from window of texture. Bands differ
+	 * by contrast and offset. Values are rounded and stay from 0 to 255
+	 * (band b gets at most 255 * (0.9 - 0.05 * b) + 10 * b), so every data
+	 * type stores the same values and the same points are detected.
+	 *
+	 * @param pafField Texture
+	 * @param nFieldWidth Width of texture
+	 * @param nXOff Column of window in texture
+	 * @param nYOff Row of window in texture
+	 * @param nWidth Width of window and raster
+	 * @param nHeight Height of window and raster
+	 * @param eType Data type of bands
+	 *
+	 * @return Dataset or NULL if error occurs.
+	 */
+	static GDALDataset *Create(const float *pafField, int nFieldWidth,
+			int nXOff, int nYOff, int nWidth, int nHeight, GDALDataType eType);
+
+private:
+	/**
+	 * Deterministic generator of random numbers from 0 to 1
+	 * (linear congruential, the same on every platform).
+	 *
+	 * @param pnState State of generator
+	 *
+	 * @return Next number.
+	 */
+	static double NextRandom(GUInt32 *pnState);
+};
+
+#endif /* GDALSYNTHETICRASTER_H_ */
@@ -0,0 +1,99 @@
+/******************************************************************************
+ * Project:  GDAL
+ * Purpose:  Correlator
+ * Author:   Andrew Migal, migal.drew@gmail.com
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, Andrew Migal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Simple pool of worker threads for independent jobs.
+ */
+
+#ifndef GDALTHREADPOOL_H_
+#define GDALTHREADPOOL_H_
+
+#include "gdal.h"
+#include "cpl_multiproc.h"
+
+/**
+ * @author Andrew Migal migal.drew@gmail.com
+ * @brief Simple pool of worker threads for independent jobs.
+ * @details Jobs are identified by numbers from zero to number of jobs.
+ * Worker threads take next job number from shared counter until
+ * all jobs are done. Job function shouldn't depend on the order
+ * in which jobs are executed or on the thread which executes it,
+ * then result doesn't depend on number of threads.
+ */
+class GDALThreadPool
+{
+public:
+	/**
+	 * Function which performs one job.
+	 *
+	 * @param pData User data provided to RunJobs
+	 * @param iJob Number of job
+	 */
+	typedef void (*JobFunc)(void *pData, int iJob);
+
+	/**
+	 * Execute jobs and wait for their completion.
+	 *
+	 * @param nJobs Number of jobs
+	 * @param pfnJob Function which performs one job
+	 * @param pData User data passed to every job
+	 * @param nThreads Number of threads. If zero or negative,
+	 * GetDefaultThreadCount() is used. Calling thread is one of workers
+	 */
+	static void RunJobs(int nJobs, JobFunc pfnJob, void *pData, int nThreads);
+
+	/**
+	 * Fetch default number of threads. Value is taken from GDAL_NUM_THREADS
+	 * configuration option (number or ALL_CPUS), otherwise number of CPUs is used.
+	 *
+	 * @return Number of threads, at least one.
+	 */
+	static int GetDefaultThreadCount();
+
+private:
+	/**
+	 * State shared by worker threads
+	 */
+	class Queue
+	{
+	public:
+		JobFunc pfnJob;
+		void *pData;
+		int nJobs;
+		int nNextJob;
+		void *hMutex;
+	};
+
+	/**
+	 * Body of worker thread.
+	 */
+	static void WorkerFunc(void *pQueue);
+};
+
+#endif /* GDALTHREADPOOL_H_ */
@@ -0,0 +1,80 @@
+#include "GDALCPUDispatch.h"
+
+#include "cpl_conv.h"
+
+volatile int GDALCPUDispatch::nLevel = -1;
+
+static const char *apszLevelNames[5] =
+		{"REFERENCE", "SCALAR", "SSE2", "AVX2", "AVX512"};
+
+const char *GDALCPUDispatch::GetLevelName(Level eLevel)
+{
+	return apszLevelNames[eLevel];
+}
+
+CPLErr GDALCPUDispatch::ParseLevel(const char *pszName, Level *peLevel)
+{
+	for (int i = 0; i < 5 && pszName != NULL; i++)
+		if (EQUAL(pszName, apszLevelNames[i]))
+		{
+			*peLevel = (Level)i;
+			return CE_None;
+		}
+
+	CPLError(CE_Failure, CPLE_IllegalArg, "Unknown SIMD level: %s",
+			pszName != NULL ? pszName : "(null)");
+	return CE_Failure;
+}
+
+GDALCPUDispatch::Level GDALCPUDispatch::DetectLevel()
+{
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+	// Checks include support of extended registers by OS
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+		return LEVEL_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return LEVEL_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return LEVEL_SSE2;
+	return LEVEL_SCALAR;
+#elif defined(__SSE2__)
+	return LEVEL_SSE2;
+#else
+	return LEVEL_SCALAR;
+#endif
+}
+
+GDALCPUDispatch::Level GDALCPUDispatch::SetLevel(Level eLevel)
+{
+	Level eSupported = DetectLevel();
+	if (eLevel > eSupported)
+	{
+		CPLDebug("GDALCPUDispatch", "%s isn't supported, %s is used",
+				GetLevelName(eLevel), GetLevelName(eSupported));
+		eLevel = eSupported;
+	}
+
+	nLevel = eLevel;
+	return eLevel;
+}
+
+GDALCPUDispatch::Level GDALCPUDispatch::GetLevel()
+{
+	// Selection is idempotent, so concurrent first calls are harmless
+	int nSelected = nLevel;
+	if (nSelected >= 0)
+		return (Level)nSelected;
+
+	Level eLevel = DetectLevel();
+
+	const char *pszLevel = CPLGetConfigOption("GDAL_CORRELATOR_SIMD", NULL);
+	if (pszLevel != NULL && ParseLevel(pszLevel, &eLevel) != CE_None)
+		eLevel = DetectLevel();
+
+	eLevel = SetLevel(eLevel);
+	CPLDebug("GDALCPUDispatch", "Using %s kernels", GetLevelName(eLevel));
+
+	return eLevel;
+}
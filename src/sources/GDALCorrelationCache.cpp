@@ -0,0 +1,255 @@
+#include "GDALCorrelationCache.h"
+
+#include "cpl_multiproc.h"
+
+GDALCorrelationCache::GDALCorrelationCache(GIntBig nMaxMemory,
+		int nMaxDatasets, int nHandlesPerDataset)
+{
+	this->nMaxMemory = nMaxMemory;
+	this->nMaxDatasets = nMaxDatasets;
+	this->nHandlesPerDataset = nHandlesPerDataset;
+
+	nMemory = 0;
+	nDatasets = 0;
+	nHits = 0;
+	nMisses = 0;
+
+	hMutex = CPLCreateMutex();
+	CPLReleaseMutex(hMutex);
+}
+
+GDALCorrelationCache::~GDALCorrelationCache()
+{
+	for (list<Entry *>::iterator it = oLRU.begin(); it != oLRU.end(); ++it)
+	{
+		if ((*it)->nRefs > 0)
+			CPLDebug("GDALCorrelationCache", "Entry %s is still acquired",
+					(*it)->osKey.c_str());
+		Destroy(*it);
+	}
+
+	CPLDestroyMutex(hMutex);
+}
+
+void GDALCorrelationCache::Destroy(Entry *poEntry)
+{
+	if (poEntry->eKind == KIND_DATASET)
+	{
+		delete (GDALDatasetPool *)poEntry->pObject;
+		GDALClose((GDALDatasetH)poEntry->poDataset);
+	}
+	else
+		delete (GDALReferenceCorrelator *)poEntry->pObject;
+
+	delete poEntry;
+}
+
+GDALCorrelationCache::Entry *GDALCorrelationCache::Lookup(Kind eKind,
+		const string &osKey)
+{
+	map<pair<int, string>, list<Entry *>::iterator>::iterator it =
+			oIndex.find(make_pair((int)eKind, osKey));
+
+	if (it == oIndex.end())
+		return NULL;
+
+	Entry *poEntry = *it->second;
+	poEntry->nRefs++;
+
+	// Move to the front, iterators of list stay valid
+	oLRU.splice(oLRU.begin(), oLRU, it->second);
+
+	return poEntry;
+}
+
+void GDALCorrelationCache::Insert(Entry *poEntry)
+{
+	oLRU.push_front(poEntry);
+	oIndex[make_pair((int)poEntry->eKind, poEntry->osKey)] = oLRU.begin();
+	oObjects[poEntry->pObject] = oLRU.begin();
+
+	if (poEntry->eKind == KIND_DATASET)
+		nDatasets++;
+	else
+		nMemory += poEntry->nSize;
+
+	Evict();
+}
+
+void GDALCorrelationCache::Evict()
+{
+	list<Entry *>::iterator it = oLRU.end();
+
+	while (it != oLRU.begin() && (nMemory > nMaxMemory || nDatasets > nMaxDatasets))
+	{
+		--it;
+		Entry *poEntry = *it;
+
+		bool bOverLimit = (poEntry->eKind == KIND_DATASET) ?
+				nDatasets > nMaxDatasets : nMemory > nMaxMemory;
+		if (poEntry->nRefs > 0 || !bOverLimit)
+			continue;
+
+		if (poEntry->eKind == KIND_DATASET)
+			nDatasets--;
+		else
+			nMemory -= poEntry->nSize;
+
+		oIndex.erase(make_pair((int)poEntry->eKind, poEntry->osKey));
+		oObjects.erase(poEntry->pObject);
+		it = oLRU.erase(it);
+
+		CPLDebug("GDALCorrelationCache", "Evicted %s", poEntry->osKey.c_str());
+		Destroy(poEntry);
+	}
+}
+
+void GDALCorrelationCache::Release(const void *pObject)
+{
+	if (pObject == NULL)
+		return;
+
+	CPLAcquireMutex(hMutex, 1000.0);
+
+	map<const void *, list<Entry *>::iterator>::iterator it =
+			oObjects.find(pObject);
+	if (it != oObjects.end())
+	{
+		(*it->second)->nRefs--;
+		Evict();
+	}
+	else
+		CPLError(CE_Failure, CPLE_AppDefined, "Object isn't in cache");
+
+	CPLReleaseMutex(hMutex);
+}
+
+GDALDatasetPool *GDALCorrelationCache::AcquireDataset(const char *pszFilename)
+{
+	if (pszFilename == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "File name isn't specified");
+		return NULL;
+	}
+
+	string osKey(pszFilename);
+
+	CPLAcquireMutex(hMutex, 1000.0);
+	Entry *poEntry = Lookup(KIND_DATASET, osKey);
+	if (poEntry != NULL)
+		nHits++;
+	else
+		nMisses++;
+	CPLReleaseMutex(hMutex);
+
+	if (poEntry != NULL)
+		return (GDALDatasetPool *)poEntry->pObject;
+
+	// Opening may be slow, so cache isn't locked
+	GDALDataset *poDataset = (GDALDataset *)GDALOpen(pszFilename, GA_ReadOnly);
+	if (poDataset == NULL)
+		return NULL;
+
+	CPLAcquireMutex(hMutex, 1000.0);
+
+	// Dataset could be opened by another thread meanwhile
+	poEntry = Lookup(KIND_DATASET, osKey);
+	if (poEntry == NULL)
+	{
+		poEntry = new Entry();
+		poEntry->eKind = KIND_DATASET;
+		poEntry->osKey = osKey;
+		poEntry->poDataset = poDataset;
+		poEntry->pObject = new GDALDatasetPool(poDataset, nHandlesPerDataset);
+		poEntry->nSize = 0;
+		poEntry->nRefs = 1;
+		Insert(poEntry);
+		poDataset = NULL;
+	}
+
+	CPLReleaseMutex(hMutex);
+
+	if (poDataset != NULL)
+		GDALClose((GDALDatasetH)poDataset);
+
+	return (GDALDatasetPool *)poEntry->pObject;
+}
+
+void GDALCorrelationCache::ReleaseDataset(GDALDatasetPool *poPool)
+{
+	Release(poPool);
+}
+
+const GDALReferenceCorrelator *GDALCorrelationCache::AcquireReference(
+		const char *pszKey)
+{
+	if (pszKey == NULL)
+		return NULL;
+
+	CPLAcquireMutex(hMutex, 1000.0);
+	Entry *poEntry = Lookup(KIND_REFERENCE, string(pszKey));
+	if (poEntry != NULL)
+		nHits++;
+	else
+		nMisses++;
+	CPLReleaseMutex(hMutex);
+
+	return (poEntry != NULL) ? (const GDALReferenceCorrelator *)poEntry->pObject
+			: NULL;
+}
+
+const GDALReferenceCorrelator *GDALCorrelationCache::InsertReference(
+		const char *pszKey, GDALReferenceCorrelator *poCorrelator)
+{
+	if (pszKey == NULL || poCorrelator == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Key or correlator isn't specified");
+		delete poCorrelator;
+		return NULL;
+	}
+
+	CPLAcquireMutex(hMutex, 1000.0);
+
+	Entry *poEntry = Lookup(KIND_REFERENCE, string(pszKey));
+	if (poEntry == NULL)
+	{
+		poEntry = new Entry();
+		poEntry->eKind = KIND_REFERENCE;
+		poEntry->osKey = pszKey;
+		poEntry->poDataset = NULL;
+		poEntry->pObject = poCorrelator;
+		poEntry->nSize = poCorrelator->GetMemoryUsage();
+		poEntry->nRefs = 1;
+		Insert(poEntry);
+		poCorrelator = NULL;
+	}
+
+	CPLReleaseMutex(hMutex);
+
+	delete poCorrelator;
+
+	return (const GDALReferenceCorrelator *)poEntry->pObject;
+}
+
+void GDALCorrelationCache::ReleaseReference(
+		const GDALReferenceCorrelator *poCorrelator)
+{
+	Release(poCorrelator);
+}
+
+GIntBig GDALCorrelationCache::GetMemoryUsage()
+{
+	CPLAcquireMutex(hMutex, 1000.0);
+	GIntBig nResult = nMemory;
+	CPLReleaseMutex(hMutex);
+
+	return nResult;
+}
+
+void GDALCorrelationCache::GetStatistics(GIntBig *pnHits, GIntBig *pnMisses)
+{
+	CPLAcquireMutex(hMutex, 1000.0);
+	*pnHits = nHits;
+	*pnMisses = nMisses;
+	CPLReleaseMutex(hMutex);
+}
@@ -0,0 +1,247 @@
+#include "GDALCorrelatorStats.h"
+
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+GDALCorrelatorStats::Timer::Timer(GDALCorrelatorStats *poStats, Stage eStage)
+{
+	this->poStats = poStats;
+	this->eStage = eStage;
+
+	if (poStats != NULL)
+	{
+		dfWallStart = GetWallClock();
+		dfCPUStart = GetCPUClock();
+	}
+	else
+	{
+		dfWallStart = 0;
+		dfCPUStart = 0;
+	}
+}
+
+void GDALCorrelatorStats::Timer::Stop()
+{
+	if (poStats == NULL)
+		return;
+
+	poStats->AddTime(eStage, GetWallClock() - dfWallStart,
+			GetCPUClock() - dfCPUStart);
+	poStats = NULL;
+}
+
+GDALCorrelatorStats::Timer::~Timer()
+{
+	Stop();
+}
+
+GDALCorrelatorStats::GDALCorrelatorStats()
+{
+	Reset();
+}
+
+void GDALCorrelatorStats::Reset()
+{
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		adfWallTime[i] = 0;
+		adfCPUTime[i] = 0;
+	}
+
+	nBytesRead = 0;
+	nPixels = 0;
+	nDistanceEvaluations = 0;
+	nRatioRejections = 0;
+	nMatches = 0;
+	nPeakMemory = 0;
+
+	anLayerPixels.clear();
+	anCandidates.clear();
+	anExtrema.clear();
+}
+
+void GDALCorrelatorStats::Merge(const GDALCorrelatorStats &oOther)
+{
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		adfWallTime[i] += oOther.adfWallTime[i];
+		adfCPUTime[i] += oOther.adfCPUTime[i];
+	}
+
+	nBytesRead += oOther.nBytesRead;
+	nPixels += oOther.nPixels;
+	nDistanceEvaluations += oOther.nDistanceEvaluations;
+	nRatioRejections += oOther.nRatioRejections;
+	nMatches += oOther.nMatches;
+	UpdatePeakMemory(oOther.nPeakMemory);
+
+	for (int oct = 1; oct <= oOther.GetOctaveCount(); oct++)
+		AddOctave(oct, oOther.anLayerPixels[oct], oOther.anCandidates[oct],
+				oOther.anExtrema[oct]);
+}
+
+void GDALCorrelatorStats::AddTime(Stage eStage, double dfWallTime,
+		double dfCPUTime)
+{
+	if (eStage < 0 || eStage >= STAGE_COUNT)
+		return;
+
+	adfWallTime[eStage] += dfWallTime;
+	adfCPUTime[eStage] += dfCPUTime;
+}
+
+double GDALCorrelatorStats::GetWallTime(Stage eStage) const
+{
+	return (eStage >= 0 && eStage < STAGE_COUNT) ? adfWallTime[eStage] : 0;
+}
+
+double GDALCorrelatorStats::GetCPUTime(Stage eStage) const
+{
+	return (eStage >= 0 && eStage < STAGE_COUNT) ? adfCPUTime[eStage] : 0;
+}
+
+void GDALCorrelatorStats::ResizeOctaves(int nOctaves)
+{
+	if ((int)anLayerPixels.size() > nOctaves)
+		return;
+
+	anLayerPixels.resize(nOctaves + 1, 0);
+	anCandidates.resize(nOctaves + 1, 0);
+	anExtrema.resize(nOctaves + 1, 0);
+}
+
+void GDALCorrelatorStats::AddOctave(int nOctave, GIntBig nLayerPixels,
+		GIntBig nCandidates, GIntBig nExtrema)
+{
+	if (nOctave < 1)
+		return;
+
+	ResizeOctaves(nOctave);
+	anLayerPixels[nOctave] += nLayerPixels;
+	anCandidates[nOctave] += nCandidates;
+	anExtrema[nOctave] += nExtrema;
+}
+
+int GDALCorrelatorStats::GetOctaveCount() const
+{
+	return anLayerPixels.empty() ? 0 : (int)anLayerPixels.size() - 1;
+}
+
+GIntBig GDALCorrelatorStats::GetLayerPixels(int nOctave) const
+{
+	return (nOctave >= 1 && nOctave <= GetOctaveCount()) ?
+			anLayerPixels[nOctave] : 0;
+}
+
+GIntBig GDALCorrelatorStats::GetCandidates(int nOctave) const
+{
+	return (nOctave >= 1 && nOctave <= GetOctaveCount()) ?
+			anCandidates[nOctave] : 0;
+}
+
+GIntBig GDALCorrelatorStats::GetExtrema(int nOctave) const
+{
+	return (nOctave >= 1 && nOctave <= GetOctaveCount()) ?
+			anExtrema[nOctave] : 0;
+}
+
+void GDALCorrelatorStats::UpdatePeakMemory(GIntBig nSize)
+{
+	if (nSize > nPeakMemory)
+		nPeakMemory = nSize;
+}
+
+void GDALCorrelatorStats::Log(const char *pszTitle) const
+{
+	CPLDebug("GDALCorrelator", "Statistics of %s", pszTitle);
+
+	for (int i = 0; i < STAGE_COUNT; i++)
+		if (adfWallTime[i] > 0 || adfCPUTime[i] > 0)
+			CPLDebug("GDALCorrelator", "  %s: wall %.6f s, CPU %.6f s",
+					GetStageName((Stage)i), adfWallTime[i], adfCPUTime[i]);
+
+	if (nPixels > 0)
+		CPLDebug("GDALCorrelator", "  read " CPL_FRMT_GIB " bytes, "
+				CPL_FRMT_GIB " pixels", nBytesRead, nPixels);
+
+	for (int oct = 1; oct <= GetOctaveCount(); oct++)
+		if (anLayerPixels[oct] > 0)
+			CPLDebug("GDALCorrelator", "  octave %d: " CPL_FRMT_GIB
+					" pixels per layer, " CPL_FRMT_GIB " above threshold, "
+					CPL_FRMT_GIB " extrema", oct, anLayerPixels[oct],
+					anCandidates[oct], anExtrema[oct]);
+
+	if (nDistanceEvaluations > 0)
+		CPLDebug("GDALCorrelator", "  " CPL_FRMT_GIB " distances, "
+				CPL_FRMT_GIB " ratio test rejections, " CPL_FRMT_GIB " matches",
+				nDistanceEvaluations, nRatioRejections, nMatches);
+
+	if (nPeakMemory > 0)
+		CPLDebug("GDALCorrelator", "  peak memory " CPL_FRMT_GIB " bytes",
+				nPeakMemory);
+}
+
+bool GDALCorrelatorStats::IsLoggingEnabled()
+{
+	return CSLTestBoolean(CPLGetConfigOption("GDAL_CORRELATOR_STATS", "NO"));
+}
+
+const char *GDALCorrelatorStats::GetStageName(Stage eStage)
+{
+	switch (eStage)
+	{
+		case STAGE_READING: return "reading";
+		case STAGE_INTEGRAL: return "integral";
+		case STAGE_HESSIAN: return "hessian";
+		case STAGE_EXTREMA: return "extrema";
+		case STAGE_DESCRIPTORS: return "descriptors";
+		case STAGE_MATCHING: return "matching";
+		default: return "unknown";
+	}
+}
+
+double GDALCorrelatorStats::GetWallClock()
+{
+#ifdef _WIN32
+	LARGE_INTEGER nFrequency, nCounter;
+	QueryPerformanceFrequency(&nFrequency);
+	QueryPerformanceCounter(&nCounter);
+	return (double)nCounter.QuadPart / nFrequency.QuadPart;
+#else
+	struct timeval sTime;
+	gettimeofday(&sTime, NULL);
+	return sTime.tv_sec + sTime.tv_usec * 1e-6;
+#endif
+}
+
+double GDALCorrelatorStats::GetCPUClock()
+{
+#if defined(_WIN32)
+	FILETIME sCreation, sExit, sKernel, sUser;
+	if (GetThreadTimes(GetCurrentThread(), &sCreation, &sExit,
+			&sKernel, &sUser))
+	{
+		ULARGE_INTEGER nKernel, nUser;
+		nKernel.LowPart = sKernel.dwLowDateTime;
+		nKernel.HighPart = sKernel.dwHighDateTime;
+		nUser.LowPart = sUser.dwLowDateTime;
+		nUser.HighPart = sUser.dwHighDateTime;
+		// Units of 100 ns
+		return (double)(nKernel.QuadPart + nUser.QuadPart) * 1e-7;
+	}
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec sTime;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &sTime) == 0)
+		return sTime.tv_sec + sTime.tv_nsec * 1e-9;
+#endif
+
+	return (double)clock() / CLOCKS_PER_SEC;
+}
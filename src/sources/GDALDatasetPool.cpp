@@ -0,0 +1,150 @@
+#include "GDALDatasetPool.h"
+#include "GDALThreadPool.h"
+
+#include "cpl_multiproc.h"
+#include "cpl_string.h"
+
+GDALDatasetPool::GDALDatasetPool(GDALDataset *poDataset, int nMaxHandles)
+{
+	this->poDataset = poDataset;
+
+	if (nMaxHandles <= 0)
+		nMaxHandles = GDALThreadPool::GetDefaultThreadCount();
+
+	// Every handle should keep its strip in shared block cache
+	GIntBig nStripCache = GetStripCacheSize(poDataset);
+	if (nStripCache > 0)
+	{
+		GIntBig nFit = GDALGetCacheMax64() / nStripCache;
+		if (nFit < nMaxHandles)
+		{
+			CPLDebug("GDALDatasetPool",
+					"Block cache fits %d handles of %d requested",
+					(int)MAX(nFit, 1), nMaxHandles);
+			nMaxHandles = (int)MAX(nFit, 1);
+		}
+	}
+
+	this->nMaxHandles = nMaxHandles;
+
+	// The original dataset is the first handle
+	apoFree.push_back(poDataset);
+	nHandles = 1;
+	bOpenFailed = false;
+
+	hMutex = CPLCreateMutex();
+	CPLReleaseMutex(hMutex);
+	hCond = CPLCreateCond();
+}
+
+GDALDatasetPool::~GDALDatasetPool()
+{
+	for (size_t i = 0; i < apoOpened.size(); i++)
+		GDALClose((GDALDatasetH)apoOpened[i]);
+
+	CPLDestroyCond(hCond);
+	CPLDestroyMutex(hMutex);
+}
+
+GDALDataset *GDALDatasetPool::GetDataset() const
+{
+	return poDataset;
+}
+
+int GDALDatasetPool::GetMaxHandles() const
+{
+	return nMaxHandles;
+}
+
+GIntBig GDALDatasetPool::GetStripCacheSize(GDALDataset *poDataset)
+{
+	GIntBig nSize = 0;
+
+	for (int i = 1; i <= poDataset->GetRasterCount(); i++)
+	{
+		GDALRasterBand *poBand = poDataset->GetRasterBand(i);
+
+		int nBlockXSize, nBlockYSize;
+		poBand->GetBlockSize(&nBlockXSize, &nBlockYSize);
+		int nBlocksPerRow = (poBand->GetXSize() + nBlockXSize - 1) / nBlockXSize;
+
+		nSize += (GIntBig)nBlocksPerRow * nBlockXSize * nBlockYSize *
+				(GDALGetDataTypeSize(poBand->GetRasterDataType()) / 8);
+	}
+
+	return nSize;
+}
+
+GDALDataset *GDALDatasetPool::OpenHandle()
+{
+	// Reopen by the same driver with the same options
+	char **papszAllowedDrivers = NULL;
+	GDALDriver *poDriver = poDataset->GetDriver();
+	if (poDriver != NULL)
+		papszAllowedDrivers = CSLAddString(papszAllowedDrivers,
+				poDriver->GetDescription());
+
+	// Datasets without file (MEM, etc.) can't be opened again,
+	// it isn't an error, the original handle is shared then
+	CPLPushErrorHandler(CPLQuietErrorHandler);
+	GDALDataset *poHandle = (GDALDataset *)GDALOpenEx(
+			poDataset->GetDescription(), GDAL_OF_RASTER | GDAL_OF_READONLY,
+			papszAllowedDrivers, poDataset->GetOpenOptions(), NULL);
+	CPLPopErrorHandler();
+
+	if (poHandle == NULL)
+		CPLErrorReset();
+
+	CSLDestroy(papszAllowedDrivers);
+	return poHandle;
+}
+
+GDALDataset *GDALDatasetPool::Acquire()
+{
+	CPLAcquireMutex(hMutex, 1000.0);
+
+	while (apoFree.empty())
+	{
+		if (nHandles < nMaxHandles && !bOpenFailed)
+		{
+			// Opening may be slow, so other threads aren't blocked
+			nHandles++;
+			CPLReleaseMutex(hMutex);
+
+			GDALDataset *poHandle = OpenHandle();
+
+			CPLAcquireMutex(hMutex, 1000.0);
+			if (poHandle != NULL)
+			{
+				apoOpened.push_back(poHandle);
+				CPLReleaseMutex(hMutex);
+				return poHandle;
+			}
+
+			CPLDebug("GDALDatasetPool", "Can't open %s again, %d handles are used",
+					poDataset->GetDescription(), nHandles - 1);
+			nHandles--;
+			bOpenFailed = true;
+			continue;
+		}
+
+		CPLCondWait(hCond, hMutex);
+	}
+
+	GDALDataset *poHandle = apoFree.back();
+	apoFree.pop_back();
+
+	CPLReleaseMutex(hMutex);
+	return poHandle;
+}
+
+void GDALDatasetPool::Release(GDALDataset *poHandle)
+{
+	if (poHandle == NULL)
+		return;
+
+	CPLAcquireMutex(hMutex, 1000.0);
+	apoFree.push_back(poHandle);
+	CPLCondSignal(hCond);
+	CPLReleaseMutex(hMutex);
+}
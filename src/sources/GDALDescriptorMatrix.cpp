@@ -0,0 +1,523 @@
+#include "GDALDescriptorMatrix.h"
+#include "GDALCPUDispatch.h"
+
+#include <math.h>
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+GDALDescriptorMatrix::GDALDescriptorMatrix()
+{
+	nRows = 0;
+}
+
+void GDALDescriptorMatrix::Initialize(GDALFeaturePointsCollection *poCollection,
+		const int *panIndices, int nIndices)
+{
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+
+	nRows = nIndices;
+	adfData.resize((size_t)nIndices * nDim);
+	adfNorms.resize(nIndices);
+	anIndices.assign(panIndices, panIndices + nIndices);
+
+	for (int i = 0; i < nIndices; i++)
+	{
+		GDALFeaturePoint *poPoint = poCollection->GetPoint(panIndices[i]);
+		double *padfRow = &adfData[(size_t)i * nDim];
+		double norm = 0;
+
+		for (int k = 0; k < nDim; k++)
+		{
+			padfRow[k] = (*poPoint)[k];
+			norm += padfRow[k] * padfRow[k];
+		}
+
+		adfNorms[i] = norm;
+	}
+}
+
+int GDALDescriptorMatrix::GetRows() const { return nRows; }
+
+const double *GDALDescriptorMatrix::GetRow(int nRow) const
+{
+	return &adfData[(size_t)nRow * GDALFeaturePoint::DESC_SIZE];
+}
+
+int GDALDescriptorMatrix::GetIndex(int nRow) const { return anIndices[nRow]; }
+
+double GDALDescriptorMatrix::GetSquaredNorm(int nRow) const { return adfNorms[nRow]; }
+
+/* -------------------------------------------------------------------- */
+/*      Distance kernels. Squares of differences are accumulated        */
+/*      in DISTANCE_LANES partial sums (component k goes to sum         */
+/*      k % DISTANCE_LANES), which are added pairwise in fixed order,   */
+/*      so every kernel gives the same result. Partial sums are added   */
+/*      after every ABANDON_STEP components only if bound is finite.    */
+/* -------------------------------------------------------------------- */
+
+// Kernels process ABANDON_STEP components per step, one per partial sum
+static const int DISTANCE_LANES = GDALDescriptorMatrix::ABANDON_STEP;
+
+/**
+ * Original distance: components are summed in order and computation
+ * is never abandoned, so the full distance is returned (reference level).
+ */
+static double DistanceKernelReference(const double *padfFirst,
+		const double *padfSecond, double /* dfBound */)
+{
+	double sum = 0;
+
+	for (int i = 0; i < GDALFeaturePoint::DESC_SIZE; i++)
+		sum += (padfFirst[i] - padfSecond[i]) * (padfFirst[i] - padfSecond[i]);
+
+	return sum;
+}
+
+static double DistanceKernelScalar(const double *padfFirst,
+		const double *padfSecond, double dfBound)
+{
+	const int nStep = GDALDescriptorMatrix::ABANDON_STEP;
+	double acc[DISTANCE_LANES];
+	for (int j = 0; j < DISTANCE_LANES; j++)
+		acc[j] = 0;
+
+	double sum = 0;
+	for (int i = 0; i < GDALFeaturePoint::DESC_SIZE; i += nStep)
+	{
+		for (int j = 0; j < DISTANCE_LANES; j++)
+		{
+			double diff = padfFirst[i + j] - padfSecond[i + j];
+			acc[j] += diff * diff;
+		}
+
+		if (dfBound < HUGE_VAL || i + nStep == GDALFeaturePoint::DESC_SIZE)
+		{
+			sum = ((acc[0] + acc[4]) + (acc[2] + acc[6])) +
+					((acc[1] + acc[5]) + (acc[3] + acc[7]));
+			if (sum > dfBound)
+				return sum;
+		}
+	}
+
+	return sum;
+}
+
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#if !defined(__SSE2__)
+GDAL_CORRELATOR_TARGET("sse2")
+#endif
+static double DistanceKernelSSE2(const double *padfFirst,
+		const double *padfSecond, double dfBound)
+{
+	const int nStep = GDALDescriptorMatrix::ABANDON_STEP;
+
+	// Partial sums 0-1, 2-3, 4-5 and 6-7
+	__m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+	__m128d acc2 = _mm_setzero_pd(), acc3 = _mm_setzero_pd();
+
+	double sum = 0;
+	for (int i = 0; i < GDALFeaturePoint::DESC_SIZE; i += nStep)
+	{
+		__m128d d0 = _mm_sub_pd(_mm_loadu_pd(padfFirst + i),
+				_mm_loadu_pd(padfSecond + i));
+		__m128d d1 = _mm_sub_pd(_mm_loadu_pd(padfFirst + i + 2),
+				_mm_loadu_pd(padfSecond + i + 2));
+		__m128d d2 = _mm_sub_pd(_mm_loadu_pd(padfFirst + i + 4),
+				_mm_loadu_pd(padfSecond + i + 4));
+		__m128d d3 = _mm_sub_pd(_mm_loadu_pd(padfFirst + i + 6),
+				_mm_loadu_pd(padfSecond + i + 6));
+
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(d0, d0));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(d1, d1));
+		acc2 = _mm_add_pd(acc2, _mm_mul_pd(d2, d2));
+		acc3 = _mm_add_pd(acc3, _mm_mul_pd(d3, d3));
+
+		if (dfBound < HUGE_VAL || i + nStep == GDALFeaturePoint::DESC_SIZE)
+		{
+			__m128d t = _mm_add_pd(_mm_add_pd(acc0, acc2), _mm_add_pd(acc1, acc3));
+			sum = _mm_cvtsd_f64(_mm_add_sd(t, _mm_unpackhi_pd(t, t)));
+			if (sum > dfBound)
+				return sum;
+		}
+	}
+
+	return sum;
+}
+#endif
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+GDAL_CORRELATOR_TARGET("avx2")
+static double DistanceKernelAVX2(const double *padfFirst,
+		const double *padfSecond, double dfBound)
+{
+	const int nStep = GDALDescriptorMatrix::ABANDON_STEP;
+
+	// Partial sums 0-3 and 4-7
+	__m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+
+	double sum = 0;
+	for (int i = 0; i < GDALFeaturePoint::DESC_SIZE; i += nStep)
+	{
+		__m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(padfFirst + i),
+				_mm256_loadu_pd(padfSecond + i));
+		__m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(padfFirst + i + 4),
+				_mm256_loadu_pd(padfSecond + i + 4));
+
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(d0, d0));
+		acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(d1, d1));
+
+		if (dfBound < HUGE_VAL || i + nStep == GDALFeaturePoint::DESC_SIZE)
+		{
+			__m256d s = _mm256_add_pd(acc0, acc1);
+			__m128d t = _mm_add_pd(_mm256_castpd256_pd128(s),
+					_mm256_extractf128_pd(s, 1));
+			sum = _mm_cvtsd_f64(_mm_add_sd(t, _mm_unpackhi_pd(t, t)));
+			if (sum > dfBound)
+				return sum;
+		}
+	}
+
+	return sum;
+}
+
+GDAL_CORRELATOR_TARGET("avx512f") GDAL_CORRELATOR_NO_CONTRACT
+static double DistanceKernelAVX512(const double *padfFirst,
+		const double *padfSecond, double dfBound)
+{
+	const int nStep = GDALDescriptorMatrix::ABANDON_STEP;
+
+	// All partial sums in one register
+	__m512d acc = _mm512_setzero_pd();
+
+	double sum = 0;
+	for (int i = 0; i < GDALFeaturePoint::DESC_SIZE; i += nStep)
+	{
+		__m512d d = _mm512_sub_pd(_mm512_loadu_pd(padfFirst + i),
+				_mm512_loadu_pd(padfSecond + i));
+		acc = _mm512_add_pd(acc, _mm512_mul_pd(d, d));
+
+		if (dfBound < HUGE_VAL || i + nStep == GDALFeaturePoint::DESC_SIZE)
+		{
+			__m256d s = _mm256_add_pd(_mm512_castpd512_pd256(acc),
+					_mm512_extractf64x4_pd(acc, 1));
+			__m128d t = _mm_add_pd(_mm256_castpd256_pd128(s),
+					_mm256_extractf128_pd(s, 1));
+			sum = _mm_cvtsd_f64(_mm_add_sd(t, _mm_unpackhi_pd(t, t)));
+			if (sum > dfBound)
+				return sum;
+		}
+	}
+
+	return sum;
+}
+#endif
+
+GDALDescriptorMatrix::DistanceKernelFunc GDALDescriptorMatrix::GetDistanceKernel()
+{
+	switch (GDALCPUDispatch::GetLevel())
+	{
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_AVX512:
+			return DistanceKernelAVX512;
+		case GDALCPUDispatch::LEVEL_AVX2:
+			return DistanceKernelAVX2;
+#endif
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_SSE2:
+			return DistanceKernelSSE2;
+#endif
+		case GDALCPUDispatch::LEVEL_REFERENCE:
+			return DistanceKernelReference;
+		default:
+			return DistanceKernelScalar;
+	}
+}
+
+double GDALDescriptorMatrix::GetSquaredDistance(const double *padfFirst,
+		const double *padfSecond)
+{
+	return GetDistanceKernel()(padfFirst, padfSecond, HUGE_VAL);
+}
+
+double GDALDescriptorMatrix::GetSquaredDistanceBounded(const double *padfFirst,
+		const double *padfSecond, double dfBound)
+{
+	return GetDistanceKernel()(padfFirst, padfSecond, dfBound);
+}
+
+/* -------------------------------------------------------------------- */
+/*      Dot product kernels. Every kernel accumulates products          */
+/*      component by component, so all of them give the same result.    */
+/* -------------------------------------------------------------------- */
+static void DotKernelScalar(const double *padfQueries,
+		const double *padfPanel, double *padfDots)
+{
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+	const int MR = GDALDescriptorMatrix::MR;
+	const int NR = GDALDescriptorMatrix::NR;
+
+	double acc[MR * NR];
+	for (int i = 0; i < MR * NR; i++)
+		acc[i] = 0;
+
+	for (int k = 0; k < nDim; k++)
+		for (int r = 0; r < MR; r++)
+		{
+			double a = padfQueries[r * nDim + k];
+			for (int c = 0; c < NR; c++)
+				acc[r * NR + c] += a * padfPanel[k * NR + c];
+		}
+
+	for (int i = 0; i < MR * NR; i++)
+		padfDots[i] = acc[i];
+}
+
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#if !defined(__SSE2__)
+GDAL_CORRELATOR_TARGET("sse2")
+#endif
+static void DotKernelSSE2(const double *padfQueries,
+		const double *padfPanel, double *padfDots)
+{
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+	const int NR = GDALDescriptorMatrix::NR;
+
+	// MR x NR block of accumulators, two doubles per register
+	__m128d acc00 = _mm_setzero_pd(), acc01 = _mm_setzero_pd();
+	__m128d acc10 = _mm_setzero_pd(), acc11 = _mm_setzero_pd();
+	__m128d acc20 = _mm_setzero_pd(), acc21 = _mm_setzero_pd();
+	__m128d acc30 = _mm_setzero_pd(), acc31 = _mm_setzero_pd();
+
+	for (int k = 0; k < nDim; k++)
+	{
+		__m128d b0 = _mm_loadu_pd(padfPanel + k * NR);
+		__m128d b1 = _mm_loadu_pd(padfPanel + k * NR + 2);
+
+		__m128d a = _mm_set1_pd(padfQueries[k]);
+		acc00 = _mm_add_pd(acc00, _mm_mul_pd(a, b0));
+		acc01 = _mm_add_pd(acc01, _mm_mul_pd(a, b1));
+
+		a = _mm_set1_pd(padfQueries[nDim + k]);
+		acc10 = _mm_add_pd(acc10, _mm_mul_pd(a, b0));
+		acc11 = _mm_add_pd(acc11, _mm_mul_pd(a, b1));
+
+		a = _mm_set1_pd(padfQueries[2 * nDim + k]);
+		acc20 = _mm_add_pd(acc20, _mm_mul_pd(a, b0));
+		acc21 = _mm_add_pd(acc21, _mm_mul_pd(a, b1));
+
+		a = _mm_set1_pd(padfQueries[3 * nDim + k]);
+		acc30 = _mm_add_pd(acc30, _mm_mul_pd(a, b0));
+		acc31 = _mm_add_pd(acc31, _mm_mul_pd(a, b1));
+	}
+
+	_mm_storeu_pd(padfDots, acc00);      _mm_storeu_pd(padfDots + 2, acc01);
+	_mm_storeu_pd(padfDots + 4, acc10);  _mm_storeu_pd(padfDots + 6, acc11);
+	_mm_storeu_pd(padfDots + 8, acc20);  _mm_storeu_pd(padfDots + 10, acc21);
+	_mm_storeu_pd(padfDots + 12, acc30); _mm_storeu_pd(padfDots + 14, acc31);
+}
+#endif
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+GDAL_CORRELATOR_TARGET("avx2")
+static void DotKernelAVX2(const double *padfQueries,
+		const double *padfPanel, double *padfDots)
+{
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+	const int NR = GDALDescriptorMatrix::NR;
+
+	// Row of NR accumulators per query
+	__m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+	__m256d acc2 = _mm256_setzero_pd(), acc3 = _mm256_setzero_pd();
+
+	for (int k = 0; k < nDim; k++)
+	{
+		__m256d b = _mm256_loadu_pd(padfPanel + k * NR);
+
+		acc0 = _mm256_add_pd(acc0,
+				_mm256_mul_pd(_mm256_broadcast_sd(padfQueries + k), b));
+		acc1 = _mm256_add_pd(acc1,
+				_mm256_mul_pd(_mm256_broadcast_sd(padfQueries + nDim + k), b));
+		acc2 = _mm256_add_pd(acc2,
+				_mm256_mul_pd(_mm256_broadcast_sd(padfQueries + 2 * nDim + k), b));
+		acc3 = _mm256_add_pd(acc3,
+				_mm256_mul_pd(_mm256_broadcast_sd(padfQueries + 3 * nDim + k), b));
+	}
+
+	_mm256_storeu_pd(padfDots, acc0);
+	_mm256_storeu_pd(padfDots + 4, acc1);
+	_mm256_storeu_pd(padfDots + 8, acc2);
+	_mm256_storeu_pd(padfDots + 12, acc3);
+}
+
+GDAL_CORRELATOR_TARGET("avx512f") GDAL_CORRELATOR_NO_CONTRACT
+static void DotKernelAVX512(const double *padfQueries,
+		const double *padfPanel, double *padfDots)
+{
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+	const int NR = GDALDescriptorMatrix::NR;
+
+	// Two query rows per register: lower half for the first one
+	__m512d acc01 = _mm512_setzero_pd(), acc23 = _mm512_setzero_pd();
+
+	for (int k = 0; k < nDim; k++)
+	{
+		__m512d b = _mm512_broadcast_f64x4(_mm256_loadu_pd(padfPanel + k * NR));
+
+		__m512d a01 = _mm512_insertf64x4(
+				_mm512_set1_pd(padfQueries[k]),
+				_mm256_set1_pd(padfQueries[nDim + k]), 1);
+		__m512d a23 = _mm512_insertf64x4(
+				_mm512_set1_pd(padfQueries[2 * nDim + k]),
+				_mm256_set1_pd(padfQueries[3 * nDim + k]), 1);
+
+		acc01 = _mm512_add_pd(acc01, _mm512_mul_pd(a01, b));
+		acc23 = _mm512_add_pd(acc23, _mm512_mul_pd(a23, b));
+	}
+
+	_mm512_storeu_pd(padfDots, acc01);
+	_mm512_storeu_pd(padfDots + 8, acc23);
+}
+#endif
+
+GDALDescriptorMatrix::DotKernelFunc GDALDescriptorMatrix::GetDotKernel()
+{
+	switch (GDALCPUDispatch::GetLevel())
+	{
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_AVX512:
+			return DotKernelAVX512;
+		case GDALCPUDispatch::LEVEL_AVX2:
+			return DotKernelAVX2;
+#endif
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_SSE2:
+			return DotKernelSSE2;
+#endif
+		default:
+			return DotKernelScalar;
+	}
+}
+
+void GDALDescriptorMatrix::FindTwoNearest(const GDALDescriptorMatrix &oQueries,
+		const GDALDescriptorMatrix &oBase,
+		int *panBest, double *padfBest, int *panBest_2, double *padfBest_2)
+{
+	FindTwoNearest(oQueries, 0, oQueries.GetRows(), oBase,
+			panBest, padfBest, panBest_2, padfBest_2);
+}
+
+void GDALDescriptorMatrix::FindTwoNearest(const GDALDescriptorMatrix &oQueries,
+		int nFirstQuery, int nQueryCount,
+		const GDALDescriptorMatrix &oBase,
+		int *panBest, double *padfBest, int *panBest_2, double *padfBest_2)
+{
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+	int nQueries = nQueryCount;
+	int nBase = oBase.GetRows();
+
+	for (int i = 0; i < nQueries; i++)
+	{
+		panBest[i] = -1;
+		panBest_2[i] = -1;
+		padfBest[i] = HUGE_VAL;
+		padfBest_2[i] = HUGE_VAL;
+	}
+
+	if (nQueries == 0 || nBase == 0)
+		return;
+
+	// Tile of base matrix, packed by NR rows
+	vector<double> adfPanels(NB * nDim);
+	vector<double> adfPanelNorms(NB);
+	// Copy of incomplete block of query rows
+	vector<double> adfPadded(MR * nDim, 0.0);
+	double adfDots[MR * NR];
+	DotKernelFunc pfnDotKernel = GetDotKernel();
+
+	for (int nTile = 0; nTile < nBase; nTile += NB)
+	{
+		int nCols = (nBase - nTile < NB) ? nBase - nTile : NB;
+		int nPanels = (nCols + NR - 1) / NR;
+
+/* -------------------------------------------------------------------- */
+/*      Pack tile. Missing rows of the last panel are zeros             */
+/*      with infinite norm, so they never become candidates.            */
+/* -------------------------------------------------------------------- */
+		for (int p = 0; p < nPanels; p++)
+			for (int c = 0; c < NR; c++)
+			{
+				int col = p * NR + c;
+				double *padfPanel = &adfPanels[(size_t)p * nDim * NR];
+
+				if (col < nCols)
+				{
+					const double *padfRow = oBase.GetRow(nTile + col);
+					for (int k = 0; k < nDim; k++)
+						padfPanel[k * NR + c] = padfRow[k];
+					adfPanelNorms[col] = oBase.GetSquaredNorm(nTile + col);
+				}
+				else
+				{
+					for (int k = 0; k < nDim; k++)
+						padfPanel[k * NR + c] = 0;
+					adfPanelNorms[col] = HUGE_VAL;
+				}
+			}
+
+/* -------------------------------------------------------------------- */
+/*      Multiply blocks of query rows by tile and update candidates.    */
+/* -------------------------------------------------------------------- */
+		for (int i = 0; i < nQueries; i += MR)
+		{
+			int nBlockRows = (nQueries - i < MR) ? nQueries - i : MR;
+			const double *padfQueries = oQueries.GetRow(nFirstQuery + i);
+
+			if (nBlockRows < MR)
+			{
+				for (int k = 0; k < nBlockRows * nDim; k++)
+					adfPadded[k] = padfQueries[k];
+				padfQueries = &adfPadded[0];
+			}
+
+			for (int p = 0; p < nPanels; p++)
+			{
+				pfnDotKernel(padfQueries, &adfPanels[(size_t)p * nDim * NR], adfDots);
+
+				for (int r = 0; r < nBlockRows; r++)
+				{
+					int nQuery = i + r;
+					double queryNorm = oQueries.GetSquaredNorm(nFirstQuery + nQuery);
+
+					for (int c = 0; c < NR; c++)
+					{
+						double dist = queryNorm + adfPanelNorms[p * NR + c]
+								- 2 * adfDots[r * NR + c];
+						if (dist < 0)
+							dist = 0;
+
+						if (dist < padfBest[nQuery])
+						{
+							padfBest_2[nQuery] = padfBest[nQuery];
+							panBest_2[nQuery] = panBest[nQuery];
+							padfBest[nQuery] = dist;
+							panBest[nQuery] = nTile + p * NR + c;
+						}
+						else if (dist < padfBest_2[nQuery])
+						{
+							padfBest_2[nQuery] = dist;
+							panBest_2[nQuery] = nTile + p * NR + c;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+GDALDescriptorMatrix::~GDALDescriptorMatrix()
+{
+}
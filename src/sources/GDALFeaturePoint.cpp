@@ -9,6 +9,7 @@ GDALFeaturePoint::GDALFeaturePoint()
 	nSign =   -1;
 
 	padfDescriptor = new double[DESC_SIZE];
+	bInArena = false;
 }
 
 GDALFeaturePoint::GDALFeaturePoint(const GDALFeaturePoint& fp)
@@ -22,6 +23,7 @@ GDALFeaturePoint::GDALFeaturePoint(const GDALFeaturePoint& fp)
 	padfDescriptor = new double[DESC_SIZE];
 	for (int i = 0; i < DESC_SIZE; i++)
 		padfDescriptor[i] = fp.padfDescriptor[i];
+	bInArena = false;
 }
 
 GDALFeaturePoint::GDALFeaturePoint(int nX, int nY,
@@ -34,6 +36,20 @@ GDALFeaturePoint::GDALFeaturePoint(int nX, int nY,
 	this->nSign = nSign;
 
 	this->padfDescriptor = new double[DESC_SIZE];
+	this->bInArena = false;
+}
+
+GDALFeaturePoint::GDALFeaturePoint(int nX, int nY,
+		int nScale, int nRadius, int nSign, double *padfDescriptor)
+{
+	this->nX = nX;
+	this->nY = nY;
+	this->nScale = nScale;
+	this->nRadius = nRadius;
+	this->nSign = nSign;
+
+	this->padfDescriptor = padfDescriptor;
+	this->bInArena = true;
 }
 
 GDALFeaturePoint& GDALFeaturePoint::operator = (const GDALFeaturePoint& point)
@@ -46,11 +62,7 @@ GDALFeaturePoint& GDALFeaturePoint::operator = (const GDALFeaturePoint& point)
 		nRadius = point.nRadius;
 		nSign = point.nSign;
 
-		//Free memory
-		delete[] padfDescriptor;
-
-		//Copy descriptor values
-		padfDescriptor = new double[DESC_SIZE];
+		//Copy descriptor values, size of descriptor is constant
 		for (int i = 0; i < DESC_SIZE; i++)
 			padfDescriptor[i] = point.padfDescriptor[i];
 	}
@@ -58,21 +70,23 @@ GDALFeaturePoint& GDALFeaturePoint::operator = (const GDALFeaturePoint& point)
 	return *this;
 }
 
-int  GDALFeaturePoint::GetX() { return nX; }
+int  GDALFeaturePoint::GetX() const { return nX; }
 void GDALFeaturePoint::SetX(int nX) { this->nX = nX; }
 
-int  GDALFeaturePoint::GetY() { return nY; }
+int  GDALFeaturePoint::GetY() const { return nY; }
 void GDALFeaturePoint::SetY(int nY) { this->nY = nY; }
 
-int  GDALFeaturePoint::GetScale() { return nScale; }
+int  GDALFeaturePoint::GetScale() const { return nScale; }
 void GDALFeaturePoint::SetScale(int nScale) { this->nScale = nScale; }
 
-int  GDALFeaturePoint::GetRadius() { return nRadius; }
+int  GDALFeaturePoint::GetRadius() const { return nRadius; }
 void GDALFeaturePoint::SetRadius(int nRadius) { this->nRadius = nRadius; }
 
-int  GDALFeaturePoint::GetSign() { return nSign; }
+int  GDALFeaturePoint::GetSign() const { return nSign; }
 void GDALFeaturePoint::SetSign(int nSign) { this->nSign = nSign; }
 
+bool GDALFeaturePoint::IsInArena() const { return bInArena; }
+
 double& GDALFeaturePoint::operator [] (int nIndex)
 {
 	if (nIndex < 0 || nIndex >= DESC_SIZE)
@@ -84,7 +98,11 @@ double& GDALFeaturePoint::operator [] (int nIndex)
 	return padfDescriptor[nIndex];
 }
 
+double *GDALFeaturePoint::GetDescriptor() { return padfDescriptor; }
+const double *GDALFeaturePoint::GetDescriptor() const { return padfDescriptor; }
+
 GDALFeaturePoint::~GDALFeaturePoint() {
-	delete[] padfDescriptor;
+	if (!bInArena)
+		delete[] padfDescriptor;
 }
 
@@ -0,0 +1,118 @@
+#include "GDALFeaturePointsArena.h"
+
+#include "cpl_conv.h"
+
+#include <new>
+
+GDALFeaturePointsArena::GDALFeaturePointsArena(int nBlockSize)
+{
+	this->nBlockSize = MAX(nBlockSize, 1);
+	nCurrentBlock = 0;
+	nUsed = 0;
+	nPoints = 0;
+}
+
+GByte *GDALFeaturePointsArena::Allocate(double **ppadfDescriptor)
+{
+	if (nUsed == nBlockSize)
+	{
+		nCurrentBlock++;
+		nUsed = 0;
+	}
+
+	if (nCurrentBlock == (int)aoBlocks.size())
+	{
+		Block oBlock;
+		oBlock.pabyPoints = (GByte *)VSIMalloc2(nBlockSize,
+				sizeof(GDALFeaturePoint));
+		oBlock.padfDescriptors = (double *)VSIMalloc3(nBlockSize,
+				GDALFeaturePoint::DESC_SIZE, sizeof(double));
+
+		if (oBlock.pabyPoints == NULL || oBlock.padfDescriptors == NULL)
+		{
+			CPLFree(oBlock.pabyPoints);
+			CPLFree(oBlock.padfDescriptors);
+			CPLError(CE_Failure, CPLE_OutOfMemory,
+					"Can't allocate block of %d feature points", nBlockSize);
+			return NULL;
+		}
+
+		aoBlocks.push_back(oBlock);
+	}
+
+	const Block &oBlock = aoBlocks[nCurrentBlock];
+	*ppadfDescriptor = oBlock.padfDescriptors +
+			(size_t)nUsed * GDALFeaturePoint::DESC_SIZE;
+	GByte *pabyPoint = oBlock.pabyPoints +
+			(size_t)nUsed * sizeof(GDALFeaturePoint);
+
+	nUsed++;
+	nPoints++;
+
+	return pabyPoint;
+}
+
+GDALFeaturePoint *GDALFeaturePointsArena::NewPoint(int nX, int nY,
+		int nScale, int nRadius, int nSign)
+{
+	double *padfDescriptor = NULL;
+	GByte *pabyPoint = Allocate(&padfDescriptor);
+	if (pabyPoint == NULL)
+		return NULL;
+
+	return new (pabyPoint) GDALFeaturePoint(nX, nY, nScale, nRadius, nSign,
+			padfDescriptor);
+}
+
+GDALFeaturePoint *GDALFeaturePointsArena::NewPoint(
+		const GDALFeaturePoint &oPoint)
+{
+	GDALFeaturePoint *poPoint = NewPoint(oPoint.GetX(), oPoint.GetY(),
+			oPoint.GetScale(), oPoint.GetRadius(), oPoint.GetSign());
+
+	if (poPoint != NULL)
+		memcpy(poPoint->GetDescriptor(), oPoint.GetDescriptor(),
+				sizeof(double) * GDALFeaturePoint::DESC_SIZE);
+
+	return poPoint;
+}
+
+void GDALFeaturePointsArena::Reset()
+{
+	// Points don't own memory, so destructors aren't needed
+	nCurrentBlock = 0;
+	nUsed = 0;
+	nPoints = 0;
+}
+
+void GDALFeaturePointsArena::Shrink()
+{
+	FreeBlocks(nPoints > 0 ? nCurrentBlock + 1 : 0);
+}
+
+void GDALFeaturePointsArena::FreeBlocks(int nFirst)
+{
+	for (size_t i = nFirst; i < aoBlocks.size(); i++)
+	{
+		CPLFree(aoBlocks[i].pabyPoints);
+		CPLFree(aoBlocks[i].padfDescriptors);
+	}
+
+	aoBlocks.resize(nFirst);
+}
+
+int GDALFeaturePointsArena::GetPointCount() const
+{
+	return nPoints;
+}
+
+GIntBig GDALFeaturePointsArena::GetMemoryUsage() const
+{
+	return (GIntBig)aoBlocks.size() * nBlockSize * (sizeof(GDALFeaturePoint) +
+			sizeof(double) * GDALFeaturePoint::DESC_SIZE);
+}
+
+GDALFeaturePointsArena::~GDALFeaturePointsArena()
+{
+	FreeBlocks(0);
+}
@@ -1,15 +1,54 @@
 #include "GDALFeaturePointsCollection.h"
+#include "GDALFeaturePointsFile.h"
+
+#include "cpl_conv.h"
+
+GDALFeaturePointsCollection::DatasetFingerprint::DatasetFingerprint()
+{
+	nRasterXSize = 0;
+	nRasterYSize = 0;
+	nBands = 0;
+	for (int i = 0; i < 6; i++)
+		adfGeoTransform[i] = 0;
+	nNameHash = 0;
+}
+
+bool GDALFeaturePointsCollection::DatasetFingerprint::IsEqual(
+		const DatasetFingerprint &oOther) const
+{
+	if (nRasterXSize != oOther.nRasterXSize ||
+			nRasterYSize != oOther.nRasterYSize ||
+			nBands != oOther.nBands ||
+			nNameHash != oOther.nNameHash)
+		return false;
+
+	for (int i = 0; i < 6; i++)
+		if (adfGeoTransform[i] != oOther.adfGeoTransform[i])
+			return false;
+
+	return true;
+}
 
 GDALFeaturePointsCollection::GDALFeaturePointsCollection()
 {
 	pPoints = new vector<GDALFeaturePoint*>();
 	poDataset = NULL;
+
+	nOctaveStart = -1;
+	nOctaveEnd = -1;
+	dfThreshold = -1;
+	nHeapPoints = 0;
 }
 
 GDALFeaturePointsCollection::GDALFeaturePointsCollection(GDALDataset* poDataset)
 {
 	this->pPoints = new vector<GDALFeaturePoint*>();
 	this->poDataset = poDataset;
+
+	nOctaveStart = -1;
+	nOctaveEnd = -1;
+	dfThreshold = -1;
+	nHeapPoints = 0;
 }
 
 GDALDataset* GDALFeaturePointsCollection::GetDataset()
@@ -24,8 +63,32 @@ void GDALFeaturePointsCollection::SetDataset(GDALDataset *poDataset)
 
 void GDALFeaturePointsCollection::AddPoint(GDALFeaturePoint *poPoint)
 {
+	if (poPoint == NULL)
+		return;
+
+	pPoints->push_back(poPoint);
+	if (!poPoint->IsInArena())
+		nHeapPoints++;
+}
+
+GDALFeaturePoint* GDALFeaturePointsCollection::NewPoint(int nX, int nY,
+		int nScale, int nRadius, int nSign)
+{
+	GDALFeaturePoint *poPoint = oArena.NewPoint(nX, nY, nScale, nRadius, nSign);
 	if (poPoint != NULL)
 		pPoints->push_back(poPoint);
+
+	return poPoint;
+}
+
+GDALFeaturePoint* GDALFeaturePointsCollection::NewPoint(
+		const GDALFeaturePoint &oPoint)
+{
+	GDALFeaturePoint *poPoint = oArena.NewPoint(oPoint);
+	if (poPoint != NULL)
+		pPoints->push_back(poPoint);
+
+	return poPoint;
 }
 
 GDALFeaturePoint* GDALFeaturePointsCollection::GetPoint(int nIndex)
@@ -36,6 +99,14 @@ GDALFeaturePoint* GDALFeaturePointsCollection::GetPoint(int nIndex)
 	return pPoints->at(nIndex);
 }
 
+const GDALFeaturePoint* GDALFeaturePointsCollection::GetPoint(int nIndex) const
+{
+	if (nIndex < 0 || nIndex >= this->GetSize())
+		return NULL;
+
+	return pPoints->at(nIndex);
+}
+
 int GDALFeaturePointsCollection::GetSize() const
 {
 	return pPoints->size();
@@ -43,16 +114,120 @@ int GDALFeaturePointsCollection::GetSize() const
 
 void GDALFeaturePointsCollection::Clear()
 {
-	for (int i = 0; i < pPoints->size(); i++)
+	// Points of arena are freed all at once
+	for (int i = 0; nHeapPoints > 0 && i < pPoints->size(); i++)
+		if (!(*pPoints)[i]->IsInArena())
+		{
 			delete (*pPoints)[i];
+			nHeapPoints--;
+		}
 
 	pPoints->clear();
+	oArena.Reset();
+	nHeapPoints = 0;
+}
+
+void GDALFeaturePointsCollection::Shrink()
+{
+	oArena.Shrink();
+
+	if (pPoints->empty())
+		vector<GDALFeaturePoint*>().swap(*pPoints);
+}
+
+GIntBig GDALFeaturePointsCollection::GetMemoryUsage() const
+{
+	return oArena.GetMemoryUsage() +
+			(GIntBig)pPoints->capacity() * sizeof(GDALFeaturePoint*) +
+			(GIntBig)nHeapPoints * (sizeof(GDALFeaturePoint) +
+			GDALFeaturePoint::DESC_SIZE * sizeof(double));
+}
+
+void GDALFeaturePointsCollection::SetExtractionParameters(
+		int nOctaveStart, int nOctaveEnd, double dfThreshold)
+{
+	this->nOctaveStart = nOctaveStart;
+	this->nOctaveEnd = nOctaveEnd;
+	this->dfThreshold = dfThreshold;
+}
+
+int GDALFeaturePointsCollection::GetOctaveStart() const { return nOctaveStart; }
+
+int GDALFeaturePointsCollection::GetOctaveEnd() const { return nOctaveEnd; }
+
+double GDALFeaturePointsCollection::GetThreshold() const { return dfThreshold; }
+
+void GDALFeaturePointsCollection::ComputeFingerprint(
+		GDALDataset *poDataset, DatasetFingerprint *poFingerprint)
+{
+	*poFingerprint = DatasetFingerprint();
+
+	if (poDataset == NULL)
+		return;
+
+	poFingerprint->nRasterXSize = poDataset->GetRasterXSize();
+	poFingerprint->nRasterYSize = poDataset->GetRasterYSize();
+	poFingerprint->nBands = poDataset->GetRasterCount();
+
+	if (poDataset->GetGeoTransform(poFingerprint->adfGeoTransform) != CE_None)
+		for (int i = 0; i < 6; i++)
+			poFingerprint->adfGeoTransform[i] = 0;
+
+	// FNV-1a hash. Path is ignored, so dataset may be moved
+	GUIntBig nHash = 14695981039346656037ULL;
+	const char *pszName = CPLGetFilename(poDataset->GetDescription());
+	for (; *pszName != '\0'; pszName++)
+	{
+		nHash ^= (GByte)*pszName;
+		nHash *= 1099511628211ULL;
+	}
+	poFingerprint->nNameHash = nHash;
+}
+
+GDALFeaturePointsCollection::DatasetFingerprint
+GDALFeaturePointsCollection::GetFingerprint() const
+{
+	if (poDataset == NULL)
+		return oFingerprint;
+
+	DatasetFingerprint oResult;
+	ComputeFingerprint(poDataset, &oResult);
+
+	return oResult;
+}
+
+void GDALFeaturePointsCollection::SetFingerprint(
+		const DatasetFingerprint &oFingerprint)
+{
+	this->oFingerprint = oFingerprint;
+}
+
+CPLErr GDALFeaturePointsCollection::Save(const char *pszFilename)
+{
+	return GDALFeaturePointsFile::Write(pszFilename, this);
+}
+
+CPLErr GDALFeaturePointsCollection::Load(const char *pszFilename)
+{
+	GDALFeaturePointsFile oFile;
+
+	if (oFile.Open(pszFilename) != CE_None)
+		return CE_Failure;
+
+	if (poDataset != NULL && !GetFingerprint().IsEqual(oFile.GetFingerprint()))
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature points in %s were detected on another dataset",
+				pszFilename);
+		return CE_Failure;
+	}
+
+	return oFile.ExportToCollection(this);
 }
 
 GDALFeaturePointsCollection::~GDALFeaturePointsCollection()
 {
-	for (int i = 0; i < pPoints->size(); i++)
-		delete (*pPoints)[i];
+	Clear();
 
 	delete pPoints;
 }
@@ -0,0 +1,371 @@
+#include "GDALFeaturePointsFile.h"
+
+#include "cpl_conv.h"
+
+// Signature of the file
+static const char szMagic[] = "GDALFPTS";
+
+// Number of points processed by one write call
+static const int WRITE_CHUNK = 1024;
+
+GDALFeaturePointsFile::GDALFeaturePointsFile()
+{
+	nCount = 0;
+	nOctaveStart = -1;
+	nOctaveEnd = -1;
+	dfThreshold = -1;
+
+	psVirtualMem = NULL;
+	fpMapped = NULL;
+	pabyBuffer = NULL;
+	pabyData = NULL;
+
+	for (int i = 0; i < ARRAYS; i++)
+		anOffsets[i] = 0;
+}
+
+void GDALFeaturePointsFile::ComputeLayout(GUIntBig nCount,
+		vsi_l_offset *panOffsets, vsi_l_offset *pnTotalSize)
+{
+	// X, Y, scale, radius and sign arrays, then descriptors
+	const vsi_l_offset anItemSize[ARRAYS] = { 4, 4, 4, 4, 4,
+			sizeof(double) * GDALFeaturePoint::DESC_SIZE };
+
+	vsi_l_offset nOffset = HEADER_SIZE;
+	for (int i = 0; i < ARRAYS; i++)
+	{
+		panOffsets[i] = nOffset;
+		nOffset += anItemSize[i] * nCount;
+		// Align next array on 8-byte boundary
+		nOffset = (nOffset + 7) & ~((vsi_l_offset)7);
+	}
+
+	*pnTotalSize = nOffset;
+}
+
+CPLErr GDALFeaturePointsFile::Write(const char *pszFilename,
+		const GDALFeaturePointsCollection *poCollection)
+{
+#ifdef CPL_MSB
+	CPLError(CE_Failure, CPLE_NotSupported,
+			"Feature points files are supported only on little-endian hosts");
+	return CE_Failure;
+#else
+	if (pszFilename == NULL || poCollection == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"File name or collection isn't specified");
+		return CE_Failure;
+	}
+
+	int nCount = poCollection->GetSize();
+	vsi_l_offset anOffsets[ARRAYS];
+	vsi_l_offset nTotalSize;
+	ComputeLayout(nCount, anOffsets, &nTotalSize);
+
+/* -------------------------------------------------------------------- */
+/*      Prepare header.                                                 */
+/* -------------------------------------------------------------------- */
+	GByte abyHeader[HEADER_SIZE];
+	memset(abyHeader, 0, HEADER_SIZE);
+
+	GUInt32 nVersion = FORMAT_VERSION;
+	GUInt32 nDescSize = GDALFeaturePoint::DESC_SIZE;
+	GUIntBig nPoints = nCount;
+	GInt32 nOctStart = poCollection->GetOctaveStart();
+	GInt32 nOctEnd = poCollection->GetOctaveEnd();
+	double dfThresh = poCollection->GetThreshold();
+	GDALFeaturePointsCollection::DatasetFingerprint oPrint =
+			poCollection->GetFingerprint();
+
+	memcpy(abyHeader, szMagic, 8);
+	memcpy(abyHeader + 8, &nVersion, 4);
+	memcpy(abyHeader + 12, &nDescSize, 4);
+	memcpy(abyHeader + 16, &nPoints, 8);
+	memcpy(abyHeader + 24, &nOctStart, 4);
+	memcpy(abyHeader + 28, &nOctEnd, 4);
+	memcpy(abyHeader + 32, &dfThresh, 8);
+	memcpy(abyHeader + 40, &oPrint.nRasterXSize, 4);
+	memcpy(abyHeader + 44, &oPrint.nRasterYSize, 4);
+	memcpy(abyHeader + 48, &oPrint.nBands, 4);
+	memcpy(abyHeader + 56, oPrint.adfGeoTransform, 48);
+	memcpy(abyHeader + 104, &oPrint.nNameHash, 8);
+
+	VSILFILE *fp = VSIFOpenL(pszFilename, "wb");
+	if (fp == NULL)
+	{
+		CPLError(CE_Failure, CPLE_OpenFailed, "Can't create %s", pszFilename);
+		return CE_Failure;
+	}
+
+	bool bOk = VSIFWriteL(abyHeader, HEADER_SIZE, 1, fp) == 1;
+
+/* -------------------------------------------------------------------- */
+/*      Write arrays. Every array is collected in chunks.               */
+/* -------------------------------------------------------------------- */
+	double *padfChunk = (double *)CPLMalloc(
+			sizeof(double) * GDALFeaturePoint::DESC_SIZE * WRITE_CHUNK);
+	GInt32 *panChunk = (GInt32 *)padfChunk;
+	const GByte abyZero[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+	for (int iArray = 0; iArray < ARRAYS && bOk; iArray++)
+	{
+		bOk = VSIFSeekL(fp, anOffsets[iArray], SEEK_SET) == 0;
+
+		for (int iStart = 0; iStart < nCount && bOk; iStart += WRITE_CHUNK)
+		{
+			int nChunk = (nCount - iStart < WRITE_CHUNK) ?
+					nCount - iStart : WRITE_CHUNK;
+
+			for (int i = 0; i < nChunk; i++)
+			{
+				const GDALFeaturePoint *poPoint = poCollection->GetPoint(iStart + i);
+				switch (iArray)
+				{
+				case 0: panChunk[i] = poPoint->GetX(); break;
+				case 1: panChunk[i] = poPoint->GetY(); break;
+				case 2: panChunk[i] = poPoint->GetScale(); break;
+				case 3: panChunk[i] = poPoint->GetRadius(); break;
+				case 4: panChunk[i] = poPoint->GetSign(); break;
+				default:
+					memcpy(padfChunk + i * GDALFeaturePoint::DESC_SIZE,
+							poPoint->GetDescriptor(),
+							GDALFeaturePoint::DESC_SIZE * sizeof(double));
+				}
+			}
+
+			if (iArray < ARRAYS - 1)
+				bOk = VSIFWriteL(panChunk, 4, nChunk, fp) == (size_t)nChunk;
+			else
+				bOk = VSIFWriteL(padfChunk, sizeof(double) * GDALFeaturePoint::DESC_SIZE,
+						nChunk, fp) == (size_t)nChunk;
+		}
+	}
+
+	// Padding after the last array
+	if (bOk && VSIFTellL(fp) < nTotalSize)
+		bOk = VSIFWriteL(abyZero, 1, (size_t)(nTotalSize - VSIFTellL(fp)), fp) > 0;
+
+	CPLFree(padfChunk);
+
+	if (VSIFCloseL(fp) != 0)
+		bOk = false;
+
+	if (!bOk)
+	{
+		CPLError(CE_Failure, CPLE_FileIO, "Can't write %s", pszFilename);
+		return CE_Failure;
+	}
+
+	return CE_None;
+#endif
+}
+
+CPLErr GDALFeaturePointsFile::Open(const char *pszFilename)
+{
+	Close();
+
+#ifdef CPL_MSB
+	CPLError(CE_Failure, CPLE_NotSupported,
+			"Feature points files are supported only on little-endian hosts");
+	return CE_Failure;
+#else
+	VSILFILE *fp = VSIFOpenL(pszFilename, "rb");
+	if (fp == NULL)
+	{
+		CPLError(CE_Failure, CPLE_OpenFailed, "Can't open %s", pszFilename);
+		return CE_Failure;
+	}
+
+/* -------------------------------------------------------------------- */
+/*      Read and validate header.                                       */
+/* -------------------------------------------------------------------- */
+	GByte abyHeader[HEADER_SIZE];
+	GUInt32 nVersion = 0;
+	GUInt32 nDescSize = 0;
+	GUIntBig nPoints = 0;
+
+	if (VSIFReadL(abyHeader, HEADER_SIZE, 1, fp) != 1 ||
+			memcmp(abyHeader, szMagic, 8) != 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"%s isn't a feature points file", pszFilename);
+		VSIFCloseL(fp);
+		return CE_Failure;
+	}
+
+	memcpy(&nVersion, abyHeader + 8, 4);
+	memcpy(&nDescSize, abyHeader + 12, 4);
+	memcpy(&nPoints, abyHeader + 16, 8);
+
+	if (nVersion != FORMAT_VERSION ||
+			nDescSize != (GUInt32)GDALFeaturePoint::DESC_SIZE ||
+			nPoints > 0x7fffffff)
+	{
+		CPLError(CE_Failure, CPLE_NotSupported,
+				"%s has unsupported version or descriptor size", pszFilename);
+		VSIFCloseL(fp);
+		return CE_Failure;
+	}
+
+	vsi_l_offset nTotalSize;
+	ComputeLayout(nPoints, anOffsets, &nTotalSize);
+
+	VSIFSeekL(fp, 0, SEEK_END);
+	if (VSIFTellL(fp) < nTotalSize)
+	{
+		CPLError(CE_Failure, CPLE_FileIO, "%s is truncated", pszFilename);
+		VSIFCloseL(fp);
+		return CE_Failure;
+	}
+
+	nCount = (int)nPoints;
+	memcpy(&nOctaveStart, abyHeader + 24, 4);
+	memcpy(&nOctaveEnd, abyHeader + 28, 4);
+	memcpy(&dfThreshold, abyHeader + 32, 8);
+	memcpy(&oFingerprint.nRasterXSize, abyHeader + 40, 4);
+	memcpy(&oFingerprint.nRasterYSize, abyHeader + 44, 4);
+	memcpy(&oFingerprint.nBands, abyHeader + 48, 4);
+	memcpy(oFingerprint.adfGeoTransform, abyHeader + 56, 48);
+	memcpy(&oFingerprint.nNameHash, abyHeader + 104, 8);
+
+/* -------------------------------------------------------------------- */
+/*      Map file into memory, or read it at once.                       */
+/* -------------------------------------------------------------------- */
+	if (CPLIsVirtualMemFileMapAvailable())
+	{
+		psVirtualMem = CPLVirtualMemFileMapNew(fp, 0, nTotalSize,
+				VIRTUALMEM_READONLY, NULL, NULL);
+		if (psVirtualMem != NULL)
+		{
+			// Handle should be alive while mapping exists
+			fpMapped = fp;
+			pabyData = (const GByte *)CPLVirtualMemGetAddr(psVirtualMem);
+			return CE_None;
+		}
+	}
+
+	pabyBuffer = (GByte *)VSIMalloc((size_t)nTotalSize);
+	if (pabyBuffer == NULL)
+	{
+		CPLError(CE_Failure, CPLE_OutOfMemory,
+				"Can't allocate memory for %s", pszFilename);
+		VSIFCloseL(fp);
+		Close();
+		return CE_Failure;
+	}
+
+	if (VSIFSeekL(fp, 0, SEEK_SET) != 0 ||
+			VSIFReadL(pabyBuffer, 1, (size_t)nTotalSize, fp) != (size_t)nTotalSize)
+	{
+		CPLError(CE_Failure, CPLE_FileIO, "Can't read %s", pszFilename);
+		VSIFCloseL(fp);
+		Close();
+		return CE_Failure;
+	}
+
+	VSIFCloseL(fp);
+	pabyData = pabyBuffer;
+
+	return CE_None;
+#endif
+}
+
+void GDALFeaturePointsFile::Close()
+{
+	if (psVirtualMem != NULL)
+		CPLVirtualMemFree(psVirtualMem);
+	if (fpMapped != NULL)
+		VSIFCloseL(fpMapped);
+	CPLFree(pabyBuffer);
+
+	psVirtualMem = NULL;
+	fpMapped = NULL;
+	pabyBuffer = NULL;
+	pabyData = NULL;
+	nCount = 0;
+}
+
+int GDALFeaturePointsFile::GetSize() const { return nCount; }
+
+int GDALFeaturePointsFile::GetOctaveStart() const { return nOctaveStart; }
+
+int GDALFeaturePointsFile::GetOctaveEnd() const { return nOctaveEnd; }
+
+double GDALFeaturePointsFile::GetThreshold() const { return dfThreshold; }
+
+const GDALFeaturePointsCollection::DatasetFingerprint &
+GDALFeaturePointsFile::GetFingerprint() const
+{
+	return oFingerprint;
+}
+
+const GInt32 *GDALFeaturePointsFile::GetX() const
+{
+	return pabyData ? (const GInt32 *)(pabyData + anOffsets[0]) : NULL;
+}
+
+const GInt32 *GDALFeaturePointsFile::GetY() const
+{
+	return pabyData ? (const GInt32 *)(pabyData + anOffsets[1]) : NULL;
+}
+
+const GInt32 *GDALFeaturePointsFile::GetScale() const
+{
+	return pabyData ? (const GInt32 *)(pabyData + anOffsets[2]) : NULL;
+}
+
+const GInt32 *GDALFeaturePointsFile::GetRadius() const
+{
+	return pabyData ? (const GInt32 *)(pabyData + anOffsets[3]) : NULL;
+}
+
+const GInt32 *GDALFeaturePointsFile::GetSign() const
+{
+	return pabyData ? (const GInt32 *)(pabyData + anOffsets[4]) : NULL;
+}
+
+const double *GDALFeaturePointsFile::GetDescriptors() const
+{
+	return pabyData ? (const double *)(pabyData + anOffsets[5]) : NULL;
+}
+
+CPLErr GDALFeaturePointsFile::ExportToCollection(
+		GDALFeaturePointsCollection *poCollection) const
+{
+	if (pabyData == NULL || poCollection == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature points file isn't opened or collection isn't specified");
+		return CE_Failure;
+	}
+
+	const GInt32 *panX = GetX();
+	const GInt32 *panY = GetY();
+	const GInt32 *panScale = GetScale();
+	const GInt32 *panRadius = GetRadius();
+	const GInt32 *panSign = GetSign();
+	const double *padfDesc = GetDescriptors();
+
+	for (int i = 0; i < nCount; i++)
+	{
+		GDALFeaturePoint *poPoint = poCollection->NewPoint(
+				panX[i], panY[i], panScale[i], panRadius[i], panSign[i]);
+		if (poPoint == NULL)
+			return CE_Failure;
+
+		for (int k = 0; k < GDALFeaturePoint::DESC_SIZE; k++)
+			(*poPoint)[k] = padfDesc[i * GDALFeaturePoint::DESC_SIZE + k];
+	}
+
+	poCollection->SetExtractionParameters(nOctaveStart, nOctaveEnd, dfThreshold);
+	if (poCollection->GetDataset() == NULL)
+		poCollection->SetFingerprint(oFingerprint);
+
+	return CE_None;
+}
+
+GDALFeaturePointsFile::~GDALFeaturePointsFile()
+{
+	Close();
+}
@@ -1,4 +1,13 @@
 #include "GDALIntegralImage.h"
+#include "GDALCPUDispatch.h"
+
+#include <stddef.h>
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 GDALIntegralImage::GDALIntegralImage()
 {
@@ -11,33 +20,241 @@ int GDALIntegralImage::GetHeight() { return nHeight; }
 
 int GDALIntegralImage::GetWidth() { return nWidth; }
 
-void GDALIntegralImage::Initialize(const double **padfImg, int nHeight, int nWidth)
+const double *GDALIntegralImage::GetData()
 {
-	//Memory allocation
-	pMatrix = new double*[nHeight];
-	for (int i = 0; i < nHeight; i++)
-		pMatrix[i] = new double[nWidth];
+	return (pMatrix != 0 && nHeight > 0) ? pMatrix[0] : 0;
+}
 
-	this->nHeight = nHeight;
-	this->nWidth = nWidth;
+/* -------------------------------------------------------------------- */
+/*      Prefix sum kernels. Value is the sum of the source row up to    */
+/*      the column, accumulated from left to right, added to the value  */
+/*      above it. Vector kernels accumulate several rows at once, one   */
+/*      row per lane, so all of them give the same result.              */
+/* -------------------------------------------------------------------- */
+
+/**
+ * Compute integral rows from source rows, starting from specified column.
+ * Running sums of rows at that column are passed in padfSums.
+ */
+static void PrefixSumRowsScalar(const double **papadfSrc, double *padfDst,
+		const double *padfPrev, int nRows, int nWidth,
+		int nStartCol, const double *padfSums)
+{
+	for (int i = 0; i < nRows; i++)
+	{
+		const double *padfSrc = papadfSrc[i];
+		double *padfRow = padfDst + (size_t)i * nWidth;
+		double sum = (padfSums != NULL) ? padfSums[i] : 0;
+
+		for (int j = nStartCol; j < nWidth; j++)
+		{
+			sum += padfSrc[j];
+			padfRow[j] = (padfPrev != NULL) ? padfPrev[j] + sum : sum;
+		}
+
+		padfPrev = padfRow;
+	}
+}
+
+/**
+ * Original recurrence of integral image, value from its left,
+ * upper and upper left neighbours (reference level).
+ */
+static void PrefixSumKernelReference(const double **papadfSrc, double *padfDst,
+		const double *padfPrev, int nRows, int nWidth)
+{
+	for (int i = 0; i < nRows; i++)
+	{
+		double *padfRow = padfDst + (size_t)i * nWidth;
 
-	//Integral image calculation
-	for (int i = 0; i < nHeight; i++)
 		for (int j = 0; j < nWidth; j++)
 		{
-			double val = padfImg[i][j];
+			double val = papadfSrc[i][j];
 			double a = 0, b = 0, c = 0;
 
-			if (i - 1 >= 0 && j - 1 >= 0)
-				a = pMatrix[i - 1][j - 1];
+			if (padfPrev != NULL && j - 1 >= 0)
+				a = padfPrev[j - 1];
 			if (j - 1 >= 0)
-				b = pMatrix[i][j - 1];
-			if (i - 1 >= 0)
-				c = pMatrix[i - 1][j];
+				b = padfRow[j - 1];
+			if (padfPrev != NULL)
+				c = padfPrev[j];
 
 			//New value based on previous calculations
-			pMatrix[i][j] = val - a + b + c;
+			padfRow[j] = val - a + b + c;
 		}
+
+		padfPrev = padfRow;
+	}
+}
+
+static void PrefixSumKernelScalar(const double **papadfSrc, double *padfDst,
+		const double *padfPrev, int nRows, int nWidth)
+{
+	PrefixSumRowsScalar(papadfSrc, padfDst, padfPrev, nRows, nWidth, 0, NULL);
+}
+
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#if !defined(__SSE2__)
+GDAL_CORRELATOR_TARGET("sse2")
+#endif
+static void PrefixSumKernelSSE2(const double **papadfSrc, double *padfDst,
+		const double *padfPrev, int nRows, int nWidth)
+{
+	int i = 0;
+	for ( ; i + 2 <= nRows; i += 2)
+	{
+		const double *padfSrc0 = papadfSrc[i];
+		const double *padfSrc1 = papadfSrc[i + 1];
+		double *padfRow0 = padfDst + (size_t)i * nWidth;
+		double *padfRow1 = padfRow0 + nWidth;
+
+		// Running sums of both rows
+		__m128d sum = _mm_setzero_pd();
+
+		int j = 0;
+		for ( ; j + 2 <= nWidth; j += 2)
+		{
+			__m128d x0 = _mm_loadu_pd(padfSrc0 + j);
+			__m128d x1 = _mm_loadu_pd(padfSrc1 + j);
+
+			__m128d s0 = _mm_add_pd(sum, _mm_unpacklo_pd(x0, x1));
+			sum = _mm_add_pd(s0, _mm_unpackhi_pd(x0, x1));
+
+			__m128d r0 = _mm_unpacklo_pd(s0, sum);
+			__m128d r1 = _mm_unpackhi_pd(s0, sum);
+
+			if (padfPrev != NULL)
+				r0 = _mm_add_pd(_mm_loadu_pd(padfPrev + j), r0);
+			r1 = _mm_add_pd(r0, r1);
+
+			_mm_storeu_pd(padfRow0 + j, r0);
+			_mm_storeu_pd(padfRow1 + j, r1);
+		}
+
+		double adfSums[2];
+		_mm_storeu_pd(adfSums, sum);
+		PrefixSumRowsScalar(papadfSrc + i, padfRow0, padfPrev, 2, nWidth,
+				j, adfSums);
+
+		padfPrev = padfRow1;
+	}
+
+	PrefixSumRowsScalar(papadfSrc + i, padfDst + (size_t)i * nWidth,
+			padfPrev, nRows - i, nWidth, 0, NULL);
+}
+#endif
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+GDAL_CORRELATOR_TARGET("avx2")
+static void PrefixSumKernelAVX2(const double **papadfSrc, double *padfDst,
+		const double *padfPrev, int nRows, int nWidth)
+{
+	int i = 0;
+	for ( ; i + 4 <= nRows; i += 4)
+	{
+		double *padfRow0 = padfDst + (size_t)i * nWidth;
+
+		// Running sums of four rows
+		__m256d sum = _mm256_setzero_pd();
+
+		int j = 0;
+		for ( ; j + 4 <= nWidth; j += 4)
+		{
+			__m256d x0 = _mm256_loadu_pd(papadfSrc[i] + j);
+			__m256d x1 = _mm256_loadu_pd(papadfSrc[i + 1] + j);
+			__m256d x2 = _mm256_loadu_pd(papadfSrc[i + 2] + j);
+			__m256d x3 = _mm256_loadu_pd(papadfSrc[i + 3] + j);
+
+			// Transpose 4x4 block, so every register holds a column
+			__m256d t0 = _mm256_unpacklo_pd(x0, x1);
+			__m256d t1 = _mm256_unpackhi_pd(x0, x1);
+			__m256d t2 = _mm256_unpacklo_pd(x2, x3);
+			__m256d t3 = _mm256_unpackhi_pd(x2, x3);
+
+			__m256d s0 = _mm256_add_pd(sum,
+					_mm256_permute2f128_pd(t0, t2, 0x20));
+			__m256d s1 = _mm256_add_pd(s0,
+					_mm256_permute2f128_pd(t1, t3, 0x20));
+			__m256d s2 = _mm256_add_pd(s1,
+					_mm256_permute2f128_pd(t0, t2, 0x31));
+			sum = _mm256_add_pd(s2,
+					_mm256_permute2f128_pd(t1, t3, 0x31));
+
+			// Transpose sums back to rows
+			t0 = _mm256_unpacklo_pd(s0, s1);
+			t1 = _mm256_unpackhi_pd(s0, s1);
+			t2 = _mm256_unpacklo_pd(s2, sum);
+			t3 = _mm256_unpackhi_pd(s2, sum);
+
+			__m256d r0 = _mm256_permute2f128_pd(t0, t2, 0x20);
+			__m256d r1 = _mm256_permute2f128_pd(t1, t3, 0x20);
+			__m256d r2 = _mm256_permute2f128_pd(t0, t2, 0x31);
+			__m256d r3 = _mm256_permute2f128_pd(t1, t3, 0x31);
+
+			if (padfPrev != NULL)
+				r0 = _mm256_add_pd(_mm256_loadu_pd(padfPrev + j), r0);
+			r1 = _mm256_add_pd(r0, r1);
+			r2 = _mm256_add_pd(r1, r2);
+			r3 = _mm256_add_pd(r2, r3);
+
+			_mm256_storeu_pd(padfRow0 + j, r0);
+			_mm256_storeu_pd(padfRow0 + nWidth + j, r1);
+			_mm256_storeu_pd(padfRow0 + 2 * (size_t)nWidth + j, r2);
+			_mm256_storeu_pd(padfRow0 + 3 * (size_t)nWidth + j, r3);
+		}
+
+		double adfSums[4];
+		_mm256_storeu_pd(adfSums, sum);
+		PrefixSumRowsScalar(papadfSrc + i, padfRow0, padfPrev, 4, nWidth,
+				j, adfSums);
+
+		padfPrev = padfRow0 + 3 * (size_t)nWidth;
+	}
+
+	PrefixSumRowsScalar(papadfSrc + i, padfDst + (size_t)i * nWidth,
+			padfPrev, nRows - i, nWidth, 0, NULL);
+}
+#endif
+
+typedef void (*PrefixSumKernelFunc)(const double **papadfSrc, double *padfDst,
+		const double *padfPrev, int nRows, int nWidth);
+
+static PrefixSumKernelFunc GetPrefixSumKernel()
+{
+	switch (GDALCPUDispatch::GetLevel())
+	{
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		// 8x8 transposes cost more than they save,
+		// so 256-bit kernel is used for AVX-512 too
+		case GDALCPUDispatch::LEVEL_AVX512:
+		case GDALCPUDispatch::LEVEL_AVX2:
+			return PrefixSumKernelAVX2;
+#endif
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_SSE2:
+			return PrefixSumKernelSSE2;
+#endif
+		case GDALCPUDispatch::LEVEL_REFERENCE:
+			return PrefixSumKernelReference;
+		default:
+			return PrefixSumKernelScalar;
+	}
+}
+
+void GDALIntegralImage::Initialize(const double **padfImg, int nHeight, int nWidth)
+{
+	//Memory allocation. Rows are placed in one contiguous block
+	pMatrix = new double*[nHeight];
+	double *padfData = new double[(size_t)nHeight * nWidth];
+	for (int i = 0; i < nHeight; i++)
+		pMatrix[i] = padfData + (size_t)i * nWidth;
+
+	this->nHeight = nHeight;
+	this->nWidth = nWidth;
+
+	//Integral image calculation
+	if (nHeight > 0 && nWidth > 0)
+		GetPrefixSumKernel()(padfImg, padfData, NULL, nHeight, nWidth);
 }
 
 /*
@@ -101,8 +318,8 @@ double GDALIntegralImage::HaarWavelet_Y(int nRow, int nCol, int nSize)
 GDALIntegralImage::~GDALIntegralImage()
 {
 	//Clean up memory
-	for (int i = 0; i < nHeight; i++)
-		delete[] pMatrix[i];
+	if (pMatrix != 0 && nHeight > 0)
+		delete[] pMatrix[0];
 
 	delete[] pMatrix;
 }
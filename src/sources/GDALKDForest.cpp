@@ -0,0 +1,254 @@
+#include "GDALKDForest.h"
+
+#include <algorithm>
+#include <functional>
+
+GDALKDForest::SearchContext::SearchContext()
+{
+	nStamp = 0;
+}
+
+GDALKDForest::GDALKDForest(int nTrees)
+{
+	this->nTrees = (nTrees > 0) ? nTrees : 1;
+	nDim = 0;
+	nPoints = 0;
+	padfData = NULL;
+	nSeed = 1;
+}
+
+int GDALKDForest::GetSize() const
+{
+	return (nTrees > 0) ? (int)anTreeIndices.size() / nTrees : 0;
+}
+
+int GDALKDForest::NextRandom(int nRange)
+{
+	// Linear congruential generator (Numerical Recipes constants)
+	nSeed = nSeed * 1664525u + 1013904223u;
+	return (int)((nSeed >> 8) % (unsigned int)nRange);
+}
+
+void GDALKDForest::Build(const double *padfData, int nPoints, int nDim,
+		const int *panIndices, int nIndices)
+{
+	this->padfData = padfData;
+	this->nPoints = nPoints;
+	this->nDim = nDim;
+
+	aoNodes.clear();
+	anRoots.clear();
+	anTreeIndices.resize((size_t)nIndices * nTrees);
+	nSeed = 1;
+
+	for (int t = 0; t < nTrees; t++)
+	{
+		for (int i = 0; i < nIndices; i++)
+			anTreeIndices[(size_t)t * nIndices + i] = panIndices[i];
+
+		anRoots.push_back(BuildTree(t * nIndices, nIndices));
+	}
+}
+
+int GDALKDForest::BuildTree(int nStart, int nCount)
+{
+	int nNode = (int)aoNodes.size();
+	aoNodes.push_back(Node());
+
+	if (nCount <= LEAF_SIZE)
+	{
+		aoNodes[nNode].nSplitDim = -1;
+		aoNodes[nNode].dfSplitVal = 0;
+		aoNodes[nNode].nLeft = nStart;
+		aoNodes[nNode].nRight = nCount;
+		return nNode;
+	}
+
+	int *panIdx = &anTreeIndices[nStart];
+
+/* -------------------------------------------------------------------- */
+/*      Estimate mean and variance of every dimension by sample.        */
+/* -------------------------------------------------------------------- */
+	int nSamples = (nCount < VARIANCE_SAMPLES) ? nCount : VARIANCE_SAMPLES;
+	int nStep = nCount / nSamples;
+
+	vector<double> adfMean(nDim, 0.0);
+	vector<double> adfVar(nDim, 0.0);
+
+	for (int s = 0; s < nSamples; s++)
+	{
+		const double *padfPoint = padfData + (size_t)panIdx[s * nStep] * nDim;
+		for (int d = 0; d < nDim; d++)
+			adfMean[d] += padfPoint[d];
+	}
+	for (int d = 0; d < nDim; d++)
+		adfMean[d] /= nSamples;
+
+	for (int s = 0; s < nSamples; s++)
+	{
+		const double *padfPoint = padfData + (size_t)panIdx[s * nStep] * nDim;
+		for (int d = 0; d < nDim; d++)
+			adfVar[d] += (padfPoint[d] - adfMean[d]) * (padfPoint[d] - adfMean[d]);
+	}
+
+/* -------------------------------------------------------------------- */
+/*      Select random dimension among dimensions with top variance.     */
+/* -------------------------------------------------------------------- */
+	int anTop[RAND_DIMS];
+	int nTop = 0;
+	for (int d = 0; d < nDim; d++)
+	{
+		int pos = (nTop < RAND_DIMS) ? nTop++ : RAND_DIMS;
+		while (pos > 0 && adfVar[anTop[pos - 1]] < adfVar[d])
+		{
+			if (pos < RAND_DIMS)
+				anTop[pos] = anTop[pos - 1];
+			pos--;
+		}
+		if (pos < RAND_DIMS)
+			anTop[pos] = d;
+	}
+
+	int nSplitDim = anTop[NextRandom(nTop)];
+	double dfSplitVal = adfMean[nSplitDim];
+
+/* -------------------------------------------------------------------- */
+/*      Partition indexes. If all points are on one side,               */
+/*      split in the middle to guarantee progress.                      */
+/* -------------------------------------------------------------------- */
+	int nLeftCount = 0;
+	for (int i = 0; i < nCount; i++)
+		if (padfData[(size_t)panIdx[i] * nDim + nSplitDim] < dfSplitVal)
+			std::swap(panIdx[i], panIdx[nLeftCount++]);
+
+	if (nLeftCount == 0 || nLeftCount == nCount)
+		nLeftCount = nCount / 2;
+
+	aoNodes[nNode].nSplitDim = nSplitDim;
+	aoNodes[nNode].dfSplitVal = dfSplitVal;
+
+	int nLeft = BuildTree(nStart, nLeftCount);
+	int nRight = BuildTree(nStart + nLeftCount, nCount - nLeftCount);
+
+	aoNodes[nNode].nLeft = nLeft;
+	aoNodes[nNode].nRight = nRight;
+
+	return nNode;
+}
+
+int GDALKDForest::Descend(int nNode, double dfBound, const double *padfQuery,
+		SearchContext *poContext) const
+{
+	while (aoNodes[nNode].nSplitDim >= 0)
+	{
+		const Node &oNode = aoNodes[nNode];
+		double diff = padfQuery[oNode.nSplitDim] - oNode.dfSplitVal;
+
+		int nNear = (diff < 0) ? oNode.nLeft : oNode.nRight;
+		int nFar = (diff < 0) ? oNode.nRight : oNode.nLeft;
+
+		// Memorize far branch with lower bound of distance to it
+		poContext->aoBranches.push_back(
+				pair<double, int>(dfBound + diff * diff, nFar));
+		push_heap(poContext->aoBranches.begin(), poContext->aoBranches.end(),
+				greater< pair<double, int> >());
+
+		nNode = nNear;
+	}
+
+	return nNode;
+}
+
+void GDALKDForest::CheckLeaf(const Node &oLeaf, const double *padfQuery,
+		const bool *pabExcluded, SearchContext *poContext,
+		int *pnChecked, int *pnBest, double *pdfBest, double *pdfBest_2) const
+{
+	for (int i = oLeaf.nLeft; i < oLeaf.nLeft + oLeaf.nRight; i++)
+	{
+		int nIndex = anTreeIndices[i];
+
+		// Point may be already checked in another tree
+		if (poContext->anVisited[nIndex] == poContext->nStamp)
+			continue;
+		poContext->anVisited[nIndex] = poContext->nStamp;
+
+		if (pabExcluded != NULL && pabExcluded[nIndex])
+			continue;
+
+		const double *padfPoint = padfData + (size_t)nIndex * nDim;
+		double dist = 0;
+		for (int d = 0; d < nDim; d++)
+			dist += (padfQuery[d] - padfPoint[d]) * (padfQuery[d] - padfPoint[d]);
+
+		(*pnChecked)++;
+
+		if (*pnBest < 0 || dist < *pdfBest)
+		{
+			*pdfBest_2 = (*pnBest < 0) ? -1 : *pdfBest;
+			*pdfBest = dist;
+			*pnBest = nIndex;
+		}
+		else if (*pdfBest_2 < 0 || dist < *pdfBest_2)
+		{
+			*pdfBest_2 = dist;
+		}
+	}
+}
+
+int GDALKDForest::FindTwoNearest(const double *padfQuery, int nChecks,
+		const bool *pabExcluded, SearchContext *poContext,
+		int *pnBest, double *pdfBestDist, double *pdfBestDist_2) const
+{
+	*pnBest = -1;
+	*pdfBestDist = -1;
+	*pdfBestDist_2 = -1;
+
+	if (anRoots.empty() || poContext == NULL)
+		return 0;
+
+	// Prepare working memory
+	if ((int)poContext->anVisited.size() != nPoints)
+	{
+		poContext->anVisited.assign(nPoints, 0);
+		poContext->nStamp = 0;
+	}
+	if (++poContext->nStamp == 0)
+	{
+		poContext->anVisited.assign(nPoints, 0);
+		poContext->nStamp = 1;
+	}
+	poContext->aoBranches.clear();
+
+	int nChecked = 0;
+
+	// The first leaf of every tree is always checked
+	for (size_t t = 0; t < anRoots.size(); t++)
+	{
+		int nLeaf = Descend(anRoots[t], 0, padfQuery, poContext);
+		CheckLeaf(aoNodes[nLeaf], padfQuery, pabExcluded, poContext,
+				&nChecked, pnBest, pdfBestDist, pdfBestDist_2);
+	}
+
+	// Explore the closest branches of all trees
+	while (nChecked < nChecks && !poContext->aoBranches.empty())
+	{
+		pop_heap(poContext->aoBranches.begin(), poContext->aoBranches.end(),
+				greater< pair<double, int> >());
+		pair<double, int> oBranch = poContext->aoBranches.back();
+		poContext->aoBranches.pop_back();
+
+		// Branch can't contain anything closer than current 2nd nearest
+		if (*pdfBestDist_2 >= 0 && oBranch.first >= *pdfBestDist_2)
+			break;
+
+		int nLeaf = Descend(oBranch.second, oBranch.first, padfQuery, poContext);
+		CheckLeaf(aoNodes[nLeaf], padfQuery, pabExcluded, poContext,
+				&nChecked, pnBest, pdfBestDist, pdfBestDist_2);
+	}
+
+	return nChecked;
+}
+
+GDALKDForest::~GDALKDForest()
+{
+}
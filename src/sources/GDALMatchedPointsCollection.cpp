@@ -4,13 +4,99 @@ GDALMatchedPointsCollection::GDALMatchedPointsCollection()
 {
 	poCollect_1 = new GDALFeaturePointsCollection();
 	poCollect_2 = new GDALFeaturePointsCollection();
+
+	poSource_1 = poCollect_1;
+	poSource_2 = poCollect_2;
 }
 
 void GDALMatchedPointsCollection::AddPoints(
-		GDALFeaturePoint *poFirstPoint, GDALFeaturePoint *poSecondPoint)
+		GDALFeaturePoint *poFirstPoint, GDALFeaturePoint *poSecondPoint,
+		double dfDistance)
 {
+	if (HasExternalSources())
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Points can't be added to collection with external sources");
+		return;
+	}
+
 	poCollect_1->AddPoint(poFirstPoint);
 	poCollect_2->AddPoint(poSecondPoint);
+
+	AddPair(poCollect_1->GetSize() - 1, poCollect_2->GetSize() - 1, dfDistance);
+}
+
+void GDALMatchedPointsCollection::AddPointCopies(
+		const GDALFeaturePoint &oFirstPoint, const GDALFeaturePoint &oSecondPoint,
+		double dfDistance)
+{
+	if (HasExternalSources())
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Points can't be added to collection with external sources");
+		return;
+	}
+
+	// Pairs refer points by indexes, so unpaired point is harmless
+	if (poCollect_1->NewPoint(oFirstPoint) == NULL ||
+			poCollect_2->NewPoint(oSecondPoint) == NULL)
+		return;
+
+	AddPair(poCollect_1->GetSize() - 1, poCollect_2->GetSize() - 1, dfDistance);
+}
+
+CPLErr GDALMatchedPointsCollection::SetSources(
+		GDALFeaturePointsCollection *poFirstSource,
+		GDALFeaturePointsCollection *poSecondSource)
+{
+	if (GetSize() != 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Sources can be set only for empty collection");
+		return CE_Failure;
+	}
+
+	if (poFirstSource == NULL || poSecondSource == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Source collections are not specified");
+		return CE_Failure;
+	}
+
+	poSource_1 = poFirstSource;
+	poSource_2 = poSecondSource;
+
+	return CE_None;
+}
+
+bool GDALMatchedPointsCollection::HasExternalSources() const
+{
+	return poSource_1 != poCollect_1;
+}
+
+GDALFeaturePointsCollection *GDALMatchedPointsCollection::GetFirstSource() const
+{
+	return poSource_1;
+}
+
+GDALFeaturePointsCollection *GDALMatchedPointsCollection::GetSecondSource() const
+{
+	return poSource_2;
+}
+
+void GDALMatchedPointsCollection::AddPair(
+		int nFirstIndex, int nSecondIndex, double dfDistance)
+{
+	anIndex_1.push_back(nFirstIndex);
+	anIndex_2.push_back(nSecondIndex);
+	adfDistance.push_back(dfDistance);
+}
+
+void GDALMatchedPointsCollection::Reserve(int nPairs)
+{
+	anIndex_1.reserve(nPairs);
+	anIndex_2.reserve(nPairs);
+	adfDistance.reserve(nPairs);
 }
 
 void GDALMatchedPointsCollection::GetPoints(
@@ -23,13 +109,77 @@ void GDALMatchedPointsCollection::GetPoints(
 		return;
 
 	// Copy points
-	*poFirstPoint = *(poCollect_1->GetPoint(nIndex));
-	*poSecondPoint = *(poCollect_2->GetPoint(nIndex));
+	*poFirstPoint = *GetFirstPoint(nIndex);
+	*poSecondPoint = *GetSecondPoint(nIndex);
+}
+
+const GDALFeaturePoint *GDALMatchedPointsCollection::GetFirstPoint(
+		int nIndex) const
+{
+	if (nIndex < 0 || nIndex >= GetSize())
+		return NULL;
+
+	return ((const GDALFeaturePointsCollection *)poSource_1)->GetPoint(
+			anIndex_1[nIndex]);
+}
+
+const GDALFeaturePoint *GDALMatchedPointsCollection::GetSecondPoint(
+		int nIndex) const
+{
+	if (nIndex < 0 || nIndex >= GetSize())
+		return NULL;
+
+	return ((const GDALFeaturePointsCollection *)poSource_2)->GetPoint(
+			anIndex_2[nIndex]);
+}
+
+const int *GDALMatchedPointsCollection::GetFirstIndices() const
+{
+	return anIndex_1.empty() ? NULL : &anIndex_1[0];
+}
+
+const int *GDALMatchedPointsCollection::GetSecondIndices() const
+{
+	return anIndex_2.empty() ? NULL : &anIndex_2[0];
+}
+
+const double *GDALMatchedPointsCollection::GetDistances() const
+{
+	return adfDistance.empty() ? NULL : &adfDistance[0];
+}
+
+void GDALMatchedPointsCollection::ExportCoordinates(
+		double *padfFirstX, double *padfFirstY,
+		double *padfSecondX, double *padfSecondY) const
+{
+	for (int i = 0; i < GetSize(); i++)
+	{
+		const GDALFeaturePoint *poFirst = GetFirstPoint(i);
+		const GDALFeaturePoint *poSecond = GetSecondPoint(i);
+
+		if (padfFirstX != NULL) padfFirstX[i] = poFirst->GetX();
+		if (padfFirstY != NULL) padfFirstY[i] = poFirst->GetY();
+		if (padfSecondX != NULL) padfSecondX[i] = poSecond->GetX();
+		if (padfSecondY != NULL) padfSecondY[i] = poSecond->GetY();
+	}
 }
 
 int GDALMatchedPointsCollection::GetSize() const
 {
-	return poCollect_1->GetSize();
+	return anIndex_1.size();
+}
+
+void GDALMatchedPointsCollection::Clear()
+{
+	poCollect_1->Clear();
+	poCollect_2->Clear();
+
+	poSource_1 = poCollect_1;
+	poSource_2 = poCollect_2;
+
+	anIndex_1.clear();
+	anIndex_2.clear();
+	adfDistance.clear();
 }
 
 GDALMatchedPointsCollection::~GDALMatchedPointsCollection()
@@ -0,0 +1,251 @@
+#include "GDALMatchesExporter.h"
+
+#include <string.h>
+
+/**
+ * Names of attribute fields, in order of anFields
+ */
+static const char *apszFieldNames[5] =
+		{"PIXEL", "LINE", "PIXEL_2", "LINE_2", "DISTANCE"};
+
+GDALMatchesExporter::GDALMatchesExporter(OGRLayer *poLayer,
+		const double *padfGeoTransform, int nBatchSize)
+{
+	this->poLayer = poLayer;
+	memcpy(adfGeoTransform, padfGeoTransform, sizeof(adfGeoTransform));
+	this->nBatchSize = MAX(nBatchSize, 1);
+
+	bPrepared = false;
+	bInTransaction = false;
+	nPending = 0;
+	nFeatures = 0;
+
+	for (int i = 0; i < 5; i++)
+		anFields[i] = -1;
+}
+
+GDALMatchesExporter::~GDALMatchesExporter()
+{
+	Flush();
+}
+
+int GDALMatchesExporter::GetFeatureCount() const
+{
+	return nFeatures;
+}
+
+CPLErr GDALMatchesExporter::PrepareFields()
+{
+	if (poLayer == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Layer isn't specified");
+		return CE_Failure;
+	}
+
+	for (int i = 0; i < 5; i++)
+	{
+		OGRFeatureDefn *poDefn = poLayer->GetLayerDefn();
+		anFields[i] = poDefn->GetFieldIndex(apszFieldNames[i]);
+		if (anFields[i] >= 0)
+			continue;
+
+		OGRFieldDefn oField(apszFieldNames[i], i < 4 ? OFTInteger : OFTReal);
+		if (poLayer->CreateField(&oField) != OGRERR_NONE)
+		{
+			CPLError(CE_Failure, CPLE_AppDefined,
+					"Can't create field %s", apszFieldNames[i]);
+			return CE_Failure;
+		}
+
+		anFields[i] = poLayer->GetLayerDefn()->GetFieldIndex(apszFieldNames[i]);
+	}
+
+	bPrepared = true;
+	return CE_None;
+}
+
+CPLErr GDALMatchesExporter::AppendPair(const GDALFeaturePoint *poFirstPoint,
+		const GDALFeaturePoint *poSecondPoint, double dfDistance)
+{
+	return WritePair(poFirstPoint, poSecondPoint, dfDistance, adfGeoTransform);
+}
+
+CPLErr GDALMatchesExporter::WritePair(const GDALFeaturePoint *poFirstPoint,
+		const GDALFeaturePoint *poSecondPoint, double dfDistance,
+		const double *padfGeoTransform)
+{
+	if (!bPrepared && PrepareFields() != CE_None)
+		return CE_Failure;
+
+	// Layers without transactions simply write every feature
+	if (!bInTransaction)
+		bInTransaction = poLayer->StartTransaction() == OGRERR_NONE;
+
+	double dfPixel = poSecondPoint->GetX();
+	double dfLine = poSecondPoint->GetY();
+
+	OGRFeature *poFeature = OGRFeature::CreateFeature(poLayer->GetLayerDefn());
+	poFeature->SetField(anFields[0], poFirstPoint->GetX());
+	poFeature->SetField(anFields[1], poFirstPoint->GetY());
+	poFeature->SetField(anFields[2], poSecondPoint->GetX());
+	poFeature->SetField(anFields[3], poSecondPoint->GetY());
+	poFeature->SetField(anFields[4], dfDistance);
+
+	OGRPoint oPoint(
+			padfGeoTransform[0] + dfPixel * padfGeoTransform[1] +
+			dfLine * padfGeoTransform[2],
+			padfGeoTransform[3] + dfPixel * padfGeoTransform[4] +
+			dfLine * padfGeoTransform[5]);
+	poFeature->SetGeometry(&oPoint);
+
+	OGRErr eErr = poLayer->CreateFeature(poFeature);
+	OGRFeature::DestroyFeature(poFeature);
+
+	if (eErr != OGRERR_NONE)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Can't create feature");
+
+		// Partial batch mustn't be committed later by Flush
+		if (bInTransaction)
+		{
+			poLayer->RollbackTransaction();
+			nFeatures -= nPending;
+			bInTransaction = false;
+			nPending = 0;
+		}
+		return CE_Failure;
+	}
+
+	nFeatures++;
+	if (bInTransaction && ++nPending >= nBatchSize)
+		return Flush();
+
+	return CE_None;
+}
+
+CPLErr GDALMatchesExporter::Append(const GDALMatchedPointsCollection *poMatched)
+{
+	if (poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points collection isn't specified");
+		return CE_Failure;
+	}
+
+	const double *padfDistances = poMatched->GetDistances();
+	for (int i = 0; i < poMatched->GetSize(); i++)
+		if (AppendPair(poMatched->GetFirstPoint(i), poMatched->GetSecondPoint(i),
+				padfDistances[i]) != CE_None)
+			return CE_Failure;
+
+	return CE_None;
+}
+
+CPLErr GDALMatchesExporter::Append(const GDALMatchedPointsCollection *poMatched,
+		int nFirstPair, int nPairs)
+{
+	if (poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points collection isn't specified");
+		return CE_Failure;
+	}
+
+	if (nFirstPair < 0 || nPairs < 0 || nPairs > poMatched->GetSize() - nFirstPair)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Range of pairs is out of collection");
+		return CE_Failure;
+	}
+
+	// Pairs of images matched in batch are georeferenced by their own images
+	const double *padfGeoTransform = adfGeoTransform;
+	double adfSourceGeoTransform[6];
+	GDALFeaturePointsCollection *poSource = poMatched->GetSecondSource();
+	if (poSource != NULL && poSource->GetDataset() != NULL &&
+			poSource->GetDataset()->GetGeoTransform(adfSourceGeoTransform) == CE_None)
+		padfGeoTransform = adfSourceGeoTransform;
+
+	const double *padfDistances = poMatched->GetDistances();
+	for (int i = nFirstPair; i < nFirstPair + nPairs; i++)
+		if (WritePair(poMatched->GetFirstPoint(i), poMatched->GetSecondPoint(i),
+				padfDistances[i], padfGeoTransform) != CE_None)
+			return CE_Failure;
+
+	return CE_None;
+}
+
+CPLErr GDALMatchesExporter::SinkFunc(const GDALMatchedPointsCollection *poMatched,
+		int nFirstPair, int nPairs, void *pExporter)
+{
+	return ((GDALMatchesExporter *)pExporter)->Append(poMatched,
+			nFirstPair, nPairs);
+}
+
+CPLErr GDALMatchesExporter::Flush()
+{
+	if (!bInTransaction)
+		return CE_None;
+
+	bInTransaction = false;
+	nPending = 0;
+
+	if (poLayer->CommitTransaction() != OGRERR_NONE)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Can't commit transaction");
+		return CE_Failure;
+	}
+
+	return CE_None;
+}
+
+CPLErr GDALMatchesExporter::ExportToGCPs(
+		const GDALMatchedPointsCollection *poMatched,
+		GDALDataset *poTarget, GDALDataset *poReference)
+{
+	if (poMatched == NULL || poTarget == NULL || poReference == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Collection or datasets are not specified");
+		return CE_Failure;
+	}
+
+	double adfGeoTransform[6];
+	if (poReference->GetGeoTransform(adfGeoTransform) != CE_None)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Reference dataset doesn't have geotransform");
+		return CE_Failure;
+	}
+
+	int nGCPs = poMatched->GetSize();
+	GDAL_GCP *pasGCPs = (GDAL_GCP *)CPLCalloc(MAX(nGCPs, 1), sizeof(GDAL_GCP));
+	GDALInitGCPs(nGCPs, pasGCPs);
+
+	for (int i = 0; i < nGCPs; i++)
+	{
+		const GDALFeaturePoint *poFirstPoint = poMatched->GetFirstPoint(i);
+		const GDALFeaturePoint *poSecondPoint = poMatched->GetSecondPoint(i);
+
+		double dfPixel = poSecondPoint->GetX();
+		double dfLine = poSecondPoint->GetY();
+
+		CPLFree(pasGCPs[i].pszId);
+		pasGCPs[i].pszId = CPLStrdup(CPLSPrintf("%d", i + 1));
+		pasGCPs[i].dfGCPPixel = poFirstPoint->GetX();
+		pasGCPs[i].dfGCPLine = poFirstPoint->GetY();
+		pasGCPs[i].dfGCPX = adfGeoTransform[0] + dfPixel * adfGeoTransform[1] +
+				dfLine * adfGeoTransform[2];
+		pasGCPs[i].dfGCPY = adfGeoTransform[3] + dfPixel * adfGeoTransform[4] +
+				dfLine * adfGeoTransform[5];
+		pasGCPs[i].dfGCPZ = 0;
+	}
+
+	CPLErr eErr = poTarget->SetGCPs(nGCPs, pasGCPs,
+			poReference->GetProjectionRef());
+
+	GDALDeinitGCPs(nGCPs, pasGCPs);
+	CPLFree(pasGCPs);
+
+	return eErr;
+}
@@ -0,0 +1,193 @@
+#include "GDALMemoryBudget.h"
+
+#include "GDALOctaveLayer.h"
+#include "GDALOctaveMap.h"
+
+#include "cpl_error.h"
+
+#include <algorithm>
+
+GDALMemoryBudget::ExecutionPlan::ExecutionPlan()
+{
+	nTileXSize = 0;
+	nTileYSize = 0;
+	nMargin = 0;
+	bRetainLayers = true;
+	nEstimate = 0;
+	nXSize = 0;
+	nYSize = 0;
+}
+
+bool GDALMemoryBudget::ExecutionPlan::IsTiled() const
+{
+	return nTileXSize < nXSize || nTileYSize < nYSize;
+}
+
+void GDALMemoryBudget::GetReadStrips(int nYSize, int nHeight, int nBlockYSize,
+		int *pnRatio, int *pnStripRows)
+{
+	if (nYSize % nHeight != 0)
+	{
+		*pnRatio = 0;
+		*pnStripRows = nHeight;
+		return;
+	}
+
+	// Strip consists of whole rows of blocks
+	nBlockYSize = std::max(nBlockYSize, 1);
+
+	int nStripLines = MAX((int)PREFETCH_LINES, nBlockYSize);
+	nStripLines = (nStripLines + nBlockYSize - 1) / nBlockYSize * nBlockYSize;
+
+	*pnRatio = nYSize / nHeight;
+	*pnStripRows = std::max(nStripLines / *pnRatio, 1);
+}
+
+GIntBig GDALMemoryBudget::EstimateReading(int nWidth, int nHeight, int nYSize,
+		int nBlockYSize, int nPixelSize, int nReaders)
+{
+	int nRatio, nStripRows;
+	GetReadStrips(nYSize, nHeight, nBlockYSize, &nRatio, &nStripRows);
+
+	int nStrips = (nHeight + nStripRows - 1) / nStripRows;
+
+	// Strips kept at once: read and converted one, or one per thread
+	int nBuffers = (nReaders > 0) ? std::min(nReaders, nStrips) :
+			std::min(2, nStrips);
+
+	// Band buffers of strip and green and blue rows of conversion
+	GIntBig nStrip = (GIntBig)nPixelSize * nWidth * nStripRows +
+			2 * nWidth * sizeof(double);
+
+	return nBuffers * nStrip;
+}
+
+GIntBig GDALMemoryBudget::EstimateWindow(int nXSize, int nYSize,
+		int nOctaveStart, int nOctaveEnd, bool bRetainLayers,
+		GIntBig nReadingMemory)
+{
+	GIntBig nPixels = (GIntBig)nXSize * nYSize;
+
+	// Luminosity and integral images, values and row pointers
+	GIntBig nImage = nPixels * sizeof(double) + nYSize * sizeof(double*);
+
+	// Hessian values and signs of layer
+	GIntBig nLayer = nPixels * (sizeof(double) + sizeof(int)) +
+			nYSize * (sizeof(double*) + sizeof(int*));
+
+	// The first two layers of octave are shared with the previous one
+	int nLayers = GDALOctaveMap::INTERVALS;
+	if (bRetainLayers)
+		nLayers += (GDALOctaveMap::INTERVALS - 2) * (nOctaveEnd - nOctaveStart);
+
+	// Luminosity image is freed after integral one is computed
+	GIntBig nReading = nImage + nReadingMemory;
+	GIntBig nIntegral = 2 * nImage;
+	GIntBig nHessian = nImage + nLayers * nLayer;
+
+	return std::max(std::max(nReading, nIntegral), nHessian);
+}
+
+int GDALMemoryBudget::GetTileMargin(int nOctaveEnd)
+{
+	// Filter of the top layer and descriptor of the largest point,
+	// which spans 10 scales around point and Haar wavelets of 2 scales
+	GDALOctaveLayer oTopLayer(nOctaveEnd, GDALOctaveMap::INTERVALS);
+
+	return oTopLayer.radius + 1 + 12 * oTopLayer.scale;
+}
+
+/**
+ * Estimate peak memory of detection on window of full resolution,
+ * which is read through one handle or through pool.
+ */
+static GIntBig EstimateReadWindow(int nXSize, int nYSize,
+		int nOctaveStart, int nOctaveEnd, bool bRetainLayers,
+		int nBlockYSize, int nPixelSize, int nReaders)
+{
+	return GDALMemoryBudget::EstimateWindow(nXSize, nYSize,
+			nOctaveStart, nOctaveEnd, bRetainLayers,
+			GDALMemoryBudget::EstimateReading(nXSize, nYSize, nYSize,
+			nBlockYSize, nPixelSize, nReaders));
+}
+
+CPLErr GDALMemoryBudget::Plan(int nXSize, int nYSize, int nOctaveStart,
+		int nOctaveEnd, GIntBig nBudget, int nBlockYSize, int nPixelSize,
+		int nReaders, ExecutionPlan *poPlan)
+{
+	if (poPlan == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Plan isn't specified");
+		return CE_Failure;
+	}
+
+	poPlan->nXSize = nXSize;
+	poPlan->nYSize = nYSize;
+	poPlan->nTileXSize = nXSize;
+	poPlan->nTileYSize = nYSize;
+	poPlan->nMargin = 0;
+
+	// The whole image with all layers
+	poPlan->bRetainLayers = true;
+	poPlan->nEstimate = EstimateReadWindow(nXSize, nYSize,
+			nOctaveStart, nOctaveEnd, true,
+			nBlockYSize, nPixelSize, nReaders);
+	if (nBudget <= 0 || poPlan->nEstimate <= nBudget)
+		return CE_None;
+
+	// The whole image octave by octave
+	poPlan->bRetainLayers = false;
+	poPlan->nEstimate = EstimateReadWindow(nXSize, nYSize,
+			nOctaveStart, nOctaveEnd, false,
+			nBlockYSize, nPixelSize, nReaders);
+	if (poPlan->nEstimate <= nBudget)
+		return CE_None;
+
+	// Square tiles, the largest core which fits
+	int nMargin = GetTileMargin(nOctaveEnd);
+	int nLow = MIN_TILE_SIZE;
+	int nHigh = std::max(nXSize, nYSize);
+	int nTileSize = 0;
+
+	while (nLow <= nHigh)
+	{
+		int nCore = nLow + (nHigh - nLow) / 2;
+		GIntBig nEstimate = EstimateReadWindow(
+				std::min(nCore + 2 * nMargin, nXSize),
+				std::min(nCore + 2 * nMargin, nYSize),
+				nOctaveStart, nOctaveEnd, false,
+				nBlockYSize, nPixelSize, nReaders);
+
+		if (nEstimate <= nBudget)
+		{
+			nTileSize = nCore;
+			nLow = nCore + 1;
+		}
+		else
+			nHigh = nCore - 1;
+	}
+
+	if (nTileSize == 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Memory budget " CPL_FRMT_GIB " bytes is too small, "
+				"tile of %d pixels with margin of %d pixels requires "
+				CPL_FRMT_GIB " bytes", nBudget, MIN_TILE_SIZE, nMargin,
+				EstimateReadWindow(std::min(MIN_TILE_SIZE + 2 * nMargin, nXSize),
+						std::min(MIN_TILE_SIZE + 2 * nMargin, nYSize),
+						nOctaveStart, nOctaveEnd, false,
+						nBlockYSize, nPixelSize, nReaders));
+		return CE_Failure;
+	}
+
+	poPlan->nTileXSize = std::min(nTileSize, nXSize);
+	poPlan->nTileYSize = std::min(nTileSize, nYSize);
+	poPlan->nMargin = nMargin;
+	poPlan->nEstimate = EstimateReadWindow(
+			std::min(nTileSize + 2 * nMargin, nXSize),
+			std::min(nTileSize + 2 * nMargin, nYSize),
+			nOctaveStart, nOctaveEnd, false,
+			nBlockYSize, nPixelSize, nReaders);
+
+	return CE_None;
+}
@@ -1,4 +1,11 @@
 #include "GDALOctaveLayer.h"
+#include "GDALCPUDispatch.h"
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 GDALOctaveLayer::GDALOctaveLayer(int nOctave, int nInterval)
 {
@@ -13,6 +20,230 @@ GDALOctaveLayer::GDALOctaveLayer(int nOctave, int nInterval)
 	this->signs = 0;
 }
 
+/**
+ * Number of rectangles of Fast Hessian filters: two for dxx,
+ * two for dyy and four for dxy
+ */
+static const int HESSIAN_BOXES = 8;
+
+/**
+ * Corners of filter rectangles for one row of layer. Rows of corners
+ * are pointers into integral image, columns are relative to the pixel.
+ */
+struct HessianRowBoxes
+{
+	const double *apadfTop[HESSIAN_BOXES];
+	const double *apadfBottom[HESSIAN_BOXES];
+	int anLeft[HESSIAN_BOXES];
+	int anRight[HESSIAN_BOXES];
+	double dfNormalization;
+};
+
+/* -------------------------------------------------------------------- */
+/*      Hessian kernels for pixels, which filters are fully inside      */
+/*      the image. Rectangle sums and filter values are evaluated       */
+/*      in the same order as by GetRectangleSum, so all kernels         */
+/*      give the same result as the range checked computation.          */
+/* -------------------------------------------------------------------- */
+static void HessianKernelScalar(const HessianRowBoxes *poBoxes,
+		int nColStart, int nColEnd, double *padfDet, int *panSign)
+{
+	const double dfWeight = 0.9 * 0.9;
+
+	for (int c = nColStart; c < nColEnd; c++)
+	{
+		double adfSums[HESSIAN_BOXES];
+		for (int k = 0; k < HESSIAN_BOXES; k++)
+		{
+			double a = poBoxes->apadfTop[k][c + poBoxes->anLeft[k]];
+			double b = poBoxes->apadfTop[k][c + poBoxes->anRight[k]];
+			double cc = poBoxes->apadfBottom[k][c + poBoxes->anRight[k]];
+			double d = poBoxes->apadfBottom[k][c + poBoxes->anLeft[k]];
+			double res = a + cc - b - d;
+			adfSums[k] = (res > 0) ? res : 0;
+		}
+
+		double dxx = adfSums[0] - 3 * adfSums[1];
+		double dyy = adfSums[2] - 3 * adfSums[3];
+		double dxy = adfSums[4] + adfSums[5] - adfSums[6] - adfSums[7];
+
+		dxx /= poBoxes->dfNormalization;
+		dyy /= poBoxes->dfNormalization;
+		dxy /= poBoxes->dfNormalization;
+
+		padfDet[c] = dxx * dyy - dfWeight * dxy * dxy;
+		panSign[c] = (dxx + dyy >= 0) ? 1 : -1;
+	}
+}
+
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#if !defined(__SSE2__)
+GDAL_CORRELATOR_TARGET("sse2")
+#endif
+static void HessianKernelSSE2(const HessianRowBoxes *poBoxes,
+		int nColStart, int nColEnd, double *padfDet, int *panSign)
+{
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d three = _mm_set1_pd(3);
+	const __m128d weight = _mm_set1_pd(0.9 * 0.9);
+	const __m128d norm = _mm_set1_pd(poBoxes->dfNormalization);
+
+	int c = nColStart;
+	for ( ; c + 2 <= nColEnd; c += 2)
+	{
+		__m128d sums[HESSIAN_BOXES];
+		for (int k = 0; k < HESSIAN_BOXES; k++)
+		{
+			const double *padfTop = poBoxes->apadfTop[k] + c;
+			const double *padfBottom = poBoxes->apadfBottom[k] + c;
+
+			__m128d res = _mm_sub_pd(_mm_sub_pd(_mm_add_pd(
+					_mm_loadu_pd(padfTop + poBoxes->anLeft[k]),
+					_mm_loadu_pd(padfBottom + poBoxes->anRight[k])),
+					_mm_loadu_pd(padfTop + poBoxes->anRight[k])),
+					_mm_loadu_pd(padfBottom + poBoxes->anLeft[k]));
+			sums[k] = _mm_max_pd(res, zero);
+		}
+
+		__m128d dxx = _mm_sub_pd(sums[0], _mm_mul_pd(three, sums[1]));
+		__m128d dyy = _mm_sub_pd(sums[2], _mm_mul_pd(three, sums[3]));
+		__m128d dxy = _mm_sub_pd(_mm_sub_pd(_mm_add_pd(sums[4], sums[5]),
+				sums[6]), sums[7]);
+
+		dxx = _mm_div_pd(dxx, norm);
+		dyy = _mm_div_pd(dyy, norm);
+		dxy = _mm_div_pd(dxy, norm);
+
+		_mm_storeu_pd(padfDet + c, _mm_sub_pd(_mm_mul_pd(dxx, dyy),
+				_mm_mul_pd(_mm_mul_pd(weight, dxy), dxy)));
+
+		int nMask = _mm_movemask_pd(_mm_cmpge_pd(_mm_add_pd(dxx, dyy), zero));
+		panSign[c] = (nMask & 1) ? 1 : -1;
+		panSign[c + 1] = (nMask & 2) ? 1 : -1;
+	}
+
+	HessianKernelScalar(poBoxes, c, nColEnd, padfDet, panSign);
+}
+#endif
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+GDAL_CORRELATOR_TARGET("avx2")
+static void HessianKernelAVX2(const HessianRowBoxes *poBoxes,
+		int nColStart, int nColEnd, double *padfDet, int *panSign)
+{
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d three = _mm256_set1_pd(3);
+	const __m256d weight = _mm256_set1_pd(0.9 * 0.9);
+	const __m256d norm = _mm256_set1_pd(poBoxes->dfNormalization);
+
+	int c = nColStart;
+	for ( ; c + 4 <= nColEnd; c += 4)
+	{
+		__m256d sums[HESSIAN_BOXES];
+		for (int k = 0; k < HESSIAN_BOXES; k++)
+		{
+			const double *padfTop = poBoxes->apadfTop[k] + c;
+			const double *padfBottom = poBoxes->apadfBottom[k] + c;
+
+			__m256d res = _mm256_sub_pd(_mm256_sub_pd(_mm256_add_pd(
+					_mm256_loadu_pd(padfTop + poBoxes->anLeft[k]),
+					_mm256_loadu_pd(padfBottom + poBoxes->anRight[k])),
+					_mm256_loadu_pd(padfTop + poBoxes->anRight[k])),
+					_mm256_loadu_pd(padfBottom + poBoxes->anLeft[k]));
+			sums[k] = _mm256_max_pd(res, zero);
+		}
+
+		__m256d dxx = _mm256_sub_pd(sums[0], _mm256_mul_pd(three, sums[1]));
+		__m256d dyy = _mm256_sub_pd(sums[2], _mm256_mul_pd(three, sums[3]));
+		__m256d dxy = _mm256_sub_pd(_mm256_sub_pd(
+				_mm256_add_pd(sums[4], sums[5]), sums[6]), sums[7]);
+
+		dxx = _mm256_div_pd(dxx, norm);
+		dyy = _mm256_div_pd(dyy, norm);
+		dxy = _mm256_div_pd(dxy, norm);
+
+		_mm256_storeu_pd(padfDet + c, _mm256_sub_pd(_mm256_mul_pd(dxx, dyy),
+				_mm256_mul_pd(_mm256_mul_pd(weight, dxy), dxy)));
+
+		int nMask = _mm256_movemask_pd(_mm256_cmp_pd(
+				_mm256_add_pd(dxx, dyy), zero, _CMP_GE_OQ));
+		for (int k = 0; k < 4; k++)
+			panSign[c + k] = (nMask & (1 << k)) ? 1 : -1;
+	}
+
+	HessianKernelScalar(poBoxes, c, nColEnd, padfDet, panSign);
+}
+
+GDAL_CORRELATOR_TARGET("avx512f") GDAL_CORRELATOR_NO_CONTRACT
+static void HessianKernelAVX512(const HessianRowBoxes *poBoxes,
+		int nColStart, int nColEnd, double *padfDet, int *panSign)
+{
+	const __m512d zero = _mm512_setzero_pd();
+	const __m512d three = _mm512_set1_pd(3);
+	const __m512d weight = _mm512_set1_pd(0.9 * 0.9);
+	const __m512d norm = _mm512_set1_pd(poBoxes->dfNormalization);
+
+	int c = nColStart;
+	for ( ; c + 8 <= nColEnd; c += 8)
+	{
+		__m512d sums[HESSIAN_BOXES];
+		for (int k = 0; k < HESSIAN_BOXES; k++)
+		{
+			const double *padfTop = poBoxes->apadfTop[k] + c;
+			const double *padfBottom = poBoxes->apadfBottom[k] + c;
+
+			__m512d res = _mm512_sub_pd(_mm512_sub_pd(_mm512_add_pd(
+					_mm512_loadu_pd(padfTop + poBoxes->anLeft[k]),
+					_mm512_loadu_pd(padfBottom + poBoxes->anRight[k])),
+					_mm512_loadu_pd(padfTop + poBoxes->anRight[k])),
+					_mm512_loadu_pd(padfBottom + poBoxes->anLeft[k]));
+			sums[k] = _mm512_max_pd(res, zero);
+		}
+
+		__m512d dxx = _mm512_sub_pd(sums[0], _mm512_mul_pd(three, sums[1]));
+		__m512d dyy = _mm512_sub_pd(sums[2], _mm512_mul_pd(three, sums[3]));
+		__m512d dxy = _mm512_sub_pd(_mm512_sub_pd(
+				_mm512_add_pd(sums[4], sums[5]), sums[6]), sums[7]);
+
+		dxx = _mm512_div_pd(dxx, norm);
+		dyy = _mm512_div_pd(dyy, norm);
+		dxy = _mm512_div_pd(dxy, norm);
+
+		_mm512_storeu_pd(padfDet + c, _mm512_sub_pd(_mm512_mul_pd(dxx, dyy),
+				_mm512_mul_pd(_mm512_mul_pd(weight, dxy), dxy)));
+
+		__mmask8 nMask = _mm512_cmp_pd_mask(
+				_mm512_add_pd(dxx, dyy), zero, _CMP_GE_OQ);
+		for (int k = 0; k < 8; k++)
+			panSign[c + k] = (nMask & (1 << k)) ? 1 : -1;
+	}
+
+	HessianKernelScalar(poBoxes, c, nColEnd, padfDet, panSign);
+}
+#endif
+
+typedef void (*HessianKernelFunc)(const HessianRowBoxes *poBoxes,
+		int nColStart, int nColEnd, double *padfDet, int *panSign);
+
+static HessianKernelFunc GetHessianKernel()
+{
+	switch (GDALCPUDispatch::GetLevel())
+	{
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_AVX512:
+			return HessianKernelAVX512;
+		case GDALCPUDispatch::LEVEL_AVX2:
+			return HessianKernelAVX2;
+#endif
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_SSE2:
+			return HessianKernelSSE2;
+#endif
+		default:
+			return HessianKernelScalar;
+	}
+}
+
 void GDALOctaveLayer::ComputeLayer(GDALIntegralImage *poImg)
 {
 	this->width = poImg->GetWidth();
@@ -39,11 +270,73 @@ void GDALOctaveLayer::ComputeLayer(GDALIntegralImage *poImg)
 
 	int normalization = filterSize * filterSize;
 
+	// Rectangles of filters relative to the pixel: row, column,
+	// width and height, in order of HessianRowBoxes
+	const int anBoxes[HESSIAN_BOXES][4] = {
+		{ -lobe + 1, -radius, filterSize, longPart },
+		{ -lobe + 1, -(lobe - 1) / 2, lobe, longPart },
+		{ -radius, -lobe - 1, longPart, filterSize },
+		{ -lobe + 1, -lobe + 1, longPart, lobe },
+		{ -lobe, -lobe, lobe, lobe },
+		{ 1, 1, lobe, lobe },
+		{ -lobe, 1, lobe, lobe },
+		{ 1, -lobe, lobe, lobe } };
+
+	// Columns, which filters don't cross image borders at
+	int nInnerStart = radius;
+	int nInnerEnd = width - radius + 1;
+	for (int k = 0; k < HESSIAN_BOXES; k++)
+	{
+		nInnerStart = MAX(nInnerStart, 1 - anBoxes[k][1]);
+		nInnerEnd = MIN(nInnerEnd, width - anBoxes[k][1] - anBoxes[k][2] + 1);
+	}
+
+	// Reference level computes all columns by range checked code
+	if (GDALCPUDispatch::GetLevel() == GDALCPUDispatch::LEVEL_REFERENCE)
+		nInnerEnd = nInnerStart;
+
+	HessianRowBoxes oBoxes;
+	oBoxes.dfNormalization = normalization;
+	for (int k = 0; k < HESSIAN_BOXES; k++)
+	{
+		oBoxes.anLeft[k] = anBoxes[k][1] - 1;
+		oBoxes.anRight[k] = anBoxes[k][1] + anBoxes[k][2] - 1;
+	}
+
+	const double *padfIntegral = poImg->GetData();
+	HessianKernelFunc pfnHessianKernel = GetHessianKernel();
+
 	//Loop over image pixels
 	//Filter should remain into image borders
 	for (int r = radius; r <= height - radius; r++)
+	{
+		// Range checked computation is used near borders
+		int nColStart = nInnerStart;
+		int nColEnd = MAX(nInnerStart, nInnerEnd);
+		for (int k = 0; k < HESSIAN_BOXES; k++)
+		{
+			int nTop = r + anBoxes[k][0] - 1;
+			int nBottom = r + anBoxes[k][0] + anBoxes[k][3] - 1;
+			if (nTop < 0 || nBottom >= height)
+				nColStart = nColEnd = width - radius + 1;
+			else
+			{
+				oBoxes.apadfTop[k] = padfIntegral + (size_t)nTop * width;
+				oBoxes.apadfBottom[k] = padfIntegral + (size_t)nBottom * width;
+			}
+		}
+
+		if (nColStart < nColEnd)
+			pfnHessianKernel(&oBoxes, nColStart, nColEnd,
+					detHessians[r], signs[r]);
+
 		for (int c = radius; c <= width - radius; c++)
 		{
+			if (c == nColStart)
+				c = nColEnd;
+			if (c > width - radius)
+				break;
+
 			dxx = poImg->GetRectangleSum(r - lobe + 1, c - radius, filterSize, longPart)
 				- 3 * poImg->GetRectangleSum(r - lobe + 1, c - (lobe - 1) / 2, lobe, longPart);
 			dyy = poImg->GetRectangleSum(r - radius, c - lobe - 1, longPart, filterSize)
@@ -61,9 +354,10 @@ void GDALOctaveLayer::ComputeLayer(GDALIntegralImage *poImg)
 			detHessians[r][c] = dxx * dyy - 0.9 * 0.9 * dxy * dxy;
 			signs[r][c] = (dxx + dyy >= 0) ? 1 : -1;
 		}
+	}
 }
 
-GDALOctaveLayer::~GDALOctaveLayer()
+void GDALOctaveLayer::Release()
 {
 	if (detHessians != NULL && signs != NULL)
 		for (int i = 0; i < height; i++)
@@ -74,5 +368,22 @@ GDALOctaveLayer::~GDALOctaveLayer()
 
 	delete[] detHessians;
 	delete[] signs;
+
+	detHessians = NULL;
+	signs = NULL;
+}
+
+GIntBig GDALOctaveLayer::GetMemoryUsage() const
+{
+	if (detHessians == NULL)
+		return 0;
+
+	return (GIntBig)height * (sizeof(double *) + sizeof(int *) +
+			(GIntBig)width * (sizeof(double) + sizeof(int)));
+}
+
+GDALOctaveLayer::~GDALOctaveLayer()
+{
+	Release();
 }
 
@@ -55,18 +55,23 @@ void GDALOctaveMap::CopyCommonData(GDALOctaveLayer *source, GDALOctaveLayer *des
 void GDALOctaveMap::ComputeMap(GDALIntegralImage *poImg)
 {
     for (int oct = octaveStart; oct <= octaveEnd; oct++)
-        for (int i = 1; i <= INTERVALS; i++)
-        {
-        	if (oct == octaveStart || i > 2)
-        	{
+    	ComputeOctave(poImg, oct);
+}
+
+void GDALOctaveMap::ComputeOctave(GDALIntegralImage *poImg, int oct)
+{
+    for (int i = 1; i <= INTERVALS; i++)
+    {
+    	if (oct == octaveStart || i > 2)
+    	{
 				//pMap[oct - 1][i - 1] = new GDALOctaveLayer(oct, i);
 				pMap[oct - 1][i - 1]->ComputeLayer(poImg);
-        	}
-        	else
-        	{
-        		if (i == 1)
+    	}
+    	else
+    	{
+    		if (i == 1)
 				{
-        			/*
+    			/*
 					pMap[oct - 1][i - 1]->detHessians = pMap[oct - 2][i]->detHessians;
 					pMap[oct - 1][i - 1]->signs = pMap[oct - 2][i]->signs;
 					pMap[oct - 1][i - 1]->width = pMap[oct - 2][i]->width;
@@ -74,18 +79,65 @@ void GDALOctaveMap::ComputeMap(GDALIntegralImage *poImg)
 					*/
 					CopyCommonData(pMap[oct - 2][i], pMap[oct - 1][i - 1]);
 				}
-        		else if (i == 2)
-        		{
-        			/*
+    		else if (i == 2)
+    		{
+    			/*
 					pMap[oct - 1][i - 1]->detHessians = pMap[oct - 2][i + 1]->detHessians;
 					pMap[oct - 1][i - 1]->signs = pMap[oct - 2][i + 1]->signs;
 					pMap[oct - 1][i - 1]->width = pMap[oct - 2][i + 1]->width;
 					pMap[oct - 1][i - 1]->height = pMap[oct - 2][i + 1]->height;
 					*/
 					CopyCommonData(pMap[oct - 2][i + 1], pMap[oct - 1][i - 1]);
-        		}
-        	}
-        }
+    		}
+    	}
+    }
+}
+
+void GDALOctaveMap::ReleaseLayer(GDALOctaveLayer *poLayer)
+{
+	double **padfData = poLayer->detHessians;
+	if (padfData == NULL)
+		return;
+
+	GDALOctaveLayer *poOwner = NULL;
+	for (int oct = octaveStart - 1; oct < octaveEnd; oct++)
+		for (int i = 0; i < INTERVALS; i++)
+			if (pMap[oct][i]->detHessians == padfData)
+			{
+				if (poOwner == NULL)
+					poOwner = pMap[oct][i];
+				else
+				{
+					pMap[oct][i]->detHessians = NULL;
+					pMap[oct][i]->signs = NULL;
+				}
+			}
+
+	poOwner->Release();
+}
+
+void GDALOctaveMap::ReleaseOctave(int nOctave)
+{
+	if (nOctave < octaveStart || nOctave > octaveEnd)
+		return;
+
+	// The second and the fourth layers are the first two of next octave
+	for (int i = 0; i < INTERVALS; i++)
+		if (nOctave == octaveEnd || i == 0 || i == 2)
+			ReleaseLayer(pMap[nOctave - 1][i]);
+}
+
+GIntBig GDALOctaveMap::GetMemoryUsage() const
+{
+	GIntBig nSize = 0;
+
+	// Shared layers are always the first two of octave
+	for (int oct = octaveStart; oct <= octaveEnd; oct++)
+		for (int i = 0; i < INTERVALS; i++)
+			if (oct == octaveStart || i >= 2)
+				nSize += pMap[oct - 1][i]->GetMemoryUsage();
+
+	return nSize;
 }
 
 bool GDALOctaveMap::PointIsExtremum(int row, int col, GDALOctaveLayer *bot,
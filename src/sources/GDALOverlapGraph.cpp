@@ -0,0 +1,130 @@
+#include "GDALOverlapGraph.h"
+
+#include <algorithm>
+#include <utility>
+
+GDALOverlapGraph::GDALOverlapGraph()
+{
+}
+
+GDALOverlapGraph::~GDALOverlapGraph()
+{
+}
+
+int GDALOverlapGraph::GetEdgeCount() const
+{
+	return anFirst.size();
+}
+
+void GDALOverlapGraph::GetEdge(int nEdge, int *pnFirst, int *pnSecond) const
+{
+	*pnFirst = anFirst[nEdge];
+	*pnSecond = anSecond[nEdge];
+}
+
+CPLErr GDALOverlapGraph::ComputeFootprint(GDALDataset *poDataset,
+		double *padfFootprint)
+{
+	double adfGeoTransform[6];
+	if (poDataset == NULL ||
+			poDataset->GetGeoTransform(adfGeoTransform) != CE_None)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Dataset has no geotransform");
+		return CE_Failure;
+	}
+
+	double adfPixel[4] = {0, (double)poDataset->GetRasterXSize(),
+			0, (double)poDataset->GetRasterXSize()};
+	double adfLine[4] = {0, 0, (double)poDataset->GetRasterYSize(),
+			(double)poDataset->GetRasterYSize()};
+
+	for (int i = 0; i < 4; i++)
+	{
+		double dfX = adfGeoTransform[0] + adfPixel[i] * adfGeoTransform[1] +
+				adfLine[i] * adfGeoTransform[2];
+		double dfY = adfGeoTransform[3] + adfPixel[i] * adfGeoTransform[4] +
+				adfLine[i] * adfGeoTransform[5];
+
+		if (i == 0 || dfX < padfFootprint[0]) padfFootprint[0] = dfX;
+		if (i == 0 || dfY < padfFootprint[1]) padfFootprint[1] = dfY;
+		if (i == 0 || dfX > padfFootprint[2]) padfFootprint[2] = dfX;
+		if (i == 0 || dfY > padfFootprint[3]) padfFootprint[3] = dfY;
+	}
+
+	return CE_None;
+}
+
+CPLErr GDALOverlapGraph::Build(GDALDataset **papoDatasets, int nDatasets,
+		double dfMinOverlap)
+{
+	anFirst.clear();
+	anSecond.clear();
+
+	if (papoDatasets == NULL || nDatasets < 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Datasets are not specified");
+		return CE_Failure;
+	}
+
+	vector<double> adfFootprints(nDatasets * 4);
+	for (int i = 0; i < nDatasets; i++)
+		if (ComputeFootprint(papoDatasets[i], &adfFootprints[i * 4]) != CE_None)
+			return CE_Failure;
+
+/* -------------------------------------------------------------------- */
+/*      Sweep over footprints in order of minimal X. Every footprint    */
+/*      is compared only with active ones, which span its minimal X.    */
+/* -------------------------------------------------------------------- */
+	vector< pair<double, int> > aoOrder(nDatasets);
+	for (int i = 0; i < nDatasets; i++)
+		aoOrder[i] = make_pair(adfFootprints[i * 4], i);
+	sort(aoOrder.begin(), aoOrder.end());
+
+	vector<int> anActive;
+	vector< pair<int, int> > aoEdges;
+
+	for (int k = 0; k < nDatasets; k++)
+	{
+		int i = aoOrder[k].second;
+		const double *padfA = &adfFootprints[i * 4];
+
+		// Remove footprints, which end before current one starts
+		size_t nKept = 0;
+		for (size_t a = 0; a < anActive.size(); a++)
+			if (adfFootprints[anActive[a] * 4 + 2] > padfA[0])
+				anActive[nKept++] = anActive[a];
+		anActive.resize(nKept);
+
+		for (size_t a = 0; a < anActive.size(); a++)
+		{
+			int j = anActive[a];
+			const double *padfB = &adfFootprints[j * 4];
+
+			double dfWidth = MIN(padfA[2], padfB[2]) - MAX(padfA[0], padfB[0]);
+			double dfHeight = MIN(padfA[3], padfB[3]) - MAX(padfA[1], padfB[1]);
+			if (dfWidth <= 0 || dfHeight <= 0)
+				continue;
+
+			double dfAreaA = (padfA[2] - padfA[0]) * (padfA[3] - padfA[1]);
+			double dfAreaB = (padfB[2] - padfB[0]) * (padfB[3] - padfB[1]);
+			if (dfWidth * dfHeight < dfMinOverlap * MIN(dfAreaA, dfAreaB))
+				continue;
+
+			aoEdges.push_back(make_pair(MIN(i, j), MAX(i, j)));
+		}
+
+		anActive.push_back(i);
+	}
+
+	sort(aoEdges.begin(), aoEdges.end());
+
+	anFirst.resize(aoEdges.size());
+	anSecond.resize(aoEdges.size());
+	for (size_t e = 0; e < aoEdges.size(); e++)
+	{
+		anFirst[e] = aoEdges[e].first;
+		anSecond[e] = aoEdges[e].second;
+	}
+
+	return CE_None;
+}
@@ -0,0 +1,483 @@
+#include "GDALPQIndex.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <utility>
+
+static bool CompareEntries(const pair<float, int> &oFirst,
+		const pair<float, int> &oSecond)
+{
+	return oFirst.second < oSecond.second;
+}
+
+GDALPQIndex::GDALPQIndex()
+{
+	nLists = 0;
+	nSubspaces = 0;
+	nSubDim = 0;
+	nSeed = 1;
+}
+
+GDALPQIndex::~GDALPQIndex()
+{
+	RemoveSpilledFiles();
+}
+
+void GDALPQIndex::RemoveSpilledFiles()
+{
+	for (int i = 0; i < (int)apoSpilledFiles.size(); i++)
+	{
+		delete apoSpilledFiles[i];
+		VSIUnlink(aosSpilledFilenames[i].c_str());
+	}
+
+	apoSpilledFiles.clear();
+	aosSpilledFilenames.clear();
+}
+
+int GDALPQIndex::NextRandom(int nRange)
+{
+	nSeed = nSeed * 1664525u + 1013904223u;
+	return (int)((nSeed >> 8) % (unsigned int)nRange);
+}
+
+int GDALPQIndex::GetSize() const
+{
+	return anEntryPoint.size();
+}
+
+int GDALPQIndex::GetCodeSize() const
+{
+	return nSubspaces;
+}
+
+int GDALPQIndex::GetScene(int nEntry) const
+{
+	return anSourceScene[anEntrySource[nEntry]];
+}
+
+int GDALPQIndex::GetPointIndex(int nEntry) const
+{
+	return anEntryPoint[nEntry];
+}
+
+void GDALPQIndex::GetDescriptor(int nEntry, double *padfDesc) const
+{
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+	const GDALFeaturePointsFile *poFile = apoSourceFiles[anEntrySource[nEntry]];
+
+	memcpy(padfDesc, poFile->GetDescriptors() +
+			(size_t)anEntryPoint[nEntry] * nDim, nDim * sizeof(double));
+}
+
+void GDALPQIndex::GetPoint(int nEntry, GDALFeaturePoint *poPoint) const
+{
+	if (poPoint == NULL || nEntry < 0 || nEntry >= GetSize())
+		return;
+
+	const GDALFeaturePointsFile *poFile = apoSourceFiles[anEntrySource[nEntry]];
+	int nPoint = anEntryPoint[nEntry];
+
+	poPoint->SetX(poFile->GetX()[nPoint]);
+	poPoint->SetY(poFile->GetY()[nPoint]);
+	poPoint->SetScale(poFile->GetScale()[nPoint]);
+	poPoint->SetRadius(poFile->GetRadius()[nPoint]);
+	poPoint->SetSign(anEntrySign[nEntry]);
+	GetDescriptor(nEntry, poPoint->GetDescriptor());
+}
+
+GIntBig GDALPQIndex::GetMemoryUsage() const
+{
+	GIntBig nSize = (GIntBig)(adfCoarse.capacity() + adfCodebooks.capacity())
+			* sizeof(double);
+
+	for (int l = 0; l < (int)aanListEntries.size(); l++)
+		nSize += (GIntBig)aanListEntries[l].capacity() * sizeof(int) +
+				aabyListCodes[l].capacity();
+
+	nSize += (GIntBig)(anEntrySource.capacity() + anEntryPoint.capacity())
+			* sizeof(int);
+	nSize += anEntrySign.capacity();
+
+	return nSize;
+}
+
+int GDALPQIndex::FindNearestCentroid(const double *padfPoint,
+		const double *padfCentroids, int nClusters, int nDim)
+{
+	int nBest = 0;
+	double dfBest = HUGE_VAL;
+
+	for (int c = 0; c < nClusters; c++)
+	{
+		const double *padfCentroid = padfCentroids + c * nDim;
+		double dfDist = 0;
+		for (int k = 0; k < nDim; k++)
+		{
+			double dfDiff = padfPoint[k] - padfCentroid[k];
+			dfDist += dfDiff * dfDiff;
+		}
+
+		if (dfDist < dfBest)
+		{
+			dfBest = dfDist;
+			nBest = c;
+		}
+	}
+
+	return nBest;
+}
+
+void GDALPQIndex::KMeans(const double *padfData, int nPoints, int nDim,
+		int nClusters, double *padfCentroids)
+{
+	// Initial centroids are points of random permutation.
+	// If points are fewer than clusters, some centroids are repeated
+	vector<int> anOrder(nPoints);
+	for (int i = 0; i < nPoints; i++)
+		anOrder[i] = i;
+	for (int i = nPoints - 1; i > 0; i--)
+		swap(anOrder[i], anOrder[NextRandom(i + 1)]);
+
+	for (int c = 0; c < nClusters; c++)
+		memcpy(padfCentroids + c * nDim, padfData + anOrder[c % nPoints] * nDim,
+				nDim * sizeof(double));
+
+	vector<int> anAssigned(nPoints);
+	vector<double> adfSums(nClusters * nDim);
+	vector<int> anCounts(nClusters);
+
+	for (int nIter = 0; nIter < TRAIN_ITERATIONS; nIter++)
+	{
+		for (int i = 0; i < nPoints; i++)
+			anAssigned[i] = FindNearestCentroid(padfData + i * nDim,
+					padfCentroids, nClusters, nDim);
+
+		fill(adfSums.begin(), adfSums.end(), 0.0);
+		fill(anCounts.begin(), anCounts.end(), 0);
+
+		for (int i = 0; i < nPoints; i++)
+		{
+			double *padfSum = &adfSums[anAssigned[i] * nDim];
+			for (int k = 0; k < nDim; k++)
+				padfSum[k] += padfData[i * nDim + k];
+			anCounts[anAssigned[i]]++;
+		}
+
+		// Empty clusters keep previous centroids
+		for (int c = 0; c < nClusters; c++)
+			if (anCounts[c] > 0)
+				for (int k = 0; k < nDim; k++)
+					padfCentroids[c * nDim + k] = adfSums[c * nDim + k] / anCounts[c];
+	}
+}
+
+CPLErr GDALPQIndex::Train(GDALFeaturePointsCollection *poCollection,
+		int nLists, int nSubspaces)
+{
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+
+/* -------------------------------------------------------------------- */
+/*      Validate parameters.                                            */
+/* -------------------------------------------------------------------- */
+	if (poCollection == NULL || poCollection->GetSize() == 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Training collection is empty");
+		return CE_Failure;
+	}
+
+	if (nLists <= 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Number of lists should be positive");
+		return CE_Failure;
+	}
+
+	if (nSubspaces <= 0 || nSubspaces > nDim || nDim % nSubspaces != 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Number of subspaces should divide descriptor size %d", nDim);
+		return CE_Failure;
+	}
+
+	this->nLists = nLists;
+	this->nSubspaces = nSubspaces;
+	nSubDim = nDim / nSubspaces;
+	nSeed = 1;
+
+	aanListEntries.assign(nLists, vector<int>());
+	aabyListCodes.assign(nLists, vector<GByte>());
+	anEntrySource.clear();
+	anEntryPoint.clear();
+	anEntrySign.clear();
+	anSourceScene.clear();
+	apoSourceFiles.clear();
+	RemoveSpilledFiles();
+
+/* -------------------------------------------------------------------- */
+/*      Sample training points.                                         */
+/* -------------------------------------------------------------------- */
+	int nSize = poCollection->GetSize();
+	int nTrain = min(nSize, (int)MAX_TRAIN_POINTS);
+
+	vector<double> adfTrain(nTrain * nDim);
+	for (int i = 0; i < nTrain; i++)
+	{
+		// Evenly spaced points of collection
+		int nPoint = (int)((double)i * nSize / nTrain);
+		memcpy(&adfTrain[i * nDim],
+				poCollection->GetPoint(nPoint)->GetDescriptor(),
+				nDim * sizeof(double));
+	}
+
+/* -------------------------------------------------------------------- */
+/*      Coarse quantizer.                                               */
+/* -------------------------------------------------------------------- */
+	adfCoarse.resize(nLists * nDim);
+	KMeans(&adfTrain[0], nTrain, nDim, nLists, &adfCoarse[0]);
+
+	// Residuals to the nearest coarse centroids
+	for (int i = 0; i < nTrain; i++)
+	{
+		double *padfPoint = &adfTrain[i * nDim];
+		int nList = FindNearestCentroid(padfPoint, &adfCoarse[0], nLists, nDim);
+		for (int k = 0; k < nDim; k++)
+			padfPoint[k] -= adfCoarse[nList * nDim + k];
+	}
+
+/* -------------------------------------------------------------------- */
+/*      Codebook of every subspace.                                     */
+/* -------------------------------------------------------------------- */
+	adfCodebooks.resize(nSubspaces * CODEBOOK_SIZE * nSubDim);
+	vector<double> adfSub(nTrain * nSubDim);
+
+	for (int m = 0; m < nSubspaces; m++)
+	{
+		for (int i = 0; i < nTrain; i++)
+			memcpy(&adfSub[i * nSubDim], &adfTrain[i * nDim + m * nSubDim],
+					nSubDim * sizeof(double));
+
+		KMeans(&adfSub[0], nTrain, nSubDim, CODEBOOK_SIZE,
+				&adfCodebooks[m * CODEBOOK_SIZE * nSubDim]);
+	}
+
+	return CE_None;
+}
+
+void GDALPQIndex::AddEntry(const double *padfDesc, int nPoint, int nSign)
+{
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+	double adfResidual[GDALFeaturePoint::DESC_SIZE];
+
+	int nList = FindNearestCentroid(padfDesc, &adfCoarse[0], nLists, nDim);
+	for (int k = 0; k < nDim; k++)
+		adfResidual[k] = padfDesc[k] - adfCoarse[nList * nDim + k];
+
+	int nEntry = anEntryPoint.size();
+	anEntrySource.push_back(anSourceScene.size() - 1);
+	anEntryPoint.push_back(nPoint);
+	anEntrySign.push_back((signed char)nSign);
+
+	aanListEntries[nList].push_back(nEntry);
+	for (int m = 0; m < nSubspaces; m++)
+		aabyListCodes[nList].push_back((GByte)FindNearestCentroid(
+				adfResidual + m * nSubDim,
+				&adfCodebooks[m * CODEBOOK_SIZE * nSubDim],
+				CODEBOOK_SIZE, nSubDim));
+}
+
+CPLErr GDALPQIndex::Add(GDALFeaturePointsCollection *poCollection, int nScene)
+{
+	if (nSubspaces == 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Index isn't trained");
+		return CE_Failure;
+	}
+
+	if (poCollection == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature point collection isn't specified");
+		return CE_Failure;
+	}
+
+/* -------------------------------------------------------------------- */
+/*      Spill points to temporary file, so only codes stay in memory    */
+/*      and candidates are re-ranked by exact descriptors.              */
+/* -------------------------------------------------------------------- */
+	string osFilename = CPLGenerateTempFilename("pqindex");
+	GDALFeaturePointsFile *poFile = new GDALFeaturePointsFile();
+
+	if (GDALFeaturePointsFile::Write(osFilename.c_str(), poCollection) != CE_None ||
+			poFile->Open(osFilename.c_str()) != CE_None)
+	{
+		delete poFile;
+		VSIUnlink(osFilename.c_str());
+		return CE_Failure;
+	}
+
+	apoSpilledFiles.push_back(poFile);
+	aosSpilledFilenames.push_back(osFilename);
+
+	return Add(poFile, nScene);
+}
+
+CPLErr GDALPQIndex::Add(const GDALFeaturePointsFile *poFile, int nScene)
+{
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+
+	if (nSubspaces == 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Index isn't trained");
+		return CE_Failure;
+	}
+
+	if (poFile == NULL || poFile->GetDescriptors() == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature points file isn't opened");
+		return CE_Failure;
+	}
+
+	anSourceScene.push_back((nScene >= 0) ? nScene : (int)anSourceScene.size());
+	apoSourceFiles.push_back(poFile);
+
+	const GInt32 *panSign = poFile->GetSign();
+	const double *padfDescriptors = poFile->GetDescriptors();
+
+	for (int i = 0; i < poFile->GetSize(); i++)
+		AddEntry(padfDescriptors + (size_t)i * nDim, i, panSign[i]);
+
+	return CE_None;
+}
+
+void GDALPQIndex::FindTwoNearest(const double *padfQuery, int nSign,
+		int nProbe, int nRerank, const bool *pabExcluded,
+		int *pnBest, double *pdfBestDist, double *pdfBestDist_2) const
+{
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+
+	*pnBest = -1;
+	*pdfBestDist = -1;
+	*pdfBestDist_2 = -1;
+
+	if (nSubspaces == 0 || anEntryPoint.empty())
+		return;
+
+	nProbe = max(1, min(nProbe, nLists));
+	nRerank = max(2, nRerank);
+
+/* -------------------------------------------------------------------- */
+/*      Select the nearest lists.                                       */
+/* -------------------------------------------------------------------- */
+	vector< pair<double, int> > aoLists(nLists);
+	for (int l = 0; l < nLists; l++)
+	{
+		const double *padfCentroid = &adfCoarse[l * nDim];
+		double dfDist = 0;
+		for (int k = 0; k < nDim; k++)
+		{
+			double dfDiff = padfQuery[k] - padfCentroid[k];
+			dfDist += dfDiff * dfDiff;
+		}
+		aoLists[l] = make_pair(dfDist, l);
+	}
+	partial_sort(aoLists.begin(), aoLists.begin() + nProbe, aoLists.end());
+
+/* -------------------------------------------------------------------- */
+/*      Scan lists with asymmetric distance. Heap keeps candidates      */
+/*      with the smallest approximate distances, the worst on top.      */
+/* -------------------------------------------------------------------- */
+	vector< pair<float, int> > aoCandidates;
+	vector<float> afTable(nSubspaces * CODEBOOK_SIZE);
+	double adfResidual[GDALFeaturePoint::DESC_SIZE];
+
+	for (int p = 0; p < nProbe; p++)
+	{
+		int nList = aoLists[p].second;
+		const vector<int> &anEntries = aanListEntries[nList];
+		if (anEntries.empty())
+			continue;
+
+		for (int k = 0; k < nDim; k++)
+			adfResidual[k] = padfQuery[k] - adfCoarse[nList * nDim + k];
+
+		// Distances from parts of residual to all centroids of codebooks
+		for (int m = 0; m < nSubspaces; m++)
+		{
+			const double *padfPart = adfResidual + m * nSubDim;
+			for (int c = 0; c < CODEBOOK_SIZE; c++)
+			{
+				const double *padfCentroid =
+						&adfCodebooks[(m * CODEBOOK_SIZE + c) * nSubDim];
+				double dfDist = 0;
+				for (int k = 0; k < nSubDim; k++)
+				{
+					double dfDiff = padfPart[k] - padfCentroid[k];
+					dfDist += dfDiff * dfDiff;
+				}
+				afTable[m * CODEBOOK_SIZE + c] = (float)dfDist;
+			}
+		}
+
+		const GByte *pabyCode = &aabyListCodes[nList][0];
+		for (size_t e = 0; e < anEntries.size(); e++, pabyCode += nSubspaces)
+		{
+			int nEntry = anEntries[e];
+			if (anEntrySign[nEntry] != nSign ||
+					(pabExcluded != NULL && pabExcluded[nEntry]))
+				continue;
+
+			float fDist = 0;
+			for (int m = 0; m < nSubspaces; m++)
+				fDist += afTable[m * CODEBOOK_SIZE + pabyCode[m]];
+
+			if ((int)aoCandidates.size() < nRerank)
+			{
+				aoCandidates.push_back(make_pair(fDist, nEntry));
+				push_heap(aoCandidates.begin(), aoCandidates.end());
+			}
+			else if (fDist < aoCandidates.front().first)
+			{
+				pop_heap(aoCandidates.begin(), aoCandidates.end());
+				aoCandidates.back() = make_pair(fDist, nEntry);
+				push_heap(aoCandidates.begin(), aoCandidates.end());
+			}
+		}
+	}
+
+/* -------------------------------------------------------------------- */
+/*      Re-rank candidates by exact distance.                           */
+/* -------------------------------------------------------------------- */
+	// Candidates are processed in order of entries, so
+	// ties are resolved in the same way for any heap layout
+	sort(aoCandidates.begin(), aoCandidates.end(), CompareEntries);
+
+	for (size_t c = 0; c < aoCandidates.size(); c++)
+	{
+		int nEntry = aoCandidates[c].second;
+		double adfDesc[GDALFeaturePoint::DESC_SIZE];
+		GetDescriptor(nEntry, adfDesc);
+
+		double dfDist = 0;
+		for (int k = 0; k < nDim; k++)
+		{
+			double dfDiff = padfQuery[k] - adfDesc[k];
+			dfDist += dfDiff * dfDiff;
+		}
+
+		if (*pnBest < 0 || dfDist < *pdfBestDist)
+		{
+			*pdfBestDist_2 = *pdfBestDist;
+			*pdfBestDist = dfDist;
+			*pnBest = nEntry;
+		}
+		else if (*pdfBestDist_2 < 0 || dfDist < *pdfBestDist_2)
+		{
+			*pdfBestDist_2 = dfDist;
+		}
+	}
+}
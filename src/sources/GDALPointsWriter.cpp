@@ -0,0 +1,202 @@
+#include "GDALPointsWriter.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+CPLErr GDALPointsWriter::ParseFormat(const char *pszName, Format *peFormat)
+{
+	if (pszName != NULL && EQUAL(pszName, "text"))
+		*peFormat = FORMAT_TEXT;
+	else if (pszName != NULL && EQUAL(pszName, "binary"))
+		*peFormat = FORMAT_BINARY;
+	else
+	{
+		CPLError(CE_Failure, CPLE_IllegalArg, "Unknown output format: %s",
+				pszName != NULL ? pszName : "(null)");
+		return CE_Failure;
+	}
+
+	return CE_None;
+}
+
+int GDALPointsWriter::GetPairField(
+		const GDALMatchedPointsCollection *poMatched, int nIndex, int nField)
+{
+	switch (nField)
+	{
+		case 0: return poMatched->GetFirstIndices()[nIndex];
+		case 1: return poMatched->GetSecondIndices()[nIndex];
+		case 2: return poMatched->GetFirstPoint(nIndex)->GetX();
+		case 3: return poMatched->GetFirstPoint(nIndex)->GetY();
+		case 4: return poMatched->GetSecondPoint(nIndex)->GetX();
+		default: return poMatched->GetSecondPoint(nIndex)->GetY();
+	}
+}
+
+CPLErr GDALPointsWriter::WriteHeader(VSILFILE *fp, const char *pszSignature,
+		int nRecords, int nArrays)
+{
+	GByte abyHeader[16];
+	memcpy(abyHeader, pszSignature, 4);
+
+	GInt32 anValues[3] = {BINARY_VERSION, nRecords, nArrays};
+	for (int i = 0; i < 3; i++)
+		CPL_LSBPTR32(&anValues[i]);
+	memcpy(abyHeader + 4, anValues, sizeof(anValues));
+
+	if (VSIFWriteL(abyHeader, sizeof(abyHeader), 1, fp) != 1)
+		return CE_Failure;
+
+	return CE_None;
+}
+
+CPLErr GDALPointsWriter::WriteIntArray(VSILFILE *fp,
+		const GDALMatchedPointsCollection *poMatched, int nField)
+{
+	int nRecords = poMatched->GetSize();
+	vector<GInt32> anBuffer(MIN(nRecords, (int)BUFFER_SIZE));
+
+	for (int nStart = 0; nStart < nRecords; nStart += BUFFER_SIZE)
+	{
+		int nCount = MIN(nRecords - nStart, (int)BUFFER_SIZE);
+		for (int i = 0; i < nCount; i++)
+		{
+			anBuffer[i] = GetPairField(poMatched, nStart + i, nField);
+			CPL_LSBPTR32(&anBuffer[i]);
+		}
+
+		if (VSIFWriteL(&anBuffer[0], sizeof(GInt32), nCount, fp) != (size_t)nCount)
+			return CE_Failure;
+	}
+
+	return CE_None;
+}
+
+CPLErr GDALPointsWriter::WritePoints(const GDALFeaturePointsCollection *poCollection,
+		const char *pszFilename, Format eFormat)
+{
+	if (poCollection == NULL || pszFilename == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Collection or file name isn't specified");
+		return CE_Failure;
+	}
+
+	if (eFormat == FORMAT_BINARY)
+		return GDALFeaturePointsFile::Write(pszFilename, poCollection);
+
+	VSILFILE *fp = VSIFOpenL(pszFilename, "wb");
+	if (fp == NULL)
+	{
+		CPLError(CE_Failure, CPLE_OpenFailed, "Can't create file %s", pszFilename);
+		return CE_Failure;
+	}
+
+	int nSize = poCollection->GetSize();
+	CPLErr eErr = CE_None;
+
+	// Line is much shorter than reserve at the end of buffer
+	vector<char> achBuffer(BUFFER_SIZE + 64);
+	int nUsed = 0;
+
+	for (int i = 0; i < nSize && eErr == CE_None; i++)
+	{
+		const GDALFeaturePoint *poPoint = poCollection->GetPoint(i);
+		nUsed += snprintf(&achBuffer[nUsed], achBuffer.size() - nUsed,
+				"%d %d\n", poPoint->GetX(), poPoint->GetY());
+
+		if (nUsed >= BUFFER_SIZE || i == nSize - 1)
+		{
+			if (VSIFWriteL(&achBuffer[0], 1, nUsed, fp) != (size_t)nUsed)
+				eErr = CE_Failure;
+			nUsed = 0;
+		}
+	}
+
+	if (VSIFCloseL(fp) != 0)
+		eErr = CE_Failure;
+
+	if (eErr != CE_None)
+		CPLError(CE_Failure, CPLE_FileIO, "Can't write to file %s", pszFilename);
+
+	return eErr;
+}
+
+CPLErr GDALPointsWriter::WriteMatchedPoints(const GDALMatchedPointsCollection *poMatched,
+		const char *pszFilename, Format eFormat)
+{
+	if (poMatched == NULL || pszFilename == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Collection or file name isn't specified");
+		return CE_Failure;
+	}
+
+	VSILFILE *fp = VSIFOpenL(pszFilename, "wb");
+	if (fp == NULL)
+	{
+		CPLError(CE_Failure, CPLE_OpenFailed, "Can't create file %s", pszFilename);
+		return CE_Failure;
+	}
+
+	int nSize = poMatched->GetSize();
+	CPLErr eErr = CE_None;
+
+	if (eFormat == FORMAT_BINARY)
+	{
+		const int nIntArrays = 6;
+		eErr = WriteHeader(fp, "GCMP", nSize, nIntArrays + 1);
+		for (int nField = 0; nField < nIntArrays && eErr == CE_None; nField++)
+			eErr = WriteIntArray(fp, poMatched, nField);
+
+		const double *padfDistances = poMatched->GetDistances();
+		vector<double> adfBuffer(MIN(nSize, (int)BUFFER_SIZE));
+		for (int nStart = 0; nStart < nSize && eErr == CE_None;
+				nStart += BUFFER_SIZE)
+		{
+			int nCount = MIN(nSize - nStart, (int)BUFFER_SIZE);
+			for (int i = 0; i < nCount; i++)
+			{
+				adfBuffer[i] = padfDistances[nStart + i];
+				CPL_LSBPTR64(&adfBuffer[i]);
+			}
+
+			if (VSIFWriteL(&adfBuffer[0], sizeof(double), nCount, fp) !=
+					(size_t)nCount)
+				eErr = CE_Failure;
+		}
+	}
+	else
+	{
+		// Line is much shorter than reserve at the end of buffer
+		vector<char> achBuffer(BUFFER_SIZE + 64);
+		int nUsed = 0;
+
+		for (int i = 0; i < nSize && eErr == CE_None; i++)
+		{
+			const GDALFeaturePoint *poPoint_1 = poMatched->GetFirstPoint(i);
+			const GDALFeaturePoint *poPoint_2 = poMatched->GetSecondPoint(i);
+			nUsed += snprintf(&achBuffer[nUsed], achBuffer.size() - nUsed,
+					"%d %d %d %d\n", poPoint_1->GetX(), poPoint_1->GetY(),
+					poPoint_2->GetX(), poPoint_2->GetY());
+
+			if (nUsed >= BUFFER_SIZE || i == nSize - 1)
+			{
+				if (VSIFWriteL(&achBuffer[0], 1, nUsed, fp) != (size_t)nUsed)
+					eErr = CE_Failure;
+				nUsed = 0;
+			}
+		}
+	}
+
+	if (VSIFCloseL(fp) != 0)
+		eErr = CE_Failure;
+
+	if (eErr != CE_None)
+		CPLError(CE_Failure, CPLE_FileIO, "Can't write to file %s", pszFilename);
+
+	return eErr;
+}
@@ -0,0 +1,559 @@
+#include "GDALRansacVerifier.h"
+#include "GDALThreadPool.h"
+#include "GDALCPUDispatch.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+bool GDALRansacVerifier::SolveLinear(double *padfA, double *padfB, int nSize)
+{
+	for (int k = 0; k < nSize; k++)
+	{
+		// Row with the largest pivot
+		int nPivot = k;
+		for (int i = k + 1; i < nSize; i++)
+			if (fabs(padfA[i * nSize + k]) > fabs(padfA[nPivot * nSize + k]))
+				nPivot = i;
+
+		if (fabs(padfA[nPivot * nSize + k]) < 1e-12)
+			return false;
+
+		if (nPivot != k)
+		{
+			for (int j = 0; j < nSize; j++)
+			{
+				double dfTmp = padfA[k * nSize + j];
+				padfA[k * nSize + j] = padfA[nPivot * nSize + j];
+				padfA[nPivot * nSize + j] = dfTmp;
+			}
+			double dfTmp = padfB[k];
+			padfB[k] = padfB[nPivot];
+			padfB[nPivot] = dfTmp;
+		}
+
+		for (int i = k + 1; i < nSize; i++)
+		{
+			double dfFactor = padfA[i * nSize + k] / padfA[k * nSize + k];
+			for (int j = k; j < nSize; j++)
+				padfA[i * nSize + j] -= dfFactor * padfA[k * nSize + j];
+			padfB[i] -= dfFactor * padfB[k];
+		}
+	}
+
+	// Back substitution, solution replaces right side
+	for (int k = nSize - 1; k >= 0; k--)
+	{
+		for (int j = k + 1; j < nSize; j++)
+			padfB[k] -= padfA[k * nSize + j] * padfB[j];
+		padfB[k] /= padfA[k * nSize + k];
+	}
+
+	return true;
+}
+
+bool GDALRansacVerifier::FitModel(const Problem *poProblem,
+		const int *panIndices, int nCount, double *padfModel)
+{
+/* -------------------------------------------------------------------- */
+/*      Normalize both point sets: centroid to origin, mean distance    */
+/*      from origin to sqrt(2). It keeps equations well conditioned.    */
+/* -------------------------------------------------------------------- */
+	double adfCenter[4] = {0, 0, 0, 0};
+	for (int k = 0; k < nCount; k++)
+	{
+		int i = panIndices[k];
+		adfCenter[0] += poProblem->adfX_1[i];
+		adfCenter[1] += poProblem->adfY_1[i];
+		adfCenter[2] += poProblem->adfX_2[i];
+		adfCenter[3] += poProblem->adfY_2[i];
+	}
+	for (int c = 0; c < 4; c++)
+		adfCenter[c] /= nCount;
+
+	double dfScale_1 = 0;
+	double dfScale_2 = 0;
+	for (int k = 0; k < nCount; k++)
+	{
+		int i = panIndices[k];
+		dfScale_1 += sqrt(
+				(poProblem->adfX_1[i] - adfCenter[0]) * (poProblem->adfX_1[i] - adfCenter[0]) +
+				(poProblem->adfY_1[i] - adfCenter[1]) * (poProblem->adfY_1[i] - adfCenter[1]));
+		dfScale_2 += sqrt(
+				(poProblem->adfX_2[i] - adfCenter[2]) * (poProblem->adfX_2[i] - adfCenter[2]) +
+				(poProblem->adfY_2[i] - adfCenter[3]) * (poProblem->adfY_2[i] - adfCenter[3]));
+	}
+	if (dfScale_1 <= 0 || dfScale_2 <= 0)
+		return false;
+
+	dfScale_1 = sqrt(2.0) * nCount / dfScale_1;
+	dfScale_2 = sqrt(2.0) * nCount / dfScale_2;
+
+/* -------------------------------------------------------------------- */
+/*      Least squares in normalized coordinates.                        */
+/* -------------------------------------------------------------------- */
+	double adfNorm[9];
+	bool bAffine = poProblem->eModel == MODEL_AFFINE;
+	int nUnknowns = bAffine ? 6 : 8;
+	double adfA[64];
+	double adfB[8];
+	memset(adfA, 0, sizeof(adfA));
+	memset(adfB, 0, sizeof(adfB));
+
+	for (int k = 0; k < nCount; k++)
+	{
+		int i = panIndices[k];
+		double x = (poProblem->adfX_1[i] - adfCenter[0]) * dfScale_1;
+		double y = (poProblem->adfY_1[i] - adfCenter[1]) * dfScale_1;
+		double u = (poProblem->adfX_2[i] - adfCenter[2]) * dfScale_2;
+		double v = (poProblem->adfY_2[i] - adfCenter[3]) * dfScale_2;
+
+		// Two equations per pair:
+		// h0 x + h1 y + h2 - h6 x u - h7 y u = u
+		// h3 x + h4 y + h5 - h6 x v - h7 y v = v
+		double adfRow_u[8] = {x, y, 1, 0, 0, 0, -x * u, -y * u};
+		double adfRow_v[8] = {0, 0, 0, x, y, 1, -x * v, -y * v};
+
+		// Normal equations
+		for (int r = 0; r < nUnknowns; r++)
+		{
+			for (int c = 0; c < nUnknowns; c++)
+				adfA[r * nUnknowns + c] +=
+						adfRow_u[r] * adfRow_u[c] + adfRow_v[r] * adfRow_v[c];
+			adfB[r] += adfRow_u[r] * u + adfRow_v[r] * v;
+		}
+	}
+
+	if (!SolveLinear(adfA, adfB, nUnknowns))
+		return false;
+
+	for (int j = 0; j < 6; j++)
+		adfNorm[j] = adfB[j];
+	adfNorm[6] = bAffine ? 0 : adfB[6];
+	adfNorm[7] = bAffine ? 0 : adfB[7];
+	adfNorm[8] = 1;
+
+/* -------------------------------------------------------------------- */
+/*      Denormalize: M = T2^-1 * N * T1.                                */
+/* -------------------------------------------------------------------- */
+	double adfT_1[9] = {dfScale_1, 0, -dfScale_1 * adfCenter[0],
+			0, dfScale_1, -dfScale_1 * adfCenter[1], 0, 0, 1};
+	double adfInvT_2[9] = {1 / dfScale_2, 0, adfCenter[2],
+			0, 1 / dfScale_2, adfCenter[3], 0, 0, 1};
+
+	double adfTmp[9];
+	for (int r = 0; r < 3; r++)
+		for (int c = 0; c < 3; c++)
+			adfTmp[r * 3 + c] = adfNorm[r * 3] * adfT_1[c] +
+					adfNorm[r * 3 + 1] * adfT_1[3 + c] +
+					adfNorm[r * 3 + 2] * adfT_1[6 + c];
+
+	for (int r = 0; r < 3; r++)
+		for (int c = 0; c < 3; c++)
+			padfModel[r * 3 + c] = adfInvT_2[r * 3] * adfTmp[c] +
+					adfInvT_2[r * 3 + 1] * adfTmp[3 + c] +
+					adfInvT_2[r * 3 + 2] * adfTmp[6 + c];
+
+	if (padfModel[8] == 0)
+		return false;
+
+	for (int j = 0; j < 9; j++)
+		padfModel[j] /= padfModel[8];
+
+	return true;
+}
+
+/* -------------------------------------------------------------------- */
+/*      Inlier kernels. Pair is inlier if                               */
+/*      (px - u w)^2 + (py - v w)^2 <= e^2 w^2 and w > 0, which is      */
+/*      the same as distance check without division. All kernels        */
+/*      evaluate it with the same operations, so they give the same     */
+/*      result.                                                         */
+/* -------------------------------------------------------------------- */
+typedef int (*InlierKernelFunc)(const double *m, double dfMaxErrorSquared,
+		const double *padfX_1, const double *padfY_1,
+		const double *padfX_2, const double *padfY_2,
+		int nStart, int nEnd, bool *pabInlier);
+
+static int InlierKernelScalar(const double *m, double dfMaxErrorSquared,
+		const double *padfX_1, const double *padfY_1,
+		const double *padfX_2, const double *padfY_2,
+		int nStart, int nEnd, bool *pabInlier)
+{
+	int nScore = 0;
+
+	for (int i = nStart; i < nEnd; i++)
+	{
+		double x = padfX_1[i];
+		double y = padfY_1[i];
+		double w = m[6] * x + m[7] * y + m[8];
+		double dx = m[0] * x + m[1] * y + m[2] - padfX_2[i] * w;
+		double dy = m[3] * x + m[4] * y + m[5] - padfY_2[i] * w;
+
+		bool bInlier = w > 0 &&
+				dx * dx + dy * dy <= dfMaxErrorSquared * (w * w);
+		if (bInlier)
+			nScore++;
+
+		if (pabInlier != NULL)
+			pabInlier[i] = bInlier;
+	}
+
+	return nScore;
+}
+
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#if !defined(__SSE2__)
+GDAL_CORRELATOR_TARGET("sse2")
+#endif
+static int InlierKernelSSE2(const double *m, double dfMaxErrorSquared,
+		const double *padfX_1, const double *padfY_1,
+		const double *padfX_2, const double *padfY_2,
+		int nStart, int nEnd, bool *pabInlier)
+{
+	const __m128d m0 = _mm_set1_pd(m[0]), m1 = _mm_set1_pd(m[1]);
+	const __m128d m2 = _mm_set1_pd(m[2]), m3 = _mm_set1_pd(m[3]);
+	const __m128d m4 = _mm_set1_pd(m[4]), m5 = _mm_set1_pd(m[5]);
+	const __m128d m6 = _mm_set1_pd(m[6]), m7 = _mm_set1_pd(m[7]);
+	const __m128d m8 = _mm_set1_pd(m[8]);
+	const __m128d e2 = _mm_set1_pd(dfMaxErrorSquared);
+	const __m128d zero = _mm_setzero_pd();
+
+	int nScore = 0;
+	int i = nStart;
+
+	for ( ; i + 2 <= nEnd; i += 2)
+	{
+		__m128d x = _mm_loadu_pd(padfX_1 + i);
+		__m128d y = _mm_loadu_pd(padfY_1 + i);
+		__m128d u = _mm_loadu_pd(padfX_2 + i);
+		__m128d v = _mm_loadu_pd(padfY_2 + i);
+
+		__m128d w = _mm_add_pd(_mm_add_pd(_mm_mul_pd(m6, x),
+				_mm_mul_pd(m7, y)), m8);
+		__m128d dx = _mm_sub_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(m0, x),
+				_mm_mul_pd(m1, y)), m2), _mm_mul_pd(u, w));
+		__m128d dy = _mm_sub_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(m3, x),
+				_mm_mul_pd(m4, y)), m5), _mm_mul_pd(v, w));
+
+		__m128d err = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+		__m128d ok = _mm_and_pd(
+				_mm_cmple_pd(err, _mm_mul_pd(e2, _mm_mul_pd(w, w))),
+				_mm_cmpgt_pd(w, zero));
+
+		int nMask = _mm_movemask_pd(ok);
+		nScore += (nMask & 1) + (nMask >> 1);
+
+		if (pabInlier != NULL)
+		{
+			pabInlier[i] = (nMask & 1) != 0;
+			pabInlier[i + 1] = (nMask & 2) != 0;
+		}
+	}
+
+	return nScore + InlierKernelScalar(m, dfMaxErrorSquared,
+			padfX_1, padfY_1, padfX_2, padfY_2, i, nEnd, pabInlier);
+}
+#endif
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+GDAL_CORRELATOR_TARGET("avx2")
+static int InlierKernelAVX2(const double *m, double dfMaxErrorSquared,
+		const double *padfX_1, const double *padfY_1,
+		const double *padfX_2, const double *padfY_2,
+		int nStart, int nEnd, bool *pabInlier)
+{
+	const __m256d m0 = _mm256_set1_pd(m[0]), m1 = _mm256_set1_pd(m[1]);
+	const __m256d m2 = _mm256_set1_pd(m[2]), m3 = _mm256_set1_pd(m[3]);
+	const __m256d m4 = _mm256_set1_pd(m[4]), m5 = _mm256_set1_pd(m[5]);
+	const __m256d m6 = _mm256_set1_pd(m[6]), m7 = _mm256_set1_pd(m[7]);
+	const __m256d m8 = _mm256_set1_pd(m[8]);
+	const __m256d e2 = _mm256_set1_pd(dfMaxErrorSquared);
+	const __m256d zero = _mm256_setzero_pd();
+
+	int nScore = 0;
+	int i = nStart;
+
+	for ( ; i + 4 <= nEnd; i += 4)
+	{
+		__m256d x = _mm256_loadu_pd(padfX_1 + i);
+		__m256d y = _mm256_loadu_pd(padfY_1 + i);
+		__m256d u = _mm256_loadu_pd(padfX_2 + i);
+		__m256d v = _mm256_loadu_pd(padfY_2 + i);
+
+		__m256d w = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m6, x),
+				_mm256_mul_pd(m7, y)), m8);
+		__m256d dx = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(
+				_mm256_mul_pd(m0, x), _mm256_mul_pd(m1, y)), m2),
+				_mm256_mul_pd(u, w));
+		__m256d dy = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(
+				_mm256_mul_pd(m3, x), _mm256_mul_pd(m4, y)), m5),
+				_mm256_mul_pd(v, w));
+
+		__m256d err = _mm256_add_pd(_mm256_mul_pd(dx, dx),
+				_mm256_mul_pd(dy, dy));
+		__m256d ok = _mm256_and_pd(
+				_mm256_cmp_pd(err, _mm256_mul_pd(e2, _mm256_mul_pd(w, w)),
+				_CMP_LE_OQ),
+				_mm256_cmp_pd(w, zero, _CMP_GT_OQ));
+
+		int nMask = _mm256_movemask_pd(ok);
+		nScore += __builtin_popcount(nMask);
+
+		if (pabInlier != NULL)
+			for (int k = 0; k < 4; k++)
+				pabInlier[i + k] = (nMask & (1 << k)) != 0;
+	}
+
+	return nScore + InlierKernelScalar(m, dfMaxErrorSquared,
+			padfX_1, padfY_1, padfX_2, padfY_2, i, nEnd, pabInlier);
+}
+#endif
+
+static InlierKernelFunc GetInlierKernel()
+{
+	switch (GDALCPUDispatch::GetLevel())
+	{
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		// 256-bit kernel is used for AVX-512 too, there are only
+		// few dozens of operations per pair
+		case GDALCPUDispatch::LEVEL_AVX512:
+		case GDALCPUDispatch::LEVEL_AVX2:
+			return InlierKernelAVX2;
+#endif
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_SSE2:
+			return InlierKernelSSE2;
+#endif
+		default:
+			return InlierKernelScalar;
+	}
+}
+
+int GDALRansacVerifier::CountInliers(const Problem *poProblem,
+		const double *padfModel, int nMinScore, bool *pabInlier)
+{
+	const double *padfX_1 = &poProblem->adfX_1[0];
+	const double *padfY_1 = &poProblem->adfY_1[0];
+	const double *padfX_2 = &poProblem->adfX_2[0];
+	const double *padfY_2 = &poProblem->adfY_2[0];
+	int nPoints = poProblem->nPoints;
+
+	InlierKernelFunc pfnKernel = GetInlierKernel();
+
+	int nScore = 0;
+	for (int i = 0; i < nPoints; i += SCORE_BLOCK)
+	{
+		int nBlockEnd = (nPoints - i > SCORE_BLOCK) ? i + SCORE_BLOCK : nPoints;
+
+		nScore += pfnKernel(padfModel, poProblem->dfMaxErrorSquared,
+				padfX_1, padfY_1, padfX_2, padfY_2, i, nBlockEnd, pabInlier);
+
+		// Hypothesis can't reach required score
+		if (nScore + (nPoints - nBlockEnd) < nMinScore)
+			return -1;
+	}
+
+	return nScore;
+}
+
+void GDALRansacVerifier::DrawSample(const Problem *poProblem,
+		int nHypothesis, int *panSample)
+{
+	unsigned int nSeed = (unsigned int)nHypothesis * 2654435761u + 12345u;
+
+	for (int k = 0; k < poProblem->nSampleSize; k++)
+	{
+		bool bRepeated = true;
+		while (bRepeated)
+		{
+			nSeed = nSeed * 1664525u + 1013904223u;
+			panSample[k] = (int)((nSeed >> 8) % (unsigned int)poProblem->nPoints);
+
+			bRepeated = false;
+			for (int j = 0; j < k; j++)
+				if (panSample[j] == panSample[k])
+					bRepeated = true;
+		}
+	}
+}
+
+void GDALRansacVerifier::ScoreHypothesis(void *pData, int iJob)
+{
+	Problem *poProblem = (Problem *)pData;
+
+	int anSample[4];
+	DrawSample(poProblem, poProblem->nFirstHypothesis + iJob, anSample);
+
+	double *padfModel = &poProblem->adfModels[iJob * 9];
+	if (!FitModel(poProblem, anSample, poProblem->nSampleSize, padfModel))
+	{
+		poProblem->anScores[iJob] = -1;
+		return;
+	}
+
+	// Hypothesis is interesting only if it beats the best of previous batches
+	poProblem->anScores[iJob] = CountInliers(poProblem, padfModel,
+			poProblem->nBestScore + 1, NULL);
+}
+
+int GDALRansacVerifier::Verify(GDALMatchedPointsCollection *poMatched,
+		ModelType eModel, double dfMaxError, double *padfModel,
+		GDALMatchedPointsCollection *poInliers, bool *pabInlier,
+		int nThreads, double dfConfidence, int nMaxHypotheses)
+{
+/* -------------------------------------------------------------------- */
+/*      Validate parameters.                                            */
+/* -------------------------------------------------------------------- */
+	if (poMatched == NULL || padfModel == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points or model aren't specified");
+		return -1;
+	}
+
+	if (!(dfMaxError > 0) || !(dfConfidence > 0 && dfConfidence < 1))
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Maximal error should be positive and confidence from 0 to 1");
+		return -1;
+	}
+
+	Problem oProblem;
+	oProblem.nPoints = poMatched->GetSize();
+	oProblem.eModel = eModel;
+	oProblem.nSampleSize = (eModel == MODEL_AFFINE) ? 3 : 4;
+	oProblem.dfMaxErrorSquared = dfMaxError * dfMaxError;
+
+	if (oProblem.nPoints < oProblem.nSampleSize)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Not enough matched points to estimate model");
+		return -1;
+	}
+
+	if (nThreads <= 0)
+		nThreads = GDALThreadPool::GetDefaultThreadCount();
+
+	oProblem.adfX_1.resize(oProblem.nPoints);
+	oProblem.adfY_1.resize(oProblem.nPoints);
+	oProblem.adfX_2.resize(oProblem.nPoints);
+	oProblem.adfY_2.resize(oProblem.nPoints);
+	poMatched->ExportCoordinates(&oProblem.adfX_1[0], &oProblem.adfY_1[0],
+			&oProblem.adfX_2[0], &oProblem.adfY_2[0]);
+
+	oProblem.adfModels.resize(BATCH_SIZE * 9);
+	oProblem.anScores.resize(BATCH_SIZE);
+	oProblem.nBestScore = 0;
+
+/* -------------------------------------------------------------------- */
+/*      Score batches of hypotheses until confidence is reached.        */
+/* -------------------------------------------------------------------- */
+	double adfBest[9];
+	bool bFound = false;
+	int nRequired = nMaxHypotheses;
+	int nHypotheses = 0;
+
+	while (nHypotheses < nRequired)
+	{
+		int nBatch = nRequired - nHypotheses;
+		if (nBatch > BATCH_SIZE)
+			nBatch = BATCH_SIZE;
+
+		oProblem.nFirstHypothesis = nHypotheses;
+		GDALThreadPool::RunJobs(nBatch, ScoreHypothesis, &oProblem, nThreads);
+		nHypotheses += nBatch;
+
+		// The best in batch, the earliest wins ties
+		for (int j = 0; j < nBatch; j++)
+			if (oProblem.anScores[j] > oProblem.nBestScore)
+			{
+				oProblem.nBestScore = oProblem.anScores[j];
+				memcpy(adfBest, &oProblem.adfModels[j * 9], sizeof(adfBest));
+				bFound = true;
+			}
+
+		if (!bFound)
+			continue;
+
+		// Number of hypotheses to draw all-inlier sample with given confidence
+		double dfInlierRatio = (double)oProblem.nBestScore / oProblem.nPoints;
+		double dfGood = pow(dfInlierRatio, oProblem.nSampleSize);
+		if (dfGood >= 1)
+			break;
+
+		double dfRequired = log(1 - dfConfidence) / log(1 - dfGood);
+		if (dfRequired < nRequired)
+			nRequired = (int)ceil(dfRequired);
+	}
+
+	CPLDebug("GDALRansacVerifier", "%d hypotheses, %d inliers of %d",
+			nHypotheses, oProblem.nBestScore, oProblem.nPoints);
+
+	if (!bFound || oProblem.nBestScore < oProblem.nSampleSize)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Model can't be estimated");
+		return -1;
+	}
+
+/* -------------------------------------------------------------------- */
+/*      Refine model by least squares over inliers.                     */
+/* -------------------------------------------------------------------- */
+	bool *pabFlags = new bool[oProblem.nPoints];
+	int nInliers = CountInliers(&oProblem, adfBest, 0, pabFlags);
+
+	vector<int> anInliers;
+	anInliers.reserve(nInliers);
+	for (int i = 0; i < oProblem.nPoints; i++)
+		if (pabFlags[i])
+			anInliers.push_back(i);
+
+	double adfRefined[9];
+	if (FitModel(&oProblem, &anInliers[0], anInliers.size(), adfRefined) &&
+			CountInliers(&oProblem, adfRefined, nInliers, NULL) >= nInliers)
+	{
+		memcpy(adfBest, adfRefined, sizeof(adfBest));
+		nInliers = CountInliers(&oProblem, adfBest, 0, pabFlags);
+	}
+
+	memcpy(padfModel, adfBest, sizeof(adfBest));
+
+	if (pabInlier != NULL)
+		memcpy(pabInlier, pabFlags, oProblem.nPoints * sizeof(bool));
+
+	if (poInliers != NULL)
+	{
+		bool bReferences = poMatched->HasExternalSources();
+		if (bReferences && poInliers->SetSources(poMatched->GetFirstSource(),
+				poMatched->GetSecondSource()) != CE_None)
+		{
+			delete[] pabFlags;
+			return -1;
+		}
+
+		poInliers->Reserve(poInliers->GetSize() + nInliers);
+		for (int i = 0; i < oProblem.nPoints; i++)
+		{
+			if (!pabFlags[i])
+				continue;
+
+			if (bReferences)
+				poInliers->AddPair(poMatched->GetFirstIndices()[i],
+						poMatched->GetSecondIndices()[i],
+						poMatched->GetDistances()[i]);
+			else
+				poInliers->AddPointCopies(*poMatched->GetFirstPoint(i),
+						*poMatched->GetSecondPoint(i),
+						poMatched->GetDistances()[i]);
+		}
+	}
+
+	delete[] pabFlags;
+
+	return nInliers;
+}
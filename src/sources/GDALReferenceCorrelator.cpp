@@ -0,0 +1,68 @@
+#include "GDALReferenceCorrelator.h"
+#include "GDALSimpleSURF.h"
+
+GDALReferenceCorrelator::GDALReferenceCorrelator()
+{
+	poReference = NULL;
+}
+
+GDALReferenceCorrelator::~GDALReferenceCorrelator()
+{
+	delete poReference;
+}
+
+CPLErr GDALReferenceCorrelator::SetReference(
+		GDALFeaturePointsCollection *poReference)
+{
+	if (poReference == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Reference collection isn't specified");
+		return CE_Failure;
+	}
+
+	if (poReference != this->poReference)
+		delete this->poReference;
+
+	this->poReference = poReference;
+	GDALSimpleSURF::PackBySign(poReference, aoMatrices, &anRows);
+
+	return CE_None;
+}
+
+GDALFeaturePointsCollection *GDALReferenceCorrelator::GetReference() const
+{
+	return poReference;
+}
+
+CPLErr GDALReferenceCorrelator::Match(GDALFeaturePointsCollection *poQuery,
+		GDALMatchedPointsCollection *poMatched, double dfThreshold) const
+{
+	if (poReference == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Reference isn't set");
+		return CE_Failure;
+	}
+
+	return GDALSimpleSURF::MatchFeaturePointsPrepacked(poMatched,
+			poQuery, poReference, aoMatrices, anRows, dfThreshold);
+}
+
+GIntBig GDALReferenceCorrelator::GetMemoryUsage() const
+{
+	const int nDescSize = GDALFeaturePoint::DESC_SIZE * sizeof(double);
+	GIntBig nSize = sizeof(*this);
+
+	if (poReference != NULL)
+		nSize += (GIntBig)poReference->GetSize() *
+				(sizeof(GDALFeaturePoint) + sizeof(GDALFeaturePoint *) + nDescSize);
+
+	// Packed descriptor, norm and index per row
+	for (int i = 0; i < 2; i++)
+		nSize += (GIntBig)aoMatrices[i].GetRows() *
+				(nDescSize + sizeof(double) + sizeof(int));
+
+	nSize += (GIntBig)anRows.size() * sizeof(int);
+
+	return nSize;
+}
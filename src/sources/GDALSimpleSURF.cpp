@@ -1,4 +1,23 @@
 #include "GDALSimpleSURF.h"
+#include "GDALKDForest.h"
+#include "GDALDescriptorMatrix.h"
+#include "GDALThreadPool.h"
+#include "GDALSpatialGrid.h"
+#include "GDALCPUDispatch.h"
+#include "GDALMemoryBudget.h"
+
+#include "cpl_multiproc.h"
+
+#include <float.h>
+#include <map>
+#include <set>
+#include <vector>
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 GDALSimpleSURF::GDALSimpleSURF(int nOctaveStart, int nOctaveEnd)
 {
@@ -13,10 +32,270 @@ CPLErr GDALSimpleSURF::ConvertRGBToLuminosity(
 		GDALRasterBand *red, GDALRasterBand *green, GDALRasterBand *blue,
 		int nXSize, int nYSize, double **padfImg, int nHeight, int nWidth)
 {
-    const double forRed = 0.21;
-    const double forGreen = 0.72;
-    const double forBlue = 0.07;
+	return ConvertRGBToLuminosity(red, green, blue, 0, 0, nXSize, nYSize,
+			padfImg, nHeight, nWidth);
+}
+
+/**
+ * Choose strips of window, see GDALMemoryBudget::GetReadStrips.
+ */
+static void GetLuminosityStrips(GDALRasterBand *poBand, int nYSize, int nHeight,
+		int *pnRatio, int *pnStripRows)
+{
+	int nBlockXSize, nBlockYSize;
+	poBand->GetBlockSize(&nBlockXSize, &nBlockYSize);
+
+	GDALMemoryBudget::GetReadStrips(nYSize, nHeight, nBlockYSize,
+			pnRatio, pnStripRows);
+}
+
+/* -------------------------------------------------------------------- */
+/*      Luminosity kernels. Every value is computed with the same       */
+/*      operations in the same order, so all kernels give the same     */
+/*      result. Output may be the same array as red values.             */
+/* -------------------------------------------------------------------- */
+static const double LUMINOSITY_RED = 0.21;
+static const double LUMINOSITY_GREEN = 0.72;
+static const double LUMINOSITY_BLUE = 0.07;
+static const double LUMINOSITY_MAX = 255.0;
+
+static void LuminosityKernelScalar(const double *padfRed, const double *padfGreen,
+		const double *padfBlue, double *padfLum, int nCount)
+{
+	for (int i = 0; i < nCount; i++)
+		padfLum[i] = (
+				padfRed[i] * LUMINOSITY_RED +
+				padfGreen[i] * LUMINOSITY_GREEN +
+				padfBlue[i] * LUMINOSITY_BLUE) / LUMINOSITY_MAX;
+}
+
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#if !defined(__SSE2__)
+GDAL_CORRELATOR_TARGET("sse2")
+#endif
+static void LuminosityKernelSSE2(const double *padfRed, const double *padfGreen,
+		const double *padfBlue, double *padfLum, int nCount)
+{
+	const __m128d red = _mm_set1_pd(LUMINOSITY_RED);
+	const __m128d green = _mm_set1_pd(LUMINOSITY_GREEN);
+	const __m128d blue = _mm_set1_pd(LUMINOSITY_BLUE);
+	const __m128d maxValue = _mm_set1_pd(LUMINOSITY_MAX);
+
+	int i = 0;
+	for ( ; i + 2 <= nCount; i += 2)
+		_mm_storeu_pd(padfLum + i, _mm_div_pd(_mm_add_pd(_mm_add_pd(
+				_mm_mul_pd(_mm_loadu_pd(padfRed + i), red),
+				_mm_mul_pd(_mm_loadu_pd(padfGreen + i), green)),
+				_mm_mul_pd(_mm_loadu_pd(padfBlue + i), blue)), maxValue));
+
+	LuminosityKernelScalar(padfRed + i, padfGreen + i, padfBlue + i,
+			padfLum + i, nCount - i);
+}
+#endif
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+GDAL_CORRELATOR_TARGET("avx2")
+static void LuminosityKernelAVX2(const double *padfRed, const double *padfGreen,
+		const double *padfBlue, double *padfLum, int nCount)
+{
+	const __m256d red = _mm256_set1_pd(LUMINOSITY_RED);
+	const __m256d green = _mm256_set1_pd(LUMINOSITY_GREEN);
+	const __m256d blue = _mm256_set1_pd(LUMINOSITY_BLUE);
+	const __m256d maxValue = _mm256_set1_pd(LUMINOSITY_MAX);
+
+	int i = 0;
+	for ( ; i + 4 <= nCount; i += 4)
+		_mm256_storeu_pd(padfLum + i, _mm256_div_pd(_mm256_add_pd(_mm256_add_pd(
+				_mm256_mul_pd(_mm256_loadu_pd(padfRed + i), red),
+				_mm256_mul_pd(_mm256_loadu_pd(padfGreen + i), green)),
+				_mm256_mul_pd(_mm256_loadu_pd(padfBlue + i), blue)), maxValue));
+
+	LuminosityKernelScalar(padfRed + i, padfGreen + i, padfBlue + i,
+			padfLum + i, nCount - i);
+}
+
+GDAL_CORRELATOR_TARGET("avx512f") GDAL_CORRELATOR_NO_CONTRACT
+static void LuminosityKernelAVX512(const double *padfRed, const double *padfGreen,
+		const double *padfBlue, double *padfLum, int nCount)
+{
+	const __m512d red = _mm512_set1_pd(LUMINOSITY_RED);
+	const __m512d green = _mm512_set1_pd(LUMINOSITY_GREEN);
+	const __m512d blue = _mm512_set1_pd(LUMINOSITY_BLUE);
+	const __m512d maxValue = _mm512_set1_pd(LUMINOSITY_MAX);
+
+	int i = 0;
+	for ( ; i + 8 <= nCount; i += 8)
+		_mm512_storeu_pd(padfLum + i, _mm512_div_pd(_mm512_add_pd(_mm512_add_pd(
+				_mm512_mul_pd(_mm512_loadu_pd(padfRed + i), red),
+				_mm512_mul_pd(_mm512_loadu_pd(padfGreen + i), green)),
+				_mm512_mul_pd(_mm512_loadu_pd(padfBlue + i), blue)), maxValue));
+
+	LuminosityKernelScalar(padfRed + i, padfGreen + i, padfBlue + i,
+			padfLum + i, nCount - i);
+}
+#endif
+
+typedef void (*LuminosityKernelFunc)(const double *padfRed,
+		const double *padfGreen, const double *padfBlue,
+		double *padfLum, int nCount);
+
+static LuminosityKernelFunc GetLuminosityKernel()
+{
+	switch (GDALCPUDispatch::GetLevel())
+	{
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_AVX512:
+			return LuminosityKernelAVX512;
+		case GDALCPUDispatch::LEVEL_AVX2:
+			return LuminosityKernelAVX2;
+#endif
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_SSE2:
+			return LuminosityKernelSSE2;
+#endif
+		default:
+			return LuminosityKernelScalar;
+	}
+}
+
+/**
+ * Convert rows of RGB buffers to luminosity. Band values of every row
+ * are converted to double by GDALCopyWords (red ones right into
+ * resulting row), then luminosity kernel is applied.
+ */
+static void ConvertLuminosityRows(void **papBuffers, const GDALDataType *paeTypes,
+		int nWidth, int nRows, double **padfRows)
+{
+	vector<double> adfGreen(nWidth);
+	vector<double> adfBlue(nWidth);
+	LuminosityKernelFunc pfnLuminosityKernel = GetLuminosityKernel();
+
+	int anDataSizes[3];
+	for (int b = 0; b < 3; b++)
+		anDataSizes[b] = GDALGetDataTypeSize(paeTypes[b]) / 8;
+
+	for (int row = 0; row < nRows; row++)
+	{
+		double *padfRow = padfRows[row];
+		size_t nOffset = (size_t)nWidth * row;
+
+		GDALCopyWords((GByte *)papBuffers[0] + nOffset * anDataSizes[0],
+				paeTypes[0], anDataSizes[0], padfRow, GDT_Float64,
+				sizeof(double), nWidth);
+		GDALCopyWords((GByte *)papBuffers[1] + nOffset * anDataSizes[1],
+				paeTypes[1], anDataSizes[1], &adfGreen[0], GDT_Float64,
+				sizeof(double), nWidth);
+		GDALCopyWords((GByte *)papBuffers[2] + nOffset * anDataSizes[2],
+				paeTypes[2], anDataSizes[2], &adfBlue[0], GDT_Float64,
+				sizeof(double), nWidth);
+
+		pfnLuminosityKernel(padfRow, &adfGreen[0], &adfBlue[0], padfRow, nWidth);
+	}
+}
+
+/**
+ * Reader of horizontal strips of RGB window. One reader thread reads
+ * strips in order into two sets of buffers, while the calling thread
+ * converts the previous strip.
+ */
+struct LuminosityStripReader
+{
+	GDALRasterBand *apoBands[3];
+	GDALDataType aeTypes[3];
+	int anDataSizes[3];
+
+	int nXOff;
+	int nYOff;
+	int nXSize;
+	int nWidth;
+	// Source lines per resulting line
+	int nRatio;
+	int nHeight;
+	int nStripRows;
+	int nStrips;
+
+	// Two sets of band buffers: strip s is read into set s % 2
+	void *apBuffers[2][3];
+
+	// State shared by reader and converter, guarded by mutex.
+	// Strip is read into set, when strip two steps before is converted
+	void *hMutex;
+	void *hCond;
+	int nRead;
+	int nConverted;
+	bool bStop;
+	CPLErr eErr;
+};
+
+/**
+ * Read one strip into its set of buffers.
+ */
+static CPLErr ReadLuminosityStrip(LuminosityStripReader *poReader, int nStrip)
+{
+	int nFirstRow = nStrip * poReader->nStripRows;
+	int nRows = MIN(poReader->nStripRows, poReader->nHeight - nFirstRow);
+
+	// Let driver start fetching of the strip after this one
+	int nNextRow = nFirstRow + poReader->nStripRows;
+	if (nNextRow < poReader->nHeight)
+	{
+		int nNextRows = MIN(poReader->nStripRows, poReader->nHeight - nNextRow);
+		for (int b = 0; b < 3; b++)
+			poReader->apoBands[b]->AdviseRead(poReader->nXOff,
+					poReader->nYOff + nNextRow * poReader->nRatio,
+					poReader->nXSize, nNextRows * poReader->nRatio,
+					poReader->nWidth, nNextRows, poReader->aeTypes[b], NULL);
+	}
+
+	CPLErr eErr = CE_None;
+	for (int b = 0; b < 3 && eErr == CE_None; b++)
+		eErr = poReader->apoBands[b]->RasterIO(GF_Read,
+				poReader->nXOff, poReader->nYOff + nFirstRow * poReader->nRatio,
+				poReader->nXSize, nRows * poReader->nRatio,
+				poReader->apBuffers[nStrip % 2][b],
+				poReader->nWidth, nRows, poReader->aeTypes[b], 0, 0);
+
+	return eErr;
+}
+
+/**
+ * Reader thread: reads all strips, waiting for free set of buffers.
+ */
+static void LuminosityReaderFunc(void *pData)
+{
+	LuminosityStripReader *poReader = (LuminosityStripReader *)pData;
+
+	for (int nStrip = 0; nStrip < poReader->nStrips; nStrip++)
+	{
+		CPLAcquireMutex(poReader->hMutex, 1000.0);
+		while (nStrip - poReader->nConverted >= 2 && !poReader->bStop)
+			CPLCondWait(poReader->hCond, poReader->hMutex);
+		bool bStop = poReader->bStop;
+		CPLReleaseMutex(poReader->hMutex);
+
+		if (bStop)
+			return;
+
+		CPLErr eErr = ReadLuminosityStrip(poReader, nStrip);
+
+		CPLAcquireMutex(poReader->hMutex, 1000.0);
+		if (eErr != CE_None)
+			poReader->eErr = eErr;
+		else
+			poReader->nRead = nStrip + 1;
+		CPLCondBroadcast(poReader->hCond);
+		CPLReleaseMutex(poReader->hMutex);
 
+		if (eErr != CE_None)
+			return;
+	}
+}
+
+CPLErr GDALSimpleSURF::ConvertRGBToLuminosity(
+		GDALRasterBand *red, GDALRasterBand *green, GDALRasterBand *blue,
+		int nXOff, int nYOff, int nXSize, int nYSize,
+		double **padfImg, int nHeight, int nWidth)
+{
 	if (red == NULL || green == NULL || blue == NULL)
 	{
 		CPLError(CE_Failure, CPLE_AppDefined,
@@ -24,7 +303,8 @@ CPLErr GDALSimpleSURF::ConvertRGBToLuminosity(
 		return CE_Failure;
 	}
 
-	if (nXSize > red->GetXSize() || nYSize > red->GetYSize())
+	if (nXOff < 0 || nYOff < 0 ||
+			nXOff + nXSize > red->GetXSize() || nYOff + nYSize > red->GetYSize())
 	{
 		CPLError(CE_Failure, CPLE_AppDefined,
 						"Red band has less size than has been requested");
@@ -37,93 +317,369 @@ CPLErr GDALSimpleSURF::ConvertRGBToLuminosity(
 		return CE_Failure;
 	}
 
-	GDALDataType eRedType = red->GetRasterDataType();
-	GDALDataType eGreenType = green->GetRasterDataType();
-	GDALDataType eBlueType = blue->GetRasterDataType();
+	LuminosityStripReader oReader;
+	oReader.apoBands[0] = red;
+	oReader.apoBands[1] = green;
+	oReader.apoBands[2] = blue;
+	oReader.nXOff = nXOff;
+	oReader.nYOff = nYOff;
+	oReader.nXSize = nXSize;
+	oReader.nWidth = nWidth;
+	oReader.nHeight = nHeight;
+
+	// Strip is read while previous one is converted
+	GetLuminosityStrips(red, nYSize, nHeight,
+			&oReader.nRatio, &oReader.nStripRows);
+
+	int nStrips = (nHeight + oReader.nStripRows - 1) / oReader.nStripRows;
+	int nBuffers = (nStrips > 1) ? 2 : 1;
+	oReader.nStrips = nStrips;
+
+	for (int b = 0; b < 3; b++)
+	{
+		oReader.aeTypes[b] = oReader.apoBands[b]->GetRasterDataType();
+		oReader.anDataSizes[b] = GDALGetDataTypeSize(oReader.aeTypes[b]) / 8;
+
+		for (int k = 0; k < 2; k++)
+			oReader.apBuffers[k][b] = (k < nBuffers) ? CPLMalloc(
+					(size_t)oReader.anDataSizes[b] * nWidth * oReader.nStripRows)
+					: NULL;
+	}
+
+	CPLErr eErr = CE_None;
+
+	if (nStrips == 1)
+	{
+		// Single read of whole window, possibly with resampling
+		for (int b = 0; b < 3 && eErr == CE_None; b++)
+			eErr = oReader.apoBands[b]->RasterIO(GF_Read, nXOff, nYOff,
+					nXSize, nYSize, oReader.apBuffers[0][b], nWidth, nHeight,
+					oReader.aeTypes[b], 0, 0);
+
+		if (eErr == CE_None)
+			ConvertLuminosityRows(oReader.apBuffers[0], oReader.aeTypes,
+					nWidth, nHeight, padfImg);
+	}
+	else
+	{
+		oReader.hMutex = CPLCreateMutex();
+		CPLReleaseMutex(oReader.hMutex);
+		oReader.hCond = CPLCreateCond();
+		oReader.nRead = 0;
+		oReader.nConverted = 0;
+		oReader.bStop = false;
+		oReader.eErr = CE_None;
+
+		// Strips are read one by one if thread can't be started
+		CPLJoinableThread *poThread =
+				CPLCreateJoinableThread(LuminosityReaderFunc, &oReader);
+
+		for (int nStrip = 0; nStrip < nStrips && eErr == CE_None; nStrip++)
+		{
+			if (poThread != NULL)
+			{
+				CPLAcquireMutex(oReader.hMutex, 1000.0);
+				while (oReader.nRead <= nStrip && oReader.eErr == CE_None)
+					CPLCondWait(oReader.hCond, oReader.hMutex);
+				eErr = oReader.eErr;
+				CPLReleaseMutex(oReader.hMutex);
+			}
+			else
+				eErr = ReadLuminosityStrip(&oReader, nStrip);
+
+			if (eErr != CE_None)
+				break;
+
+			int nFirstRow = nStrip * oReader.nStripRows;
+			int nRows = MIN(oReader.nStripRows, nHeight - nFirstRow);
+
+			ConvertLuminosityRows(oReader.apBuffers[nStrip % 2],
+					oReader.aeTypes, nWidth, nRows, padfImg + nFirstRow);
+
+			// Buffers of the strip may receive the next but one
+			CPLAcquireMutex(oReader.hMutex, 1000.0);
+			oReader.nConverted = nStrip + 1;
+			CPLCondBroadcast(oReader.hCond);
+			CPLReleaseMutex(oReader.hMutex);
+		}
+
+		if (poThread != NULL)
+		{
+			CPLAcquireMutex(oReader.hMutex, 1000.0);
+			oReader.bStop = true;
+			CPLCondBroadcast(oReader.hCond);
+			CPLReleaseMutex(oReader.hMutex);
+
+			CPLJoinThread(poThread);
+		}
+
+		CPLDestroyCond(oReader.hCond);
+		CPLDestroyMutex(oReader.hMutex);
+	}
+
+	for (int k = 0; k < 2; k++)
+		for (int b = 0; b < 3; b++)
+			CPLFree(oReader.apBuffers[k][b]);
+
+	return eErr;
+}
 
-	int dataRedSize = GDALGetDataTypeSize(eRedType) / 8;
-	int dataGreenSize = GDALGetDataTypeSize(eGreenType) / 8;
-	int dataBlueSize = GDALGetDataTypeSize(eBlueType) / 8;
+/**
+ * Strips of window decoded by threads through pool of handles
+ */
+struct PooledLuminosityJob
+{
+	GDALDatasetPool *poPool;
+	const int *panBands;
+	int nXOff;
+	int nYOff;
+	int nXSize;
+	int nYSize;
+	double **padfImg;
+	int nHeight;
+	int nWidth;
+	int nRatio;
+	int nStripRows;
+	CPLErr *paeErrors;
+};
 
-	void *paRedLayer = CPLMalloc(dataRedSize * nWidth * nHeight);
-	void *paGreenLayer = CPLMalloc(dataGreenSize * nWidth * nHeight);
-	void *paBlueLayer = CPLMalloc(dataBlueSize * nWidth * nHeight);
+static void PooledLuminosityJobFunc(void *pData, int iJob)
+{
+	PooledLuminosityJob *poJob = (PooledLuminosityJob *)pData;
+	poJob->paeErrors[iJob] = CE_Failure;
 
-	red->RasterIO(GF_Read, 0, 0, nXSize, nYSize, paRedLayer, nWidth, nHeight, eRedType, 0, 0);
-	green->RasterIO(GF_Read, 0, 0, nXSize, nYSize, paGreenLayer, nWidth, nHeight, eGreenType, 0, 0);
-	blue->RasterIO(GF_Read, 0, 0, nXSize, nYSize, paBlueLayer, nWidth, nHeight, eBlueType, 0, 0);
+	GDALDataset *poHandle = poJob->poPool->Acquire();
 
-	double maxValue = 255.0;
-	for (int row = 0; row < nHeight; row++)
-		for (int col = 0; col < nWidth; col++)
+	GDALRasterBand *apoBands[3];
+	for (int b = 0; b < 3; b++)
+	{
+		apoBands[b] = poHandle->GetRasterBand(poJob->panBands[b]);
+		if (apoBands[b] == NULL)
 		{
-			// Get RGB values
-			double dfRedVal = SRCVAL(paRedLayer, eRedType,
-					nWidth * row + col * dataRedSize);
-			double dfGreenVal = SRCVAL(paGreenLayer, eGreenType,
-					nWidth * row + col * dataGreenSize);
-			double dfBlueVal = SRCVAL(paBlueLayer, eBlueType,
-					nWidth * row + col * dataBlueSize);
-			// Compute luminosity value
-			padfImg[row][col] = (
-					dfRedVal * forRed +
-					dfGreenVal * forGreen +
-					dfBlueVal * forBlue) / maxValue;
+			poJob->poPool->Release(poHandle);
+			CPLError(CE_Failure, CPLE_AppDefined, "Raster band doesn't exist");
+			return;
 		}
+	}
+
+	int nFirstRow = iJob * poJob->nStripRows;
+	int nRows = MIN(poJob->nStripRows, poJob->nHeight - nFirstRow);
+
+	// Whole window is one strip, if it can't be split
+	int nYOff = poJob->nYOff;
+	int nYSize = poJob->nYSize;
+	if (poJob->nRatio > 0)
+	{
+		nYOff += nFirstRow * poJob->nRatio;
+		nYSize = nRows * poJob->nRatio;
+	}
+
+	void *apBuffers[3];
+	GDALDataType aeTypes[3];
+	CPLErr eErr = CE_None;
+	for (int b = 0; b < 3; b++)
+	{
+		aeTypes[b] = apoBands[b]->GetRasterDataType();
+		apBuffers[b] = CPLMalloc((size_t)(GDALGetDataTypeSize(aeTypes[b]) / 8) *
+				poJob->nWidth * nRows);
+
+		if (eErr == CE_None)
+			eErr = apoBands[b]->RasterIO(GF_Read, poJob->nXOff, nYOff,
+					poJob->nXSize, nYSize, apBuffers[b], poJob->nWidth, nRows,
+					aeTypes[b], 0, 0);
+	}
+
+	poJob->poPool->Release(poHandle);
+
+	if (eErr == CE_None)
+		ConvertLuminosityRows(apBuffers, aeTypes, poJob->nWidth, nRows,
+				poJob->padfImg + nFirstRow);
+
+	for (int b = 0; b < 3; b++)
+		CPLFree(apBuffers[b]);
+
+	poJob->paeErrors[iJob] = eErr;
+}
+
+CPLErr GDALSimpleSURF::ConvertRGBToLuminosity(
+		GDALDatasetPool *poPool, const int *panBands,
+		int nXOff, int nYOff, int nXSize, int nYSize,
+		double **padfImg, int nHeight, int nWidth, int nThreads)
+{
+	if (poPool == NULL || panBands == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Dataset pool or raster bands are not specified");
+		return CE_Failure;
+	}
+
+	GDALDataset *poDataset = poPool->GetDataset();
+	GDALRasterBand *poRed = poDataset->GetRasterBand(panBands[0]);
+	if (poRed == NULL || poDataset->GetRasterBand(panBands[1]) == NULL ||
+			poDataset->GetRasterBand(panBands[2]) == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Raster bands are not specified");
+		return CE_Failure;
+	}
+
+	if (nXOff < 0 || nYOff < 0 ||
+			nXOff + nXSize > poRed->GetXSize() || nYOff + nYSize > poRed->GetYSize())
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+						"Red band has less size than has been requested");
+		return CE_Failure;
+	}
+
+	if (padfImg == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Buffer isn't specified");
+		return CE_Failure;
+	}
+
+	PooledLuminosityJob oJob;
+	oJob.poPool = poPool;
+	oJob.panBands = panBands;
+	oJob.nXOff = nXOff;
+	oJob.nYOff = nYOff;
+	oJob.nXSize = nXSize;
+	oJob.nYSize = nYSize;
+	oJob.padfImg = padfImg;
+	oJob.nHeight = nHeight;
+	oJob.nWidth = nWidth;
+	GetLuminosityStrips(poRed, nYSize, nHeight, &oJob.nRatio, &oJob.nStripRows);
+
+	int nStrips = (nHeight + oJob.nStripRows - 1) / oJob.nStripRows;
+	vector<CPLErr> aeErrors(nStrips, CE_None);
+	oJob.paeErrors = &aeErrors[0];
+
+	if (nThreads <= 0)
+		nThreads = GDALThreadPool::GetDefaultThreadCount();
 
-	CPLFree(paRedLayer);
-	CPLFree(paGreenLayer);
-	CPLFree(paBlueLayer);
+	GDALThreadPool::RunJobs(nStrips, PooledLuminosityJobFunc, &oJob,
+			MIN(nThreads, poPool->GetMaxHandles()));
+
+	for (int i = 0; i < nStrips; i++)
+		if (aeErrors[i] != CE_None)
+			return CE_Failure;
 
 	return CE_None;
 }
 
 void GDALSimpleSURF::ExtractFeaturePoints(GDALIntegralImage *poImg,
 			GDALFeaturePointsCollection *poCollection, double dfThreshold)
+{
+	int nFirstNew = poCollection->GetSize();
+
+	ComputeHessianMap(poImg);
+	DetectExtrema(poCollection, dfThreshold);
+	ComputeDescriptors(poImg, poCollection, nFirstNew);
+}
+
+void GDALSimpleSURF::ComputeHessianMap(GDALIntegralImage *poImg)
 {
 	//Calc Hessian values for layers
 	poOctMap->ComputeMap(poImg);
+}
 
-	//Search for exremum points
+void GDALSimpleSURF::ComputeHessianOctave(GDALIntegralImage *poImg, int nOctave)
+{
+	poOctMap->ComputeOctave(poImg, nOctave);
+}
+
+void GDALSimpleSURF::ReleaseHessianOctave(int nOctave)
+{
+	poOctMap->ReleaseOctave(nOctave);
+}
+
+GIntBig GDALSimpleSURF::GetHessianMemoryUsage() const
+{
+	return poOctMap->GetMemoryUsage();
+}
+
+void GDALSimpleSURF::DetectExtrema(GDALFeaturePointsCollection *poCollection,
+		double dfThreshold, GDALCorrelatorStats *poStats)
+{
 	for (int oct = octaveStart; oct <= octaveEnd; oct++)
+		DetectOctaveExtrema(oct, poCollection, dfThreshold, poStats);
+}
+
+void GDALSimpleSURF::DetectOctaveExtrema(int nOctave,
+		GDALFeaturePointsCollection *poCollection, double dfThreshold,
+		GDALCorrelatorStats *poStats)
+{
+	//Search for exremum points
+	int oct = nOctave;
+	int nFirstNew = poCollection->GetSize();
+	GIntBig nCandidates = 0;
+
+	for (int k = 0; k < GDALOctaveMap::INTERVALS - 2; k++)
 	{
-		for (int k = 0; k < GDALOctaveMap::INTERVALS - 2; k++)
+		GDALOctaveLayer *bot = poOctMap->pMap[oct - 1][k];
+		GDALOctaveLayer *mid = poOctMap->pMap[oct - 1][k + 1];
+		GDALOctaveLayer *top = poOctMap->pMap[oct - 1][k + 2];
+
+		for (int i = 0; i < mid->height; i++)
 		{
-			GDALOctaveLayer *bot = poOctMap->pMap[oct - 1][k];
-			GDALOctaveLayer *mid = poOctMap->pMap[oct - 1][k + 1];
-			GDALOctaveLayer *top = poOctMap->pMap[oct - 1][k + 2];
+			// Counted separately, so loop below is the same as without
+			// stats. Border without full neighbourhood isn't checked
+			if (poStats != NULL && i > top->radius &&
+					i + top->radius < mid->height)
+				for (int j = top->radius + 1; j + top->radius < mid->width; j++)
+					if (mid->detHessians[i][j] >= dfThreshold)
+						nCandidates++;
 
-			for (int i = 0; i < mid->height; i++)
-				for (int j = 0; j < mid->width; j++)
-					if (poOctMap->PointIsExtremum(i, j, bot, mid, top, dfThreshold))
-					{
-						GDALFeaturePoint *poFP = new GDALFeaturePoint(
-								j, i, mid->scale,
-								mid->radius, mid->signs[i][j]);
-						SetDescriptor(poFP, poImg);
+			for (int j = 0; j < mid->width; j++)
+				if (poOctMap->PointIsExtremum(i, j, bot, mid, top, dfThreshold))
+					poCollection->NewPoint(j, i, mid->scale,
+							mid->radius, mid->signs[i][j]);
+		}
+	}
 
-						poCollection->AddPoint(poFP);
-					}
+	if (poStats != NULL)
+	{
+		GDALOctaveLayer *poLayer = poOctMap->pMap[oct - 1][0];
+		poStats->AddOctave(oct, (GIntBig)poLayer->width * poLayer->height,
+				nCandidates, poCollection->GetSize() - nFirstNew);
+	}
+}
+
+void GDALSimpleSURF::ComputeDescriptors(GDALIntegralImage *poImg,
+		GDALFeaturePointsCollection *poCollection, int nFirst)
+{
+	// Points are ordered by octave, and all layers of octave
+	// have the same scale, so table is rebuilt once per octave
+	HaarSamplingTable *poTable = NULL;
+
+	for (int i = MAX(nFirst, 0); i < poCollection->GetSize(); i++)
+	{
+		GDALFeaturePoint *poPoint = poCollection->GetPoint(i);
+
+		if (poTable == NULL || poTable->scale != poPoint->GetScale())
+		{
+			delete poTable;
+			poTable = new HaarSamplingTable(poPoint->GetScale(),
+					poImg->GetWidth());
 		}
+
+		SetDescriptor(poPoint, poImg, poTable);
 	}
+
+	delete poTable;
 }
 
 double GDALSimpleSURF::GetEuclideanDistance(
 		GDALFeaturePoint &firstPoint, GDALFeaturePoint &secondPoint)
 {
-	double sum = 0;
-
-	for (int i = 0; i < GDALFeaturePoint::DESC_SIZE; i++)
-		sum += (firstPoint[i] - secondPoint[i]) * (firstPoint[i] - secondPoint[i]);
-
-	return sqrt(sum);
+	return sqrt(GDALDescriptorMatrix::GetSquaredDistance(
+			firstPoint.GetDescriptor(), secondPoint.GetDescriptor()));
 }
 
-void GDALSimpleSURF::NormalizeDistances(list<MatchedPointPairInfo> *poList)
+void GDALSimpleSURF::NormalizeDistances(vector<MatchedPointPairInfo> *poList)
 {
 	double max = 0;
 
-	list<MatchedPointPairInfo>::iterator i;
+	vector<MatchedPointPairInfo>::iterator i;
 	for (i = poList->begin(); i != poList->end(); i++)
 		if ((*i).euclideanDist > max)
 			max = (*i).euclideanDist;
@@ -195,117 +751,548 @@ void GDALSimpleSURF::SetDescriptor(
 		}
 }
 
-CPLErr GDALSimpleSURF::MatchFeaturePoints(
-		GDALMatchedPointsCollection *poMatched,
-		GDALFeaturePointsCollection *poFirstCollect,
-		GDALFeaturePointsCollection *poSecondCollect,
-		double dfThreshold)
-{
 /* -------------------------------------------------------------------- */
-/*      Validate parameters.                                            */
+/*      Descriptor kernels. Every quadrant accumulates its samples      */
+/*      in order, and wavelets are evaluated with the same rectangles   */
+/*      and summation order as by GetRectangleSum, so all kernels give  */
+/*      the same result. Vector kernels process one quadrant per lane.  */
+/*      Offsets of corner k of sample s of quadrant q are stored at     */
+/*      (s * 8 + k) * quadrants + q.                                    */
 /* -------------------------------------------------------------------- */
-	if (poMatched == NULL)
-	{
-		CPLError(CE_Failure, CPLE_AppDefined,
-				"Matched points colection isn't specified");
-		return CE_Failure;
-	}
+static const int DESC_QUADS = GDALFeaturePoint::DESC_SIZE / 4;
 
-	if (poFirstCollect == NULL || poSecondCollect == NULL)
+static void DescriptorKernelScalar(const double *padfBase,
+		const int *panOffsets, int nSamples, double *padfDescriptor)
+{
+	for (int q = 0; q < DESC_QUADS; q++)
 	{
-		CPLError(CE_Failure, CPLE_AppDefined,
-				"Feature point collections are not specified");
-		return CE_Failure;
-	}
-
-/* ==================================================================== */
-/*      Matching algorithm.                                             */
-/* ==================================================================== */
-	// Affects to false matching pruning
-	const double ratioThreshold = 0.8;
+		double dx = 0;
+		double dy = 0;
+		double abs_dx = 0;
+		double abs_dy = 0;
 
-	int len_1 = poFirstCollect->GetSize();
-	int len_2 = poSecondCollect->GetSize();
+		for (int s = 0; s < nSamples; s++)
+		{
+			// 3x3 grid of corners without the central one, row by row
+			const int *panCorners = panOffsets + s * 8 * DESC_QUADS + q;
+			double v00 = padfBase[panCorners[0]];
+			double v01 = padfBase[panCorners[DESC_QUADS]];
+			double v02 = padfBase[panCorners[2 * DESC_QUADS]];
+			double v10 = padfBase[panCorners[3 * DESC_QUADS]];
+			double v12 = padfBase[panCorners[4 * DESC_QUADS]];
+			double v20 = padfBase[panCorners[5 * DESC_QUADS]];
+			double v21 = padfBase[panCorners[6 * DESC_QUADS]];
+			double v22 = padfBase[panCorners[7 * DESC_QUADS]];
 
-	int minLength = (len_1 < len_2) ? len_1 : len_2;
+			// Same rectangles and summation order as in GetRectangleSum
+			double right = v01 + v22 - v02 - v21;
+			double left = v00 + v21 - v01 - v20;
+			double bottom = v10 + v22 - v12 - v20;
+			double top = v00 + v12 - v02 - v10;
 
-	// Temporary pointers. Used to swap collections
-	GDALFeaturePointsCollection *p_1;
-	GDALFeaturePointsCollection *p_2;
+			right = (right > 0) ? right : 0;
+			left = (left > 0) ? left : 0;
+			bottom = (bottom > 0) ? bottom : 0;
+			top = (top > 0) ? top : 0;
 
-	bool isSwap = false;
+			// Gradients
+			double cur_dx = right - left;
+			double cur_dy = bottom - top;
 
-	// Assign p_1 - collection with minimal number of points
-	if (minLength == len_2)
-	{
-		p_1 = poSecondCollect;
-		p_2 = poFirstCollect;
+			dx += cur_dx;
+			dy += cur_dy;
+			abs_dx += fabs(cur_dx);
+			abs_dy += fabs(cur_dy);
+		}
 
-		int tmp = 0;
-		tmp = len_1;
-		len_1 = len_2;
-		len_2 = tmp;
-		isSwap = true;
+		// Fills point's descriptor
+		padfDescriptor[4 * q] = dx;
+		padfDescriptor[4 * q + 1] = dy;
+		padfDescriptor[4 * q + 2] = abs_dx;
+		padfDescriptor[4 * q + 3] = abs_dy;
 	}
-	else
-	{
-		// Assignment 'as is'
-		p_1 = poFirstCollect;
-		p_2 = poSecondCollect;
-		isSwap = false;
-	}
-
-	// Stores matched point indexes and
-	// their euclidean distances
-	list<MatchedPointPairInfo> *poPairInfoList =
-			new list<MatchedPointPairInfo>();
+}
 
-	// Flags that points in the 2nd collection are matched or not
-	bool *alreadyMatched = new bool[len_2];
-	for (int i = 0; i < len_2; i++)
-		alreadyMatched[i] = false;
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+#if !defined(__SSE2__)
+GDAL_CORRELATOR_TARGET("sse2")
+#endif
+static void DescriptorKernelSSE2(const double *padfBase,
+		const int *panOffsets, int nSamples, double *padfDescriptor)
+{
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d sign = _mm_set1_pd(-0.0);
 
-	for (int i = 0; i < len_1; i++)
+	for (int q = 0; q < DESC_QUADS; q += 2)
 	{
-		// Distance to the nearest point
-		double bestDist = -1;
-		// Index of the nearest point in p_2 collection
-		int bestIndex = -1;
+		__m128d dx = zero, dy = zero, abs_dx = zero, abs_dy = zero;
 
-		// Distance to the 2nd nearest point
-		double bestDist_2 = -1;
+		for (int s = 0; s < nSamples; s++)
+		{
+			const int *panCorners = panOffsets + s * 8 * DESC_QUADS + q;
 
-		// Find the nearest and 2nd nearest points
-		for (int j = 0; j < len_2; j++)
-			if (!alreadyMatched[j])
-				if (p_1->GetPoint(i)->GetSign() ==
-						p_2->GetPoint(j)->GetSign())
+			__m128d v[8];
+			for (int k = 0; k < 8; k++)
+				v[k] = _mm_loadh_pd(_mm_load_sd(
+						padfBase + panCorners[k * DESC_QUADS]),
+						padfBase + panCorners[k * DESC_QUADS + 1]);
+
+			// v00 v01 v02 v10 v12 v20 v21 v22
+			__m128d right = _mm_max_pd(_mm_sub_pd(_mm_sub_pd(
+					_mm_add_pd(v[1], v[7]), v[2]), v[6]), zero);
+			__m128d left = _mm_max_pd(_mm_sub_pd(_mm_sub_pd(
+					_mm_add_pd(v[0], v[6]), v[1]), v[5]), zero);
+			__m128d bottom = _mm_max_pd(_mm_sub_pd(_mm_sub_pd(
+					_mm_add_pd(v[3], v[7]), v[4]), v[5]), zero);
+			__m128d top = _mm_max_pd(_mm_sub_pd(_mm_sub_pd(
+					_mm_add_pd(v[0], v[4]), v[2]), v[3]), zero);
+
+			__m128d cur_dx = _mm_sub_pd(right, left);
+			__m128d cur_dy = _mm_sub_pd(bottom, top);
+
+			dx = _mm_add_pd(dx, cur_dx);
+			dy = _mm_add_pd(dy, cur_dy);
+			abs_dx = _mm_add_pd(abs_dx, _mm_andnot_pd(sign, cur_dx));
+			abs_dy = _mm_add_pd(abs_dy, _mm_andnot_pd(sign, cur_dy));
+		}
+
+		_mm_storeu_pd(padfDescriptor + 4 * q, _mm_unpacklo_pd(dx, dy));
+		_mm_storeu_pd(padfDescriptor + 4 * q + 2, _mm_unpacklo_pd(abs_dx, abs_dy));
+		_mm_storeu_pd(padfDescriptor + 4 * q + 4, _mm_unpackhi_pd(dx, dy));
+		_mm_storeu_pd(padfDescriptor + 4 * q + 6, _mm_unpackhi_pd(abs_dx, abs_dy));
+	}
+}
+#endif
+
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+GDAL_CORRELATOR_TARGET("avx2")
+static void DescriptorKernelAVX2(const double *padfBase,
+		const int *panOffsets, int nSamples, double *padfDescriptor)
+{
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d sign = _mm256_set1_pd(-0.0);
+
+	for (int q = 0; q < DESC_QUADS; q += 4)
+	{
+		__m256d dx = zero, dy = zero, abs_dx = zero, abs_dy = zero;
+
+		for (int s = 0; s < nSamples; s++)
+		{
+			const int *panCorners = panOffsets + s * 8 * DESC_QUADS + q;
+
+			__m256d v[8];
+			for (int k = 0; k < 8; k++)
+				v[k] = _mm256_i32gather_pd(padfBase, _mm_loadu_si128(
+						(const __m128i *)(panCorners + k * DESC_QUADS)), 8);
+
+			// v00 v01 v02 v10 v12 v20 v21 v22
+			__m256d right = _mm256_max_pd(_mm256_sub_pd(_mm256_sub_pd(
+					_mm256_add_pd(v[1], v[7]), v[2]), v[6]), zero);
+			__m256d left = _mm256_max_pd(_mm256_sub_pd(_mm256_sub_pd(
+					_mm256_add_pd(v[0], v[6]), v[1]), v[5]), zero);
+			__m256d bottom = _mm256_max_pd(_mm256_sub_pd(_mm256_sub_pd(
+					_mm256_add_pd(v[3], v[7]), v[4]), v[5]), zero);
+			__m256d top = _mm256_max_pd(_mm256_sub_pd(_mm256_sub_pd(
+					_mm256_add_pd(v[0], v[4]), v[2]), v[3]), zero);
+
+			__m256d cur_dx = _mm256_sub_pd(right, left);
+			__m256d cur_dy = _mm256_sub_pd(bottom, top);
+
+			dx = _mm256_add_pd(dx, cur_dx);
+			dy = _mm256_add_pd(dy, cur_dy);
+			abs_dx = _mm256_add_pd(abs_dx, _mm256_andnot_pd(sign, cur_dx));
+			abs_dy = _mm256_add_pd(abs_dy, _mm256_andnot_pd(sign, cur_dy));
+		}
+
+		// Transpose, so every register holds values of one quadrant
+		__m256d t0 = _mm256_unpacklo_pd(dx, dy);
+		__m256d t1 = _mm256_unpackhi_pd(dx, dy);
+		__m256d t2 = _mm256_unpacklo_pd(abs_dx, abs_dy);
+		__m256d t3 = _mm256_unpackhi_pd(abs_dx, abs_dy);
+
+		_mm256_storeu_pd(padfDescriptor + 4 * q,
+				_mm256_permute2f128_pd(t0, t2, 0x20));
+		_mm256_storeu_pd(padfDescriptor + 4 * q + 4,
+				_mm256_permute2f128_pd(t1, t3, 0x20));
+		_mm256_storeu_pd(padfDescriptor + 4 * q + 8,
+				_mm256_permute2f128_pd(t0, t2, 0x31));
+		_mm256_storeu_pd(padfDescriptor + 4 * q + 12,
+				_mm256_permute2f128_pd(t1, t3, 0x31));
+	}
+}
+
+GDAL_CORRELATOR_TARGET("avx512f") GDAL_CORRELATOR_NO_CONTRACT
+static void DescriptorKernelAVX512(const double *padfBase,
+		const int *panOffsets, int nSamples, double *padfDescriptor)
+{
+	const __m512d zero = _mm512_setzero_pd();
+	const __m512i sign = _mm512_set1_epi64(0x7FFFFFFFFFFFFFFFLL);
+
+	for (int q = 0; q < DESC_QUADS; q += 8)
+	{
+		__m512d dx = zero, dy = zero, abs_dx = zero, abs_dy = zero;
+
+		for (int s = 0; s < nSamples; s++)
+		{
+			const int *panCorners = panOffsets + s * 8 * DESC_QUADS + q;
+
+			__m512d v[8];
+			for (int k = 0; k < 8; k++)
+				v[k] = _mm512_i32gather_pd(_mm256_loadu_si256(
+						(const __m256i *)(panCorners + k * DESC_QUADS)),
+						padfBase, 8);
+
+			// v00 v01 v02 v10 v12 v20 v21 v22
+			__m512d right = _mm512_max_pd(_mm512_sub_pd(_mm512_sub_pd(
+					_mm512_add_pd(v[1], v[7]), v[2]), v[6]), zero);
+			__m512d left = _mm512_max_pd(_mm512_sub_pd(_mm512_sub_pd(
+					_mm512_add_pd(v[0], v[6]), v[1]), v[5]), zero);
+			__m512d bottom = _mm512_max_pd(_mm512_sub_pd(_mm512_sub_pd(
+					_mm512_add_pd(v[3], v[7]), v[4]), v[5]), zero);
+			__m512d top = _mm512_max_pd(_mm512_sub_pd(_mm512_sub_pd(
+					_mm512_add_pd(v[0], v[4]), v[2]), v[3]), zero);
+
+			__m512d cur_dx = _mm512_sub_pd(right, left);
+			__m512d cur_dy = _mm512_sub_pd(bottom, top);
+
+			dx = _mm512_add_pd(dx, cur_dx);
+			dy = _mm512_add_pd(dy, cur_dy);
+			abs_dx = _mm512_add_pd(abs_dx, _mm512_castsi512_pd(
+					_mm512_and_epi64(_mm512_castpd_si512(cur_dx), sign)));
+			abs_dy = _mm512_add_pd(abs_dy, _mm512_castsi512_pd(
+					_mm512_and_epi64(_mm512_castpd_si512(cur_dy), sign)));
+		}
+
+		double adfValues[4][8];
+		_mm512_storeu_pd(adfValues[0], dx);
+		_mm512_storeu_pd(adfValues[1], dy);
+		_mm512_storeu_pd(adfValues[2], abs_dx);
+		_mm512_storeu_pd(adfValues[3], abs_dy);
+
+		for (int i = 0; i < 8; i++)
+			for (int j = 0; j < 4; j++)
+				padfDescriptor[4 * (q + i) + j] = adfValues[j][i];
+	}
+}
+#endif
+
+typedef void (*DescriptorKernelFunc)(const double *padfBase,
+		const int *panOffsets, int nSamples, double *padfDescriptor);
+
+static DescriptorKernelFunc GetDescriptorKernel()
+{
+	switch (GDALCPUDispatch::GetLevel())
+	{
+#if defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_AVX512:
+			return DescriptorKernelAVX512;
+		case GDALCPUDispatch::LEVEL_AVX2:
+			return DescriptorKernelAVX2;
+#endif
+#if defined(__SSE2__) || defined(GDAL_CORRELATOR_HAVE_DISPATCH)
+		case GDALCPUDispatch::LEVEL_SSE2:
+			return DescriptorKernelSSE2;
+#endif
+		default:
+			return DescriptorKernelScalar;
+	}
+}
+
+GDALSimpleSURF::HaarSamplingTable::HaarSamplingTable(int nScale, int nImgWidth)
+{
+	scale = nScale;
+	width = nImgWidth;
+
+	// Geometry is the same as in range checked SetDescriptor
+	const int haarScale = 20;
+	int haarFilterSize = 2 * nScale;
+	int half = haarFilterSize / 2;
+	int descSide = haarScale * nScale;
+	int quadStep = descSide / 4;
+	int subQuadStep = quadStep / 5;
+
+	int leftTop_row = -(descSide / 2);
+	int leftTop_col = -(descSide / 2);
+
+	minRow = minCol = 0;
+	maxRow = maxCol = 0;
+	bool isFirst = true;
+
+	int q = 0;
+
+	for (int r = leftTop_row; r < leftTop_row + descSide; r += quadStep)
+		for (int c = leftTop_col; c < leftTop_col + descSide; c += quadStep, q++)
+		{
+			int s = 0;
+
+			for (int sub_r = r; sub_r < r + quadStep; sub_r += subQuadStep)
+				for (int sub_c = c; sub_c < c + quadStep; sub_c += subQuadStep, s++)
+				{
+					int cur_r = sub_r + subQuadStep / 2 - haarFilterSize / 2;
+					int cur_c = sub_c + subQuadStep / 2 - haarFilterSize / 2;
+
+					// Rows and columns of corners, which are used by
+					// GetRectangleSum for both wavelets
+					int anRows[3] = { cur_r - 1, cur_r + half - 1, cur_r + 2 * half - 1 };
+					int anCols[3] = { cur_c - 1, cur_c + half - 1, cur_c + 2 * half - 1 };
+
+					// The central corner isn't used by either wavelet
+					int k = 0;
+					for (int i = 0; i < 3; i++)
+						for (int j = 0; j < 3; j++)
+							if (i != 1 || j != 1)
+								anOffsets[(s * CORNERS + k++) * QUADS + q] =
+										anRows[i] * nImgWidth + anCols[j];
+
+					if (isFirst || anRows[0] < minRow) minRow = anRows[0];
+					if (isFirst || anRows[2] > maxRow) maxRow = anRows[2];
+					if (isFirst || anCols[0] < minCol) minCol = anCols[0];
+					if (isFirst || anCols[2] > maxCol) maxCol = anCols[2];
+					isFirst = false;
+				}
+		}
+}
+
+bool GDALSimpleSURF::HaarSamplingTable::IsInside(
+		int nRow, int nCol, int nImgHeight) const
+{
+	return nRow + minRow >= 0 && nRow + maxRow < nImgHeight &&
+			nCol + minCol >= 0 && nCol + maxCol < width;
+}
+
+void GDALSimpleSURF::SetDescriptor(GDALFeaturePoint *poPoint,
+		GDALIntegralImage *poImg, const HaarSamplingTable *poTable)
+{
+	// Reference level uses range checked descriptors only
+	if (poTable == NULL || poTable->scale != poPoint->GetScale() ||
+			GDALCPUDispatch::GetLevel() == GDALCPUDispatch::LEVEL_REFERENCE ||
+			poTable->width != poImg->GetWidth() ||
+			!poTable->IsInside(poPoint->GetY(), poPoint->GetX(), poImg->GetHeight()))
+	{
+		SetDescriptor(poPoint, poImg);
+		return;
+	}
+
+	// Integral image value in the point's position
+	const double *padfBase = poImg->GetData() +
+			(size_t)poPoint->GetY() * poImg->GetWidth() + poPoint->GetX();
+
+	GetDescriptorKernel()(padfBase, poTable->anOffsets,
+			HaarSamplingTable::QUAD_SAMPLES, poPoint->GetDescriptor());
+}
+
+void GDALSimpleSURF::BuildBuckets(GDALFeaturePointsCollection *poCollection,
+		bool bByScale, vector<DescriptorBucket> *paoBuckets)
+{
+	// Indexes of points for every pair of sign and scale.
+	// Indexes are added in ascending order
+	map< pair<int, int>, vector<int> > oKeys;
+
+	for (int i = 0; i < poCollection->GetSize(); i++)
+	{
+		GDALFeaturePoint *poPoint = poCollection->GetPoint(i);
+		pair<int, int> oKey(poPoint->GetSign(), bByScale ? poPoint->GetScale() : 0);
+		oKeys[oKey].push_back(i);
+	}
+
+	paoBuckets->resize(oKeys.size());
+
+	int nBucket = 0;
+	map< pair<int, int>, vector<int> >::const_iterator iter;
+	for (iter = oKeys.begin(); iter != oKeys.end(); iter++, nBucket++)
+	{
+		DescriptorBucket &oBucket = (*paoBuckets)[nBucket];
+		oBucket.nSign = iter->first.first;
+		oBucket.nScale = iter->first.second;
+		oBucket.oMatrix.Initialize(poCollection,
+				&iter->second[0], iter->second.size());
+	}
+}
+
+CPLErr GDALSimpleSURF::MatchFeaturePoints(
+		GDALMatchedPointsCollection *poMatched,
+		GDALFeaturePointsCollection *poFirstCollect,
+		GDALFeaturePointsCollection *poSecondCollect,
+		double dfThreshold, double dfMaxScaleRatio,
+		GDALCorrelatorStats *poStats)
+{
+	GDALCorrelatorStats::Timer oTimer(poStats, GDALCorrelatorStats::STAGE_MATCHING);
+
+/* -------------------------------------------------------------------- */
+/*      Validate parameters.                                            */
+/* -------------------------------------------------------------------- */
+	if (poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points colection isn't specified");
+		return CE_Failure;
+	}
+
+	if (poFirstCollect == NULL || poSecondCollect == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature point collections are not specified");
+		return CE_Failure;
+	}
+
+/* ==================================================================== */
+/*      Matching algorithm.                                             */
+/* ==================================================================== */
+	// Affects to false matching pruning
+	const double ratioThreshold = 0.8;
+
+	int len_1 = poFirstCollect->GetSize();
+	int len_2 = poSecondCollect->GetSize();
+
+	int minLength = (len_1 < len_2) ? len_1 : len_2;
+
+	// Temporary pointers. Used to swap collections
+	GDALFeaturePointsCollection *p_1;
+	GDALFeaturePointsCollection *p_2;
+
+	bool isSwap = false;
+
+	// Assign p_1 - collection with minimal number of points
+	if (minLength == len_2)
+	{
+		p_1 = poSecondCollect;
+		p_2 = poFirstCollect;
+
+		int tmp = 0;
+		tmp = len_1;
+		len_1 = len_2;
+		len_2 = tmp;
+		isSwap = true;
+	}
+	else
+	{
+		// Assignment 'as is'
+		p_1 = poFirstCollect;
+		p_2 = poSecondCollect;
+		isSwap = false;
+	}
+
+	// Stores matched point indexes and
+	// their euclidean distances
+	vector<MatchedPointPairInfo> *poPairInfoList =
+			new vector<MatchedPointPairInfo>();
+
+	// Flags that points in the 2nd collection are matched or not
+	bool *alreadyMatched = new bool[len_2];
+	for (int i = 0; i < len_2; i++)
+		alreadyMatched[i] = false;
+
+/* -------------------------------------------------------------------- */
+/*      Split the 2nd collection into contiguous buckets by sign and,   */
+/*      if scale constraint is enabled, by scale. Inside bucket points  */
+/*      keep their order, so without scale constraint every point is    */
+/*      compared with the same candidates in the same order as before.  */
+/* -------------------------------------------------------------------- */
+	bool bByScale = dfMaxScaleRatio > 0;
+	vector<DescriptorBucket> aoBuckets;
+	BuildBuckets(p_2, bByScale, &aoBuckets);
+
+	// Compatible buckets for every pair of sign and scale of query
+	map< pair<int, int>, vector<int> > oCompatible;
+
+	// Counters are local, so matching without statistics costs the same
+	GIntBig nDistances = 0;
+	GIntBig nRatioRejections = 0;
+
+	GDALDescriptorMatrix::DistanceKernelFunc pfnDistance =
+			GDALDescriptorMatrix::GetDistanceKernel();
+
+	for (int i = 0; i < len_1; i++)
+	{
+		// Distance to the nearest point
+		double bestDist = -1;
+		// Index of the nearest point in p_2 collection
+		int bestIndex = -1;
+
+		// Distance to the 2nd nearest point
+		double bestDist_2 = -1;
+
+		// Candidates, which squared distance exceeds this bound,
+		// can't change the nearest and the 2nd nearest points
+		double dfBound = HUGE_VAL;
+
+		GDALFeaturePoint *poPoint = p_1->GetPoint(i);
+		const double *padfQuery = poPoint->GetDescriptor();
+
+		pair<int, int> oKey(poPoint->GetSign(), bByScale ? poPoint->GetScale() : 0);
+		if (oCompatible.find(oKey) == oCompatible.end())
+		{
+			vector<int> &anBuckets = oCompatible[oKey];
+			for (int b = 0; b < (int)aoBuckets.size(); b++)
+			{
+				if (aoBuckets[b].nSign != oKey.first)
+					continue;
+
+				if (bByScale)
 				{
-					// Get distance between two feature points
-					double curDist = GetEuclideanDistance(
-							*(p_1->GetPoint(i)), *(p_2->GetPoint(j)));
+					double dfScale_1 = oKey.second;
+					double dfScale_2 = aoBuckets[b].nScale;
+					if (dfScale_1 <= 0 || dfScale_2 <= 0 ||
+							dfScale_1 > dfScale_2 * dfMaxScaleRatio ||
+							dfScale_2 > dfScale_1 * dfMaxScaleRatio)
+						continue;
+				}
+
+				anBuckets.push_back(b);
+			}
+		}
+		const vector<int> &anBuckets = oCompatible[oKey];
+
+		// Find the nearest and 2nd nearest points
+		for (size_t b = 0; b < anBuckets.size(); b++)
+		{
+			const GDALDescriptorMatrix &oMatrix = aoBuckets[anBuckets[b]].oMatrix;
+
+			for (int r = 0; r < oMatrix.GetRows(); r++)
+			{
+				int j = oMatrix.GetIndex(r);
+				if (alreadyMatched[j])
+					continue;
+
+				nDistances++;
+
+				// Get distance between two feature points.
+				// Computation is abandoned if it exceeds the bound
+				double curSquared = pfnDistance(
+						padfQuery, oMatrix.GetRow(r), dfBound);
+				if (curSquared > dfBound)
+					continue;
+
+				double curDist = sqrt(curSquared);
 
-					if (bestDist == -1)
+				if (bestDist == -1)
+				{
+					bestDist = curDist;
+					bestIndex = j;
+				}
+				else
+				{
+					if (curDist < bestDist)
 					{
 						bestDist = curDist;
 						bestIndex = j;
 					}
-					else
-					{
-						if (curDist < bestDist)
-						{
-							bestDist = curDist;
-							bestIndex = j;
-						}
-					}
+				}
 
-					// Findes the 2nd nearest point
-					if (bestDist_2 < 0)
+				// Findes the 2nd nearest point
+				if (bestDist_2 < 0)
+					bestDist_2 = curDist;
+				else
+					if (curDist > bestDist && curDist < bestDist_2)
 						bestDist_2 = curDist;
-					else
-						if (curDist > bestDist && curDist < bestDist_2)
-							bestDist_2 = curDist;
-				}
+
+				// bestDist_2 is never less than bestDist, so candidates
+				// not closer than bestDist_2 affect nothing. Margin keeps
+				// decision the same as comparison of square roots
+				dfBound = bestDist_2 * bestDist_2 * (1 + 4 * DBL_EPSILON);
+			}
+		}
+
 /* -------------------------------------------------------------------- */
 /*	    False matching pruning.                                         */
 /* If ratio bestDist to bestDist_2 greater than 0.8 =>                  */
@@ -313,22 +1300,62 @@ CPLErr GDALSimpleSURF::MatchFeaturePoints(
 /* Otherwise, add points as matched pair.                               */
 /*----------------------------------------------------------------------*/
 		if (bestDist_2 > 0 && bestDist >= 0)
+		{
 			if (bestDist / bestDist_2 < ratioThreshold)
 			{
 				MatchedPointPairInfo info(i, bestIndex, bestDist);
 				poPairInfoList->push_back(info);
 				alreadyMatched[bestIndex] = true;
 			}
+			else
+				nRatioRejections++;
+		}
+	}
+
+	int nMatchedBefore = poMatched->GetSize();
+	CPLErr eErr = AddMatchedPairs(poMatched, poPairInfoList, p_1, p_2, isSwap, dfThreshold, true);
+
+	if (poStats != NULL)
+	{
+		poStats->nDistanceEvaluations += nDistances;
+		poStats->nRatioRejections += nRatioRejections;
+		poStats->nMatches += poMatched->GetSize() - nMatchedBefore;
 	}
 
+	// Clean up
+	delete[] alreadyMatched;
+	delete poPairInfoList;
+
+	return eErr;
+}
+
+CPLErr GDALSimpleSURF::AddMatchedPairs(GDALMatchedPointsCollection *poMatched,
+		vector<MatchedPointPairInfo> *poPairInfoList,
+		GDALFeaturePointsCollection *p_1, GDALFeaturePointsCollection *p_2,
+		bool isSwap, double dfThreshold, bool bNormalize)
+{
+	// Pairs refer to points of matched collections without copying
+	bool bReferences = poMatched->HasExternalSources();
+	if (bReferences &&
+			(poMatched->GetFirstSource() != (isSwap ? p_2 : p_1) ||
+			poMatched->GetSecondSource() != (isSwap ? p_1 : p_2)))
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Sources of matched points collection differ from matched collections");
+		return CE_Failure;
+	}
 
 /* -------------------------------------------------------------------- */
 /*      Pruning based on the provided threshold                         */
 /* -------------------------------------------------------------------- */
 
-	NormalizeDistances(poPairInfoList);
+	if (bNormalize)
+		NormalizeDistances(poPairInfoList);
+
+	if (bReferences)
+		poMatched->Reserve(poMatched->GetSize() + poPairInfoList->size());
 
-	list<MatchedPointPairInfo>::const_iterator iter;
+	vector<MatchedPointPairInfo>::const_iterator iter;
 	for (iter = poPairInfoList->begin(); iter != poPairInfoList->end(); iter++)
 	{
 		if ((*iter).euclideanDist <= dfThreshold)
@@ -336,32 +1363,976 @@ CPLErr GDALSimpleSURF::MatchFeaturePoints(
 			int i_1 = (*iter).ind_1;
 			int i_2 = (*iter).ind_2;
 
-			// New pair of matched points
-			GDALFeaturePoint *poPoint_1 = new GDALFeaturePoint();
-			GDALFeaturePoint *poPoint_2 = new GDALFeaturePoint();
+			if (bReferences)
+			{
+				if (!isSwap)
+					poMatched->AddPair(i_1, i_2, (*iter).euclideanDist);
+				else
+					poMatched->AddPair(i_2, i_1, (*iter).euclideanDist);
 
-			// Copy objects
-			(*poPoint_1) = (*p_1->GetPoint(i_1));
-			(*poPoint_2) = (*p_2->GetPoint(i_2));
+				continue;
+			}
 
 			// Add copies into MatchedCollection
 			if(!isSwap)
 			{
-				poMatched->AddPoints(poPoint_1, poPoint_2);
+				poMatched->AddPointCopies(*p_1->GetPoint(i_1),
+						*p_2->GetPoint(i_2), (*iter).euclideanDist);
 			}
 			else
 			{
-				poMatched->AddPoints(poPoint_2, poPoint_1);
+				poMatched->AddPointCopies(*p_2->GetPoint(i_2),
+						*p_1->GetPoint(i_1), (*iter).euclideanDist);
 			}
 		}
 	}
 
-	// Clean up
-	delete[] alreadyMatched;
-
 	return CE_None;
 }
 
+CPLErr GDALSimpleSURF::MatchFeaturePointsAbsolute(
+		GDALMatchedPointsCollection *poMatched,
+		GDALFeaturePointsCollection *poFirstCollect,
+		GDALFeaturePointsCollection *poSecondCollect,
+		double dfMaxDistance)
+{
+/* -------------------------------------------------------------------- */
+/*      Validate parameters.                                            */
+/* -------------------------------------------------------------------- */
+	if (poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points colection isn't specified");
+		return CE_Failure;
+	}
+
+	if (poFirstCollect == NULL || poSecondCollect == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature point collections are not specified");
+		return CE_Failure;
+	}
+
+	if (dfMaxDistance < 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Maximal distance should be positive");
+		return CE_Failure;
+	}
+
+	// Affects to false matching pruning
+	const double ratioThreshold = 0.8;
+
+	// p_1 - collection with minimal number of points
+	bool isSwap = poSecondCollect->GetSize() <= poFirstCollect->GetSize();
+	GDALFeaturePointsCollection *p_1 = isSwap ? poSecondCollect : poFirstCollect;
+	GDALFeaturePointsCollection *p_2 = isSwap ? poFirstCollect : poSecondCollect;
+
+	int len_1 = p_1->GetSize();
+	int len_2 = p_2->GetSize();
+
+/* -------------------------------------------------------------------- */
+/*      Pair is accepted if bestDist <= dfMaxDistance and               */
+/*      bestDist < 0.8 * bestDist_2. Every candidate farther than       */
+/*      dfMaxDistance / 0.8 passes ratio test as the 2nd nearest,       */
+/*      so its exact distance isn't required.                           */
+/* -------------------------------------------------------------------- */
+	double dfFarSquared = (dfMaxDistance / ratioThreshold) *
+			(dfMaxDistance / ratioThreshold) * (1 + 4 * DBL_EPSILON);
+
+	vector<MatchedPointPairInfo> *poPairInfoList =
+			new vector<MatchedPointPairInfo>();
+
+	// Flags that points in the 2nd collection are matched or not
+	vector<bool> alreadyMatched(len_2, false);
+
+	GDALDescriptorMatrix::DistanceKernelFunc pfnDistance =
+			GDALDescriptorMatrix::GetDistanceKernel();
+
+	for (int i = 0; i < len_1; i++)
+	{
+		GDALFeaturePoint *poPoint = p_1->GetPoint(i);
+		const double *padfQuery = poPoint->GetDescriptor();
+
+		// Squared distances to the nearest and the 2nd nearest points
+		double bestSquared = HUGE_VAL;
+		double bestSquared_2 = HUGE_VAL;
+		int bestIndex = -1;
+		// Some candidate is farther than dfFarSquared
+		bool bHasFar = false;
+
+		for (int j = 0; j < len_2; j++)
+		{
+			if (alreadyMatched[j] ||
+					poPoint->GetSign() != p_2->GetPoint(j)->GetSign())
+				continue;
+
+			double dfBound = (bestSquared_2 < dfFarSquared) ?
+					bestSquared_2 : dfFarSquared;
+			double curSquared = pfnDistance(
+					padfQuery, p_2->GetPoint(j)->GetDescriptor(), dfBound);
+
+			if (curSquared > dfBound)
+			{
+				if (curSquared > dfFarSquared)
+					bHasFar = true;
+				continue;
+			}
+
+			if (curSquared < bestSquared)
+			{
+				bestSquared_2 = bestSquared;
+				bestSquared = curSquared;
+				bestIndex = j;
+			}
+			else if (curSquared < bestSquared_2)
+			{
+				bestSquared_2 = curSquared;
+			}
+		}
+
+		if (bestIndex < 0)
+			continue;
+
+		double bestDist = sqrt(bestSquared);
+		if (bestDist > dfMaxDistance)
+			continue;
+
+		bool bPassed = false;
+		if (bestSquared_2 != HUGE_VAL)
+			bPassed = bestSquared_2 > 0 &&
+					bestDist / sqrt(bestSquared_2) < ratioThreshold;
+		else
+			bPassed = bHasFar;
+
+		if (bPassed)
+		{
+			MatchedPointPairInfo info(i, bestIndex, bestDist);
+			poPairInfoList->push_back(info);
+			alreadyMatched[bestIndex] = true;
+		}
+	}
+
+	CPLErr eErr = AddMatchedPairs(poMatched, poPairInfoList, p_1, p_2, isSwap, dfMaxDistance, false);
+
+	delete poPairInfoList;
+
+	return eErr;
+}
+
+CPLErr GDALSimpleSURF::MatchFeaturePointsIndexed(
+		GDALMatchedPointsCollection *poMatched,
+		GDALFeaturePointsCollection *poFirstCollect,
+		GDALFeaturePointsCollection *poSecondCollect,
+		double dfThreshold, int nChecks, int nTrees)
+{
+/* -------------------------------------------------------------------- */
+/*      Validate parameters.                                            */
+/* -------------------------------------------------------------------- */
+	if (poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points colection isn't specified");
+		return CE_Failure;
+	}
+
+	if (poFirstCollect == NULL || poSecondCollect == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature point collections are not specified");
+		return CE_Failure;
+	}
+
+	if (nChecks <= 0 || nTrees <= 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Number of checks and trees should be positive");
+		return CE_Failure;
+	}
+
+	// Affects to false matching pruning
+	const double ratioThreshold = 0.8;
+	const int nDim = GDALFeaturePoint::DESC_SIZE;
+
+	// Index is built over collection with maximal number of points
+	bool isSwap = poSecondCollect->GetSize() <= poFirstCollect->GetSize();
+	GDALFeaturePointsCollection *p_1 = isSwap ? poSecondCollect : poFirstCollect;
+	GDALFeaturePointsCollection *p_2 = isSwap ? poFirstCollect : poSecondCollect;
+
+	int len_1 = p_1->GetSize();
+	int len_2 = p_2->GetSize();
+
+/* -------------------------------------------------------------------- */
+/*      Pack descriptors of the 2nd collection and build separate       */
+/*      forests for points with positive and negative signs.            */
+/* -------------------------------------------------------------------- */
+	double *padfData = new double[(size_t)len_2 * nDim + 1];
+	vector<int> anPositive;
+	vector<int> anNegative;
+
+	for (int j = 0; j < len_2; j++)
+	{
+		GDALFeaturePoint *poPoint = p_2->GetPoint(j);
+		for (int k = 0; k < nDim; k++)
+			padfData[(size_t)j * nDim + k] = (*poPoint)[k];
+
+		if (poPoint->GetSign() == 1)
+			anPositive.push_back(j);
+		else if (poPoint->GetSign() == -1)
+			anNegative.push_back(j);
+	}
+
+	GDALKDForest oPositive(nTrees);
+	GDALKDForest oNegative(nTrees);
+	if (!anPositive.empty())
+		oPositive.Build(padfData, len_2, nDim, &anPositive[0], anPositive.size());
+	if (!anNegative.empty())
+		oNegative.Build(padfData, len_2, nDim, &anNegative[0], anNegative.size());
+
+/* ==================================================================== */
+/*      Matching algorithm.                                             */
+/* ==================================================================== */
+	vector<MatchedPointPairInfo> *poPairInfoList =
+			new vector<MatchedPointPairInfo>();
+
+	// Flags that points in the 2nd collection are matched or not
+	bool *alreadyMatched = new bool[len_2 + 1];
+	for (int i = 0; i < len_2; i++)
+		alreadyMatched[i] = false;
+
+	GDALKDForest::SearchContext oContext;
+	double adfQuery[GDALFeaturePoint::DESC_SIZE];
+
+	for (int i = 0; i < len_1; i++)
+	{
+		GDALFeaturePoint *poPoint = p_1->GetPoint(i);
+
+		GDALKDForest *poForest = NULL;
+		if (poPoint->GetSign() == 1)
+			poForest = &oPositive;
+		else if (poPoint->GetSign() == -1)
+			poForest = &oNegative;
+
+		if (poForest == NULL || poForest->GetSize() == 0)
+			continue;
+
+		for (int k = 0; k < nDim; k++)
+			adfQuery[k] = (*poPoint)[k];
+
+		int bestIndex;
+		double bestDist, bestDist_2;
+		poForest->FindTwoNearest(adfQuery, nChecks, alreadyMatched, &oContext,
+				&bestIndex, &bestDist, &bestDist_2);
+
+		// Forest returns squared distances
+		if (bestDist_2 > 0 && bestDist >= 0)
+			if (sqrt(bestDist) / sqrt(bestDist_2) < ratioThreshold)
+			{
+				MatchedPointPairInfo info(i, bestIndex, sqrt(bestDist));
+				poPairInfoList->push_back(info);
+				alreadyMatched[bestIndex] = true;
+			}
+	}
+
+	CPLErr eErr = AddMatchedPairs(poMatched, poPairInfoList, p_1, p_2, isSwap, dfThreshold, true);
+
+	// Clean up
+	delete[] alreadyMatched;
+	delete[] padfData;
+	delete poPairInfoList;
+
+	return eErr;
+}
+
+CPLErr GDALSimpleSURF::MatchFeaturePointsBlocked(
+		GDALMatchedPointsCollection *poMatched,
+		GDALFeaturePointsCollection *poFirstCollect,
+		GDALFeaturePointsCollection *poSecondCollect,
+		double dfThreshold)
+{
+/* -------------------------------------------------------------------- */
+/*      Validate parameters.                                            */
+/* -------------------------------------------------------------------- */
+	if (poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points colection isn't specified");
+		return CE_Failure;
+	}
+
+	if (poFirstCollect == NULL || poSecondCollect == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature point collections are not specified");
+		return CE_Failure;
+	}
+
+	// p_1 - collection with minimal number of points
+	bool isSwap = poSecondCollect->GetSize() <= poFirstCollect->GetSize();
+	GDALFeaturePointsCollection *p_1 = isSwap ? poSecondCollect : poFirstCollect;
+	GDALFeaturePointsCollection *p_2 = isSwap ? poFirstCollect : poSecondCollect;
+
+/* -------------------------------------------------------------------- */
+/*      Pack descriptors separately for each sign of Hessian.           */
+/* -------------------------------------------------------------------- */
+	GDALDescriptorMatrix aoQueries[2];
+	GDALDescriptorMatrix aoBase[2];
+	// Position of point in packed matrix of its sign or -1
+	vector<int> anQueryRow;
+	vector<int> anBaseRow;
+
+	PackBySign(p_1, aoQueries, &anQueryRow);
+	PackBySign(p_2, aoBase, &anBaseRow);
+
+	return MatchPackedBySign(poMatched, p_1, p_2, isSwap, dfThreshold,
+			aoQueries, anQueryRow, aoBase, anBaseRow);
+}
+
+CPLErr GDALSimpleSURF::MatchFeaturePointsPrepacked(
+		GDALMatchedPointsCollection *poMatched,
+		GDALFeaturePointsCollection *poFirstCollect,
+		GDALFeaturePointsCollection *poSecondCollect,
+		const GDALDescriptorMatrix *paoSecondMatrices,
+		const vector<int> &anSecondRows, double dfThreshold)
+{
+/* -------------------------------------------------------------------- */
+/*      Validate parameters.                                            */
+/* -------------------------------------------------------------------- */
+	if (poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points colection isn't specified");
+		return CE_Failure;
+	}
+
+	if (poFirstCollect == NULL || poSecondCollect == NULL ||
+			paoSecondMatrices == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature point collections are not specified");
+		return CE_Failure;
+	}
+
+	if ((int)anSecondRows.size() != poSecondCollect->GetSize())
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Packed matrices don't correspond to the second collection");
+		return CE_Failure;
+	}
+
+	GDALDescriptorMatrix aoQueries[2];
+	vector<int> anQueryRow;
+	PackBySign(poFirstCollect, aoQueries, &anQueryRow);
+
+	return MatchPackedBySign(poMatched, poFirstCollect, poSecondCollect, false,
+			dfThreshold, aoQueries, anQueryRow, paoSecondMatrices, anSecondRows);
+}
+
+CPLErr GDALSimpleSURF::MatchPackedBySign(GDALMatchedPointsCollection *poMatched,
+		GDALFeaturePointsCollection *p_1, GDALFeaturePointsCollection *p_2,
+		bool isSwap, double dfThreshold,
+		const GDALDescriptorMatrix *paoQueries, const vector<int> &anQueryRow,
+		const GDALDescriptorMatrix *paoBase, const vector<int> &anBaseRow)
+{
+	// Affects to false matching pruning
+	const double ratioThreshold = 0.8;
+
+	int len_1 = p_1->GetSize();
+	int len_2 = p_2->GetSize();
+
+	// The nearest and the 2nd nearest points (indexes in p_2) for every point of p_1
+	vector<int> anBest(len_1, -1);
+	vector<int> anBest_2(len_1, -1);
+
+	for (int s = 0; s < 2; s++)
+	{
+		int nQueries = paoQueries[s].GetRows();
+		int nBase = paoBase[s].GetRows();
+		if (nQueries == 0 || nBase == 0)
+			continue;
+
+		vector<int> anRowBest(nQueries);
+		vector<int> anRowBest_2(nQueries);
+		vector<double> adfRowBest(nQueries);
+		vector<double> adfRowBest_2(nQueries);
+
+		GDALDescriptorMatrix::FindTwoNearest(paoQueries[s], paoBase[s],
+				&anRowBest[0], &adfRowBest[0], &anRowBest_2[0], &adfRowBest_2[0]);
+
+		for (int r = 0; r < nQueries; r++)
+		{
+			int i = paoQueries[s].GetIndex(r);
+			anBest[i] = (anRowBest[r] >= 0) ? paoBase[s].GetIndex(anRowBest[r]) : -1;
+			anBest_2[i] = (anRowBest_2[r] >= 0) ? paoBase[s].GetIndex(anRowBest_2[r]) : -1;
+		}
+	}
+
+/* ==================================================================== */
+/*      Greedy assignment in order of p_1, as in MatchFeaturePoints.    */
+/*      If one of candidates is already matched, the row is searched    */
+/*      again among unmatched points only.                              */
+/* ==================================================================== */
+	vector<MatchedPointPairInfo> *poPairInfoList =
+			new vector<MatchedPointPairInfo>();
+
+	vector<bool> alreadyMatched(len_2, false);
+
+	GDALDescriptorMatrix::DistanceKernelFunc pfnDistance =
+			GDALDescriptorMatrix::GetDistanceKernel();
+
+	for (int i = 0; i < len_1; i++)
+	{
+		if (anQueryRow[i] < 0)
+			continue;
+
+		int s = (p_1->GetPoint(i)->GetSign() == 1) ? 0 : 1;
+		const double *padfQuery = paoQueries[s].GetRow(anQueryRow[i]);
+
+		int bestIndex = anBest[i];
+		int bestIndex_2 = anBest_2[i];
+
+		if ((bestIndex >= 0 && alreadyMatched[bestIndex]) ||
+				(bestIndex_2 >= 0 && alreadyMatched[bestIndex_2]))
+		{
+			double bestDist = HUGE_VAL;
+			double bestDist_2 = HUGE_VAL;
+			bestIndex = -1;
+			bestIndex_2 = -1;
+
+			for (int r = 0; r < paoBase[s].GetRows(); r++)
+			{
+				int j = paoBase[s].GetIndex(r);
+				if (alreadyMatched[j])
+					continue;
+
+				double curDist = pfnDistance(
+						padfQuery, paoBase[s].GetRow(r), HUGE_VAL);
+
+				if (curDist < bestDist)
+				{
+					bestDist_2 = bestDist;
+					bestIndex_2 = bestIndex;
+					bestDist = curDist;
+					bestIndex = j;
+				}
+				else if (curDist < bestDist_2)
+				{
+					bestDist_2 = curDist;
+					bestIndex_2 = j;
+				}
+			}
+		}
+
+		if (bestIndex < 0 || bestIndex_2 < 0)
+			continue;
+
+		// Ratio test uses exact distances
+		double bestDist = sqrt(GDALDescriptorMatrix::GetSquaredDistance(
+				padfQuery, paoBase[s].GetRow(anBaseRow[bestIndex])));
+		double bestDist_2 = sqrt(GDALDescriptorMatrix::GetSquaredDistance(
+				padfQuery, paoBase[s].GetRow(anBaseRow[bestIndex_2])));
+
+		if (bestDist_2 > 0 && bestDist / bestDist_2 < ratioThreshold)
+		{
+			MatchedPointPairInfo info(i, bestIndex, bestDist);
+			poPairInfoList->push_back(info);
+			alreadyMatched[bestIndex] = true;
+		}
+	}
+
+	CPLErr eErr = AddMatchedPairs(poMatched, poPairInfoList, p_1, p_2, isSwap, dfThreshold, true);
+
+	delete poPairInfoList;
+
+	return eErr;
+}
+
+void GDALSimpleSURF::PackBySign(GDALFeaturePointsCollection *poCollection,
+		GDALDescriptorMatrix *paoMatrices, vector<int> *panRows)
+{
+	int nSize = poCollection->GetSize();
+	vector<int> anIndices[2];
+
+	panRows->assign(nSize, -1);
+
+	for (int i = 0; i < nSize; i++)
+	{
+		int nSign = poCollection->GetPoint(i)->GetSign();
+		if (nSign == 1 || nSign == -1)
+		{
+			int s = (nSign == 1) ? 0 : 1;
+			(*panRows)[i] = anIndices[s].size();
+			anIndices[s].push_back(i);
+		}
+	}
+
+	for (int s = 0; s < 2; s++)
+		if (!anIndices[s].empty())
+			paoMatrices[s].Initialize(poCollection,
+					&anIndices[s][0], anIndices[s].size());
+}
+
+/**
+ * Job of mutual matching: search the nearest points for range
+ * of rows of one matrix in another one.
+ */
+class MutualMatchingJob
+{
+public:
+	const GDALDescriptorMatrix *poQueries;
+	const GDALDescriptorMatrix *poBase;
+	int nFirstRow;
+	int nRows;
+	int *panBest;
+	int *panBest_2;
+	double *padfBest;
+	double *padfBest_2;
+};
+
+static void MutualMatchingJobFunc(void *pData, int iJob)
+{
+	MutualMatchingJob *poJob = ((MutualMatchingJob *)pData) + iJob;
+
+	GDALDescriptorMatrix::FindTwoNearest(*poJob->poQueries,
+			poJob->nFirstRow, poJob->nRows, *poJob->poBase,
+			poJob->panBest + poJob->nFirstRow,
+			poJob->padfBest + poJob->nFirstRow,
+			poJob->panBest_2 + poJob->nFirstRow,
+			poJob->padfBest_2 + poJob->nFirstRow);
+}
+
+CPLErr GDALSimpleSURF::MatchFeaturePointsMutual(
+		GDALMatchedPointsCollection *poMatched,
+		GDALFeaturePointsCollection *poFirstCollect,
+		GDALFeaturePointsCollection *poSecondCollect,
+		double dfThreshold, int nThreads)
+{
+/* -------------------------------------------------------------------- */
+/*      Validate parameters.                                            */
+/* -------------------------------------------------------------------- */
+	if (poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points colection isn't specified");
+		return CE_Failure;
+	}
+
+	if (poFirstCollect == NULL || poSecondCollect == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature point collections are not specified");
+		return CE_Failure;
+	}
+
+	// Affects to false matching pruning
+	const double ratioThreshold = 0.8;
+	// Number of query rows in one job
+	const int nJobRows = 256;
+
+	GDALDescriptorMatrix aoFirst[2];
+	GDALDescriptorMatrix aoSecond[2];
+	vector<int> anFirstRow;
+	vector<int> anSecondRow;
+
+	PackBySign(poFirstCollect, aoFirst, &anFirstRow);
+	PackBySign(poSecondCollect, aoSecond, &anSecondRow);
+
+/* -------------------------------------------------------------------- */
+/*      Search in both directions. Every job fills its own range of     */
+/*      result arrays, so result doesn't depend on number of threads.   */
+/*      Index 0 of arrays is for direction 1->2, index 1 - for 2->1.    */
+/* -------------------------------------------------------------------- */
+	vector<int> anBest[2][2];
+	vector<int> anBest_2[2][2];
+	vector<double> adfBest[2][2];
+	vector<double> adfBest_2[2][2];
+	vector<MutualMatchingJob> aoJobs;
+
+	for (int s = 0; s < 2; s++)
+	{
+		if (aoFirst[s].GetRows() == 0 || aoSecond[s].GetRows() == 0)
+			continue;
+
+		for (int d = 0; d < 2; d++)
+		{
+			const GDALDescriptorMatrix *poQueries = (d == 0) ? &aoFirst[s] : &aoSecond[s];
+			const GDALDescriptorMatrix *poBase = (d == 0) ? &aoSecond[s] : &aoFirst[s];
+			int nRows = poQueries->GetRows();
+
+			anBest[s][d].resize(nRows);
+			anBest_2[s][d].resize(nRows);
+			adfBest[s][d].resize(nRows);
+			adfBest_2[s][d].resize(nRows);
+
+			for (int r = 0; r < nRows; r += nJobRows)
+			{
+				MutualMatchingJob oJob;
+				oJob.poQueries = poQueries;
+				oJob.poBase = poBase;
+				oJob.nFirstRow = r;
+				oJob.nRows = (nRows - r < nJobRows) ? nRows - r : nJobRows;
+				oJob.panBest = &anBest[s][d][0];
+				oJob.panBest_2 = &anBest_2[s][d][0];
+				oJob.padfBest = &adfBest[s][d][0];
+				oJob.padfBest_2 = &adfBest_2[s][d][0];
+				aoJobs.push_back(oJob);
+			}
+		}
+	}
+
+	if (!aoJobs.empty())
+		GDALThreadPool::RunJobs(aoJobs.size(), MutualMatchingJobFunc,
+				&aoJobs[0], nThreads);
+
+/* ==================================================================== */
+/*      Keep pairs, which are nearest to each other and pass ratio      */
+/*      test in both directions. Pairs are ordered as the first         */
+/*      collection.                                                     */
+/* ==================================================================== */
+	vector<MatchedPointPairInfo> *poPairInfoList =
+			new vector<MatchedPointPairInfo>();
+
+	for (int i = 0; i < poFirstCollect->GetSize(); i++)
+	{
+		int r = anFirstRow[i];
+		if (r < 0)
+			continue;
+
+		int s = (poFirstCollect->GetPoint(i)->GetSign() == 1) ? 0 : 1;
+		if (anBest[s][0].empty())
+			continue;
+
+		int c = anBest[s][0][r];
+		if (c < 0 || anBest[s][1][c] != r)
+			continue;
+
+		// Ratio test uses exact distances
+		const double *padfFirst = aoFirst[s].GetRow(r);
+		const double *padfSecond = aoSecond[s].GetRow(c);
+		double bestDist = sqrt(GDALDescriptorMatrix::GetSquaredDistance(
+				padfFirst, padfSecond));
+
+		int r_2 = anBest_2[s][0][r];
+		int c_2 = anBest_2[s][1][c];
+		if (r_2 < 0 || c_2 < 0)
+			continue;
+
+		double forwardDist_2 = sqrt(GDALDescriptorMatrix::GetSquaredDistance(
+				padfFirst, aoSecond[s].GetRow(r_2)));
+		double backwardDist_2 = sqrt(GDALDescriptorMatrix::GetSquaredDistance(
+				padfSecond, aoFirst[s].GetRow(c_2)));
+
+		if (forwardDist_2 > 0 && bestDist / forwardDist_2 < ratioThreshold &&
+				backwardDist_2 > 0 && bestDist / backwardDist_2 < ratioThreshold)
+		{
+			MatchedPointPairInfo info(i, aoSecond[s].GetIndex(c), bestDist);
+			poPairInfoList->push_back(info);
+		}
+	}
+
+	CPLErr eErr = AddMatchedPairs(poMatched, poPairInfoList,
+			poFirstCollect, poSecondCollect, false, dfThreshold, true);
+
+	delete poPairInfoList;
+
+	return eErr;
+}
+
+CPLErr GDALSimpleSURF::ComputeAffinePrior(const double *padfFirstGeoTransform,
+		const double *padfSecondGeoTransform, double *padfTransform)
+{
+	double adfInverse[6];
+	if (!GDALInvGeoTransform((double *)padfSecondGeoTransform, adfInverse))
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Geotransform of the second image isn't invertible");
+		return CE_Failure;
+	}
+
+	const double *g = padfFirstGeoTransform;
+	const double *h = adfInverse;
+
+	// Composition: pixel/line of the 1st image -> georeferenced
+	// coordinates -> pixel/line of the 2nd image
+	padfTransform[0] = h[0] + h[1] * g[0] + h[2] * g[3];
+	padfTransform[1] = h[1] * g[1] + h[2] * g[4];
+	padfTransform[2] = h[1] * g[2] + h[2] * g[5];
+	padfTransform[3] = h[3] + h[4] * g[0] + h[5] * g[3];
+	padfTransform[4] = h[4] * g[1] + h[5] * g[4];
+	padfTransform[5] = h[4] * g[2] + h[5] * g[5];
+
+	return CE_None;
+}
+
+CPLErr GDALSimpleSURF::MatchFeaturePointsGuided(
+		GDALMatchedPointsCollection *poMatched,
+		GDALFeaturePointsCollection *poFirstCollect,
+		GDALFeaturePointsCollection *poSecondCollect,
+		double dfThreshold, const double *padfTransform,
+		double dfRadius)
+{
+/* -------------------------------------------------------------------- */
+/*      Validate parameters.                                            */
+/* -------------------------------------------------------------------- */
+	if (poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points colection isn't specified");
+		return CE_Failure;
+	}
+
+	if (poFirstCollect == NULL || poSecondCollect == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature point collections are not specified");
+		return CE_Failure;
+	}
+
+	if (padfTransform == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Transformation isn't specified");
+		return CE_Failure;
+	}
+
+	if (!(dfRadius > 0))
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Search radius should be positive");
+		return CE_Failure;
+	}
+
+	// Affects to false matching pruning
+	const double ratioThreshold = 0.8;
+
+	GDALSpatialGrid oGrid;
+	if (oGrid.Build(poSecondCollect, dfRadius) != CE_None)
+		return CE_Failure;
+
+	vector<MatchedPointPairInfo> *poPairInfoList =
+			new vector<MatchedPointPairInfo>();
+
+	// Flags that points in the 2nd collection are matched or not
+	vector<bool> alreadyMatched(poSecondCollect->GetSize(), false);
+
+	// Candidates of current point
+	vector<int> anCandidates;
+
+	GDALDescriptorMatrix::DistanceKernelFunc pfnDistance =
+			GDALDescriptorMatrix::GetDistanceKernel();
+
+	for (int i = 0; i < poFirstCollect->GetSize(); i++)
+	{
+		GDALFeaturePoint *poPoint = poFirstCollect->GetPoint(i);
+		const double *padfQuery = poPoint->GetDescriptor();
+
+		// Expected position on the 2nd image
+		double dfX = padfTransform[0] + poPoint->GetX() * padfTransform[1] +
+				poPoint->GetY() * padfTransform[2];
+		double dfY = padfTransform[3] + poPoint->GetX() * padfTransform[4] +
+				poPoint->GetY() * padfTransform[5];
+
+		oGrid.Query(dfX, dfY, dfRadius, &anCandidates);
+
+		// Squared distances to the nearest and the 2nd nearest points
+		double bestSquared = HUGE_VAL;
+		double bestSquared_2 = HUGE_VAL;
+		int bestIndex = -1;
+
+		for (size_t k = 0; k < anCandidates.size(); k++)
+		{
+			int j = anCandidates[k];
+			GDALFeaturePoint *poCandidate = poSecondCollect->GetPoint(j);
+
+			if (alreadyMatched[j] || poPoint->GetSign() != poCandidate->GetSign())
+				continue;
+
+			double curSquared = pfnDistance(
+					padfQuery, poCandidate->GetDescriptor(), bestSquared_2);
+			if (curSquared >= bestSquared_2)
+				continue;
+
+			if (curSquared < bestSquared)
+			{
+				bestSquared_2 = bestSquared;
+				bestSquared = curSquared;
+				bestIndex = j;
+			}
+			else
+			{
+				bestSquared_2 = curSquared;
+			}
+		}
+
+		if (bestIndex < 0 || bestSquared_2 <= 0)
+			continue;
+
+		// The only candidate within search radius is
+		// unambiguous and passes ratio test
+		double bestDist = sqrt(bestSquared);
+		if (bestSquared_2 == HUGE_VAL ||
+				bestDist / sqrt(bestSquared_2) < ratioThreshold)
+		{
+			MatchedPointPairInfo info(i, bestIndex, bestDist);
+			poPairInfoList->push_back(info);
+			alreadyMatched[bestIndex] = true;
+		}
+	}
+
+	CPLErr eErr = AddMatchedPairs(poMatched, poPairInfoList,
+			poFirstCollect, poSecondCollect, false, dfThreshold, true);
+
+	delete poPairInfoList;
+
+	return eErr;
+}
+
+CPLErr GDALSimpleSURF::MatchFeaturePointsPQ(
+		GDALMatchedPointsCollection *poMatched,
+		GDALFeaturePointsCollection *poCollect,
+		const GDALPQIndex *poIndex,
+		double dfThreshold, int nProbe, int nRerank,
+		vector<int> *panScenes, vector<int> *panScenePoints)
+{
+/* -------------------------------------------------------------------- */
+/*      Validate parameters.                                            */
+/* -------------------------------------------------------------------- */
+	if (poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points colection isn't specified");
+		return CE_Failure;
+	}
+
+	if (poCollect == NULL || poIndex == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature point collection or index isn't specified");
+		return CE_Failure;
+	}
+
+	if (poIndex->GetCodeSize() == 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Index isn't trained");
+		return CE_Failure;
+	}
+
+	if (poMatched->HasExternalSources())
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Indexed points can't be referred by external sources");
+		return CE_Failure;
+	}
+
+	// Affects to false matching pruning
+	const double ratioThreshold = 0.8;
+
+	vector<MatchedPointPairInfo> *poPairInfoList =
+			new vector<MatchedPointPairInfo>();
+
+	// Flags that indexed points are matched or not
+	bool *alreadyMatched = new bool[poIndex->GetSize()];
+	for (int i = 0; i < poIndex->GetSize(); i++)
+		alreadyMatched[i] = false;
+
+	for (int i = 0; i < poCollect->GetSize(); i++)
+	{
+		GDALFeaturePoint *poPoint = poCollect->GetPoint(i);
+
+		int bestIndex;
+		double bestSquared;
+		double bestSquared_2;
+		poIndex->FindTwoNearest(poPoint->GetDescriptor(), poPoint->GetSign(),
+				nProbe, nRerank, alreadyMatched,
+				&bestIndex, &bestSquared, &bestSquared_2);
+
+		if (bestIndex < 0 || bestSquared_2 <= 0)
+			continue;
+
+		double bestDist = sqrt(bestSquared);
+		if (bestDist / sqrt(bestSquared_2) < ratioThreshold)
+		{
+			MatchedPointPairInfo info(i, bestIndex, bestDist);
+			poPairInfoList->push_back(info);
+			alreadyMatched[bestIndex] = true;
+		}
+	}
+
+/* -------------------------------------------------------------------- */
+/*      Pruning based on the provided threshold. Indexed points may     */
+/*      belong to different scenes, so they are restored by entry.      */
+/* -------------------------------------------------------------------- */
+	NormalizeDistances(poPairInfoList);
+
+	GDALFeaturePoint oIndexedPoint;
+	vector<MatchedPointPairInfo>::const_iterator iter;
+	for (iter = poPairInfoList->begin(); iter != poPairInfoList->end(); iter++)
+	{
+		if ((*iter).euclideanDist <= dfThreshold)
+		{
+			poIndex->GetPoint((*iter).ind_2, &oIndexedPoint);
+			poMatched->AddPointCopies(*poCollect->GetPoint((*iter).ind_1),
+					oIndexedPoint, (*iter).euclideanDist);
+
+			if (panScenes != NULL)
+				panScenes->push_back(poIndex->GetScene((*iter).ind_2));
+			if (panScenePoints != NULL)
+				panScenePoints->push_back(poIndex->GetPointIndex((*iter).ind_2));
+		}
+	}
+
+	// Clean up
+	delete[] alreadyMatched;
+	delete poPairInfoList;
+
+	return CE_None;
+}
+
+double GDALSimpleSURF::ComputeMatchingRecall(
+		GDALMatchedPointsCollection *poReference,
+		GDALMatchedPointsCollection *poMatched)
+{
+	if (poReference == NULL || poMatched == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Matched points collections are not specified");
+		return -1;
+	}
+
+	if (poReference->GetSize() == 0)
+		return 1;
+
+	// Pairs are identified by coordinates and scales of both points
+	set< vector<int> > oFound;
+	vector<int> anKey(6);
+
+	for (int i = 0; i < poMatched->GetSize(); i++)
+	{
+		const GDALFeaturePoint *poPoint_1 = poMatched->GetFirstPoint(i);
+		const GDALFeaturePoint *poPoint_2 = poMatched->GetSecondPoint(i);
+		anKey[0] = poPoint_1->GetX(); anKey[1] = poPoint_1->GetY();
+		anKey[2] = poPoint_1->GetScale();
+		anKey[3] = poPoint_2->GetX(); anKey[4] = poPoint_2->GetY();
+		anKey[5] = poPoint_2->GetScale();
+		oFound.insert(anKey);
+	}
+
+	int nRecalled = 0;
+	for (int i = 0; i < poReference->GetSize(); i++)
+	{
+		const GDALFeaturePoint *poPoint_1 = poReference->GetFirstPoint(i);
+		const GDALFeaturePoint *poPoint_2 = poReference->GetSecondPoint(i);
+		anKey[0] = poPoint_1->GetX(); anKey[1] = poPoint_1->GetY();
+		anKey[2] = poPoint_1->GetScale();
+		anKey[3] = poPoint_2->GetX(); anKey[4] = poPoint_2->GetY();
+		anKey[5] = poPoint_2->GetScale();
+		if (oFound.count(anKey) > 0)
+			nRecalled++;
+	}
+
+	return (double)nRecalled / poReference->GetSize();
+}
+
 GDALSimpleSURF::~GDALSimpleSURF()
 {
 	delete poOctMap;
@@ -0,0 +1,149 @@
+#include "GDALSpatialGrid.h"
+
+#include <algorithm>
+#include <math.h>
+
+GDALSpatialGrid::GDALSpatialGrid()
+{
+	dfCellSize = 1;
+	dfMinX = 0;
+	dfMinY = 0;
+	nCols = 0;
+	nRows = 0;
+}
+
+int GDALSpatialGrid::GetSize() const
+{
+	return adfX.size();
+}
+
+CPLErr GDALSpatialGrid::Build(GDALFeaturePointsCollection *poCollection,
+		double dfCellSize)
+{
+	if (poCollection == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Feature point collection isn't specified");
+		return CE_Failure;
+	}
+
+	if (!(dfCellSize > 0))
+	{
+		CPLError(CE_Failure, CPLE_AppDefined,
+				"Cell size should be positive");
+		return CE_Failure;
+	}
+
+	int nSize = poCollection->GetSize();
+
+	this->dfCellSize = dfCellSize;
+	adfX.resize(nSize);
+	adfY.resize(nSize);
+	anPoints.resize(nSize);
+
+	double dfMaxX = 0;
+	double dfMaxY = 0;
+	dfMinX = 0;
+	dfMinY = 0;
+	for (int i = 0; i < nSize; i++)
+	{
+		adfX[i] = poCollection->GetPoint(i)->GetX();
+		adfY[i] = poCollection->GetPoint(i)->GetY();
+
+		if (i == 0 || adfX[i] < dfMinX) dfMinX = adfX[i];
+		if (i == 0 || adfY[i] < dfMinY) dfMinY = adfY[i];
+		if (i == 0 || adfX[i] > dfMaxX) dfMaxX = adfX[i];
+		if (i == 0 || adfY[i] > dfMaxY) dfMaxY = adfY[i];
+	}
+
+	// Too small cells are enlarged, so number of cells
+	// doesn't exceed number of points much
+	double dfMaxCells = 16.0 * max(nSize, 1);
+	while (((dfMaxX - dfMinX) / this->dfCellSize + 1) *
+			((dfMaxY - dfMinY) / this->dfCellSize + 1) > dfMaxCells)
+		this->dfCellSize *= 2;
+
+	nCols = (int)floor((dfMaxX - dfMinX) / this->dfCellSize) + 1;
+	nRows = (int)floor((dfMaxY - dfMinY) / this->dfCellSize) + 1;
+
+/* -------------------------------------------------------------------- */
+/*      Counting sort of points by cell. Points of every cell keep      */
+/*      order of collection.                                            */
+/* -------------------------------------------------------------------- */
+	vector<int> anCell(nSize);
+	anCellStart.assign(nCols * nRows + 1, 0);
+
+	for (int i = 0; i < nSize; i++)
+	{
+		int nCol = (int)((adfX[i] - dfMinX) / this->dfCellSize);
+		int nRow = (int)((adfY[i] - dfMinY) / this->dfCellSize);
+		anCell[i] = nRow * nCols + nCol;
+		anCellStart[anCell[i] + 1]++;
+	}
+
+	for (int c = 0; c < nCols * nRows; c++)
+		anCellStart[c + 1] += anCellStart[c];
+
+	vector<int> anFill(anCellStart.begin(), anCellStart.end() - 1);
+	for (int i = 0; i < nSize; i++)
+		anPoints[anFill[anCell[i]]++] = i;
+
+	return CE_None;
+}
+
+/**
+ * Limit cell number to [-1, nCells], which keeps position of cell
+ * outside of grid and fits into int.
+ */
+static double ClampCell(double dfCell, int nCells)
+{
+	return MIN(MAX(dfCell, -1.0), (double)nCells);
+}
+
+void GDALSpatialGrid::Query(double dfX, double dfY, double dfRadius,
+		vector<int> *panIndices) const
+{
+	panIndices->clear();
+
+	if (adfX.empty() || dfRadius < 0)
+		return;
+
+	// Center may come from arbitrary transformation
+	if (!CPLIsFinite(dfX) || !CPLIsFinite(dfY) || !CPLIsFinite(dfRadius))
+		return;
+
+	// Range of cells, which intersect bounding box of circle.
+	// Cells are clamped in double, so conversion to int is defined
+	int nColStart = (int)ClampCell(
+			floor((dfX - dfRadius - dfMinX) / dfCellSize), nCols);
+	int nColEnd = (int)ClampCell(
+			floor((dfX + dfRadius - dfMinX) / dfCellSize), nCols);
+	int nRowStart = (int)ClampCell(
+			floor((dfY - dfRadius - dfMinY) / dfCellSize), nRows);
+	int nRowEnd = (int)ClampCell(
+			floor((dfY + dfRadius - dfMinY) / dfCellSize), nRows);
+
+	nColStart = max(nColStart, 0);
+	nRowStart = max(nRowStart, 0);
+	nColEnd = min(nColEnd, nCols - 1);
+	nRowEnd = min(nRowEnd, nRows - 1);
+
+	double dfRadiusSquared = dfRadius * dfRadius;
+
+	for (int nRow = nRowStart; nRow <= nRowEnd; nRow++)
+		for (int nCol = nColStart; nCol <= nColEnd; nCol++)
+		{
+			int c = nRow * nCols + nCol;
+			for (int k = anCellStart[c]; k < anCellStart[c + 1]; k++)
+			{
+				int i = anPoints[k];
+				double dfDX = adfX[i] - dfX;
+				double dfDY = adfY[i] - dfY;
+
+				if (dfDX * dfDX + dfDY * dfDY <= dfRadiusSquared)
+					panIndices->push_back(i);
+			}
+		}
+
+	sort(panIndices->begin(), panIndices->end());
+}
@@ -0,0 +1,96 @@
+#include "GDALSyntheticRaster.h"
+
+#include "cpl_conv.h"
+
+#include <math.h>
+
+double GDALSyntheticRaster::NextRandom(GUInt32 *pnState)
+{
+	*pnState = *pnState * 1664525U + 1013904223U;
+	return (*pnState >> 8) / 16777216.0;
+}
+
+void GDALSyntheticRaster::GenerateTexture(float *pafField, int nWidth,
+		int nHeight, double dfDensity, GUInt32 nSeed)
+{
+	for (int i = 0; i < nHeight; i++)
+		for (int j = 0; j < nWidth; j++)
+			pafField[(size_t)i * nWidth + j] =
+					(float)(64.0 + 32.0 * (i + j) / (nWidth + nHeight));
+
+	GUInt32 nState = nSeed;
+	int nBlobs = (int)(dfDensity * nWidth * nHeight / 1e6);
+
+	for (int b = 0; b < nBlobs; b++)
+	{
+		double dfX = NextRandom(&nState) * nWidth;
+		double dfY = NextRandom(&nState) * nHeight;
+		double dfRadius = 2.0 + NextRandom(&nState) * 10.0;
+		double dfAmplitude = (NextRandom(&nState) - 0.5) * 160.0;
+
+		int nReach = (int)(3 * dfRadius);
+		int nRowStart = MAX((int)dfY - nReach, 0);
+		int nRowEnd = MIN((int)dfY + nReach, nHeight - 1);
+		int nColStart = MAX((int)dfX - nReach, 0);
+		int nColEnd = MIN((int)dfX + nReach, nWidth - 1);
+		double dfFactor = -1.0 / (2 * dfRadius * dfRadius);
+
+		for (int i = nRowStart; i <= nRowEnd; i++)
+			for (int j = nColStart; j <= nColEnd; j++)
+			{
+				double dfDist2 = (i - dfY) * (i - dfY) + (j - dfX) * (j - dfX);
+				pafField[(size_t)i * nWidth + j] +=
+						(float)(dfAmplitude * exp(dfDist2 * dfFactor));
+			}
+	}
+
+	for (size_t k = 0; k < (size_t)nWidth * nHeight; k++)
+		pafField[k] = MIN(MAX(pafField[k], 0.0f), 255.0f);
+}
+
+GDALDataset *GDALSyntheticRaster::Create(const float *pafField,
+		int nFieldWidth, int nXOff, int nYOff, int nWidth, int nHeight,
+		GDALDataType eType)
+{
+	GDALDriver *poDriver = GetGDALDriverManager()->GetDriverByName("MEM");
+	if (poDriver == NULL)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "MEM driver isn't available");
+		return NULL;
+	}
+
+	GDALDataset *poDataset = poDriver->Create("", nWidth, nHeight, 3,
+			eType, NULL);
+	if (poDataset == NULL)
+		return NULL;
+
+	float *pafRow = new float[nWidth];
+	CPLErr eErr = CE_None;
+
+	for (int b = 0; b < 3 && eErr == CE_None; b++)
+	{
+		GDALRasterBand *poBand = poDataset->GetRasterBand(b + 1);
+		double dfContrast = 0.9 - 0.05 * b;
+
+		for (int i = 0; i < nHeight && eErr == CE_None; i++)
+		{
+			const float *pafSource =
+					pafField + (size_t)(i + nYOff) * nFieldWidth + nXOff;
+			for (int j = 0; j < nWidth; j++)
+				pafRow[j] = (float)floor(pafSource[j] * dfContrast + 10 * b + 0.5);
+
+			eErr = poBand->RasterIO(GF_Write, 0, i, nWidth, 1,
+					pafRow, nWidth, 1, GDT_Float32, 0, 0);
+		}
+	}
+
+	delete[] pafRow;
+
+	if (eErr != CE_None)
+	{
+		GDALClose((GDALDatasetH)poDataset);
+		return NULL;
+	}
+
+	return poDataset;
+}
@@ -0,0 +1,77 @@
+#include "GDALThreadPool.h"
+
+#include "cpl_conv.h"
+
+#include <vector>
+
+using namespace std;
+
+int GDALThreadPool::GetDefaultThreadCount()
+{
+	const char *pszThreads = CPLGetConfigOption("GDAL_NUM_THREADS", NULL);
+	int nThreads = 0;
+
+	if (pszThreads == NULL || EQUAL(pszThreads, "ALL_CPUS"))
+		nThreads = CPLGetNumCPUs();
+	else
+		nThreads = atoi(pszThreads);
+
+	return (nThreads > 0) ? nThreads : 1;
+}
+
+void GDALThreadPool::WorkerFunc(void *pQueue)
+{
+	Queue *poQueue = (Queue *)pQueue;
+
+	while (true)
+	{
+		CPLAcquireMutex(poQueue->hMutex, 1000.0);
+		int iJob = poQueue->nNextJob++;
+		CPLReleaseMutex(poQueue->hMutex);
+
+		if (iJob >= poQueue->nJobs)
+			break;
+
+		poQueue->pfnJob(poQueue->pData, iJob);
+	}
+}
+
+void GDALThreadPool::RunJobs(int nJobs, JobFunc pfnJob, void *pData, int nThreads)
+{
+	if (nThreads <= 0)
+		nThreads = GetDefaultThreadCount();
+	if (nThreads > nJobs)
+		nThreads = nJobs;
+
+	// Nothing to parallelize
+	if (nThreads <= 1)
+	{
+		for (int i = 0; i < nJobs; i++)
+			pfnJob(pData, i);
+		return;
+	}
+
+	Queue oQueue;
+	oQueue.pfnJob = pfnJob;
+	oQueue.pData = pData;
+	oQueue.nJobs = nJobs;
+	oQueue.nNextJob = 0;
+	oQueue.hMutex = CPLCreateMutex();
+	CPLReleaseMutex(oQueue.hMutex);
+
+	vector<CPLJoinableThread *> apoThreads;
+	for (int i = 0; i < nThreads - 1; i++)
+	{
+		CPLJoinableThread *poThread = CPLCreateJoinableThread(WorkerFunc, &oQueue);
+		if (poThread != NULL)
+			apoThreads.push_back(poThread);
+	}
+
+	// Calling thread works too
+	WorkerFunc(&oQueue);
+
+	for (size_t i = 0; i < apoThreads.size(); i++)
+		CPLJoinThread(apoThreads[i]);
+
+	CPLDestroyMutex(oQueue.hMutex);
+}